@@ -639,6 +639,30 @@ SystemInterface
   return thumbdir + "/" + code + ".png";
 }
 
+std::string
+SystemInterface
+::GetMeshCacheDirectory()
+{
+  string appdir = this->GetApplicationDataDirectory();
+  string cachedir = appdir + "/MeshCache";
+  if(!SystemTools::MakeDirectory(cachedir.c_str()))
+    throw IRISException("Unable to create mesh cache directory %s",
+                        cachedir.c_str());
+  return cachedir;
+}
+
+std::string
+SystemInterface
+::GetDicomDirectoryIndexFileName()
+{
+  // Kept next to the user preferences
+  string appdir = this->GetApplicationDataDirectory();
+  if(!SystemTools::MakeDirectory(appdir.c_str()))
+    throw IRISException("Unable to create application data directory %s",
+                        appdir.c_str());
+  return appdir + "/DicomDirectoryIndex.txt";
+}
+
 void SystemInterface
 ::WriteThumbnail(
     const char *associated_file, ThumbnailImageType *thumbnail)
@@ -120,6 +120,12 @@ public:
   /** Get the thumbnail filename associated with an image file */
   std::string GetThumbnailAssociatedWithFile(const char *file);
 
+  /** Get the directory of the persistent mesh cache (see MeshCache) */
+  std::string GetMeshCacheDirectory();
+
+  /** Get the file of the persistent DICOM directory index */
+  std::string GetDicomDirectoryIndexFileName();
+
   /** Write a thumbnail */
   void WriteThumbnail(const char *associated_file, ThumbnailImageType *thumbnail);
 
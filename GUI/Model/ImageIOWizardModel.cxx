@@ -73,6 +73,7 @@ ImageIOWizardModel
   m_HistoryName = delegate->GetHistoryName();
   m_DisplayName = delegate->GetDisplayName();
   m_GuidedIO = GuidedNativeImageIO::New();
+  m_GuidedIO->SetDicomDirectoryIndex(parent->GetDriver()->GetDicomDirectoryIndex());
   m_LoadDelegate = delegate;
   m_SaveDelegate = NULL;
   m_Overlay = delegate->IsOverlay();
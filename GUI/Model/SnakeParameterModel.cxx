@@ -26,6 +26,9 @@ SnakeParameterModel::SnakeParameterModel()
   m_SpeedupFactorModel = wrapGetterSetterPairAsProperty(
         this, &Self::GetSpeedupFactorValueAndRange, &Self::SetSpeedupFactorValue);
 
+  m_SolverModel = wrapGetterSetterPairAsProperty(
+        this, &Self::GetSolverValueAndRange, &Self::SetSolverValue);
+
   m_AdvancedEquationModeModel = NewSimpleConcreteProperty(false);
 
   m_CasellesOrAdvancedModeModel = wrapGetterSetterPairAsProperty(
@@ -372,6 +375,34 @@ SnakeParameterModel
   m_ParametersModel->SetValue(param);
 }
 
+bool
+SnakeParameterModel
+::GetSolverValueAndRange(
+    SnakeParameters::SolverType &value, SolverDomain *domain)
+{
+  SnakeParameters param = m_ParametersModel->GetValue();
+  value = param.GetSolver();
+
+  // Only the solvers that SNAPLevelSetDriver implements are listed
+  if(domain)
+    {
+    domain->clear();
+    (*domain)[SnakeParameters::PARALLEL_SPARSE_FIELD_SOLVER] = "Parallel sparse field";
+    (*domain)[SnakeParameters::SPARSE_FIELD_SOLVER] = "Active layer sparse field";
+    }
+
+  return true;
+}
+
+void
+SnakeParameterModel
+::SetSolverValue(SnakeParameters::SolverType value)
+{
+  SnakeParameters param = m_ParametersModel->GetValue();
+  param.SetSolver(value);
+  m_ParametersModel->SetValue(param);
+}
+
 bool SnakeParameterModel::GetCasellesOrAdvancedModeValue()
 {
   return this->GetAdvancedEquationModeModel()->GetValue() || (!this->IsRegionSnake());
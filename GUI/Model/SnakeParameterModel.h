@@ -55,6 +55,10 @@ public:
   // Speedup factor
   irisRangedPropertyAccessMacro(SpeedupFactor, double)
 
+  // Level set solver
+  typedef SimpleItemSetDomain<SnakeParameters::SolverType, std::string> SolverDomain;
+  irisGenericPropertyAccessMacro(Solver, SnakeParameters::SolverType, SolverDomain)
+
   // The model for whether the advanced mode (exponents) is on
   irisSimplePropertyAccessMacro(AdvancedEquationMode, bool)
   irisSimplePropertyAccessMacro(CasellesOrAdvancedMode, bool)
@@ -100,6 +104,12 @@ protected:
       double &value, NumericValueRange<double> *domain);
   void SetSpeedupFactorValue(double value);
 
+  typedef AbstractPropertyModel<SnakeParameters::SolverType, SolverDomain> AbstractSolverModel;
+  SmartPtr<AbstractSolverModel> m_SolverModel;
+  bool GetSolverValueAndRange(
+      SnakeParameters::SolverType &value, SolverDomain *domain);
+  void SetSolverValue(SnakeParameters::SolverType value);
+
   SmartPtr<ConcreteSimpleBooleanProperty> m_AdvancedEquationModeModel;
 
   SmartPtr<AbstractSimpleBooleanProperty> m_CasellesOrAdvancedModeModel;
@@ -105,6 +105,13 @@ SnakeWizardModel::SnakeWizardModel()
         EdgePreprocessingSettingsUpdateEvent(),
         EdgePreprocessingSettingsUpdateEvent());
 
+  m_EdgePreprocessingUseRecursiveGaussianModel = wrapGetterSetterPairAsProperty(
+        this,
+        &Self::GetEdgePreprocessingUseRecursiveGaussianValue,
+        &Self::SetEdgePreprocessingUseRecursiveGaussianValue,
+        EdgePreprocessingSettingsUpdateEvent(),
+        EdgePreprocessingSettingsUpdateEvent());
+
   m_SnakeTypeModel = wrapGetterSetterPairAsProperty(
         this,
         &Self::GetSnakeTypeValueAndRange,
@@ -192,6 +199,20 @@ SnakeWizardModel::SnakeWizardModel()
         RFClassifierModifiedEvent(),
         RFClassifierModifiedEvent());
 
+  m_ClassifierMaximumNumberOfSamplesModel = wrapGetterSetterPairAsProperty(
+        this,
+        &Self::GetClassifierMaximumNumberOfSamplesValueAndRange,
+        &Self::SetClassifierMaximumNumberOfSamplesValue,
+        RFClassifierModifiedEvent(),
+        RFClassifierModifiedEvent());
+
+  m_ClassifierIncrementalTrainingModel = wrapGetterSetterPairAsProperty(
+        this,
+        &Self::GetClassifierIncrementalTrainingValue,
+        &Self::SetClassifierIncrementalTrainingValue,
+        RFClassifierModifiedEvent(),
+        RFClassifierModifiedEvent());
+
   m_ClassifierBiasModel = wrapGetterSetterPairAsProperty(
         this,
         &Self::GetClassifierBiasValueAndRange,
@@ -562,6 +583,48 @@ void SnakeWizardModel::SetClassifierUseCoordinatesValue(bool value)
   InvokeEvent(RFClassifierModifiedEvent());
 }
 
+bool SnakeWizardModel::GetClassifierMaximumNumberOfSamplesValueAndRange(
+    int &value, NumericValueRange<int> *range)
+{
+  // Must have a classification engine
+  IRISApplication::RFEngine *rfe = m_Driver->GetClassificationEngine();
+  if(!rfe)
+    return false;
+
+  value = (int) rfe->GetMaximumNumberOfSamples();
+  if(range)
+    range->Set(10000, 10000000, 10000);
+
+  return true;
+}
+
+void SnakeWizardModel::SetClassifierMaximumNumberOfSamplesValue(int value)
+{
+  IRISApplication::RFEngine *rfe = m_Driver->GetClassificationEngine();
+  assert(rfe);
+  rfe->SetMaximumNumberOfSamples(value);
+  InvokeEvent(RFClassifierModifiedEvent());
+}
+
+bool SnakeWizardModel::GetClassifierIncrementalTrainingValue(bool &value)
+{
+  // Must have a classification engine
+  IRISApplication::RFEngine *rfe = m_Driver->GetClassificationEngine();
+  if(!rfe)
+    return false;
+
+  value = rfe->GetIncrementalTraining();
+  return true;
+}
+
+void SnakeWizardModel::SetClassifierIncrementalTrainingValue(bool value)
+{
+  IRISApplication::RFEngine *rfe = m_Driver->GetClassificationEngine();
+  assert(rfe);
+  rfe->SetIncrementalTraining(value);
+  InvokeEvent(RFClassifierModifiedEvent());
+}
+
 bool SnakeWizardModel
 ::GetClassifierLabelForegroundValueAndRange(
     ClassifierLabelForegroundMap &value, ClassifierLabelForegroundMapDomain *range)
@@ -1098,6 +1161,26 @@ SnakeWizardModel
   eps->SetRemappingExponent(x);
 }
 
+bool
+SnakeWizardModel
+::GetEdgePreprocessingUseRecursiveGaussianValue(bool &value)
+{
+  if(!AreEdgePreprocessingModelsActive())
+    return false;
+
+  EdgePreprocessingSettings *eps = m_Driver->GetEdgePreprocessingSettings();
+  value = eps->GetUseRecursiveGaussian();
+  return true;
+}
+
+void
+SnakeWizardModel
+::SetEdgePreprocessingUseRecursiveGaussianValue(bool value)
+{
+  EdgePreprocessingSettings *eps = m_Driver->GetEdgePreprocessingSettings();
+  eps->SetUseRecursiveGaussian(value);
+}
+
 
 void SnakeWizardModel
 ::EvaluateEdgePreprocessingFunction(unsigned int n, float *x, float *y)
@@ -1432,6 +1515,39 @@ bool SnakeWizardModel::PerformEvolutionStep()
   return false;
 }
 
+void SnakeWizardModel::StartEvolution()
+{
+  m_Driver->GetSNAPImageData()->StartSegmentationThread(m_StepSizeModel->GetValue());
+}
+
+void SnakeWizardModel::PauseEvolution()
+{
+  SNAPImageData *sid = m_Driver->GetSNAPImageData();
+  if(sid && sid->IsSegmentationActive())
+    {
+    sid->PauseSegmentationThread();
+
+    // Show the result of the last step taken
+    if(sid->UpdateSnakeFromSegmentationThread())
+      InvokeEvent(EvolutionIterationEvent());
+    }
+}
+
+bool SnakeWizardModel::UpdateEvolution()
+{
+  // Apply changes to the step size made while playing
+  SNAPImageData *sid = m_Driver->GetSNAPImageData();
+  if(sid->IsSegmentationThreadRunning())
+    sid->StartSegmentationThread(m_StepSizeModel->GetValue());
+
+  // Pick up the level set computed in the background
+  if(sid->UpdateSnakeFromSegmentationThread())
+    InvokeEvent(EvolutionIterationEvent());
+
+  // As in PerformEvolutionStep(), convergence is not checked
+  return false;
+}
+
 int SnakeWizardModel::GetEvolutionIterationValue()
 {
   if(m_Driver->IsSnakeModeActive() &&
@@ -118,6 +118,7 @@ public:
   irisGetMacro(EdgePreprocessingSigmaModel, AbstractRangedDoubleProperty *)
   irisGetMacro(EdgePreprocessingKappaModel, AbstractRangedDoubleProperty *)
   irisGetMacro(EdgePreprocessingExponentModel, AbstractRangedDoubleProperty *)
+  irisGetMacro(EdgePreprocessingUseRecursiveGaussianModel, AbstractSimpleBooleanProperty *)
 
 
   // Called when entering proprocessing mode (i.e., back from button page)
@@ -208,6 +209,24 @@ public:
    */
   bool PerformEvolutionStep();
 
+  /**
+   * Start evolving the snake in the background, taking steps of the current
+   * step size until paused. Call UpdateEvolution() periodically to show the
+   * progress.
+   */
+  void StartEvolution();
+
+  /** Stop evolving the snake in the background */
+  void PauseEvolution();
+
+  /**
+   * Show the latest result of the background evolution, if there is a new
+   * one. Returns true if the evolution has converged. Throws the exception
+   * of a step that failed in the background, after which the evolution is
+   * no longer running.
+   */
+  bool UpdateEvolution();
+
   /** Rewind the evolution */
   void RewindEvolution();
 
@@ -290,6 +309,12 @@ public:
   /** Whether coordinates are used as contextual features */
   irisSimplePropertyAccessMacro(ClassifierUseCoordinates, bool)
 
+  /** Maximum number of labeled voxels used to train the classifier */
+  irisRangedPropertyAccessMacro(ClassifierMaximumNumberOfSamples, int)
+
+  /** Whether retraining only replaces some of the trees of the classifier */
+  irisSimplePropertyAccessMacro(ClassifierIncrementalTraining, bool)
+
   /** Train the random forest classifier when the user hits the 'train' button */
   void TrainClassifier();
 
@@ -351,6 +376,10 @@ protected:
   bool GetEdgePreprocessingKappaValueAndRange(double &x, NumericValueRange<double> *range);
   void SetEdgePreprocessingKappaValue(double x);
 
+  SmartPtr<AbstractSimpleBooleanProperty> m_EdgePreprocessingUseRecursiveGaussianModel;
+  bool GetEdgePreprocessingUseRecursiveGaussianValue(bool &value);
+  void SetEdgePreprocessingUseRecursiveGaussianValue(bool value);
+
   SmartPtr<AbstractSnakeTypeModel> m_SnakeTypeModel;
   bool GetSnakeTypeValueAndRange(SnakeType &value, GlobalState::SnakeTypeDomain *range);
   void SetSnakeTypeValue(SnakeType value);
@@ -470,6 +499,14 @@ protected:
   bool GetClassifierUseCoordinatesValue(bool &value);
   void SetClassifierUseCoordinatesValue(bool value);
 
+  SmartPtr<AbstractRangedIntProperty> m_ClassifierMaximumNumberOfSamplesModel;
+  bool GetClassifierMaximumNumberOfSamplesValueAndRange(int &value, NumericValueRange<int> *range);
+  void SetClassifierMaximumNumberOfSamplesValue(int value);
+
+  SmartPtr<AbstractSimpleBooleanProperty> m_ClassifierIncrementalTrainingModel;
+  bool GetClassifierIncrementalTrainingValue(bool &value);
+  void SetClassifierIncrementalTrainingValue(bool value);
+
   SmartPtr<AbstractClassifierLabelForegroundModel> m_ClassifierLabelForegroundModel;
   bool GetClassifierLabelForegroundValueAndRange(ClassifierLabelForegroundMap &value,
                                               ClassifierLabelForegroundMapDomain *range);
@@ -14,6 +14,7 @@
 #include "QtDoubleSpinBoxCoupling.h"
 #include "QtSliderCoupling.h"
 #include "QtRadioButtonCoupling.h"
+#include "QtCheckBoxCoupling.h"
 #include "ColorLabelQuickListWidget.h"
 #include "IRISException.h"
 #include <QMessageBox>
@@ -238,6 +239,7 @@ void SnakeWizardPanel::SetModel(GlobalUIModel *model)
   // Couple the edge preprocessing controls
   makeCoupling(ui->inEdgeScale, m_Model->GetEdgePreprocessingSigmaModel());
   makeCoupling(ui->inEdgeScaleSlider, m_Model->GetEdgePreprocessingSigmaModel());
+  makeCoupling(ui->inEdgeRecursiveGaussian, m_Model->GetEdgePreprocessingUseRecursiveGaussianModel());
 
   // Initialize the label quick list
   ui->boxLabelQuickList->SetModel(m_Model->GetParent());
@@ -340,18 +342,41 @@ void SnakeWizardPanel::on_stack_currentChanged(int page)
 
 void SnakeWizardPanel::on_btnPlay_toggled(bool checked)
 {
-  // This is where we toggle the snake evolution!
+  // This is where we toggle the snake evolution! The snake evolves in a
+  // background thread, and the timer shows its progress at display rate.
   if(checked)
-    m_EvolutionTimer->start(10);
+    {
+    m_Model->StartEvolution();
+    m_EvolutionTimer->start(30);
+    }
   else
+    {
     m_EvolutionTimer->stop();
+    try
+    {
+      m_Model->PauseEvolution();
+    }
+    catch(std::exception &exc)
+    {
+      ReportNonLethalException(this, exc, "Snake Evolution Failed");
+    }
+    }
 }
 
 void SnakeWizardPanel::idleCallback()
 {
-  // Step the snake. If converged (returns true), stop playing
-  if(m_Model->PerformEvolutionStep())
+  // Show the latest snake. If converged (returns true), stop playing
+  try
+  {
+    if(m_Model->UpdateEvolution())
+      ui->btnPlay->setChecked(false);
+  }
+  catch(std::exception &exc)
+  {
+    // The evolution has stopped; unchecking the button stops the timer
     ui->btnPlay->setChecked(false);
+    ReportNonLethalException(this, exc, "Snake Evolution Failed");
+  }
 }
 
 void SnakeWizardPanel::on_btnSingleStep_clicked()
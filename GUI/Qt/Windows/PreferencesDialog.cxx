@@ -107,6 +107,9 @@ void PreferencesDialog::SetModel(GlobalPreferencesModel *model)
   makeCoupling(ui->chkSyncPan, dbs->GetSyncPanModel());
   makeCoupling(ui->chkCheckForUpdates, m_Model->GetCheckForUpdateModel());
   makeCoupling(ui->chkAutoContrast, dbs->GetAutoContrastModel());
+  makeCoupling(ui->inTimePointPagerWindow, dbs->GetTimePointPagerWindowModel());
+  makeCoupling(ui->inTimePointPagerRecent, dbs->GetTimePointPagerRecentTimePointsModel());
+  makeCoupling(ui->inQuantileSamplingRate, dbs->GetIntensityQuantileLog2SamplingRateModel());
 
   // Hook up the display layout properties
   GlobalDisplaySettings *gds = m_Model->GetGlobalDisplaySettings();
@@ -185,6 +188,9 @@ void PreferencesDialog::SetModel(GlobalPreferencesModel *model)
   // Hook up the mesh options
   MeshOptions *mo = m_Model->GetMeshOptions();
 
+  makeCoupling(ui->chkDiscreteMeshing, mo->GetUseDiscreteMeshingModel());
+  makeCoupling(ui->inDiscreteRelaxationIterations, mo->GetDiscreteRelaxationIterationsModel());
+
   makeCoupling(ui->chkGaussianSmooth, mo->GetUseGaussianSmoothingModel());
   makeCoupling(ui->inGaussianSmoothDeviation, mo->GetGaussianStandardDeviationModel());
   makeCoupling(ui->inGaussianSmoothMaxError, mo->GetGaussianErrorModel());
@@ -6,6 +6,7 @@
 #include "QtSliderCoupling.h"
 #include "QtSpinBoxCoupling.h"
 #include "QtDoubleSpinBoxCoupling.h"
+#include "QtComboBoxCoupling.h"
 #include "SnakeParameterPreviewRenderer.h"
 #include "SnakeParametersPreviewPipeline.h"
 #include "SNAPQtCommon.h"
@@ -74,6 +75,8 @@ void SnakeParameterDialog::SetModel(SnakeParameterModel *model)
   makeCoupling(ui->inSpeedup, m_Model->GetSpeedupFactorModel());
   makeCoupling(ui->inSpeedupSlider, m_Model->GetSpeedupFactorModel());
 
+  makeCoupling(ui->inSolver, m_Model->GetSolverModel());
+
   // Couple the advanced checkbox
   makeCoupling(ui->chkAdvanced, m_Model->GetAdvancedEquationModeModel());
 
@@ -111,6 +111,8 @@ void SpeedImageDialog::SetModel(SnakeWizardModel *model)
   makeCoupling(ui->inClassifierTreeNumber, m_Model->GetForestSizeModel());
   makeCoupling(ui->inClassifierTreeDepth, m_Model->GetTreeDepthModel());
   makeCoupling(ui->inClassifyBias, m_Model->GetClassifierBiasModel());
+  makeCoupling(ui->inClassifierMaxSamples, m_Model->GetClassifierMaximumNumberOfSamplesModel());
+  makeCoupling(ui->inClassifierIncremental, m_Model->GetClassifierIncrementalTrainingModel());
 
   activateOnFlag(ui->inClassifyBias, m_Model, SnakeWizardModel::UIF_CLASSIFIER_TRAINED);
 
@@ -47,8 +47,9 @@ void StatisticsDialog::Activate()
 
 void StatisticsDialog::FillTable()
 {
-  // Compute the segmentation statistics
-  m_Stats->Compute(m_Model->GetDriver());
+  // Bring the segmentation statistics up to date. After the first time,
+  // this only folds in the edits made since the last update
+  m_Stats->Update(m_Model->GetDriver());
 
   // Fill out the item model
   m_ItemModel->clear();
@@ -752,7 +752,14 @@ void GenericSliceRenderer::UpdateRendererCameras()
         {
         // Map the corners of the slice into the viewport coordinates
         auto sc = m_Model->GetSliceCornersInWindowCoordinates();
-        lta->m_ImageRect->SetCorners(sc.first[0], sc.first[1], sc.second[0], sc.second[1]);
+
+        // When zoomed out, draw the layer from a reduced slice, which spans
+        // display pixels a to b of the full slice
+        Vector2d a(0.0, 0.0), b(1.0, 1.0);
+        this->UpdateReducedDisplaySlice(it.GetLayer(), lta, v_zoom, spacing, a, b);
+        Vector2d c0 = sc.first + element_product(sc.second - sc.first, a);
+        Vector2d c1 = sc.first + element_product(sc.second - sc.first, b);
+        lta->m_ImageRect->SetCorners(c0[0], c0[1], c1[0], c1[1]);
         }
       else
         {
@@ -763,6 +770,42 @@ void GenericSliceRenderer::UpdateRendererCameras()
     }
 }
 
+void GenericSliceRenderer::UpdateReducedDisplaySlice(
+    ImageWrapperBase *layer, LayerTextureAssembly *lta,
+    double zoom, const Vector3d &spacing, Vector2d &a, Vector2d &b)
+{
+  typedef ImageWrapperBase::DisplaySliceType DisplaySliceType;
+  unsigned int id = m_Model->GetId();
+
+  // Each level of the pyramid halves the resolution. Use the coarsest level
+  // at which a screen pixel still covers a whole bin of voxels.
+  double voxels_per_pixel = 1.0 / (zoom * std::max(spacing[0], spacing[1]));
+  unsigned int level = 0;
+  while(level < MAX_DISPLAY_SLICE_LEVEL && (2u << level) <= voxels_per_pixel)
+    level++;
+
+  DisplaySliceType *full = layer->GetDisplaySlice(id);
+  DisplaySliceType *ds = layer->GetReducedDisplaySlice(id, level);
+
+  // Point the texture at the slice
+  auto *exporter = static_cast<LayerTextureAssembly::VTKExporter *>(lta->m_Exporter.GetPointer());
+  if(exporter->GetInput() != ds)
+    exporter->SetInput(ds);
+
+  // Find the part of the full slice covered by the pixels of the reduced
+  // slice, in units of the full slice's extent
+  full->UpdateOutputInformation();
+  ds->UpdateOutputInformation();
+  for(unsigned int d = 0; d < 2; d++)
+    {
+    double n = full->GetLargestPossibleRegion().GetSize(d);
+    double f = ds->GetSpacing()[d] / full->GetSpacing()[d];
+    double first = (ds->GetOrigin()[d] - full->GetOrigin()[d]) / full->GetSpacing()[d] - 0.5 * (f - 1);
+    a[d] = first / n;
+    b[d] = (first + ds->GetLargestPossibleRegion().GetSize(d) * f) / n;
+    }
+}
+
 void GenericSliceRenderer::UpdateLayerApperances()
 {
   // Iterate over the layers
@@ -226,6 +226,15 @@ protected:
   // Update the renderer model/view matrices in response to zooming or panning
   void UpdateRendererCameras();
 
+  // Coarsest level of the image pyramid used to draw zoomed out slices
+  enum { MAX_DISPLAY_SLICE_LEVEL = 3 };
+
+  // Point the texture of a layer to the display slice whose resolution best
+  // matches the zoom, and find the fraction [a, b] of the full slice it spans
+  void UpdateReducedDisplaySlice(ImageWrapperBase *layer, LayerTextureAssembly *lta,
+                                 double zoom, const Vector3d &spacing,
+                                 Vector2d &a, Vector2d &b);
+
   // Update the appearance of various props in the scene
   void UpdateLayerApperances();
 
@@ -36,33 +36,53 @@
 #include "GenericImageData.h"
 #include "IRISApplication.h"
 #include "ImageCollectionConstIteratorWithIndex.h"
+#include "itkMultiThreaderBase.h"
+#include "RLEImageRegionConstIterator.h"
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <set>
 
 
 using namespace std;
 
 
-// TODO: improve efficiency by using filters to integrate label intensities
-void
 SegmentationStatistics
-::Compute(IRISApplication *app)
+::SegmentationStatistics()
 {
-  // Get the current image data
-  GenericImageData *id = app->GetCurrentImageData();
+  m_CacheWrapper = NULL;
+  m_CacheValid = false;
+  m_CacheTime = 0;
+  m_CacheTimePoint = 0;
+  m_CacheVoxelVolume = 0;
+  m_Threader = itk::MultiThreaderBase::New();
+}
 
-  // Get the selected segmentation layer
-  LabelImageWrapper *seg = app->GetSelectedSegmentationLayer();
+SegmentationStatistics
+::~SegmentationStatistics()
+{
+  if(m_CacheWrapper)
+    m_CacheWrapper->RemoveDeltaObserver(this);
+}
 
-  // A list of image sources
-  vector<ScalarImageWrapperBase *> layers;
+// Compute the size of a voxel, in mm^3
+static double GetVoxelVolume(GenericImageData *id)
+{
+  const double *spacing = 
+    id->GetMain()->GetImageBase()->GetSpacing().GetDataPointer();
+  return spacing[0] * spacing[1] * spacing[2];
+}
 
+void
+SegmentationStatistics
+::CollectLayers(IRISApplication *app, vector<ScalarImageWrapperBase *> &layers)
+{
   // Clear the list of column names
   m_ImageStatisticsColumnNames.clear();
 
   // Find all the images available for statistics computation
-  for(LayerIterator it(id, MAIN_ROLE | OVERLAY_ROLE); !it.IsAtEnd(); ++it)
+  for(LayerIterator it(app->GetCurrentImageData(), MAIN_ROLE | OVERLAY_ROLE); !it.IsAtEnd(); ++it)
     {
     ScalarImageWrapperBase *lscalar = it.GetLayerAsScalar();
     if(lscalar)
@@ -85,77 +105,337 @@ SegmentationStatistics
         }
       }
     }
+}
 
-  // Get the number of gray image layers
-  size_t ngray = layers.size();
+void
+SegmentationStatistics
+::Compute(IRISApplication *app, bool all_time_points)
+{
+  // Get the current image data
+  GenericImageData *id = app->GetCurrentImageData();
 
-  // Clear and initialize the statistics table
+  // Get the selected segmentation layer
+  LabelImageWrapper *seg = app->GetSelectedSegmentationLayer();
+
+  // A list of image sources
+  vector<ScalarImageWrapperBase *> layers;
+  this->CollectLayers(app, layers);
+
+  // Compute the size of a voxel, in mm^3
+  double volVoxel = GetVoxelVolume(id);
+
+  // Clear and fill the statistics table(s)
   m_Stats.clear();
+  m_TimePointStats.clear();
+  if(all_time_points)
+    {
+    m_TimePointStats.resize(seg->GetNumberOfTimePoints());
+    for(unsigned int tp = 0; tp < m_TimePointStats.size(); tp++)
+      this->ComputeTimePoint(seg, layers, (int) tp, volVoxel, m_TimePointStats[tp]);
+    m_Stats = m_TimePointStats[seg->GetTimePointIndex()];
+    }
+  else
+    {
+    this->ComputeTimePoint(seg, layers, -1, volVoxel, m_Stats);
+    }
+}
 
-  // Start the label image iteration
-  LabelImageWrapper::ConstIterator itLabel = seg->GetImageConstIterator();
-  itk::ImageRegion<3> region = itLabel.GetRegion();
+void
+SegmentationStatistics
+::Update(IRISApplication *app)
+{
+  LabelImageWrapper *seg = app->GetSelectedSegmentationLayer();
+  double volVoxel = GetVoxelVolume(app->GetCurrentImageData());
 
-  // Cache the entry to avoid many calls to std::map
-  LabelType runLabel = 0;
-  Entry *cachedEntry = &m_Stats[runLabel];
-  cachedEntry->resize(ngray);
-  itk::Index<3> runStart = itLabel.GetIndex();
-  long runLength = 0;
+  vector<ScalarImageWrapperBase *> layers;
+  this->CollectLayers(app, layers);
 
-  // Aggregate the statistical data
-  for( ; !itLabel.IsAtEnd(); ++itLabel, ++runLength)
+  // Follow the selected segmentation
+  if(seg != m_CacheWrapper)
+    {
+    if(m_CacheWrapper)
+      m_CacheWrapper->RemoveDeltaObserver(this);
+    m_CacheWrapper = seg;
+    m_CacheWrapper->AddDeltaObserver(this);
+    m_CacheValid = false;
+    }
+
+  // Describe the current state of the gray layers
+  vector<LayerStamp> stamps(layers.size());
+  for(size_t j = 0; j < layers.size(); j++)
+    {
+    stamps[j].layer = layers[j];
+    stamps[j].id = layers[j]->GetUniqueId();
+    stamps[j].image = layers[j]->GetImage4DBase();
+    stamps[j].time_point = layers[j]->GetTimePointIndex();
+    stamps[j].mtime = layers[j]->GetImage4DBase()->GetMTime();
+    }
+
+  // The cached statistics can be updated incrementally if the segmentation
+  // has only been changed by the edits reported to OnLabelDeltaApplied and
+  // nothing else has changed
+  if(m_CacheValid
+     && seg->GetImage4DBase()->GetMTime() == m_CacheTime
+     && seg->GetTimePointIndex() == m_CacheTimePoint
+     && volVoxel == m_CacheVoxelVolume
+     && stamps == m_CacheLayers)
+    {
+    this->ApplyChangedRuns(seg, layers);
+    }
+  else
     {
-    // Get the label and the corresponding entry (use cache to reduce time wasted in std::map)
-    LabelType label = itLabel.Value();
-    if(label != runLabel)
+    this->Compute(app);
+    m_CacheValid = true;
+    m_CacheTime = seg->GetImage4DBase()->GetMTime();
+    m_CacheTimePoint = seg->GetTimePointIndex();
+    m_CacheVoxelVolume = volVoxel;
+    m_CacheLayers = stamps;
+    }
+
+  m_ChangedRuns.clear();
+}
+
+void
+SegmentationStatistics
+::OnLabelDeltaApplied(UndoDelta<LabelType> *delta, bool inverse,
+                      itk::ModifiedTimeType base_time)
+{
+  if(!m_CacheValid)
+    return;
+
+  // The delta must apply to the state the statistics describe, and only
+  // sparse deltas are worth following
+  if(base_time != m_CacheTime
+     || m_CacheWrapper->GetTimePointIndex() != m_CacheTimePoint
+     || !delta->IsSparse()
+     || m_ChangedRuns.size() + delta->GetNumberOfRLEs() > MAX_CHANGED_RUNS)
+    {
+    m_CacheValid = false;
+    m_ChangedRuns.clear();
+    return;
+    }
+
+  // The image now holds the result of the delta, so the label before the
+  // edit is the current label minus the change made by the delta. Split the
+  // runs of the delta into runs of constant label.
+  typedef LabelImageWrapper::ImageType LabelImageType;
+  const LabelImageType *image = m_CacheWrapper->GetImage();
+  for(size_t i = 0; i < delta->GetNumberOfRLEs(); i++)
+    {
+    itk::ImageRegion<3> region = delta->GetRLERegion(i);
+    LabelType d = delta->GetRLEValue(i);
+
+    ChangedRun run;
+    run.start = region.GetIndex();
+    run.length = 0;
+    itk::ImageRegionConstIterator<LabelImageType> it(image, region);
+    for(long x = 0; !it.IsAtEnd(); ++it, ++x)
       {
-      // Record the statistics from the last run
-      this->RecordRunLength(ngray, layers, region, runStart, runLength, cachedEntry);
+      LabelType now = it.Get();
+      if(run.length > 0 && now == run.to)
+        {
+        run.length++;
+        continue;
+        }
 
-      // Change the cached entry
-      runLabel = label;
-      cachedEntry = &m_Stats[runLabel];
-      if(cachedEntry->count == 0)
-        cachedEntry->resize(ngray);
+      if(run.length > 0)
+        m_ChangedRuns.push_back(run);
 
-      runStart = itLabel.GetIndex();
-      runLength = 0;
+      run.start[0] = region.GetIndex(0) + x;
+      run.length = 1;
+      run.from = (LabelType) (inverse ? now + d : now - d);
+      run.to = now;
       }
+
+    if(run.length > 0)
+      m_ChangedRuns.push_back(run);
     }
+}
 
-  // Record the statistics from the last run
-  this->RecordRunLength(ngray, layers, region, runStart, runLength, cachedEntry);
+void
+SegmentationStatistics
+::OnLabelDeltasFinished(itk::ModifiedTimeType time)
+{
+  if(m_CacheValid)
+    m_CacheTime = time;
+}
 
-  // Compute the size of a voxel, in mm^3
-  const double *spacing = 
-    id->GetMain()->GetImageBase()->GetSpacing().GetDataPointer();
-  double volVoxel = spacing[0] * spacing[1] * spacing[2];
-  
-  // Compute the mean and standard deviation
-  for(EntryMap::iterator it = m_Stats.begin(); it != m_Stats.end(); ++it)
+void
+SegmentationStatistics
+::OnLabelImageWrapperDeleted()
+{
+  m_CacheWrapper = NULL;
+  m_CacheValid = false;
+  m_ChangedRuns.clear();
+}
+
+void
+SegmentationStatistics
+::ApplyChangedRuns(LabelImageWrapper *seg, vector<ScalarImageWrapperBase *> &layers)
+{
+  size_t ngray = layers.size();
+  itk::ImageRegion<3> region = seg->GetImage()->GetBufferedRegion();
+  vector<double> nvalid(ngray), sum(ngray), sumsq(ngray);
+  std::set<LabelType> dirty;
+
+  // Move the voxels and their intensities from the old to the new label
+  for(size_t i = 0; i < m_ChangedRuns.size(); i++)
     {
-    Entry &entry = it->second;
+    const ChangedRun &run = m_ChangedRuns[i];
+    Entry &from = m_Stats[run.from], &to = m_Stats[run.to];
+    if(from.nvalid.size() != ngray)
+      from.resize(ngray);
+    if(to.nvalid.size() != ngray)
+      to.resize(ngray);
+
+    std::fill(nvalid.begin(), nvalid.end(), 0.0);
+    std::fill(sum.begin(), sum.end(), 0.0);
+    std::fill(sumsq.begin(), sumsq.end(), 0.0);
+    for(size_t j = 0; j < ngray; j++)
+      {
+      layers[j]->GetRunLengthIntensityStatistics(
+            region, run.start, run.length, &nvalid[j], &sum[j], &sumsq[j]);
+      from.nvalid[j] -= nvalid[j];
+      from.sum[j] -= sum[j];
+      from.sumsq[j] -= sumsq[j];
+      to.nvalid[j] += nvalid[j];
+      to.sum[j] += sum[j];
+      to.sumsq[j] += sumsq[j];
+      }
+
+    from.count -= run.length;
+    to.count += run.length;
+    dirty.insert(run.from);
+    dirty.insert(run.to);
+    }
+
+  // Update the derived statistics of the labels that changed, dropping
+  // labels that no longer occur, as Compute() would
+  for(std::set<LabelType>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
+    {
+    EntryMap::iterator ie = m_Stats.find(*it);
+    if(ie->second.count == 0 && ie->first != 0)
+      m_Stats.erase(ie);
+    else
+      this->UpdateDerivedStatistics(ie->second, layers, m_CacheVoxelVolume);
+    }
+}
+
+void
+SegmentationStatistics
+::UpdateDerivedStatistics(Entry &entry, vector<ScalarImageWrapperBase *> &layers,
+                          double volVoxel) const
+{
+  for(size_t j = 0; j < layers.size(); j++)
+    {
+    // Map to native format
+    double mean = entry.sum[j] / entry.nvalid[j];
+    double stdev = sqrt((entry.sumsq[j] - entry.sum[j] * mean) / (entry.nvalid[j] - 1));
+
+    // Map with scale and shift
+    entry.mean[j] = layers[j]->GetNativeIntensityMapping()->MapInternalToNative(mean);
+
+    // Map with just shift
+    entry.stdev[j] = layers[j]->GetNativeIntensityMapping()->MapGradientMagnitudeToNative(stdev);
+    }
+  entry.volume_mm3 = entry.count * volVoxel;
+}
+
+void
+SegmentationStatistics
+::ComputeTimePoint(LabelImageWrapper *seg, vector<ScalarImageWrapperBase *> &layers,
+                   int time_point, double volVoxel, EntryMap &stats) const
+{
+  typedef LabelImageWrapper::ImageType LabelImageType;
+  typedef LabelImageType::RLLine RLLine;
+
+  // Get the number of gray image layers
+  size_t ngray = layers.size();
+
+  // The label image for the requested time point (-1 for current)
+  const LabelImageType *image = (time_point < 0)
+      ? seg->GetImage()
+      : seg->GetImageByTimePoint(time_point).GetPointer();
+  itk::ImageRegion<3> region = image->GetBufferedRegion();
+  const RLLine *lines = image->GetBuffer()->GetBufferPointer();
+  size_t ny = region.GetSize(1), nlines = ny * region.GetSize(2);
+
+  // The gray images for the requested time point, resolved once for all
+  // threads (null for the current time point)
+  vector<const itk::ImageBase<3> *> images(ngray, nullptr);
+  if(time_point >= 0)
     for(size_t j = 0; j < ngray; j++)
+      images[j] = layers[j]->GetImageBaseByTimePoint(time_point);
+
+  // The background entry is always present in the table
+  stats[0].resize(ngray);
+
+  // Split the lines of the RLE image into slabs. Each slab accumulates
+  // counts and moments into its own table, and the tables are merged in
+  // slab order, so that the result does not depend on thread scheduling
+  size_t nslabs = std::min(nlines, (size_t) m_Threader->GetNumberOfWorkUnits() * 4);
+  vector<EntryMap> slabStats(nslabs);
+
+  m_Threader->ParallelizeArray(0, nslabs, [&](itk::SizeValueType s)
+    {
+    EntryMap &local = slabStats[s];
+    LabelType runLabel = 0;
+    Entry *cachedEntry = &local[runLabel];
+    cachedEntry->resize(ngray);
+
+    size_t l0 = nlines * s / nslabs, l1 = nlines * (s + 1) / nslabs;
+    for(size_t l = l0; l < l1; l++)
       {
-      // Map to native format
-      double mean = entry.sum[j] / entry.nvalid[j];
-      double stdev = sqrt((entry.sumsq[j] - entry.sum[j] * mean) / (entry.nvalid[j] - 1));
+      itk::Index<3> runStart = region.GetIndex();
+      runStart[1] += l % ny;
+      runStart[2] += l / ny;
 
-      // Map with scale and shift
-      entry.mean[j] = layers[j]->GetNativeIntensityMapping()->MapInternalToNative(mean);
+      // Each segment of the line is a run of voxels with the same label
+      const RLLine &line = lines[l];
+      for(size_t k = 0; k < line.size(); k++)
+        {
+        LabelType label = line[k].second;
+        if(label != runLabel)
+          {
+          runLabel = label;
+          cachedEntry = &local[runLabel];
+          if(cachedEntry->count == 0)
+            cachedEntry->resize(ngray);
+          }
+
+        this->RecordRunLength(ngray, layers, region, runStart, line[k].first,
+                              images, cachedEntry);
+        runStart[0] += line[k].first;
+        }
+      }
+    }, nullptr);
 
-      // Map with just shift
-      entry.stdev[j] = layers[j]->GetNativeIntensityMapping()->MapGradientMagnitudeToNative(stdev);
+  // Merge the slab tables
+  for(size_t s = 0; s < nslabs; s++)
+    {
+    for(EntryMap::iterator it = slabStats[s].begin(); it != slabStats[s].end(); ++it)
+      {
+      const Entry &src = it->second;
+      Entry &entry = stats[it->first];
+      if(entry.nvalid.size() != ngray)
+        entry.resize(ngray);
+      entry.count += src.count;
+      entry.nvalid += src.nvalid;
+      entry.sum += src.sum;
+      entry.sumsq += src.sumsq;
       }
-    entry.volume_mm3 = entry.count * volVoxel;
     }
+
+  // Compute the mean and standard deviation
+  for(EntryMap::iterator it = stats.begin(); it != stats.end(); ++it)
+    this->UpdateDerivedStatistics(it->second, layers, volVoxel);
 }
 
 void SegmentationStatistics
 ::RecordRunLength(size_t ngray, vector<ScalarImageWrapperBase *> &layers,
-                  itk::ImageRegion<3> &region, itk::Index<3> &runStart,
-                  long runLength, Entry *cachedEntry)
+                  const itk::ImageRegion<3> &region, const itk::Index<3> &runStart,
+                  long runLength, const vector<const itk::ImageBase<3> *> &images,
+                  Entry *cachedEntry) const
 {
   // Record the statistics from the last run
   for(size_t j = 0; j < ngray; j++)
@@ -164,7 +444,8 @@ void SegmentationStatistics
           region, runStart, runLength,
           cachedEntry->nvalid.data_block() + j,
           cachedEntry->sum.data_block() + j,
-          cachedEntry->sumsq.data_block() + j);
+          cachedEntry->sumsq.data_block() + j,
+          images[j]);
     }
 
   cachedEntry->count += runLength;
@@ -173,43 +454,33 @@ void SegmentationStatistics
 void SegmentationStatistics
 ::GetVoxelCount(LabelVoxelCount &result, IRISApplication *app) const
 {
+  typedef LabelImageWrapper::ImageType LabelImageType;
+  typedef LabelImageType::RLLine RLLine;
+
   // Get selected segmentation layer
   LabelImageWrapper *liw = app->GetSelectedSegmentationLayer();
 
-  // Get the iterator from the segmentation
-  LabelImageWrapper::ConstIterator it = liw->GetImageConstIterator();
+  // Walk the runs of the RLE lines rather than decoding every voxel
+  const LabelImageType *image = liw->GetImage();
+  itk::ImageRegion<3> region = image->GetBufferedRegion();
+  const RLLine *lines = image->GetBuffer()->GetBufferPointer();
+  size_t nlines = region.GetSize(1) * region.GetSize(2);
 
-  // Iterate through image and update count
   LabelType runLabel = 0;
   unsigned long *cachedCnt = &result[runLabel];
-  unsigned long runLength = 0;
-
-  // Start counting
-  for (; !it.IsAtEnd(); ++it, ++runLength)
+  for(size_t l = 0; l < nlines; l++)
     {
-      LabelType label = it.Value();
-      if (label != runLabel)
+    const RLLine &line = lines[l];
+    for(size_t k = 0; k < line.size(); k++)
+      {
+      if(line[k].second != runLabel)
         {
-          // std::cout << "run length: " << runLength << endl;
-          *cachedCnt += runLength;
-
-          // Reset for new count
-          runLabel = label;
-          cachedCnt = &result[runLabel];
-          runLength = 0;
+        runLabel = line[k].second;
+        cachedCnt = &result[runLabel];
         }
+      *cachedCnt += line[k].first;
+      }
     }
-
-  // Add last run Length
-  *cachedCnt += runLength;
-
-  // Debug
-  /*
-  for (auto cit = result.cbegin(); cit != result.cend(); ++cit)
-    {
-      std::cout << cit->first << "=>" << cit->second << std::endl;
-    }
-    */
 }
 
 void 
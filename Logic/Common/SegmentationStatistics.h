@@ -36,6 +36,7 @@
 #define __SegmentationStatistics_h_
 
 #include "SNAPCommon.h"
+#include "LabelImageWrapper.h"
 #include <vector>
 #include <string>
 #include <iostream>
@@ -49,12 +50,17 @@ class IRISApplication;
 namespace itk {
   template <unsigned int VDim> class ImageRegion;
   template <unsigned int VDim> struct Index;
+  template <unsigned int VDim> class ImageBase;
+  class MultiThreaderBase;
 }
 
-class SegmentationStatistics
+class SegmentationStatistics : public LabelImageDeltaObserver
 {
 public:
 
+  SegmentationStatistics();
+  ~SegmentationStatistics();
+
   /* Data structure cooresponding to a gray overlay image */
   struct GrayStats { 
     std::string layer_id;
@@ -82,8 +88,19 @@ public:
   /* A light-weight struct storing voxel count for each label */
   typedef std::map<LabelType, unsigned long> LabelVoxelCount;
 
-  /* Compute statistics from a segmentation image */
-  void Compute(IRISApplication *app);
+  /* Compute statistics from a segmentation image. The label image is
+     traversed run by run, in slabs of lines processed in parallel. By
+     default only the current time point is computed; if all_time_points
+     is set, statistics for every time point are computed in one call and
+     can be retrieved with GetTimePointStats() */
+  void Compute(IRISApplication *app, bool all_time_points = false);
+
+  /* Bring the statistics for the current time point up to date. The first
+     call computes them in full and starts following the segmentation: the
+     edits made by painting, undo and redo are then folded in from their
+     undo deltas, and the statistics are only recomputed in full when the
+     segmentation is modified in another way or a gray layer changes */
+  void Update(IRISApplication *app);
   
   /* Export to a text file using legacy format */
   void ExportLegacy(std::ostream &oss, const ColorLabelTable &clt);
@@ -94,27 +111,99 @@ public:
   const EntryMap &GetStats() const
     { return m_Stats; }
 
+  /* Statistics for a time point, after Compute() with all_time_points set */
+  const EntryMap &GetTimePointStats(unsigned int tp) const
+    { return m_TimePointStats[tp]; }
+
+  unsigned int GetNumberOfComputedTimePoints() const
+    { return m_TimePointStats.size(); }
+
   const std::vector<std::string> &GetImageStatisticsColumns() const
     { return m_ImageStatisticsColumnNames; }
 
   /* A light-weight method only compute voxel counts for each label*/
   void GetVoxelCount(LabelVoxelCount &result, IRISApplication *app) const;
 
+  /* LabelImageDeltaObserver methods, used by Update() */
+  virtual void OnLabelDeltaApplied(UndoDelta<LabelType> *delta, bool inverse,
+                                   itk::ModifiedTimeType base_time) ITK_OVERRIDE;
+  virtual void OnLabelDeltasFinished(itk::ModifiedTimeType time) ITK_OVERRIDE;
+  virtual void OnLabelImageWrapperDeleted() ITK_OVERRIDE;
+
 private:
 
+  // The cache follows a single wrapper and cannot be copied
+  SegmentationStatistics(const SegmentationStatistics &) = delete;
+  SegmentationStatistics &operator = (const SegmentationStatistics &) = delete;
+
   // Label statistics
   EntryMap m_Stats;
 
+  // Label statistics for each time point (only when computed for all)
+  std::vector<EntryMap> m_TimePointStats;
+
   // Column information
   std::vector<std::string> m_ImageStatisticsColumnNames;
   
+  // State of a gray layer when the cached statistics were computed
+  struct LayerStamp {
+    const ScalarImageWrapperBase *layer;
+    unsigned long id;
+    const void *image;
+    unsigned int time_point;
+    itk::ModifiedTimeType mtime;
+    bool operator == (const LayerStamp &o) const
+      { return layer == o.layer && id == o.id && image == o.image
+          && time_point == o.time_point && mtime == o.mtime; }
+  };
+
+  // A run of voxels whose label was changed by an edit
+  struct ChangedRun {
+    itk::Index<3> start;
+    long length;
+    LabelType from, to;
+  };
+
+  // Incremental update state
+  LabelImageWrapper *m_CacheWrapper;
+  bool m_CacheValid;
+  itk::ModifiedTimeType m_CacheTime;
+  unsigned int m_CacheTimePoint;
+  double m_CacheVoxelVolume;
+  std::vector<LayerStamp> m_CacheLayers;
+  std::vector<ChangedRun> m_ChangedRuns;
+
+  // Threader shared by all the computations
+  SmartPtr<itk::MultiThreaderBase> m_Threader;
+
+  // Beyond this many changed runs, a full recompute is cheaper
+  static const size_t MAX_CHANGED_RUNS = 1000000;
+
+  void CollectLayers(IRISApplication *app, std::vector<ScalarImageWrapperBase *> &layers);
+
+  void ApplyChangedRuns(LabelImageWrapper *seg,
+                        std::vector<ScalarImageWrapperBase *> &layers);
+
+  void UpdateDerivedStatistics(
+      Entry &entry,
+      std::vector<ScalarImageWrapperBase *> &layers,
+      double volVoxel) const;
+
+  void ComputeTimePoint(
+      LabelImageWrapper *seg,
+      std::vector<ScalarImageWrapperBase *> &layers,
+      int time_point,
+      double volVoxel,
+      EntryMap &stats) const;
+
   void RecordRunLength(
       size_t ngray,
       std::vector<ScalarImageWrapperBase *> &layers,
-      itk::ImageRegion<3> &region,
-      itk::Index<3> &runStart,
+      const itk::ImageRegion<3> &region,
+      const itk::Index<3> &runStart,
       long runLength,
-      Entry *cachedEntry);
+      const std::vector<const itk::ImageBase<3> *> &images,
+      Entry *cachedEntry) const;
 };
 
 #endif
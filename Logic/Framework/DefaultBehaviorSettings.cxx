@@ -13,6 +13,8 @@ DefaultBehaviorSettings::DefaultBehaviorSettings()
   m_SyncPanModel = NewSimpleProperty("SyncPan", true);
 
   m_AutoContrastModel = NewSimpleProperty("AutoContrast", false);
+  m_IntensityQuantileLog2SamplingRateModel =
+      NewRangedProperty("IntensityQuantileLog2SamplingRate", 0, 0, 10, 1);
 
   // Permissions
   RegistryEnumMap<UpdateCheckingPermission> remUpdate;
@@ -33,4 +35,8 @@ DefaultBehaviorSettings::DefaultBehaviorSettings()
   // Paintbrush defaults
   m_PaintbrushDefaultInitialSizeModel = NewRangedProperty("PaintbrushDefaultInitialSize", 8, 1, 10000, 1);
   m_PaintbrushDefaultMaximumSizeModel = NewRangedProperty("PaintbrushDefaultMaximumSize", 40, 10, 10000, 1);
+
+  // Paging of 4D images
+  m_TimePointPagerWindowModel = NewRangedProperty("TimePointPagerWindow", 2, 0, 32, 1);
+  m_TimePointPagerRecentTimePointsModel = NewRangedProperty("TimePointPagerRecentTimePoints", 4, 0, 256, 1);
 }
@@ -22,6 +22,10 @@ public:
   irisSimplePropertyAccessMacro(SyncPan, bool)
   irisSimplePropertyAccessMacro(AutoContrast, bool)
 
+  // Only every 2^k-th voxel is used to estimate the intensity quantiles, which
+  // are used for auto-contrast
+  irisRangedPropertyAccessMacro(IntensityQuantileLog2SamplingRate, int)
+
   // Permissions
   enum UpdateCheckingPermission {
     UPDATE_YES, UPDATE_NO, UPDATE_UNKNOWN
@@ -43,6 +47,11 @@ public:
   irisRangedPropertyAccessMacro(PaintbrushDefaultInitialSize, int)
   irisRangedPropertyAccessMacro(PaintbrushDefaultMaximumSize, int)
 
+  // Time points of 4D images mapped from their file that are kept in memory:
+  // a window on either side of the current one, and the most recent others
+  irisRangedPropertyAccessMacro(TimePointPagerWindow, int)
+  irisRangedPropertyAccessMacro(TimePointPagerRecentTimePoints, int)
+
 protected:
 
   // Default behaviors
@@ -53,6 +62,7 @@ protected:
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncZoomModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_SyncPanModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_AutoContrastModel;
+  SmartPtr<ConcreteRangedIntProperty> m_IntensityQuantileLog2SamplingRateModel;
 
   // Permissions
   SmartPtr<ConcretePropertyModel<UpdateCheckingPermission> > m_CheckForUpdatesModel;
@@ -67,6 +77,10 @@ protected:
   SmartPtr<ConcreteRangedIntProperty> m_PaintbrushDefaultInitialSizeModel;
   SmartPtr<ConcreteRangedIntProperty> m_PaintbrushDefaultMaximumSizeModel;
 
+  // Paging of 4D images
+  SmartPtr<ConcreteRangedIntProperty> m_TimePointPagerWindowModel;
+  SmartPtr<ConcreteRangedIntProperty> m_TimePointPagerRecentTimePointsModel;
+
   // Constructor
   DefaultBehaviorSettings();
 };
@@ -76,6 +76,7 @@
 #include "UnsupervisedClustering.h"
 #include "GMMClassifyImageFilter.h"
 #include "DefaultBehaviorSettings.h"
+#include "TimePointPager.h"
 #include "ColorMapPresetManager.h"
 #include "ImageIODelegates.h"
 #include "IRISDisplayGeometry.h"
@@ -89,6 +90,7 @@
 #include "ImageMeshLayers.h"
 #include "StandaloneMeshWrapper.h"
 #include "AllPurposeProgressAccumulator.h"
+#include "DicomDirectoryIndex.h"
 
 #include <stdio.h>
 #include <sstream>
@@ -312,6 +314,9 @@ void IRISApplication::UnloadSegmentation(ImageWrapperBase *seg)
   // This has to happen in 'pure' IRIS mode, we are not allowed to just close segmentations in SNAP mode
   assert(!IsSnakeModeActive());
 
+  // Keep the meshes of the segmentation if they match its file
+  m_MeshManager->StoreMeshesInCache(dynamic_cast<LabelImageWrapper *>(seg));
+
   // If the requested segmentation is the only segmentation, then call the reset method
   m_IRISImageData->UnloadSegmentation(seg);
 
@@ -1524,6 +1529,9 @@ IRISApplication
   // Read and apply the project-level settings associated with the main image
   LoadMetaDataAssociatedWithLayer(layer, OVERLAY_ROLE, metadata);
 
+  // Apply the default behaviors that affect the layer
+  ApplyDefaultBehaviorSettingsToLayer(layer);
+
   // If the default is to auto-contrast, perform the contrast adjustment
   // operation on the image
   if(m_GlobalState->GetDefaultBehaviorSettings()->GetAutoContrast())
@@ -1570,6 +1578,9 @@ IRISApplication
   // Initialize the layer-specific segmentation parameters
   CreateSegmentationSettings(overlay, OVERLAY_ROLE);
 
+  // Apply the default behaviors that affect the layer
+  ApplyDefaultBehaviorSettingsToLayer(overlay);
+
   // If the default is to auto-contrast, perform the contrast adjustment
   // operation on the image
   if(m_GlobalState->GetDefaultBehaviorSettings()->GetAutoContrast())
@@ -1598,6 +1609,30 @@ IRISApplication
     }
 }
 
+void
+IRISApplication
+::ApplyDefaultBehaviorSettingsToLayer(ImageWrapperBase *layer)
+{
+  DefaultBehaviorSettings *dbs = m_GlobalState->GetDefaultBehaviorSettings();
+
+  // How many time points of a 4D image mapped from its file stay in memory
+  TimePointPager *pager = layer->GetTimePointPager();
+  pager->SetWindow(dbs->GetTimePointPagerWindow());
+  pager->SetMaximumRecentTimePoints(dbs->GetTimePointPagerRecentTimePoints());
+
+  // Sampling of the voxels from which the intensity quantiles are estimated
+  layer->SetTDigestLog2SamplingRate(dbs->GetIntensityQuantileLog2SamplingRate());
+}
+
+void
+IRISApplication
+::UpdateLayersFromDefaultBehaviorSettings()
+{
+  for(LayerIterator it = m_IRISImageData->GetLayers(MAIN_ROLE | OVERLAY_ROLE);
+      !it.IsAtEnd(); ++it)
+    ApplyDefaultBehaviorSettingsToLayer(it.GetLayer());
+}
+
 void
 IRISApplication
 ::CreateSegmentationSettings(ImageWrapperBase *wrapper, LayerRole role)
@@ -1668,6 +1703,9 @@ IRISApplication
   // crosshairs positions did not change from their previous values
   this->GetIRISImageData()->SetCrosshairs(layer->GetSize() / 2u);
 
+  // Apply the default behaviors that affect the layer
+  ApplyDefaultBehaviorSettingsToLayer(layer);
+
   // If the default is to auto-contrast, perform the contrast adjustment
   // operation on the image
   if(m_GlobalState->GetDefaultBehaviorSettings()->GetAutoContrast())
@@ -1824,6 +1862,10 @@ IRISApplication
   // Reset the automatic segmentation ROI
   m_GlobalState->SetSegmentationROI(GlobalState::RegionType());
 
+  // Keep the meshes of the segmentations that match their files
+  for(LayerIterator it = m_IRISImageData->GetLayers(LABEL_ROLE); !it.IsAtEnd(); ++it)
+    m_MeshManager->StoreMeshesInCache(dynamic_cast<LabelImageWrapper *>(it.GetLayer()));
+
   // Unload the main image
   m_CurrentImageData->UnloadMainImage();
 
@@ -1877,6 +1919,7 @@ IRISApplication
 
   // Create a native image IO object
   SmartPtr<GuidedNativeImageIO> io = GuidedNativeImageIO::New();
+  io->SetDicomDirectoryIndex(this->GetDicomDirectoryIndex());
 
   // Configure io using delegate
   del->ConfigureImageIO(io);
@@ -1983,6 +2026,23 @@ IRISApplication::ListAvailableSiblingDicomSeries()
   return available_dicoms;
 }
 
+DicomDirectoryIndex *IRISApplication::GetDicomDirectoryIndex()
+{
+  if(!m_DicomDirectoryIndex)
+    {
+    m_DicomDirectoryIndex = DicomDirectoryIndex::New();
+
+    // Without a file, the index is only kept for this session
+    try
+      {
+      m_DicomDirectoryIndex->SetFileName(m_SystemInterface->GetDicomDirectoryIndexFileName());
+      }
+    catch(IRISException &) {}
+    }
+
+  return m_DicomDirectoryIndex;
+}
+
 #include "MetaDataAccess.h"
 
 void IRISApplication
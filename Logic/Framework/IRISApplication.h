@@ -57,6 +57,7 @@ class IRISImageData;
 class SNAPImageData;
 class MeshExportSettings;
 class GuidedNativeImageIO;
+class DicomDirectoryIndex;
 class ThresholdSettings;
 class EdgePreprocessingSettings;
 class AbstractSlicePreviewFilterWrapper;
@@ -223,6 +224,13 @@ public:
    */
   DicomSeriesTree ListAvailableSiblingDicomSeries();
 
+  /**
+   * Get the persistent index of the tags read from DICOM files, which is kept
+   * next to the user preferences. It makes parsing a DICOM directory again
+   * much faster (see DicomDirectoryIndex).
+   */
+  DicomDirectoryIndex *GetDicomDirectoryIndex();
+
   /**
    * Load another dicom series via delegate. This is similar to OpenImageViaDelegate
    * but the input is a SeriesId assumed to be in the same DICOM directory as the
@@ -703,6 +711,12 @@ public:
    */
   void ReloadSegmentationWrapperFromFile(ImageWrapperBase *wrapper);
 
+  /**
+   * Apply the default behavior settings that affect the loaded image layers,
+   * such as how the time points of 4D images are paged. Call this after the
+   * settings have changed.
+   */
+  void UpdateLayersFromDefaultBehaviorSettings();
 
 protected:
 
@@ -790,6 +804,9 @@ protected:
   // Mesh object (used to manage meshes)
   SmartPtr<MeshManager> m_MeshManager;
 
+  // Index of parsed DICOM directories, created on first use
+  SmartPtr<DicomDirectoryIndex> m_DicomDirectoryIndex;
+
   // Color map preset manager
   SmartPtr<ColorMapPresetManager> m_ColorMapPresetManager;
 
@@ -831,6 +848,9 @@ protected:
   // Auto-adjust contrast of a layer on load
   void AutoContrastLayerOnLoad(ImageWrapperBase *layer);
 
+  // Apply the default behavior settings that affect a loaded layer
+  void ApplyDefaultBehaviorSettingsToLayer(ImageWrapperBase *layer);
+
   // -------------- Saving IRIS state during SNAP mode --------------------
   unsigned long m_SavedIRISSelectedSegmentationLayerId;
 
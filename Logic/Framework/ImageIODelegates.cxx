@@ -2,6 +2,7 @@
 #include "IRISApplication.h"
 #include "GenericImageData.h"
 #include "HistoryManager.h"
+#include "MeshManager.h"
 #include "IRISImageData.h"
 #include "ImageWrapperTraits.h"
 #include <itkImageIOBase.h>
@@ -37,6 +38,22 @@ void LoadAnatomicImageDelegate
 }
 
 
+void LoadAnatomicImageDelegate
+::ConfigureImageIO(GuidedNativeImageIO *io)
+{
+  // The anatomic wrappers keep these component types as they are (see
+  // GenericImageData::CreateAnatomicWrapper), so their voxel data can stay
+  // mapped into memory. CHAR is read as signed char and cast to char.
+  std::set<itk::IOComponentEnum> types;
+  types.insert(itk::IOComponentEnum::UCHAR);
+  types.insert(itk::IOComponentEnum::USHORT);
+  types.insert(itk::IOComponentEnum::SHORT);
+  types.insert(itk::IOComponentEnum::FLOAT);
+  types.insert(itk::IOComponentEnum::DOUBLE);
+  io->SetMappableComponentTypes(types);
+}
+
+
 /* =============================
    MAIN Image
    ============================= */
@@ -66,6 +83,8 @@ void
 LoadMainImageDelegate
 ::ConfigureImageIO(GuidedNativeImageIO *io)
 {
+  Superclass::ConfigureImageIO(io);
+
   if (m_Load4DAsMultiComponent)
     io->SetLoad4DAsMultiComponent(true);
   else if (m_LoadMultiComponentAs4D)
@@ -345,6 +364,10 @@ void DefaultSaveImageDelegate
       {
       m_Driver->GetHistoryManager()->UpdateHistory(*it, fname, m_Track);
       }
+
+    // The meshes of a segmentation now match its file and can be cached
+    if(LabelImageWrapper *seg = dynamic_cast<LabelImageWrapper *>(m_Wrapper))
+      m_Driver->GetMeshManager()->StoreMeshesInCache(seg);
     }
   catch(std::exception &exc)
     {
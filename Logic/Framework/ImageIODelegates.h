@@ -84,6 +84,8 @@ public:
 
   virtual void ValidateHeader(GuidedNativeImageIO *io, IRISWarningList &wl) ITK_OVERRIDE;
 
+  virtual void ConfigureImageIO(GuidedNativeImageIO *io) ITK_OVERRIDE;
+
 protected:
   LoadAnatomicImageDelegate() {}
   virtual ~LoadAnatomicImageDelegate() {}
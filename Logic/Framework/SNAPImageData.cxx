@@ -62,6 +62,8 @@
 #include "SlicePreviewFilterWrapper.h"
 #include "PreprocessingFilterConfigTraits.h"
 
+#include <algorithm>
+
 
 SNAPImageData
 ::SNAPImageData()
@@ -76,6 +78,15 @@ SNAPImageData
 
   m_CompressedAlternateLabelImage = NULL;
 
+  // The evolution thread is started on demand
+  m_FrontSnapshot = 0;
+  m_SnapshotReady = false;
+  m_LevelSetSnapshotIterations[0] = m_LevelSetSnapshotIterations[1] = 0;
+  m_EvolutionStepSize = 1;
+  m_EvolutionRunning = false;
+  m_EvolutionBusy = false;
+  m_EvolutionStop = false;
+
   // Initialize Mesh Layers storage
   m_MeshLayers = ImageMeshLayers::New();
   m_MeshLayers->Initialize(this);
@@ -87,6 +98,8 @@ SNAPImageData
 SNAPImageData
 ::~SNAPImageData() 
 {
+  this->StopSegmentationThread();
+
   if(m_LevelSetDriver)
     delete m_LevelSetDriver;
 
@@ -362,6 +375,7 @@ SNAPImageData
 ::InitalizeSnakeDriver(const SnakeParameters &p) 
 {
   // Create a new level set driver, deleting the current one if it's there
+  this->StopSegmentationThread();
   if (m_LevelSetDriver) { delete m_LevelSetDriver; }
     
   // This is a good place to check that the parameters are valid
@@ -383,9 +397,6 @@ SNAPImageData
   // Copy the configuration parameters
   m_CurrentSnakeParameters = p;
 
-  // Enter a thread-safe section
-  m_LevelSetPipelineMutex.lock();
-
   // Initialize the snake driver and pass the parameters
   m_LevelSetDriver = new SNAPLevelSetDriver3d(
     m_SnakeWrapper->GetModifiableImage(),
@@ -393,19 +404,29 @@ SNAPImageData
     m_CurrentSnakeParameters,
     m_ExternalAdvectionField);
 
-  // Copy the output pixels from the level set filter to the snake image wrapper.
-  // The ITK pattern is to do the opposite, i.e., graft the image onto the level
-  // set filter, but the particular filter used for level set propagation,
-  // ParallelSparseFieldLevelSetImageFilter is not coded to support this.
-  m_SnakeWrapper->SetPixelContainer(m_LevelSetDriver->GetOutput()->GetPixelContainer());
+  // The snake wrapper shows copies of the output of the level set filter,
+  // which is evolved by a background thread while the copy is displayed.
+  // Copying also works around the fact that the particular filter used for
+  // level set propagation, ParallelSparseFieldLevelSetImageFilter, cannot
+  // have an image grafted onto its output.
+  size_t n = m_LevelSetDriver->GetOutput()->GetPixelContainer()->Size();
+  for(unsigned int i = 0; i < 2; i++)
+    {
+    m_LevelSetSnapshot[i] = LevelSetContainerType::New();
+    m_LevelSetSnapshot[i]->Reserve(n);
+    }
 
+  {
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+  m_FrontSnapshot = 0;
+  m_EvolutionError = nullptr;
+  }
+  this->CopyLevelSetToSnapshot();
 
-  // Finish thread-safe section
-  m_LevelSetPipelineMutex.unlock();
-
-  // Fire events (layers changed and level set image changed)
+  // Show the initial level set and fire events (layers changed and level
+  // set image changed)
+  this->UpdateSnakeFromSegmentationThread();
   this->InvokeEvent(LayerChangeEvent());
-  this->InvokeEvent(LevelSetImageChangeEvent());
 
   // Why use segmentation's alpha?
   m_SnakeWrapper->SetAlpha(
@@ -419,27 +440,167 @@ SNAPImageData
   // Should be in level set mode
   assert(m_LevelSetDriver);
 
+  // Steps are not taken in the background at the same time
+  this->PauseSegmentationThread();
+
   // Pass through to the level set driver
+  m_LevelSetDriver->Run(nIterations);
 
-  // Enter a thread-safe section
-  m_LevelSetPipelineMutex.lock();
+  this->CopyLevelSetToSnapshot();
 
-  // clock_t c1 = clock();
-  m_LevelSetDriver->Run(nIterations);
-  
-  // The wrapper has to be notified that pixels have been updated
-  m_SnakeWrapper->PixelsModified();
-  // clock_t c2 = clock();
+  // Show the result and fire the update event
+  this->UpdateSnakeFromSegmentationThread();
+}
 
-  // Leave a thread-safe section
-  m_LevelSetPipelineMutex.unlock();
+void
+SNAPImageData
+::StartSegmentationThread(unsigned int nIterations)
+{
+  // Should be in level set mode
+  assert(m_LevelSetDriver);
+
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+  m_EvolutionStepSize = nIterations;
+  m_EvolutionRunning = true;
+  if(!m_EvolutionThread.joinable())
+    {
+    m_EvolutionStop = false;
+    m_EvolutionThread = std::thread(&SNAPImageData::EvolutionThread, this);
+    }
+  m_EvolutionCondition.notify_all();
+}
+
+void
+SNAPImageData
+::PauseSegmentationThread()
+{
+  std::unique_lock<std::mutex> lock(m_EvolutionMutex);
+  m_EvolutionRunning = false;
+  m_EvolutionCondition.wait(lock, [this]() { return !m_EvolutionBusy; });
+}
+
+bool
+SNAPImageData
+::IsSegmentationThreadRunning()
+{
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+  return m_EvolutionRunning;
+}
+
+void
+SNAPImageData
+::StopSegmentationThread()
+{
+  {
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+  m_EvolutionStop = true;
+  m_EvolutionRunning = false;
+  }
+  m_EvolutionCondition.notify_all();
+  if(m_EvolutionThread.joinable())
+    m_EvolutionThread.join();
+}
+
+void
+SNAPImageData
+::EvolutionThread()
+{
+  std::unique_lock<std::mutex> lock(m_EvolutionMutex);
+  while(true)
+    {
+    m_EvolutionCondition.wait(lock, [this]() { return m_EvolutionStop || m_EvolutionRunning; });
+    if(m_EvolutionStop)
+      return;
+
+    // Take a step with the mutex released, so that the last snapshot can be
+    // shown in the meantime. The level set is only ever changed between
+    // steps, so pausing waits for the step to finish.
+    m_EvolutionBusy = true;
+    unsigned int nIterations = m_EvolutionStepSize;
+    lock.unlock();
+
+    // A failure stops the evolution, and is reported to the caller of
+    // UpdateSnakeFromSegmentationThread()
+    std::exception_ptr error;
+    try
+      {
+      m_LevelSetDriver->Run(nIterations);
+      this->CopyLevelSetToSnapshot();
+      }
+    catch(...)
+      {
+      error = std::current_exception();
+      }
 
-  /*
-  std::cout << (c2 - c1) * 1.0 / (CLOCKS_PER_SEC * nIterations)
-            << " sec per iteration." << std::endl; */
+    lock.lock();
+    if(error)
+      {
+      m_EvolutionError = error;
+      m_EvolutionRunning = false;
+      }
+    m_EvolutionBusy = false;
+    m_EvolutionCondition.notify_all();
+    }
+}
+
+void
+SNAPImageData
+::CopyLevelSetToSnapshot()
+{
+  // Take the back snapshot. It cannot be shown until it has been written,
+  // so the copy is made without holding the mutex.
+  unsigned int back;
+  {
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+  back = 1 - m_FrontSnapshot;
+  m_SnapshotReady = false;
+  }
+
+  LevelSetContainerType *source = m_LevelSetDriver->GetOutput()->GetPixelContainer();
+  std::copy(source->GetBufferPointer(), source->GetBufferPointer() + source->Size(),
+            m_LevelSetSnapshot[back]->GetBufferPointer());
+  unsigned int iterations = m_LevelSetDriver->GetElapsedIterations();
+
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+  m_LevelSetSnapshotIterations[back] = iterations;
+  m_SnapshotReady = true;
+}
+
+bool
+SNAPImageData
+::UpdateSnakeFromSegmentationThread()
+{
+  {
+  // The mesh pipeline reads the snake image with the pipeline mutex held
+  std::lock_guard<std::mutex> guard(m_LevelSetPipelineMutex);
+
+  // The back snapshot becomes the one shown. The thread copies its next
+  // result to the snapshot shown until now. Nothing reads that one after
+  // the wrapper lets go of it below: the mesh pipeline is locked out, and
+  // the wrapper discards display slices computed from it.
+  {
+  std::lock_guard<std::mutex> lock(m_EvolutionMutex);
+
+  // Report a failure of the background evolution once
+  if(m_EvolutionError)
+    {
+    std::exception_ptr error = m_EvolutionError;
+    m_EvolutionError = nullptr;
+    std::rethrow_exception(error);
+    }
+
+  if(!m_SnapshotReady)
+    return false;
+  m_FrontSnapshot = 1 - m_FrontSnapshot;
+  m_SnapshotReady = false;
+  }
+
+  m_SnakeWrapper->SetPixelContainer(m_LevelSetSnapshot[m_FrontSnapshot]);
+  }
 
   // Fire the update event
   this->InvokeEvent(LevelSetImageChangeEvent());
+  return true;
 }
 
 bool
@@ -459,23 +620,16 @@ SNAPImageData
   // Should be in level set mode
   assert(m_LevelSetDriver);
 
-  // Enter a thread-safe section
-  m_LevelSetPipelineMutex.lock();
+  // Wait for the step in progress, if any
+  this->PauseSegmentationThread();
 
   // Pass through to the level set driver
   m_LevelSetDriver->Restart();
-    
-  // Copy the output pixels from the level set filter to the snake image wrapper.
-  // The ITK pattern is to do the opposite, i.e., graft the image onto the level
-  // set filter, but the particular filter used for level set propagation,
-  // ParallelSparseFieldLevelSetImageFilter is not coded to support this.
-  m_SnakeWrapper->SetPixelContainer(m_LevelSetDriver->GetOutput()->GetPixelContainer());
 
-  // Leave a thread-safe section
-  m_LevelSetPipelineMutex.unlock();
+  this->CopyLevelSetToSnapshot();
 
-  // Fire the update event
-  this->InvokeEvent(LevelSetImageChangeEvent());
+  // Show the initial level set and fire the update event
+  this->UpdateSnakeFromSegmentationThread();
 }
 
 void 
@@ -485,6 +639,9 @@ SNAPImageData
   // Should be in level set mode
   assert(m_LevelSetDriver);
 
+  // The thread must not outlive the level set driver
+  this->StopSegmentationThread();
+
   // Enter a thread-safe section
   m_LevelSetPipelineMutex.lock();
 
@@ -505,15 +662,23 @@ SNAPImageData
   // Should be in level set mode
   assert(m_LevelSetDriver);
 
+  // The parameters are changed between steps
+  bool running = this->IsSegmentationThreadRunning();
+  this->PauseSegmentationThread();
+
   // Pass through to the level set driver
   m_LevelSetDriver->SetSnakeParameters(parameters);
+
+  if(running)
+    this->StartSegmentationThread(m_EvolutionStepSize);
 }
 
 unsigned int 
 SNAPImageData::
 GetElapsedSegmentationIterations() const
 {
-  return m_LevelSetDriver->GetElapsedIterations();
+  // The iterations of the level set being shown
+  return m_LevelSetSnapshotIterations[m_FrontSnapshot];
 }
 
 SNAPLevelSetDriver<3>::LevelSetFunctionType *
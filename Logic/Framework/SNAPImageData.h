@@ -48,6 +48,10 @@
 #include "SNAPLevelSetDriver.h"
 
 #include <vector>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include "SNAPLevelSetFunction.h"
 #include "itkImageAdaptor.h"
@@ -163,6 +167,29 @@ public:
   /** Run the segmentation for a fixed number of iterations */
   void RunSegmentation(unsigned int nIterations);
 
+  /**
+   * Evolve the segmentation on a background thread, nIterations at a time,
+   * until paused. If the thread is already running, this changes the number
+   * of iterations per step. The level set image shown by the snake wrapper
+   * is not changed by the thread; call UpdateSnakeFromSegmentationThread()
+   * to show the result of the latest step.
+   */
+  void StartSegmentationThread(unsigned int nIterations);
+
+  /** Stop evolving in the background, waiting for the current step */
+  void PauseSegmentationThread();
+
+  /** Is the segmentation evolving in the background */
+  bool IsSegmentationThreadRunning();
+
+  /**
+   * Show the level set computed by the latest completed step, if it has not
+   * been shown yet. Returns true and fires LevelSetImageChangeEvent if the
+   * snake image was updated. If a step failed, the thread stops running and
+   * the exception it threw is rethrown here.
+   */
+  bool UpdateSnakeFromSegmentationThread();
+
   /** Revert the segmentation to the beginning */
   void RestartSegmentation();
 
@@ -288,6 +315,36 @@ protected:
   // causing the level set pipeline to update at once.
   std::mutex m_LevelSetPipelineMutex;
 
+  // Two copies of the level set image. The snake wrapper shows the front
+  // one, and new results are copied to the other one, so that the image
+  // being shown is never written to.
+  typedef SNAPLevelSetDriver3d::FloatImageType::PixelContainer LevelSetContainerType;
+  SmartPtr<LevelSetContainerType> m_LevelSetSnapshot[2];
+  unsigned int m_LevelSetSnapshotIterations[2];
+  unsigned int m_FrontSnapshot;
+  bool m_SnapshotReady;
+
+  // Thread evolving the level set, the number of iterations per step, and
+  // whether it should be running, is in the middle of a step or should exit.
+  // The flags and the snapshots are guarded by the mutex.
+  std::thread m_EvolutionThread;
+  std::mutex m_EvolutionMutex;
+  std::condition_variable m_EvolutionCondition;
+  unsigned int m_EvolutionStepSize;
+  bool m_EvolutionRunning, m_EvolutionBusy, m_EvolutionStop;
+
+  // The exception thrown by the last failed step, until it is reported
+  std::exception_ptr m_EvolutionError;
+
+  void EvolutionThread();
+
+  // Stop and join the evolution thread
+  void StopSegmentationThread();
+
+  // Copy the level set to the back snapshot. Must be called without the
+  // evolution mutex, and not while the thread is taking a step.
+  void CopyLevelSetToSnapshot();
+
   // Are we in example mode
   bool m_LabelImageInExampleMode;
 
@@ -75,11 +75,19 @@ public:
       m_ActiveLabel(active_label),
       m_DrawOver(draw_over),
       m_Iterator(seg_wrapper->GetModifiableImage(), region),
+      m_Position(0),
+      m_RunStart(0),
+      m_RunLength(0),
+      m_RunValue(0),
       m_ChangedVoxels(0)
   {
-    // Create the delta
+    // Create the delta. Only the changed runs within the region are stored
     m_Delta = new UndoDelta();
     m_Delta->SetRegion(region);
+    m_Delta->SetSparse(true);
+
+    // Remember the state of the image before the update, for delta observers
+    m_BaseTime = seg_wrapper->GetImage4DBase()->GetMTime();
 
     // Set the voxel delta to zero
     m_VoxelDelta = 0;
@@ -93,15 +101,29 @@ public:
 
   void operator ++()
   {
-    // Encode the current voxel delta
-    m_Delta->Encode(m_VoxelDelta);
-    m_VoxelDelta = 0;
-
-    // Keep track of changed voxels
+    // Changed voxels are collected into runs, which are passed to the delta
+    // when they end, so unchanged voxels cost nothing to encode
     if(m_VoxelDelta != 0)
-      m_ChangedVoxels++;
+      {
+      if(m_RunLength > 0
+         && m_RunStart + m_RunLength == m_Position
+         && m_RunValue == m_VoxelDelta
+         && m_Position % m_Region.GetSize(0) != 0)
+        {
+        m_RunLength++;
+        }
+      else
+        {
+        this->FlushRun();
+        m_RunStart = m_Position;
+        m_RunLength = 1;
+        m_RunValue = m_VoxelDelta;
+        }
+      m_VoxelDelta = 0;
+      }
 
     // Update the internal iterator
+    ++m_Position;
     ++m_Iterator;
   }
 
@@ -232,10 +254,13 @@ public:
    */
   bool Finalize(const char *undo_string = nullptr)
   {
+    this->FlushRun();
     m_Delta->FinishEncoding();
     if(m_ChangedVoxels > 0)
       {
+      m_Wrapper->NotifyDeltaApplied(m_Delta, false, m_BaseTime);
       m_Wrapper->PixelsModified();
+      m_Wrapper->NotifyDeltasFinished();
       if(undo_string)
         m_Wrapper->StoreUndoPoint(undo_string, RelinquishDelta());
       return true;
@@ -265,6 +290,16 @@ public:
 
 protected:
 
+  // Pass the open run of changed voxels to the delta
+  void FlushRun()
+  {
+    if(m_RunLength > 0)
+      {
+      m_Delta->EncodeRun(m_RunStart, m_RunLength, m_RunValue);
+      m_RunLength = 0;
+      }
+  }
+
   // The label image wrapper to which segmentation is applied
   LabelImageWrapper *m_Wrapper;
 
@@ -289,6 +324,14 @@ protected:
   // Delta at the current location
   LabelType m_VoxelDelta;
 
+  // Offset of the current voxel from the start of the region, and the open
+  // run of changed voxels with the same delta
+  size_t m_Position, m_RunStart, m_RunLength;
+  LabelType m_RunValue;
+
+  // MTime of the image before the update
+  itk::ModifiedTimeType m_BaseTime;
+
   // Number of voxels actually modified
   unsigned long m_ChangedVoxels;
 };
@@ -37,13 +37,58 @@
 
 #include <vector>
 #include <list>
+#include <cstdio>
 
 #include <RLEImage.h>
 
+/**
+ * A temporary file to which the undo system spills old deltas once they
+ * exceed the memory budget. Data is appended to the end of the file; the
+ * file is truncated once no spilled data remains live. The file is deleted
+ * automatically when closed.
+ */
+class UndoSpillFile
+{
+public:
+  UndoSpillFile();
+  ~UndoSpillFile();
+
+  /** Write a block of bytes, returning its offset in the file, or -1 if
+   * the file could not be written (e.g., disk full, no temp directory) */
+  long long Write(const std::vector<unsigned char> &data);
+
+  /** Read a block previously written with Write(). Returns false on error */
+  bool Read(long long offset, size_t size, std::vector<unsigned char> &data);
+
+  /** Mark a block as no longer needed */
+  void Release(size_t size);
+
+  /** Number of bytes occupied by live blocks */
+  size_t GetLiveSize() const { return m_LiveSize; }
+
+protected:
+  FILE *m_File;
+  long long m_End;
+  size_t m_LiveSize;
+};
+
 /**
  * The Delta class represents a difference between two images used in
  * the Undo system. It only supports linear traversal of images and
  * stores differences in an RLE (run length encoding) format.
+ *
+ * A delta can be moved between storage tiers to bound the memory used by
+ * the undo history. In the RAW tier, the run length array is held in
+ * memory and can be read. In the COMPRESSED tier, the runs are packed as
+ * variable-length integers and deflated. In the SPILLED tier, the packed
+ * bytes are held in an UndoSpillFile. Restore() brings a delta back to
+ * the RAW tier, which is required before calling GetRLEValue/GetRLELength.
+ *
+ * A delta may also be sparse. A sparse delta only stores the runs of
+ * nonzero differences, each with its offset from the start of the region,
+ * and runs never cross a line of the region. This way an edit that only
+ * changes a few voxels in a large bounding box is stored compactly, and
+ * can be replayed by visiting only the lines it changed (GetRLERegion).
  */
 template <typename TPixel>
 class UndoDelta
@@ -51,20 +96,44 @@ class UndoDelta
 public:
   typedef itk::ImageRegion<3> RegionType;
 
+  enum StorageTier { RAW, COMPRESSED, SPILLED };
+
   UndoDelta();
+  ~UndoDelta();
 
   void SetRegion(const RegionType &region)
   { this->m_Region = region; }
 
+  /** Make the delta sparse. Must be called before encoding, and requires
+   * the region to be set, since runs are split at its line boundaries */
+  void SetSparse(bool flag)
+  { this->m_Sparse = flag; }
+
+  bool IsSparse() const
+  { return m_Sparse; }
+
   const RegionType &GetRegion()
   { return m_Region; }
 
+  /** For dense deltas, store the difference at the next voxel of the region */
   void Encode(const TPixel &value);
 
+  /** For sparse deltas, store a run of voxels with the same nonzero
+   * difference, starting at the given offset from the start of the region.
+   * Runs must be given in increasing order and may not cross a line of the
+   * region; a run that continues the previous one is merged with it. This
+   * lets the caller skip the unchanged voxels instead of encoding them.
+   * Must not be mixed with Encode() in the same delta. */
+  void EncodeRun(size_t offset, size_t length, const TPixel &value);
+
   void FinishEncoding();
 
+  /** Number of calls to Encode() and EncodeRun() made so far */
+  size_t GetNumberOfEncodeCalls() const
+  { return m_EncodeCalls; }
+
   size_t GetNumberOfRLEs()
-  { return m_Array.size(); }
+  { return m_Tier == RAW ? m_Array.size() : m_NumberOfRLEs; }
 
   TPixel GetRLEValue(size_t i)
   { return m_Array[i].second; }
@@ -72,9 +141,33 @@ public:
   size_t GetRLELength(size_t i)
   { return m_Array[i].first; }
 
+  /** For sparse deltas, offset of the i-th run from the start of the region */
+  size_t GetRLEOffset(size_t i)
+  { return m_Offsets[i]; }
+
+  /** For sparse deltas, the part of a single line covered by the i-th run */
+  RegionType GetRLERegion(size_t i);
+
   unsigned long GetUniqueID() const
   { return m_UniqueID; }
 
+  /** Current storage tier */
+  StorageTier GetStorageTier() const
+  { return m_Tier; }
+
+  /** Number of bytes of memory held by the delta's data */
+  size_t GetMemorySize() const;
+
+  /** Pack the runs into a deflated byte buffer (RAW -> COMPRESSED) */
+  void Compress();
+
+  /** Move the packed bytes to the spill file (COMPRESSED -> SPILLED).
+   * If the file cannot be written, the delta stays COMPRESSED. */
+  void Spill(UndoSpillFile *file);
+
+  /** Bring the delta back to the RAW tier */
+  void Restore();
+
   UndoDelta & operator = (const UndoDelta &other);
 
 protected:
@@ -84,6 +177,21 @@ protected:
   size_t m_CurrentLength;
   TPixel m_LastValue;
 
+  // Sparse deltas: offsets of the runs from the start of the region
+  bool m_Sparse;
+  std::vector<size_t> m_Offsets;
+  size_t m_EncodeCalls;
+
+  // Number of RLEs, valid in all tiers
+  size_t m_NumberOfRLEs;
+
+  // Storage for the COMPRESSED and SPILLED tiers
+  StorageTier m_Tier;
+  std::vector<unsigned char> m_Packed;
+  size_t m_PackedSize, m_UnpackedSize;
+  long long m_SpillOffset;
+  UndoSpillFile *m_SpillFile;
+
   // The delta is associated with an image region
   RegionType m_Region;
 
@@ -96,6 +204,14 @@ protected:
 /**
  * \class UndoDataManager
  * \brief Manages data (delta updates) for undo/redo in itk-snap
+ *
+ * The history is kept in tiers. The commits nearest to the current undo
+ * position are kept as raw RLE, so that undo and redo of recent edits are
+ * immediate. Older commits are compressed, and once the memory used by the
+ * history exceeds the memory budget, the oldest compressed commits are
+ * spilled to a temporary file. Commits are paged back in by
+ * GetCommitForUndo() and GetCommitForRedo(). The total number of RLEs in
+ * the history (in any tier) is bounded by nMaxTotalSize.
  */
 template<typename TPixel> class UndoDataManager
 {
@@ -123,6 +239,10 @@ public:
     Commit(const DList &list, const char *name);
     void DeleteDeltas();
     size_t GetNumberOfRLEs() const;
+    size_t GetMemorySize() const;
+    void Compress() const;
+    void Spill(UndoSpillFile *file) const;
+    void Restore() const;
     const DList &GetDeltas() const { return m_Deltas; }
   protected:
     DList m_Deltas;
@@ -130,6 +250,7 @@ public:
   };
 
   UndoDataManager(size_t nMinCommits, size_t nMaxTotalSize);
+  ~UndoDataManager();
 
   /** Add a delta to the staging list. The staging list must be committed */
   void AddDeltaToStaging(Delta *delta);
@@ -149,8 +270,34 @@ public:
   size_t GetNumberOfCommits()
     { return m_CommitList.size(); }
 
+  /** Number of commits on either side of the current position that are
+   * kept uncompressed (default 2) */
+  void SetNumberOfRawCommits(size_t n)
+    { m_NumberOfRawCommits = n; UpdateStorageTiers(); }
+
+  /** Memory budget for the history, in bytes. Compressed commits beyond
+   * the budget are spilled to disk (if enabled). Default 64 MB. */
+  void SetMemoryBudget(size_t bytes)
+    { m_MemoryBudget = bytes; UpdateStorageTiers(); }
+
+  /** Whether commits beyond the memory budget may be spilled to a
+   * temporary file (default on) */
+  void SetSpillToDisk(bool flag)
+    { m_SpillToDisk = flag; UpdateStorageTiers(); }
+
+  /** Memory currently used by the history, in bytes */
+  size_t GetMemorySize() const;
+
+  /** Bytes of history currently held in the spill file */
+  size_t GetSpilledSize() const
+    { return m_SpillFile ? m_SpillFile->GetLiveSize() : 0; }
+
 private:
 
+  // Move commits between tiers according to their distance from the
+  // current position and the memory budget
+  void UpdateStorageTiers();
+
   // Current staging list - where deltas are added
   DList m_StagingList;
 
@@ -163,6 +310,13 @@ private:
   CList m_CommitList;
   CIterator m_Position;
   size_t m_TotalSize, m_MinCommits, m_MaxTotalSize;
+
+  // Tiered storage settings
+  size_t m_NumberOfRawCommits, m_MemoryBudget;
+  bool m_SpillToDisk;
+
+  // Spill file, created on first use
+  UndoSpillFile *m_SpillFile;
 };
 
 #endif // __UndoDataManager_h_
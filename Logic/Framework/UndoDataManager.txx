@@ -33,6 +33,10 @@
 
 =========================================================================*/
 
+#include "IRISException.h"
+#include "itk_zlib.h"
+#include <cstring>
+
 template<typename TPixel> unsigned long UndoDelta<TPixel>::m_UniqueIDCounter = 0;
 
 template<typename TPixel>
@@ -40,14 +44,32 @@ UndoDelta<TPixel>
 ::UndoDelta()
 {
   m_CurrentLength = 0;
+  m_Sparse = false;
+  m_EncodeCalls = 0;
+  m_NumberOfRLEs = 0;
+  m_Tier = RAW;
+  m_PackedSize = 0;
+  m_UnpackedSize = 0;
+  m_SpillOffset = -1;
+  m_SpillFile = NULL;
   m_UniqueID = m_UniqueIDCounter++;
 }
 
+template<typename TPixel>
+UndoDelta<TPixel>
+::~UndoDelta()
+{
+  if(m_Tier == SPILLED)
+    m_SpillFile->Release(m_PackedSize);
+}
+
 template<typename TPixel>
 void
 UndoDelta<TPixel>
 ::Encode(const TPixel &value)
 {
+  assert(!m_Sparse);
+  m_EncodeCalls++;
   if(m_CurrentLength == 0)
     {
     m_LastValue = value;
@@ -65,6 +87,33 @@ UndoDelta<TPixel>
     }
 }
 
+template<typename TPixel>
+void
+UndoDelta<TPixel>
+::EncodeRun(size_t offset, size_t length, const TPixel &value)
+{
+  assert(m_Sparse && m_CurrentLength == 0);
+  m_EncodeCalls++;
+  if(length == 0 || value == 0)
+    return;
+
+  // Merge with the previous run if it ends where this one starts, on the
+  // same line
+  if(!m_Array.empty())
+    {
+    RLEPair &last = m_Array.back();
+    size_t end = m_Offsets.back() + last.first;
+    if(end == offset && last.second == value && offset % m_Region.GetSize(0) != 0)
+      {
+      last.first += length;
+      return;
+      }
+    }
+
+  m_Array.push_back(std::make_pair(length, value));
+  m_Offsets.push_back(offset);
+}
+
 template<typename TPixel>
 void
 UndoDelta<TPixel>
@@ -72,6 +121,173 @@ UndoDelta<TPixel>
 {
   if(m_CurrentLength > 0)
     m_Array.push_back(std::make_pair(m_CurrentLength, m_LastValue));
+  m_NumberOfRLEs = m_Array.size();
+}
+
+template<typename TPixel>
+typename UndoDelta<TPixel>::RegionType
+UndoDelta<TPixel>
+::GetRLERegion(size_t i)
+{
+  // Convert the offset of the run into an index within the region
+  size_t nx = m_Region.GetSize(0), ny = m_Region.GetSize(1);
+  size_t offset = m_Offsets[i], line = offset / nx;
+
+  RegionType::IndexType idx = m_Region.GetIndex();
+  idx[0] += offset % nx;
+  idx[1] += line % ny;
+  idx[2] += line / ny;
+
+  RegionType::SizeType size;
+  size[0] = m_Array[i].first;
+  size[1] = 1;
+  size[2] = 1;
+
+  return RegionType(idx, size);
+}
+
+template<typename TPixel>
+size_t
+UndoDelta<TPixel>
+::GetMemorySize() const
+{
+  switch(m_Tier)
+    {
+    case RAW: return m_Array.capacity() * sizeof(RLEPair)
+                     + m_Offsets.capacity() * sizeof(size_t);
+    case COMPRESSED: return m_Packed.capacity();
+    default: return 0;
+    }
+}
+
+template<typename TPixel>
+void
+UndoDelta<TPixel>
+::Compress()
+{
+  if(m_Tier != RAW || m_Array.empty())
+    return;
+
+  // Pack each run as a variable-length integer followed by the raw value.
+  // Deltas mostly consist of long runs of zeros and a few distinct values,
+  // which the subsequent deflate pass squeezes further. Sparse runs are
+  // preceded by the gap from the end of the previous run.
+  std::vector<unsigned char> unpacked;
+  unpacked.reserve(m_Array.size() * ((m_Sparse ? 4 : 2) + sizeof(TPixel)));
+  auto pack = [&unpacked](size_t n)
+    {
+    while(n >= 0x80)
+      {
+      unpacked.push_back((unsigned char)(n | 0x80));
+      n >>= 7;
+      }
+    unpacked.push_back((unsigned char) n);
+    };
+
+  size_t end = 0;
+  for(size_t i = 0; i < m_Array.size(); i++)
+    {
+    if(m_Sparse)
+      {
+      pack(m_Offsets[i] - end);
+      end = m_Offsets[i] + m_Array[i].first;
+      }
+    pack(m_Array[i].first);
+    const unsigned char *v = (const unsigned char *) &m_Array[i].second;
+    unpacked.insert(unpacked.end(), v, v + sizeof(TPixel));
+    }
+
+  uLongf zsize = compressBound(unpacked.size());
+  std::vector<unsigned char> packed(zsize);
+  if(compress2(&packed[0], &zsize, &unpacked[0], unpacked.size(), 1) != Z_OK)
+    return; // leave the delta raw
+
+  packed.resize(zsize);
+  packed.shrink_to_fit();
+  m_Packed.swap(packed);
+  m_PackedSize = zsize;
+  m_UnpackedSize = unpacked.size();
+  m_NumberOfRLEs = m_Array.size();
+
+  RLEArray().swap(m_Array);
+  std::vector<size_t>().swap(m_Offsets);
+  m_Tier = COMPRESSED;
+}
+
+template<typename TPixel>
+void
+UndoDelta<TPixel>
+::Spill(UndoSpillFile *file)
+{
+  if(m_Tier != COMPRESSED)
+    return;
+
+  // If the file cannot be written, the delta just stays in memory
+  long long offset = file->Write(m_Packed);
+  if(offset < 0)
+    return;
+
+  m_SpillOffset = offset;
+  m_SpillFile = file;
+  std::vector<unsigned char>().swap(m_Packed);
+  m_Tier = SPILLED;
+}
+
+template<typename TPixel>
+void
+UndoDelta<TPixel>
+::Restore()
+{
+  if(m_Tier == SPILLED)
+    {
+    if(!m_SpillFile->Read(m_SpillOffset, m_PackedSize, m_Packed))
+      throw IRISException("Failed to read undo data from temporary file");
+    m_SpillFile->Release(m_PackedSize);
+    m_SpillFile = NULL;
+    m_SpillOffset = -1;
+    m_Tier = COMPRESSED;
+    }
+
+  if(m_Tier == COMPRESSED)
+    {
+    std::vector<unsigned char> unpacked(m_UnpackedSize);
+    uLongf usize = m_UnpackedSize;
+    if(uncompress(&unpacked[0], &usize, &m_Packed[0], m_PackedSize) != Z_OK
+       || usize != m_UnpackedSize)
+      throw IRISException("Failed to decompress undo data");
+
+    const unsigned char *p = &unpacked[0];
+    auto unpack = [&p]()
+      {
+      size_t n = 0;
+      for(int shift = 0; ; shift += 7)
+        {
+        unsigned char b = *p++;
+        n |= size_t(b & 0x7f) << shift;
+        if(!(b & 0x80))
+          return n;
+        }
+      };
+
+    m_Array.resize(m_NumberOfRLEs);
+    if(m_Sparse)
+      m_Offsets.resize(m_NumberOfRLEs);
+
+    size_t end = 0;
+    for(size_t i = 0; i < m_NumberOfRLEs; i++)
+      {
+      if(m_Sparse)
+        m_Offsets[i] = end + unpack();
+      m_Array[i].first = unpack();
+      if(m_Sparse)
+        end = m_Offsets[i] + m_Array[i].first;
+      memcpy(&m_Array[i].second, p, sizeof(TPixel));
+      p += sizeof(TPixel);
+      }
+
+    std::vector<unsigned char>().swap(m_Packed);
+    m_Tier = RAW;
+    }
 }
 
 template<typename TPixel>
@@ -79,9 +295,15 @@ UndoDelta<TPixel> &
 UndoDelta<TPixel>
 ::operator = (const UndoDelta<TPixel> &other)
 {
+  // Only raw deltas can be copied
+  assert(other.m_Tier == RAW);
   m_Array = other.m_Array;
   m_CurrentLength = other.m_CurrentLength;
   m_LastValue = other.m_LastValue;
+  m_Sparse = other.m_Sparse;
+  m_Offsets = other.m_Offsets;
+  m_EncodeCalls = other.m_EncodeCalls;
+  m_NumberOfRLEs = other.m_NumberOfRLEs;
   m_Region = other.m_Region;
   return *this;
 }
@@ -95,6 +317,19 @@ UndoDataManager<TPixel>
   this->m_MaxTotalSize = nMaxTotalSize;
   this->m_TotalSize = 0;
   m_Position = m_CommitList.begin();
+  m_NumberOfRawCommits = 2;
+  m_MemoryBudget = 64 * 1024 * 1024;
+  m_SpillToDisk = true;
+  m_SpillFile = NULL;
+}
+
+template<typename TPixel>
+UndoDataManager<TPixel>
+::~UndoDataManager()
+{
+  // The deltas must be deleted before the file they may be spilled to
+  Clear();
+  delete m_SpillFile;
 }
 
 template<typename TPixel>
@@ -171,10 +406,62 @@ UndoDataManager<TPixel>
   m_Position = m_CommitList.end();
   m_TotalSize += n_new_rles;
 
+  // Push older commits down the storage tiers
+  UpdateStorageTiers();
+
   // Return the number of RLEs
   return n_new_rles;
 }
 
+template<typename TPixel>
+void
+UndoDataManager<TPixel>
+::UpdateStorageTiers()
+{
+  // Order the commits by their distance from the current position,
+  // alternating between the undo and the redo side
+  std::vector<const Commit *> order;
+  order.reserve(m_CommitList.size());
+  CIterator itBack = m_Position, itFwd = m_Position;
+  while(itBack != m_CommitList.begin() || itFwd != m_CommitList.end())
+    {
+    if(itBack != m_CommitList.begin())
+      order.push_back(&(*(--itBack)));
+    if(itFwd != m_CommitList.end())
+      order.push_back(&(*(itFwd++)));
+    }
+
+  // Keep the nearest commits as they are, compress the rest, and spill
+  // whatever does not fit into the memory budget
+  size_t memory = 0;
+  for(size_t k = 0; k < order.size(); k++)
+    {
+    const Commit *c = order[k];
+    if(k >= m_NumberOfRawCommits)
+      {
+      c->Compress();
+      if(m_SpillToDisk && memory + c->GetMemorySize() > m_MemoryBudget)
+        {
+        if(!m_SpillFile)
+          m_SpillFile = new UndoSpillFile();
+        c->Spill(m_SpillFile);
+        }
+      }
+    memory += c->GetMemorySize();
+    }
+}
+
+template<typename TPixel>
+size_t
+UndoDataManager<TPixel>
+::GetMemorySize() const
+{
+  size_t memory = 0;
+  for(CConstIterator it = m_CommitList.begin(); it != m_CommitList.end(); ++it)
+    memory += it->GetMemorySize();
+  return memory;
+}
+
 template<typename TPixel>
 bool
 UndoDataManager<TPixel>
@@ -194,6 +481,10 @@ UndoDataManager<TPixel>
   // Move the position one delta to the beginning
   m_Position--;
 
+  // Rebalance the tiers around the new position and page in the commit
+  UpdateStorageTiers();
+  m_Position->Restore();
+
   // Return the current delta
   return *m_Position;
 }
@@ -220,6 +511,10 @@ UndoDataManager<TPixel>
   // Move the position one delta to the end
   m_Position++;
 
+  // Rebalance the tiers around the new position and page in the commit
+  UpdateStorageTiers();
+  commit.Restore();
+
   // Return the current delta
   return commit;
 }
@@ -263,3 +558,43 @@ UndoDataManager<TPixel>::Commit::GetNumberOfRLEs() const
     }
   return n;
 }
+
+template<typename TPixel>
+size_t
+UndoDataManager<TPixel>::Commit::GetMemorySize() const
+{
+  size_t n = 0;
+  for(DConstIterator dit = m_Deltas.begin(); dit != m_Deltas.end(); ++dit)
+    {
+    if(*dit)
+      n += (*dit)->GetMemorySize();
+    }
+  return n;
+}
+
+template<typename TPixel>
+void
+UndoDataManager<TPixel>::Commit::Compress() const
+{
+  for(DConstIterator dit = m_Deltas.begin(); dit != m_Deltas.end(); ++dit)
+    if(*dit)
+      (*dit)->Compress();
+}
+
+template<typename TPixel>
+void
+UndoDataManager<TPixel>::Commit::Spill(UndoSpillFile *file) const
+{
+  for(DConstIterator dit = m_Deltas.begin(); dit != m_Deltas.end(); ++dit)
+    if(*dit)
+      (*dit)->Spill(file);
+}
+
+template<typename TPixel>
+void
+UndoDataManager<TPixel>::Commit::Restore() const
+{
+  for(DConstIterator dit = m_Deltas.begin(); dit != m_Deltas.end(); ++dit)
+    if(*dit)
+      (*dit)->Restore();
+}
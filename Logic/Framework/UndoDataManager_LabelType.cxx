@@ -36,5 +36,63 @@
 #include "UndoDataManager.h"
 #include "UndoDataManager.txx"
 
+#if defined(_WIN32)
+#define undo_fseek _fseeki64
+#else
+#define undo_fseek fseeko
+#endif
+
+UndoSpillFile::UndoSpillFile()
+  : m_File(NULL), m_End(0), m_LiveSize(0)
+{
+}
+
+UndoSpillFile::~UndoSpillFile()
+{
+  if(m_File)
+    fclose(m_File);
+}
+
+long long UndoSpillFile::Write(const std::vector<unsigned char> &data)
+{
+  // The file is created lazily, and removed by the system when closed
+  if(!m_File)
+    {
+    m_File = tmpfile();
+    m_End = 0;
+    if(!m_File)
+      return -1;
+    }
+
+  if(undo_fseek(m_File, m_End, SEEK_SET) != 0
+     || fwrite(data.data(), 1, data.size(), m_File) != data.size())
+    return -1;
+
+  long long offset = m_End;
+  m_End += data.size();
+  m_LiveSize += data.size();
+  return offset;
+}
+
+bool UndoSpillFile::Read(long long offset, size_t size, std::vector<unsigned char> &data)
+{
+  data.resize(size);
+  return m_File
+      && undo_fseek(m_File, offset, SEEK_SET) == 0
+      && fread(data.data(), 1, size, m_File) == size;
+}
+
+void UndoSpillFile::Release(size_t size)
+{
+  // Once nothing live remains in the file, discard it to reclaim the space
+  m_LiveSize -= size;
+  if(m_LiveSize == 0 && m_File)
+    {
+    fclose(m_File);
+    m_File = NULL;
+    m_End = 0;
+    }
+}
+
 template class UndoDelta<LabelType>;
 template class UndoDataManager<LabelType>;
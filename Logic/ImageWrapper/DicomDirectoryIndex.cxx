@@ -0,0 +1,169 @@
+#include "DicomDirectoryIndex.h"
+#include "itksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+
+using itksys::SystemTools;
+
+// First line of the index file. Increment when the format changes
+static const char *DICOM_INDEX_HEADER = "SNAPDicomDirectoryIndex 1";
+
+namespace
+{
+// Tag values and file names may contain any character, so tabs, newlines
+// and backslashes are escaped to keep one record per line
+std::string escape(const std::string &s)
+{
+  std::string out;
+  out.reserve(s.size());
+  for(char c : s)
+    {
+    switch(c)
+      {
+      case '\\': out += "\\\\"; break;
+      case '\t': out += "\\t"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      default: out += c;
+      }
+    }
+  return out;
+}
+
+std::string unescape(const std::string &s)
+{
+  std::string out;
+  out.reserve(s.size());
+  for(size_t i = 0; i < s.size(); i++)
+    {
+    if(s[i] == '\\' && i + 1 < s.size())
+      {
+      char c = s[++i];
+      out += (c == 't') ? '\t' : (c == 'n') ? '\n' : (c == 'r') ? '\r' : c;
+      }
+    else
+      out += s[i];
+    }
+  return out;
+}
+
+std::vector<std::string> split(const std::string &line)
+{
+  std::vector<std::string> fields;
+  size_t start = 0;
+  for(size_t pos; (pos = line.find('\t', start)) != std::string::npos; start = pos + 1)
+    fields.push_back(line.substr(start, pos - start));
+  fields.push_back(line.substr(start));
+  return fields;
+}
+}
+
+DicomDirectoryIndex::DicomDirectoryIndex()
+{
+  m_Loaded = false;
+}
+
+void DicomDirectoryIndex::SetFileName(const std::string &fn)
+{
+  m_FileName = fn;
+  m_Directories.clear();
+  m_Loaded = false;
+}
+
+void DicomDirectoryIndex::Load()
+{
+  m_Loaded = true;
+  if(m_FileName.empty())
+    return;
+
+  std::ifstream ifs(m_FileName.c_str());
+  std::string line;
+  if(!ifs.good() || !std::getline(ifs, line) || line != DICOM_INDEX_HEADER)
+    return;
+
+  // The file consists of directory lines, each followed by the lines of the
+  // files in that directory. Malformed lines are skipped.
+  DirectoryEntry *entry = nullptr;
+  while(std::getline(ifs, line))
+    {
+    std::vector<std::string> f = split(line);
+    if(f[0] == "D" && f.size() == 3)
+      {
+      entry = &m_Directories[unescape(f[2])];
+      entry->LastUsed = atol(f[1].c_str());
+      }
+    else if(f[0] == "F" && f.size() >= 5 && entry)
+      {
+      FileRecord rec;
+      rec.ModifiedTime = atol(f[1].c_str());
+      rec.Size = strtoull(f[2].c_str(), nullptr, 10);
+      rec.IsDicom = (f[3] == "1");
+      for(size_t i = 5; i < f.size(); i++)
+        rec.Tags.push_back(unescape(f[i]));
+      entry->Files[unescape(f[4])] = rec;
+      }
+    }
+}
+
+void DicomDirectoryIndex::Save()
+{
+  if(m_FileName.empty())
+    return;
+
+  if(!m_Loaded)
+    this->Load();
+
+  // Only keep the most recently used directories
+  std::vector<std::pair<long, std::string> > by_use;
+  for(auto &it : m_Directories)
+    by_use.push_back(std::make_pair(it.second.LastUsed, it.first));
+  std::sort(by_use.rbegin(), by_use.rend());
+  for(size_t i = MAX_DIRECTORIES; i < by_use.size(); i++)
+    m_Directories.erase(by_use[i].second);
+
+  // Write to a temporary file first, so that another instance of SNAP never
+  // reads a partial index
+  std::string tmp = m_FileName + ".tmp";
+  std::ofstream ofs(tmp.c_str());
+  ofs << DICOM_INDEX_HEADER << "\n";
+  for(auto &dit : m_Directories)
+    {
+    ofs << "D\t" << dit.second.LastUsed << "\t" << escape(dit.first) << "\n";
+    for(auto &fit : dit.second.Files)
+      {
+      const FileRecord &rec = fit.second;
+      ofs << "F\t" << rec.ModifiedTime << "\t" << rec.Size << "\t"
+          << (rec.IsDicom ? 1 : 0) << "\t" << escape(fit.first);
+      for(auto &tag : rec.Tags)
+        ofs << "\t" << escape(tag);
+      ofs << "\n";
+      }
+    }
+  ofs.close();
+
+  if(ofs.fail() || !SystemTools::RenameFile(tmp, m_FileName))
+    SystemTools::RemoveFile(tmp);
+}
+
+DicomDirectoryIndex::FileRecordMap
+DicomDirectoryIndex::GetDirectory(const std::string &dir)
+{
+  if(!m_Loaded)
+    this->Load();
+
+  auto it = m_Directories.find(dir);
+  return it != m_Directories.end() ? it->second.Files : FileRecordMap();
+}
+
+void DicomDirectoryIndex::UpdateDirectory(const std::string &dir, const FileRecordMap &records)
+{
+  if(!m_Loaded)
+    this->Load();
+
+  DirectoryEntry &entry = m_Directories[dir];
+  entry.LastUsed = (long) time(nullptr);
+  entry.Files = records;
+}
@@ -0,0 +1,81 @@
+#ifndef DICOMDIRECTORYINDEX_H
+#define DICOMDIRECTORYINDEX_H
+
+#include "SNAPCommon.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * \class DicomDirectoryIndex
+ * \brief A persistent record of the DICOM tags read from the files in
+ * recently parsed directories.
+ *
+ * GuidedNativeImageIO::ParseDicomDirectory() reads a handful of tags from
+ * every file in a directory, which is slow for large directories on network
+ * storage. This index remembers the tags of each file, along with the file's
+ * modification time and size, so that parsing the directory again only has
+ * to read the files that are new or have changed. Files that are not DICOM
+ * are remembered too, so they are not read again either.
+ *
+ * The index is kept in a text file, which is read on first use and written
+ * by Save(). Only the most recently parsed directories are kept.
+ */
+class DicomDirectoryIndex : public itk::Object
+{
+public:
+  irisITKObjectMacro(DicomDirectoryIndex, itk::Object)
+
+  /** What is known about one file */
+  struct FileRecord
+  {
+    long ModifiedTime = 0;
+    unsigned long long Size = 0;
+    bool IsDicom = false;
+
+    // Tag values, in the order used by the caller
+    std::vector<std::string> Tags;
+  };
+
+  typedef std::map<std::string, FileRecord> FileRecordMap;
+
+  /** Maximum number of directories kept in the index */
+  static constexpr unsigned int MAX_DIRECTORIES = 32;
+
+  /** Set the file where the index is kept. If not set, the index is only
+   * kept in memory */
+  void SetFileName(const std::string &fn);
+  const std::string &GetFileName() const { return m_FileName; }
+
+  /**
+   * Get the records of the files in a directory. A record is still valid if
+   * the file has the same modification time and size.
+   */
+  FileRecordMap GetDirectory(const std::string &dir);
+
+  /** Replace the records of a directory with the given records */
+  void UpdateDirectory(const std::string &dir, const FileRecordMap &records);
+
+  /** Write the index to its file. Failures are ignored */
+  void Save();
+
+protected:
+  DicomDirectoryIndex();
+  virtual ~DicomDirectoryIndex() {}
+
+  void Load();
+
+  struct DirectoryEntry
+  {
+    long LastUsed = 0;
+    FileRecordMap Files;
+  };
+
+  std::string m_FileName;
+  std::map<std::string, DirectoryEntry> m_Directories;
+  bool m_Loaded;
+};
+
+#endif // DICOMDIRECTORYINDEX_H
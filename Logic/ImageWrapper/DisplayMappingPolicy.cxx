@@ -4,8 +4,10 @@
 #include "LabelToRGBAFilter.h"
 #include "IntensityCurveVTK.h"
 #include "IntensityToColorLookupTableImageFilter.h"
-#include "LookupTableIntensityMappingFilter.h"
 #include "RGBALookupTableIntensityMappingFilter.h"
+#include "SliceIntensityMappingFilter.h"
+#include "BinAverageImageFilter.h"
+#include "AdaptiveSlicingPipeline.h"
 #include "ColorMap.h"
 #include "ScalarImageHistogram.h"
 #include "itkMinimumMaximumImageFilter.h"
@@ -17,6 +19,7 @@
 #include "Rebroadcaster.h"
 #include "TDigestImageFilter.h"
 #include "ColorLookupTable.h"
+#include <algorithm>
 
 /* ===============================================================
     ColorLabelTableDisplayMappingPolicy implementation
@@ -169,8 +172,28 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
   m_LookupTableFilter->SetImageMinInput(m_Wrapper->GetImageMinObject());
   m_LookupTableFilter->SetImageMaxInput(m_Wrapper->GetImageMaxObject());
 
+  // The display slices are read from the image, in the geometry of the slicers
   for(unsigned int i=0; i<3; i++)
-    m_IntensityFilter[i]->SetInput(m_Wrapper->GetSlice(i));
+    {
+    m_IntensityFilter[i]->SetInput(image);
+    m_IntensityFilter[i]->SetSlicer(m_Wrapper->GetSlicer(i));
+    m_IntensityFilter[i]->SetSliceCache(m_Wrapper->GetDisplaySliceCache());
+    }
+
+  // The pyramid levels that have been made are recomputed from the new image
+  for(unsigned int level = 1; level <= PYRAMID_LEVELS; level++)
+    if(m_PyramidFilter[level-1])
+      this->UpdatePyramidLevel(level, image);
+}
+
+template <class TWrapperTraits>
+void
+CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
+::UpdatePyramidLevel(unsigned int level, ImageType *image)
+{
+  m_PyramidFilter[level-1]->SetInput(image);
+  for(unsigned int i=0; i<3; i++)
+    m_ReducedIntensityFilter[level-1][i]->SetSlicer(m_Wrapper->GetSlicer(i));
 }
 
 template<class TWrapperTraits>
@@ -186,6 +209,11 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
   for(unsigned int i=0; i<3; i++)
     m_IntensityFilter[i]->SetLookupTable(m_LookupTableFilter->GetLookupTable());
 
+  for(unsigned int level = 1; level <= PYRAMID_LEVELS; level++)
+    if(m_PyramidFilter[level-1])
+      for(unsigned int i=0; i<3; i++)
+        m_ReducedIntensityFilter[level-1][i]->SetLookupTable(m_LookupTableFilter->GetLookupTable());
+
   // Copy the color map and the intensity curve
   this->SetColorMap(reference->m_ColorMap);
   this->SetIntensityCurve(reference->m_IntensityCurveVTK);
@@ -249,6 +277,34 @@ CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
   return m_IntensityFilter[dim]->GetOutput();
 }
 
+template<class TWrapperTraits>
+typename CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>::DisplaySlicePointer
+CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
+::GetReducedDisplaySlice(unsigned int dim, unsigned int level)
+{
+  level = std::min(level, (unsigned int) PYRAMID_LEVELS);
+  if(level == 0 || !m_Wrapper->GetImage())
+    return this->GetDisplaySlice(dim);
+
+  // Make the pyramid level the first time it is asked for. It shares the
+  // lookup table of the full resolution slices.
+  if(!m_PyramidFilter[level-1])
+    {
+    m_PyramidFilter[level-1] = PyramidFilterType::New();
+    m_PyramidFilter[level-1]->SetShrinkFactor(1u << level);
+    for(unsigned int i=0; i<3; i++)
+      {
+      m_ReducedIntensityFilter[level-1][i] = ReducedIntensityFilterType::New();
+      m_ReducedIntensityFilter[level-1][i]->SetInput(m_PyramidFilter[level-1]->GetOutput());
+      m_ReducedIntensityFilter[level-1][i]->SetShrinkFactor(1u << level);
+      m_ReducedIntensityFilter[level-1][i]->SetLookupTable(m_LookupTableFilter->GetLookupTable());
+      }
+    this->UpdatePyramidLevel(level, m_Wrapper->GetImage());
+    }
+
+  return m_ReducedIntensityFilter[level-1][dim]->GetOutput();
+}
+
 template<class TWrapperTraits>
 ColorMap *
 CachingCurveAndColorMapDisplayMappingPolicy<TWrapperTraits>
@@ -743,6 +799,17 @@ MultiChannelDisplayMappingPolicy<TWrapperTraits>
   return m_DisplaySliceSelector[slice]->GetOutput();
 }
 
+template <class TWrapperTraits>
+typename MultiChannelDisplayMappingPolicy<TWrapperTraits>::DisplaySlicePointer
+MultiChannelDisplayMappingPolicy<TWrapperTraits>
+::GetReducedDisplaySlice(unsigned int slice, unsigned int level)
+{
+  if(m_ScalarRepresentation && !m_DisplayMode.UseRGB && !m_DisplayMode.RenderAsGrid)
+    return m_ScalarRepresentation->GetReducedDisplaySlice(slice, level);
+
+  return this->GetDisplaySlice(slice);
+}
+
 template <class TWrapperTraits>
 IntensityCurveInterface *
 MultiChannelDisplayMappingPolicy<TWrapperTraits>
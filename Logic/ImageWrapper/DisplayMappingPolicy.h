@@ -14,7 +14,9 @@ class IntensityCurveVTK;
 class Registry;
 class ActorMapperPool;
 template <class TEnum> class RegistryEnumMap;
-template <class T, class U> class LookupTableIntensityMappingFilter;
+template <class T, class U, class V> class SliceIntensityMappingFilter;
+template <class T, class U> class BinAverageImageFilter;
+template <typename T, typename U, typename V> class AdaptiveSlicingPipeline;
 template <class T> class RGBALookupTableIntensityMappingFilter;
 template <class T, typename U> class InputSelectionImageFilter;
 
@@ -38,6 +40,14 @@ public:
 
   virtual DisplaySlicePointer GetDisplaySlice(unsigned int slice) = 0;
 
+  /**
+   * Get the display slice made from a reduced resolution copy of the image,
+   * shrunk by 2^level along each axis. Policies that do not support reduced
+   * slices return the full resolution slice.
+   */
+  virtual DisplaySlicePointer GetReducedDisplaySlice(unsigned int slice, unsigned int level)
+    { return this->GetDisplaySlice(slice); }
+
   virtual void Save(Registry &folder) = 0;
   virtual void Restore(Registry &folder) = 0;
 
@@ -235,6 +245,12 @@ public:
    */
   DisplaySlicePointer GetDisplaySlice(unsigned int dim) ITK_OVERRIDE;
 
+  /**
+   * Get the display slice made from a level of the image pyramid. The levels
+   * are computed the first time they are needed.
+   */
+  DisplaySlicePointer GetReducedDisplaySlice(unsigned int dim, unsigned int level) ITK_OVERRIDE;
+
   /**
     Get a pointer to the colormap
     */
@@ -272,8 +288,19 @@ protected:
   // Filter that generates the lookup table
   typedef IntensityToColorLookupTableImageFilter<ImageType, DefaultColorMapTraits> LookupTableFilterType;
 
-  // Filter that applies the lookup table to slices
-  typedef LookupTableIntensityMappingFilter<InputSliceType, DisplaySliceType> IntensityFilterType;
+  // The wrapper's slicer
+  typedef itk::Image<PixelType, 3> PreviewImageType;
+  typedef AdaptiveSlicingPipeline<ImageType, InputSliceType, PreviewImageType> SlicerType;
+
+  // Filter that slices the image and applies the lookup table in one pass
+  typedef SliceIntensityMappingFilter<SlicerType, DisplaySliceType, ImageType> IntensityFilterType;
+
+  // Levels of the image pyramid, and the filters that slice them
+  typedef BinAverageImageFilter<ImageType, PreviewImageType> PyramidFilterType;
+  typedef SliceIntensityMappingFilter<SlicerType, DisplaySliceType, PreviewImageType> ReducedIntensityFilterType;
+
+  // Point the filters of a pyramid level to the image
+  void UpdatePyramidLevel(unsigned int level, ImageType *image);
 
   // LUT generator
   SmartPtr<LookupTableFilterType> m_LookupTableFilter;
@@ -281,6 +308,11 @@ protected:
   // Filters for the three slice directions
   SmartPtr<IntensityFilterType> m_IntensityFilter[3];
 
+  // Pyramid levels shrunk by 2, 4 and 8, created on demand
+  enum { PYRAMID_LEVELS = 3 };
+  SmartPtr<PyramidFilterType> m_PyramidFilter[PYRAMID_LEVELS];
+  SmartPtr<ReducedIntensityFilterType> m_ReducedIntensityFilter[PYRAMID_LEVELS][3];
+
   /**
    * Implementation of the intensity curve funcitonality. The intensity map
    * transforms input intensity values into the range [0 1], which serves as
@@ -452,6 +484,9 @@ public:
 
   DisplaySlicePointer GetDisplaySlice(unsigned int slice) ITK_OVERRIDE;
 
+  /** Reduced slices are only available when a single component is shown */
+  DisplaySlicePointer GetReducedDisplaySlice(unsigned int slice, unsigned int level) ITK_OVERRIDE;
+
   Vector2d GetNativeImageRangeForCurve() ITK_OVERRIDE;
   virtual TDigest *GetTDigest() override;
 
@@ -0,0 +1,173 @@
+#include "DisplaySliceCache.h"
+
+#include <algorithm>
+
+DisplaySliceCache::DisplaySliceCache()
+{
+  m_Capacity = 8;
+  m_PrefetchDepth = 4;
+  m_Entries.resize(m_Capacity);
+  for(Entry &e : m_Entries)
+    e.valid = false;
+  m_Next = 0;
+  m_State.buffer = nullptr;
+  m_State.image_time = m_State.lut_time = 0;
+  m_Generation = 0;
+  m_Busy = false;
+  m_Stop = false;
+}
+
+DisplaySliceCache::~DisplaySliceCache()
+{
+  {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Stop = true;
+  m_Queue.clear();
+  }
+  m_Condition.notify_all();
+  if(m_Thread.joinable())
+    m_Thread.join();
+}
+
+void DisplaySliceCache::SetCapacity(unsigned int capacity)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  this->Clear(lock);
+  m_Capacity = capacity;
+  m_Entries.resize(capacity);
+  for(Entry &e : m_Entries)
+    e.valid = false;
+  m_Next = 0;
+}
+
+bool DisplaySliceCache::Lookup(const SourceState &state, const SliceKey &key, DisplayPixelType *out)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  // Slices of a different image or color map are of no use
+  if(!(state == m_State))
+    {
+    this->Clear(lock);
+    m_State = state;
+    return false;
+    }
+
+  // The slice may be on its way
+  m_Condition.wait(lock, [this, &key]() { return !m_Busy || !(m_BusyKey == key); });
+
+  Entry *e = this->Find(key);
+  if(!e)
+    return false;
+
+  std::copy(e->pixels.begin(), e->pixels.end(), out);
+  return true;
+}
+
+void DisplaySliceCache::Store(const SliceKey &key, const DisplayPixelType *data)
+{
+  std::vector<DisplayPixelType> pixels(data, data + (size_t) key.width * key.height);
+
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  this->Insert(key, pixels);
+}
+
+void DisplaySliceCache::Prefetch(const std::vector<PrefetchRequest> &requests)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  m_Queue.clear();
+  for(const PrefetchRequest &r : requests)
+    {
+    if(!this->Find(r.key) && !(m_Busy && m_BusyKey == r.key))
+      m_Queue.push_back(r);
+    }
+
+  if(m_Queue.empty())
+    return;
+
+  if(!m_Thread.joinable())
+    m_Thread = std::thread(&DisplaySliceCache::PrefetchThread, this);
+
+  lock.unlock();
+  m_Condition.notify_all();
+}
+
+void DisplaySliceCache::Invalidate()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  this->Clear(lock);
+  m_State.buffer = nullptr;
+  m_State.image_time = m_State.lut_time = 0;
+}
+
+DisplaySliceCache::Entry *DisplaySliceCache::Find(const SliceKey &key)
+{
+  for(Entry &e : m_Entries)
+    if(e.valid && e.key == key)
+      return &e;
+  return nullptr;
+}
+
+void DisplaySliceCache::Insert(const SliceKey &key, std::vector<DisplayPixelType> &pixels)
+{
+  if(m_Entries.empty())
+    return;
+
+  // Replace the slice if it is already there, otherwise the oldest slice
+  Entry *e = this->Find(key);
+  if(!e)
+    {
+    e = &m_Entries[m_Next];
+    m_Next = (m_Next + 1) % m_Entries.size();
+    }
+
+  e->valid = true;
+  e->key = key;
+  e->pixels.swap(pixels);
+}
+
+void DisplaySliceCache::Clear(std::unique_lock<std::mutex> &lock)
+{
+  // Drop the queue, and wait for the thread to let go of the slice it is
+  // computing, which is then discarded
+  m_Queue.clear();
+  m_Condition.wait(lock, [this]() { return !m_Busy; });
+  m_Generation++;
+
+  for(Entry &e : m_Entries)
+    {
+    e.valid = false;
+    std::vector<DisplayPixelType>().swap(e.pixels);
+    }
+  m_Next = 0;
+}
+
+void DisplaySliceCache::PrefetchThread()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while(true)
+    {
+    m_Condition.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+    if(m_Stop)
+      return;
+
+    PrefetchRequest request = m_Queue.front();
+    m_Queue.pop_front();
+    m_Busy = true;
+    m_BusyKey = request.key;
+    unsigned long generation = m_Generation;
+    lock.unlock();
+
+    std::vector<DisplayPixelType> pixels((size_t) request.key.width * request.key.height);
+    request.function(pixels.data());
+
+    // Let go of the image before the cache can be invalidated
+    request.function = nullptr;
+
+    lock.lock();
+    if(generation == m_Generation)
+      this->Insert(request.key, pixels);
+    m_Busy = false;
+    m_Condition.notify_all();
+    }
+}
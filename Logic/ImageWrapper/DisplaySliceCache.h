@@ -0,0 +1,145 @@
+#ifndef DISPLAYSLICECACHE_H
+#define DISPLAYSLICECACHE_H
+
+#include "SNAPCommon.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkIntTypes.h"
+#include "itkRGBAPixel.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \class DisplaySliceCache
+ * \brief Keeps recently shown and speculatively computed display slices of
+ * an image wrapper.
+ *
+ * The slices are kept in a ring buffer of fixed capacity, so that the
+ * oldest slice makes room for the newest. Each slice is identified by its
+ * position and layout in the image buffer (SliceKey). All slices in the
+ * cache are computed from the same state of the image and the color map
+ * (SourceState); when the state passed to Lookup() differs, the cache is
+ * emptied.
+ *
+ * When the user scrolls through the slices, the display filter asks the
+ * cache to compute the next few slices in the direction of travel on a
+ * background thread (Prefetch), so that they are ready by the time they
+ * are shown. The wrapper empties the cache when its image or time point
+ * changes, so that the background thread never reads a released buffer.
+ */
+class DisplaySliceCache : public itk::Object
+{
+public:
+  irisITKObjectMacro(DisplaySliceCache, itk::Object)
+
+  typedef itk::RGBAPixel<unsigned char> DisplayPixelType;
+
+  /** Position of the first voxel of a slice and its layout in the image buffer */
+  struct SliceKey
+  {
+    long long start, pixel_stride, line_stride;
+    unsigned int width, height;
+
+    bool operator == (const SliceKey &other) const
+      {
+      return start == other.start && pixel_stride == other.pixel_stride
+          && line_stride == other.line_stride
+          && width == other.width && height == other.height;
+      }
+  };
+
+  /** The image buffer and color map that the slices are computed from */
+  struct SourceState
+  {
+    const void *buffer;
+    itk::ModifiedTimeType image_time, lut_time;
+
+    bool operator == (const SourceState &other) const
+      {
+      return buffer == other.buffer && image_time == other.image_time
+          && lut_time == other.lut_time;
+      }
+  };
+
+  /** Function that computes a slice into an array of width x height pixels */
+  typedef std::function<void(DisplayPixelType *)> SliceFunction;
+
+  /** A slice to be computed in the background */
+  struct PrefetchRequest
+  {
+    SliceKey key;
+    SliceFunction function;
+  };
+
+  /** Number of slices kept in the cache (default 8) */
+  void SetCapacity(unsigned int capacity);
+  irisGetMacro(Capacity, unsigned int)
+
+  /** Number of slices computed ahead of the current one; zero disables (default 4) */
+  irisGetSetMacro(PrefetchDepth, unsigned int)
+
+  /**
+   * Copy the slice with the given key into out, if it is in the cache. If
+   * the slice is being computed in the background, this waits for it.
+   */
+  bool Lookup(const SourceState &state, const SliceKey &key, DisplayPixelType *out);
+
+  /** Add a slice computed from the state passed to the last Lookup() */
+  void Store(const SliceKey &key, const DisplayPixelType *data);
+
+  /**
+   * Replace the slices waiting to be computed in the background. Slices
+   * that are already in the cache are skipped.
+   */
+  void Prefetch(const std::vector<PrefetchRequest> &requests);
+
+  /** Empty the cache, waiting for the slice being computed, if any */
+  void Invalidate();
+
+protected:
+  DisplaySliceCache();
+  virtual ~DisplaySliceCache();
+
+  struct Entry
+  {
+    bool valid;
+    SliceKey key;
+    std::vector<DisplayPixelType> pixels;
+  };
+
+  // Find an entry, with the mutex held
+  Entry *Find(const SliceKey &key);
+
+  // Insert an entry, with the mutex held
+  void Insert(const SliceKey &key, std::vector<DisplayPixelType> &pixels);
+
+  // Remove the entries and the queue, with the mutex locked
+  void Clear(std::unique_lock<std::mutex> &lock);
+
+  void PrefetchThread();
+
+  unsigned int m_Capacity, m_PrefetchDepth;
+
+  // Ring buffer of slices and the position of the next insertion
+  std::vector<Entry> m_Entries;
+  unsigned int m_Next;
+
+  // State of the image and color map for the slices in the cache. Changes
+  // to the generation make slices computed earlier unusable.
+  SourceState m_State;
+  unsigned long m_Generation;
+
+  // Prefetching thread and its queue
+  std::thread m_Thread;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::deque<PrefetchRequest> m_Queue;
+  SliceKey m_BusyKey;
+  bool m_Busy, m_Stop;
+};
+
+#endif // DISPLAYSLICECACHE_H
@@ -74,11 +74,16 @@
 #include "MultiFrameDicomSeriesSorter.h"
 #include "itkStringTools.h"
 #include "AllPurposeProgressAccumulator.h"
+#include "MemoryMappedFile.h"
+#include "itkByteSwapper.h"
+#include "itksys/SystemTools.hxx"
 
 #include <itk_zlib.h>
 #include "itkImportImageFilter.h"
 #include <algorithm>
 #include "itksys/Base64.h"
+#include <cstring>
+#include <fstream>
 
 
 using namespace std;
@@ -452,6 +457,11 @@ GuidedNativeImageIO
         flag_read ? itk::ImageIOFactory::ReadMode : itk::ImageIOFactory::WriteMode);
       }
     }
+
+  // An image loaded from the file may still be mapped into memory, and its
+  // contents must be copied out before the file is overwritten
+  if(!flag_read)
+    MemoryMappedFile::ReleaseFile(fname);
 }
 
 void
@@ -714,6 +724,212 @@ GuidedNativeImageIO
   m_IOBase = NULL;
 }
 
+namespace
+{
+// Locate the voxel data of a single-file NIfTI-1 or NIfTI-2 image. Only
+// succeeds for data that is stored without scaling, in the byte order of
+// this machine, and not as a vector (which ITK reorders when reading).
+bool locate_nifti_data(const std::string &fn,
+                       unsigned long long &offset, unsigned long long &nbytes)
+{
+  char hdr[540];
+  std::ifstream ifs(fn.c_str(), std::ios::binary);
+  if(!ifs.read(hdr, 348))
+    return false;
+
+  // The header size is also how the byte order is detected. Compressed
+  // files do not match either value.
+  int32_t sizeof_hdr;
+  memcpy(&sizeof_hdr, hdr, 4);
+
+  long long dim[8];
+  int bitpix;
+  double vox_offset, slope, inter;
+  if(sizeof_hdr == 348)
+    {
+    if(memcmp(hdr + 344, "n+1", 4))
+      return false;
+
+    int16_t dim16[8], bitpix16;
+    float f[3];
+    memcpy(dim16, hdr + 40, sizeof(dim16));
+    memcpy(&bitpix16, hdr + 72, sizeof(bitpix16));
+    memcpy(f, hdr + 108, sizeof(f));
+    std::copy(dim16, dim16 + 8, dim);
+    bitpix = bitpix16;
+    vox_offset = f[0]; slope = f[1]; inter = f[2];
+    }
+  else if(sizeof_hdr == 540)
+    {
+    if(!ifs.read(hdr + 348, 540 - 348) || memcmp(hdr + 4, "n+2\0\r\n\032\n", 8))
+      return false;
+
+    int16_t bitpix16;
+    int64_t dim64[8], vox_offset64;
+    memcpy(&bitpix16, hdr + 14, sizeof(bitpix16));
+    memcpy(dim64, hdr + 16, sizeof(dim64));
+    memcpy(&vox_offset64, hdr + 168, sizeof(vox_offset64));
+    memcpy(&slope, hdr + 176, sizeof(slope));
+    memcpy(&inter, hdr + 184, sizeof(inter));
+    std::copy(dim64, dim64 + 8, dim);
+    bitpix = bitpix16;
+    vox_offset = (double) vox_offset64;
+    }
+  else
+    return false;
+
+  // ITK rescales the data to float if there is a slope or an intercept
+  if(!(slope == 0.0 || slope == 1.0) || inter != 0.0)
+    return false;
+
+  if(dim[0] < 1 || dim[0] > 7 || (dim[0] >= 5 && dim[5] > 1) || bitpix <= 0 || bitpix % 8)
+    return false;
+
+  if(vox_offset < 0 || vox_offset != std::floor(vox_offset))
+    return false;
+
+  unsigned long long nvox = 1;
+  for(int i = 1; i <= dim[0]; i++)
+    {
+    if(dim[i] < 1)
+      return false;
+    nvox *= dim[i];
+    }
+
+  offset = (unsigned long long) vox_offset;
+  nbytes = nvox * (bitpix / 8);
+  return true;
+}
+
+// Locate the voxel data of a MetaImage, which is either in the same file
+// after the header (LOCAL) or in a single separate file
+bool locate_meta_data(const std::string &fn, unsigned long long nbytes,
+                      std::string &datafile, unsigned long long &offset)
+{
+  std::ifstream ifs(fn.c_str(), std::ios::binary);
+  std::string line;
+  long long header_size = 0;
+  bool local = false;
+  unsigned long long local_offset = 0;
+  while(std::getline(ifs, line))
+    {
+    size_t eq = line.find('=');
+    if(eq == std::string::npos)
+      continue;
+
+    std::string key = itksys::SystemTools::TrimWhitespace(line.substr(0, eq));
+    std::string value = itksys::SystemTools::TrimWhitespace(line.substr(eq + 1));
+    if(key == "CompressedData")
+      {
+      if(itksys::SystemTools::LowerCase(value) == "true")
+        return false;
+      }
+    else if(key == "HeaderSize")
+      {
+      header_size = atoll(value.c_str());
+      }
+    else if(key == "ElementDataFile")
+      {
+      // The last field of the header
+      if(itksys::SystemTools::LowerCase(value) == "local")
+        {
+        local = true;
+        local_offset = (unsigned long long) ifs.tellg();
+        datafile = fn;
+        }
+      else if(value == "LIST" || value.find('%') != std::string::npos)
+        {
+        // Data split over multiple files
+        return false;
+        }
+      else if(itksys::SystemTools::FileIsFullPath(value))
+        {
+        datafile = value;
+        }
+      else
+        {
+        datafile = itksys::SystemTools::GetFilenamePath(fn);
+        datafile = datafile.size() ? datafile + "/" + value : value;
+        }
+      break;
+      }
+    }
+
+  if(datafile.empty())
+    return false;
+
+  // Same rules as MetaIO for where the data starts
+  if(header_size > 0)
+    offset = (unsigned long long) header_size;
+  else if(header_size == -1)
+    {
+    itksys::SystemTools::Stat_t st;
+    if(itksys::SystemTools::Stat(datafile, &st) != 0 || (unsigned long long) st.st_size < nbytes)
+      return false;
+    offset = (unsigned long long) st.st_size - nbytes;
+    }
+  else
+    offset = local ? local_offset : 0;
+
+  return true;
+}
+}
+
+bool
+GuidedNativeImageIO
+::GetMappableDataLocation(size_t nbytes, size_t align,
+                          std::string &datafile, unsigned long long &offset)
+{
+  // Small images are read quickly, and mapping them would needlessly keep
+  // their files locked on some systems
+  if(nbytes < MIN_MAPPED_DATA_SIZE)
+    return false;
+
+  // Data in the other byte order must be swapped when read
+  if(align > 1)
+    {
+    bool big = itk::ByteSwapper<int>::SystemIsBigEndian();
+    if((m_NativeByteOrder == itk::IOByteOrderEnum::BigEndian && !big)
+       || (m_NativeByteOrder == itk::IOByteOrderEnum::LittleEndian && big))
+      return false;
+    }
+
+  switch(m_FileFormat)
+    {
+    case FORMAT_NIFTI:
+      {
+      unsigned long long disk_bytes;
+      if(!locate_nifti_data(m_NativeFileName, offset, disk_bytes) || disk_bytes != nbytes)
+        return false;
+      datafile = m_NativeFileName;
+      }
+      break;
+    case FORMAT_MHA:
+      if(!locate_meta_data(m_NativeFileName, nbytes, datafile, offset))
+        return false;
+      break;
+    case FORMAT_RAW:
+      {
+      int header_size = m_Hints["Raw.HeaderSize"][0];
+      if(header_size < 0)
+        return false;
+      datafile = m_NativeFileName;
+      offset = header_size;
+      }
+      break;
+    default:
+      return false;
+    }
+
+  // The voxels in the mapping must be aligned, and the file must hold them all
+  if(offset % align)
+    return false;
+
+  itksys::SystemTools::Stat_t st;
+  return itksys::SystemTools::Stat(datafile, &st) == 0
+      && (unsigned long long) st.st_size >= offset + nbytes;
+}
+
 void
 GuidedNativeImageIO
 ::ReadNativeImage(const char *FileName, Registry &folder, itk::Command *progressCmd)
@@ -972,6 +1188,37 @@ GuidedNativeImageIO
 }
 
 
+template<class TScalar>
+bool
+GuidedNativeImageIO
+::MapNativeImageData(itk::VectorImage<TScalar, 4> *image)
+{
+  // These cases rearrange the voxels after reading
+  if(m_NDimBeforeFolding > 4 || m_FileFormat == FORMAT_NRRD_SEQ
+     || m_Load4DAsMultiComponent || m_LoadMultiComponentAs4D)
+    return false;
+
+  // Data that is cast after reading would be copied out of the mapping
+  if(!m_MappableComponentTypes.count(m_NativeType))
+    return false;
+
+  size_t n = image->GetBufferedRegion().GetNumberOfPixels()
+             * image->GetNumberOfComponentsPerPixel();
+
+  std::string datafile;
+  unsigned long long offset;
+  if(!this->GetMappableDataLocation(n * sizeof(TScalar), sizeof(TScalar), datafile, offset))
+    return false;
+
+  typedef MappedImageContainer<TScalar> ContainerType;
+  SmartPtr<ContainerType> pc = ContainerType::New();
+  if(!pc->Map(datafile, offset, n, m_NativeFileName))
+    return false;
+
+  image->SetPixelContainer(pc);
+  return true;
+}
+
 template<class TScalar>
 void
 GuidedNativeImageIO
@@ -1379,12 +1626,18 @@ GuidedNativeImageIO
     typename NativeImageType::Pointer image = NativeImageType::New();
 
     UpdateImageHeader<NativeImageType>(image);
-    image->Allocate();
+
+    // Uncompressed data can be mapped into memory instead of being read, so
+    // that it is only loaded from disk as it is accessed
+    bool mapped = this->MapNativeImageData<TScalar>(image);
+    if(!mapped)
+      image->Allocate();
 
     regularImageReadingProgSrc->AddProgress(0.1);
 
     // Read the image into the buffer
-		m_IOBase->Read(image->GetBufferPointer());
+    if(!mapped)
+      m_IOBase->Read(image->GetBufferPointer());
 
     // For seq.nrrd, convert the component dimension to the sequence dimension
     if (m_FileFormat == FORMAT_NRRD_SEQ && m_NCompBeforeFolding > 1 &&
@@ -1907,6 +2160,10 @@ CastNativeImage<TOutputImage,TCastFunctor>
   // Bytes needed to store the data in target format
   size_t nbTarget = input->GetPixelContainer()->Size() * szTarget;
 
+  // Memory that the input does not own (i.e., a file mapped into memory)
+  // cannot be resized, so the output gets a buffer of its own
+  bool inPlace = ipc->GetContainerManageMemory();
+
   // This memory is no longer owned by the input
   ipc->SetContainerManageMemory(false);
 
@@ -1914,7 +2171,7 @@ CastNativeImage<TOutputImage,TCastFunctor>
   TNative *ib = ipc->GetImportPointer();
 
   // If target is larger than native, expand the pixel container
-  if(nbNative < nbTarget)
+  if(inPlace && nbNative < nbTarget)
     {
     // We should probably avoid this possibility by forcing at least a short
     // type when loading char data. But if this does happen, all we need to
@@ -1922,8 +2179,10 @@ CastNativeImage<TOutputImage,TCastFunctor>
     ib = reinterpret_cast<TNative *>(realloc(ib, nbTarget));
     }
 
-  // Get a pointer to the output buffer (same as input buffer)
-  OutputComponentType *ob = reinterpret_cast<OutputComponentType *>(ib);
+  // Get a pointer to the output buffer (same as input buffer when in place)
+  OutputComponentType *ob = inPlace
+      ? reinterpret_cast<OutputComponentType *>(ib)
+      : reinterpret_cast<OutputComponentType *>(malloc(nbTarget));
 
   // Finally, we get to the code where we map from input format to the output
   // format. Here again we have to be careful. If the native image is larger or
@@ -1948,7 +2207,7 @@ CastNativeImage<TOutputImage,TCastFunctor>
     }
 
   // If needed, squeeze the memory
-  if(nbTarget < nbNative)
+  if(inPlace && nbTarget < nbNative)
     ob = reinterpret_cast<OutputComponentType *>(realloc(ob, nbTarget));
 
   // Create a new container wrapped around the same chunk of memory as the
@@ -2067,6 +2326,37 @@ const gdcm::Tag GuidedNativeImageIO::m_tagSliceThickness(0x0018, 0x0050);
 
 #include "gdcmDirectory.h"
 #include "gdcmImageReader.h"
+#include "itkMultiThreaderBase.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Read the given tags from a DICOM file into an index record
+static void ReadDicomFileRecord(const std::string &fn,
+                                const std::vector<gdcm::Tag> &tags,
+                                DicomDirectoryIndex::FileRecord &rec)
+{
+  std::set<gdcm::Tag> tag_set(tags.begin(), tags.end());
+
+  gdcm::Reader reader;
+  reader.SetFileName(fn.c_str());
+
+  // Try reading this file. Fail quietly.
+  bool read = false;
+  try { read = reader.ReadSelectedTags(tag_set, true); }
+  catch(...) {}
+
+  rec.IsDicom = read;
+  rec.Tags.clear();
+  if(read)
+    {
+    // Create a string filter to get tags
+    gdcm::StringFilter sf;
+    sf.SetFile(reader.GetFile());
+    for(const gdcm::Tag &tag : tags)
+      rec.Tags.push_back(sf.ToString(tag));
+    }
+}
 
 void
 GuidedNativeImageIO
@@ -2090,15 +2380,12 @@ GuidedNativeImageIO
   tags_refine.push_back(m_tagRows);
   tags_refine.push_back(m_tagCols);
 
-  // List of tags that we want to parse - everything else may be ignored
-  std::set<gdcm::Tag> tags_all;
-  tags_all.insert(tags_refine.begin(), tags_refine.end());
-  tags_all.insert(m_tagDesc);
-  tags_all.insert(m_tagSeriesInstanceUID);
-
-  //--Dev: Add to read list
-  std::set<std::string> sliceLocSet;
-  std::map<std::string, std::set<std::string>> sliceMap;
+  // List of tags that we want to parse - everything else may be ignored. The
+  // values are kept in this order in the DICOM directory index.
+  std::vector<gdcm::Tag> tags_all;
+  tags_all.push_back(m_tagSeriesInstanceUID);
+  tags_all.push_back(m_tagDesc);
+  tags_all.insert(tags_all.end(), tags_refine.begin(), tags_refine.end());
 
   // Clear the information about the last parse
   m_LastDicomParseResult.Reset();
@@ -2110,96 +2397,184 @@ GuidedNativeImageIO
   // Load the directory - this should be quick
   dirList.Load(dir, false);
   gdcm::Directory::FilenamesType const &filenames = dirList.GetFilenames();
-  for(gdcm::Directory::FilenamesType::const_iterator it = filenames.begin();
-    it != filenames.end(); ++it)
+  size_t n_files = filenames.size();
+
+  // Records of the files that have already been indexed
+  typedef DicomDirectoryIndex::FileRecord FileRecord;
+  DicomDirectoryIndex::FileRecordMap known;
+  if(m_DicomDirectoryIndex)
+    known = m_DicomDirectoryIndex->GetDirectory(dir);
+
+  // The records of the files in the directory, filled by the workers. The
+  // workers take the files in order, and the main thread adds the files to
+  // the parse result in the same order as they are completed.
+  std::vector<FileRecord> records(n_files);
+  std::vector<bool> done(n_files, false);
+  size_t next_file = 0;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  auto worker = [&]()
     {
-    // Process each filename in the directory
-    gdcm::Reader reader;
-    reader.SetFileName(it->c_str());
+    while(true)
+      {
+      size_t i;
+        {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(next_file >= n_files)
+          return;
+        i = next_file++;
+        }
 
-    // Try reading this file. Fail quietly.
-    bool read = false;
-    try { read = reader.ReadSelectedTags(tags_all, true); }
-    catch(...) {}
+      // Reuse the indexed record if the file has not changed
+      FileRecord rec;
+      const std::string &fn = filenames[i];
+      rec.ModifiedTime = itksys::SystemTools::ModifiedTime(fn);
+      rec.Size = itksys::SystemTools::FileLength(fn);
+      auto it = known.find(fn);
+      if(it != known.end()
+         && it->second.ModifiedTime == rec.ModifiedTime
+         && it->second.Size == rec.Size
+         && (!it->second.IsDicom || it->second.Tags.size() == tags_all.size()))
+        {
+        rec = it->second;
+        }
+      else
+        {
+        ReadDicomFileRecord(fn, tags_all, rec);
+        }
 
-    // If nothing read, keep going
-    if(!read)
-      continue;
+      std::lock_guard<std::mutex> lock(mutex);
+      records[i] = std::move(rec);
+      done[i] = true;
+      cv.notify_one();
+      }
+    };
+
+  // Reading is dominated by I/O latency, particularly on network storage, so
+  // use at least a few workers even on machines with few cores
+  size_t n_workers = std::max(4u, itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
+  n_workers = std::min(n_workers, n_files);
+  std::vector<std::thread> workers;
+  for(size_t k = 0; k < n_workers; k++)
+    workers.push_back(std::thread(worker));
+
+  // Stop handing out files and wait for the workers to finish
+  auto join_workers = [&]()
+    {
+      {
+      std::lock_guard<std::mutex> lock(mutex);
+      next_file = n_files;
+      }
+    for(auto &t : workers)
+      t.join();
+    };
 
-    // Create a string filter to get tags
-    gdcm::StringFilter sf;
-    sf.SetFile(reader.GetFile());
+  try
+    {
+    for(size_t i = 0; i < n_files; i++)
+      {
+      // Wait for the next file in order
+      FileRecord rec;
+        {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return done[i]; });
+        rec = records[i];
+        }
 
-    // Start with the ID being the UID
-    std::string uid = sf.ToString(m_tagSeriesInstanceUID);
-    std::string full_id = uid;
+      // If nothing read, keep going
+      if(!rec.IsDicom)
+        continue;
 
-    // Iterate over the tags in the refine list
-		for(size_t iTag = 0u; iTag < tags_refine.size(); iTag++)
-      {
-      // Read the tag value
-      std::string s = sf.ToString(tags_refine[iTag]);
+      // Start with the ID being the UID
+      std::string uid = rec.Tags[0];
+      std::string full_id = uid;
 
-      // This code is from gdcmSerieHelper
-      if( full_id == uid && !s.empty() )
+      // Iterate over the tags in the refine list
+      for(size_t iTag = 0u; iTag < tags_refine.size(); iTag++)
         {
-        full_id += "."; // add separator
+        // Read the tag value
+        const std::string &s = rec.Tags[2 + iTag];
+
+        // This code is from gdcmSerieHelper
+        if( full_id == uid && !s.empty() )
+          {
+          full_id += "."; // add separator
+          }
+        full_id += s;
         }
-      full_id += s;
-      }
 
-    // Eliminate non-alnum characters, including whitespace...
-    //   that may have been introduced by concats.
-    for(size_t i=0; i<full_id.size(); i++)
-      {
-      while(i<full_id.size()
-        && !( full_id[i] == '.'
-          || (full_id[i] >= 'a' && full_id[i] <= 'z')
-          || (full_id[i] >= '0' && full_id[i] <= '9')
-          || (full_id[i] >= 'A' && full_id[i] <= 'Z')))
+      // Eliminate non-alnum characters, including whitespace...
+      //   that may have been introduced by concats.
+      for(size_t j=0; j<full_id.size(); j++)
         {
-        full_id.erase(i, 1);
+        while(j<full_id.size()
+          && !( full_id[j] == '.'
+            || (full_id[j] >= 'a' && full_id[j] <= 'z')
+            || (full_id[j] >= '0' && full_id[j] <= '9')
+            || (full_id[j] >= 'A' && full_id[j] <= 'Z')))
+          {
+          full_id.erase(j, 1);
+          }
         }
-      }
 
-    // The info for the current series
-    DicomDirectoryParseResult::DicomSeriesInfo &series_info
-        = m_LastDicomParseResult.SeriesMap[full_id];
+      // The info for the current series
+      DicomDirectoryParseResult::DicomSeriesInfo &series_info
+          = m_LastDicomParseResult.SeriesMap[full_id];
 
-    // The registry for the current series
-    Registry &r = series_info.MetaData;
+      // The registry for the current series
+      Registry &r = series_info.MetaData;
 
-    // Have we found this ID before?
-    if(r.IsEmpty())
-      {
-      r["SeriesId"] << full_id;
+      // Have we found this ID before?
+      if(r.IsEmpty())
+        {
+        r["SeriesId"] << full_id;
 
-      // Read series description
-      r["SeriesDescription"] << sf.ToString(m_tagDesc);
-      r["SeriesNumber"] << sf.ToString(m_tagSeriesNumber);
+        // Read series description
+        r["SeriesDescription"] << rec.Tags[1];
+        r["SeriesNumber"] << rec.Tags[2];
 
-      // Read the dimensions
-      r["Rows"] << std::atoi(sf.ToString(m_tagRows).c_str());
-      r["Columns"] << std::atoi(sf.ToString(m_tagCols).c_str());
-      r["NumberOfImages"] << 1;
-      }
-    else
-      {
-      // Increement the number of images
-      r["NumberOfImages"] << r["NumberOfImages"][0] + 1;
-      }
+        // Read the dimensions
+        r["Rows"] << std::atoi(rec.Tags[5].c_str());
+        r["Columns"] << std::atoi(rec.Tags[6].c_str());
+        r["NumberOfImages"] << 1;
+        }
+      else
+        {
+        // Increement the number of images
+        r["NumberOfImages"] << r["NumberOfImages"][0] + 1;
+        }
 
-    // Update the dimensions string
-    ostringstream oss;
-    oss << r["Rows"][0] << " x " << r["Columns"][0] << " x " << r["NumberOfImages"][0];
-    r["Dimensions"] << oss.str();
+      // Update the dimensions string
+      ostringstream oss;
+      oss << r["Rows"][0] << " x " << r["Columns"][0] << " x " << r["NumberOfImages"][0];
+      r["Dimensions"] << oss.str();
 
-    // Update the filelist
-    series_info.FileList.push_back(*it);
+      // Update the filelist
+      series_info.FileList.push_back(filenames[i]);
 
-    // Indicate some progress
-    if(progressCommand)
-      progressCommand->Execute(this, itk::ProgressEvent());
+      // Indicate some progress
+      if(progressCommand)
+        progressCommand->Execute(this, itk::ProgressEvent());
+      }
+    }
+  catch(...)
+    {
+    // The progress command may throw to abort the parsing
+    join_workers();
+    throw;
+    }
+
+  join_workers();
+
+  // Remember the records of this directory for the next time it is parsed
+  if(m_DicomDirectoryIndex)
+    {
+    DicomDirectoryIndex::FileRecordMap indexed;
+    for(size_t i = 0; i < n_files; i++)
+      indexed[filenames[i]] = records[i];
+    m_DicomDirectoryIndex->UpdateDirectory(dir, indexed);
+    m_DicomDirectoryIndex->Save();
     }
 
   // Complain if no series have been found
@@ -2209,6 +2584,20 @@ GuidedNativeImageIO
         "Directory '%s' does not appear to contain a DICOM series.", dir.c_str());
 }
 
+void
+GuidedNativeImageIO
+::SetDicomDirectoryIndex(DicomDirectoryIndex *index)
+{
+  m_DicomDirectoryIndex = index;
+}
+
+DicomDirectoryIndex *
+GuidedNativeImageIO
+::GetDicomDirectoryIndex() const
+{
+  return m_DicomDirectoryIndex;
+}
+
 void GuidedNativeImageIO::DicomDirectoryParseResult::Reset()
 {
   Directory.clear();
@@ -44,6 +44,8 @@
 #include "itkEventObject.h"
 #include "gdcmTag.h"
 #include "MultiFrameDicomSeriesSorter.h"
+#include "DicomDirectoryIndex.h"
+#include <set>
 
 
 namespace itk
@@ -270,10 +272,20 @@ public:
    *   - SeriesFiles (an array with filenames)
    *
    * To obtain the result of the parsing call GetLastDicomParseRegistry()
+   *
+   * The tags are read by a pool of threads, and the files are added to the
+   * result in the order in which they are listed, so the result does not
+   * depend on the number of threads. The progress command is called from
+   * the calling thread. If a DICOM directory index is set, only the files
+   * that are new or have changed since they were last indexed are read.
    */
   void ParseDicomDirectory(
       const std::string &dir, itk::Command *progressCommand = NULL);
 
+  /** Set the persistent index used by ParseDicomDirectory (optional) */
+  void SetDicomDirectoryIndex(DicomDirectoryIndex *index);
+  DicomDirectoryIndex *GetDicomDirectoryIndex() const;
+
   /**
    * Get the result of the last parse operation. This should be safe to
    * call from the callback of progressCommand in ParseDicomDirectory(),
@@ -299,6 +311,15 @@ public:
     m_LoadMultiComponentAs4D = !value;
   }
 
+  /**
+   * Component types for which the voxel data may be mapped into memory
+   * instead of being read (see MapNativeImageData). These should be the
+   * types that the caller keeps as they are, since a cast copies the data
+   * into a new buffer anyway. By default, no data is mapped.
+   */
+  void SetMappableComponentTypes(const std::set<itk::IOComponentEnum> &types)
+    { m_MappableComponentTypes = types; }
+
   /**
    * If header already exists, return it. Otherwise read the header and return it.
    * This is needed because sometimes an io object is passed to a method, and it may not be
@@ -320,6 +341,27 @@ protected:
   /** Templated function that reads a scalar image in its native datatype */
 	template <typename TScalar> void DoReadNative(const char *fname, Registry &folder, itk::Command *ProgressCmd = nullptr);
 
+  /**
+   * Map the voxel data of an uncompressed NIfTI, MetaImage or raw file into
+   * the image instead of reading it, so that the pages are only loaded from
+   * disk as they are accessed. This is only done when the data on disk is
+   * in the layout and byte order of the native image, and its component
+   * type is one of the mappable types (i.e., it will not be cast). Returns
+   * false if the data must be read instead.
+   *
+   * The mapping is made from the file itself, so the application crashes
+   * (SIGBUS) if another program truncates the file while it is loaded. See
+   * MemoryMappedFile.
+   */
+  template <typename TScalar> bool MapNativeImageData(itk::VectorImage<TScalar, 4> *image);
+
+  /** Find the file and the offset of the voxel data, if they can be mapped */
+  bool GetMappableDataLocation(size_t nbytes, size_t align,
+                               std::string &datafile, unsigned long long &offset);
+
+  /** Images with less voxel data than this are always read */
+  static constexpr size_t MIN_MAPPED_DATA_SIZE = 16 * 1024 * 1024;
+
   /** Templated function that reads a scalar image in its native datatype */
   template <typename TScalar> void DoSaveNative(const char *fname, Registry &folder);
 
@@ -400,6 +442,9 @@ protected:
   // DICOM directory last processed by ParseDicomSeries
   DicomDirectoryParseResult m_LastDicomParseResult;
 
+  // Index of the tags of previously parsed DICOM files
+  SmartPtr<DicomDirectoryIndex> m_DicomDirectoryIndex;
+
   // This information is copied from IOBase in order to delete IOBase at the 
   // earliest possible point, so as to conserve memory
   itk::IOComponentEnum m_NativeType;
@@ -457,6 +502,9 @@ protected:
   bool m_LoadMultiComponentAs4D = false;
   bool m_Load4DAsMultiComponent = false;
 
+  /** Component types whose data may be mapped into memory */
+  std::set<itk::IOComponentEnum> m_MappableComponentTypes;
+
 };
 
 
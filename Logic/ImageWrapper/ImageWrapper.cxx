@@ -70,10 +70,14 @@
 #include "itkCastImageFilter.h"
 #include "RLEImageRegionConstIterator.h"
 #include "TDigestImageFilter.h"
+#include "TimePointPager.h"
+#include "DisplaySliceCache.h"
+#include "MemoryMappedFile.h"
 #include "AllPurposeProgressAccumulator.h"
 
 #include <vnl/vnl_inverse.h>
 #include <iostream>
+#include <algorithm>
 #include <cassert>
 
 #include <itksys/SystemTools.hxx>
@@ -239,6 +243,13 @@ public:
                         image_4d->GetNameOfClass());
   }
 
+  static void GetContiguousBuffer(Image4DType *itkNotUsed(image_4d), void *&buffer, size_t &nbytes)
+  {
+    // Not every image keeps its voxels in a single array
+    buffer = nullptr;
+    nbytes = 0;
+  }
+
   static PatchOffsetTable GetPatchOffsetTable(TImage *image, const itk::Size<3> &)
   {
     throw IRISException("GetPatchOffsetTable unsupported for class %s", image->GetNameOfClass());
@@ -414,6 +425,13 @@ public:
     image_4d->SetPixelContainer(container);
   }
 
+  static void GetContiguousBuffer(Image4DType *image_4d, void *&buffer, size_t &nbytes)
+  {
+    typedef typename Image4DType::PixelContainer::Element ElementType;
+    buffer = image_4d->GetBufferPointer();
+    nbytes = image_4d->GetPixelContainer()->Size() * sizeof(ElementType);
+  }
+
   static PatchOffsetTable GetPatchOffsetTable(TImage *image, const itk::Size<3> &radius)
   {
     // Create an iterator over the output image
@@ -950,6 +968,9 @@ ImageWrapper<TTraits>
   for(unsigned int i = 0; i < 3; i++)
     m_Slicers[i] = SlicerType::New();
 
+  // Create the display slice cache, which the display mapping may use
+  m_DisplaySliceCache = DisplaySliceCache::New();
+
   // Initialize the display mapping
   m_DisplayMapping = DisplayMapping::New();
   m_DisplayMapping->Initialize(static_cast<typename DisplayMapping::WrapperType *>(this));
@@ -965,6 +986,21 @@ ImageWrapper<TTraits>
   // Initialize the t-digest filter
   m_TDigestFilter = TDigestFilterType::New();
 
+  // The statistics are computed in a pass over all time points, after which
+  // the time points that are not in use can be released
+  typedef itk::SimpleMemberCommand<Self> CommandType;
+  SmartPtr<CommandType> cmdStats = CommandType::New();
+  cmdStats->SetCallbackFunction(this, &Self::OnStatisticsUpdated);
+  m_TDigestFilter->AddObserver(itk::EndEvent(), cmdStats);
+
+  // The thumbnail is made again after the display mapping changes
+  SmartPtr<CommandType> cmdDisplay = CommandType::New();
+  cmdDisplay->SetCallbackFunction(this, &Self::OnDisplayMappingChange);
+  this->AddObserver(WrapperDisplayMappingChangeEvent(), cmdDisplay);
+
+  // Create the pager, which is only used for images mapped from a file
+  m_TimePointPager = TimePointPager::New();
+
   // Update the image geometry to default value
   this->UpdateImageGeometry();
 }
@@ -1074,6 +1110,15 @@ ImageWrapper<TTraits>
   return m_Image;
 }
 
+template<class TTraits>
+typename ImageWrapper<TTraits>::ImageBaseType *
+ImageWrapper<TTraits>
+::GetImageBaseByTimePoint(unsigned int tp) const
+{
+  tp = std::min(tp, (unsigned int) m_ImageTimePoints.size() - 1);
+  return m_ImageTimePoints[tp];
+}
+
 template<class TTraits>
 const typename ImageWrapper<TTraits>::ImageType *
 ImageWrapper<TTraits>
@@ -1377,6 +1422,11 @@ ImageWrapper<TTraits>
     ImageBaseType *referenceSpace,
     ITKTransformType *transform)
 {
+  // Stop paging the buffer of the previous image, and forget its slices
+  m_TimePointPager->SetBuffer(nullptr, 0, 0);
+  m_DisplaySliceCache->Invalidate();
+  m_Thumbnail = nullptr;
+
   // Assign the pointer to the 4D image
   m_Image4D = image_4d;
 
@@ -1427,17 +1477,10 @@ ImageWrapper<TTraits>
   // operations with MinMaxCalc
   m_Image4D->Modified();
 
-  // Set the image as the input to the TDigest
+  // Set the image as the input to the TDigest. It computes the min/max, the
+  // histogram and the quantiles of the image in a single pass over all voxels.
   m_TDigestFilter->SetInput(m_Image4D);
 
-  // Set the sampling rate in the TDigest. For large images it is too computationally
-  // expensive to digest the whole image, so instead we can digest a subset of the pixels.
-  // The values here restrict sampling to a value between 500000 and 1000000.
-  auto n_values = m_Image4D->GetBufferedRegion().GetNumberOfPixels() * m_Image4D->GetNumberOfComponentsPerPixel();
-  double x_oversampling = n_values * 1.0e-6;
-  int digest_sampling_rate_log2 = x_oversampling > 1.0 ? (int) std::log2(x_oversampling * 2.0) : 0;
-  m_TDigestFilter->SetLog2SamplingRate(digest_sampling_rate_log2);
-
   // Update the image in the display mapping
   m_DisplayMapping->UpdateImagePointer(m_Image);
 
@@ -1448,6 +1491,9 @@ ImageWrapper<TTraits>
   // Update the reference space and transform
   this->SetITKTransform(referenceSpace, transform);
 
+  // Page the time points if the image is mapped from its file
+  this->UpdateTimePointPager();
+
   // Store the time when the image was assigned
   m_ImageAssignTime = m_ImageSaveTime = m_Image4D->GetTimeStamp();
 
@@ -1669,6 +1715,10 @@ void
 ImageWrapper<TTraits>
 ::Reset()
 {
+  m_TimePointPager->SetBuffer(nullptr, 0, 0);
+  m_DisplaySliceCache->Invalidate();
+  m_Thumbnail = nullptr;
+
   if (m_Initialized)
     {
     for(ImagePointer img : m_ImageTimePoints)
@@ -1914,12 +1964,66 @@ ImageWrapper<TTraits>
     {
     m_TimePointIndex = index;
 
+    // The cached slices are of the previous time point
+    m_DisplaySliceCache->Invalidate();
+    m_Thumbnail = nullptr;
+
     // Update the image selector
     m_TimePointSelectFilter->SetSelectedInput(index);
     m_TimePointSelectFilter->Update();
+
+    // Keep the new time point and its neighbours in memory
+    m_TimePointPager->SetCurrentTimePoint(index);
+    }
+}
+
+template<class TTraits>
+void
+ImageWrapper<TTraits>
+::UpdateTimePointPager()
+{
+  typedef ImageWrapperPartialSpecializationTraits<ImageType, Image4DType> Specialization;
+  void *buffer = nullptr;
+  size_t nbytes = 0;
+  unsigned int nt = m_ImageTimePoints.size();
+  if(m_Image4D)
+    Specialization::GetContiguousBuffer(m_Image4D, buffer, nbytes);
+
+  // Images that were read into memory stay there; paging them would only
+  // move them to the swap file
+  if(nt > 1 && buffer && MemoryMappedFile::IsMapped(buffer))
+    {
+    m_TimePointPager->SetBuffer(buffer, nbytes / nt, nt);
+    m_TimePointPager->SetCurrentTimePoint(m_TimePointIndex);
+
+    // The quantiles and histogram of paged images are estimated from a
+    // sample of the time points. The other time points are only scanned
+    // for the intensity range, which must be exact for the display LUT.
+    m_TDigestFilter->SetMaximumNumberOfTimePoints(PAGED_STATISTICS_TIME_POINTS);
+    }
+  else
+    {
+    m_TimePointPager->SetBuffer(nullptr, 0, 0);
+    m_TDigestFilter->SetMaximumNumberOfTimePoints(0);
     }
 }
 
+template<class TTraits>
+void
+ImageWrapper<TTraits>
+::OnStatisticsUpdated()
+{
+  m_TimePointPager->ReleaseInactiveTimePoints();
+}
+
+template<class TTraits>
+void
+ImageWrapper<TTraits>
+::OnDisplayMappingChange()
+{
+  m_Thumbnail = nullptr;
+}
+
 template<class TTraits>
 const typename ImageWrapper<TTraits>::ImagePointer
 ImageWrapper<TTraits>::GetImageByTimePoint(unsigned int timepoint) const
@@ -1947,6 +2051,13 @@ ImageWrapper<TTraits>::GetTDigest()
   return m_TDigestFilter->GetTDigest();
 }
 
+template<class TTraits>
+void
+ImageWrapper<TTraits>::SetTDigestLog2SamplingRate(int k)
+{
+  m_TDigestFilter->SetLog2SamplingRate(k);
+}
+
 template<class TTraits>
 const typename ImageWrapper<TTraits>::MinMaxObjectType *
 ImageWrapper<TTraits>::GetImageMinObject()
@@ -2051,6 +2162,10 @@ ImageWrapper<TTraits>
   // which is the output of the time point selection pipeline and thus
   // is not necessarily input to downstream filters.
   m_ImageTimePoints[m_TimePointIndex]->Modified();
+
+  // Cached display slices show the old voxels
+  m_DisplaySliceCache->Invalidate();
+  m_Thumbnail = nullptr;
   }
 
 template<class TTraits>
@@ -2061,12 +2176,18 @@ void ImageWrapper<TTraits>
         container->Size() == m_Image4D->GetPixelContainer()->Size(),
         "Source array size does not match target array size in SetPixelContainer");
 
+  m_TimePointPager->SetBuffer(nullptr, 0, 0);
+  m_DisplaySliceCache->Invalidate();
+  m_Thumbnail = nullptr;
+
   typedef ImageWrapperPartialSpecializationTraits<ImageType, Image4DType> Specialization;
   Specialization::UpdatePixelContainer(m_Image4D, container);
   for(unsigned int tp = 0; tp < m_ImageTimePoints.size(); tp++)
     Specialization::ConfigureTimePointImageFromImage4D(m_Image4D, m_ImageTimePoints[tp], tp);
   m_TimePointSelectFilter->Update();
 
+  this->UpdateTimePointPager();
+
   this->PixelsModified();
 }
 
@@ -2191,6 +2312,13 @@ ImageWrapper<TTraits>::GetDisplaySlice(unsigned int dim)
   return m_DisplayMapping->GetDisplaySlice(dim);
 }
 
+template<class TTraits>
+typename ImageWrapper<TTraits>::DisplaySlicePointer
+ImageWrapper<TTraits>::GetReducedDisplaySlice(unsigned int dim, unsigned int level)
+{
+  return m_DisplayMapping->GetReducedDisplaySlice(dim, level);
+}
+
 template<class TTraits>
 void
 ImageWrapper<TTraits>
@@ -2371,6 +2499,10 @@ typename ImageWrapper<TTraits>::DisplaySlicePointer
 ImageWrapper<TTraits>
 ::MakeThumbnail(unsigned int maxdim)
 {
+  // Reuse the last thumbnail if nothing that it shows has changed
+  if(m_Thumbnail && m_ThumbnailSize == maxdim && m_ThumbnailGeometry == m_ImageGeometry)
+    return m_Thumbnail;
+
   // Determine which axis to use for thumbnail generation. Each axis is assigned
   // a penalty based on the following
   //   - Type 1 penalty is 1 if one of the slice dimensions is 1, 0 otherwise
@@ -2501,9 +2633,12 @@ ImageWrapper<TTraits>
   SmartPtr<OpaqueFilter> opaquer = OpaqueFilter::New();
   opaquer->SetInput(flipper->GetOutput());
 
-  // Return the result
+  // Keep the result for the next request
   opaquer->Update();
   DisplaySlicePointer result = opaquer->GetOutput();
+  m_Thumbnail = result;
+  m_ThumbnailSize = maxdim;
+  m_ThumbnailGeometry = m_ImageGeometry;
   return result;
 }
 
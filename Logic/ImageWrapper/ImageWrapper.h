@@ -56,6 +56,8 @@ template <class TInputImage, class TTag> class InputSelectionImageFilter;
 
 template<class TIn> class TDigestImageFilter;
 class TDigestDataObject;
+class TimePointPager;
+class DisplaySliceCache;
 
 class SNAPSegmentationROISettings;
 
@@ -250,6 +252,9 @@ public:
   /** Return some image info independently of pixel type */
   ImageBaseType* GetImageBase() const ITK_OVERRIDE;
 
+  /** Return the image of a time point independently of pixel type */
+  ImageBaseType* GetImageBaseByTimePoint(unsigned int tp) const ITK_OVERRIDE;
+
   /** Return 4D image metadata */
   Image4DBaseType* GetImage4DBase() const ITK_OVERRIDE { return m_Image4D; }
 
@@ -443,6 +448,12 @@ public:
   /** Set the current time index */
   virtual void SetTimePointIndex(unsigned int index) ITK_OVERRIDE;
 
+  /** Get the object that decides which time points stay in memory */
+  virtual TimePointPager *GetTimePointPager() const ITK_OVERRIDE { return m_TimePointPager; }
+
+  /** Get the cache of display slices */
+  virtual DisplaySliceCache *GetDisplaySliceCache() const ITK_OVERRIDE { return m_DisplaySliceCache; }
+
   const ImageBaseType* GetDisplayViewportGeometry(unsigned int index) const;
 
   virtual void SetDisplayViewportGeometry(
@@ -461,6 +472,8 @@ public:
     */
   virtual TDigestDataObject *GetTDigest() ITK_OVERRIDE;
 
+  virtual void SetTDigestLog2SamplingRate(int k) ITK_OVERRIDE;
+
   typedef itk::SimpleDataObjectDecorator<ComponentType> MinMaxObjectType;
 
   /** Legacy code returning image min as an object. TODO: refactor this out */
@@ -593,6 +606,11 @@ public:
    */
   DisplaySlicePointer GetDisplaySlice(unsigned int dim) ITK_OVERRIDE;
 
+  /**
+   * Get the display slice made from a reduced resolution copy of the image
+   */
+  DisplaySlicePointer GetReducedDisplaySlice(unsigned int dim, unsigned int level) ITK_OVERRIDE;
+
   /**
     Attach a preview pipeline to the wrapper. This is used with wrappers that
     represent results of image processing operations, such as speed images.
@@ -802,6 +820,32 @@ protected:
   /** The current time point (index into m_ImageTimePoints) */
   unsigned int m_TimePointIndex = 0;
 
+  /** Keeps the time points in use in memory, for images mapped from a file */
+  SmartPtr<TimePointPager> m_TimePointPager;
+
+  /** Start or stop paging the time points of the current 4D image */
+  void UpdateTimePointPager();
+
+  /** Number of time points of a paged image that the quantiles are taken from */
+  static constexpr unsigned int PAGED_STATISTICS_TIME_POINTS = 8;
+
+  /** Recently shown and prefetched display slices of the current time point */
+  SmartPtr<DisplaySliceCache> m_DisplaySliceCache;
+
+  /** Called when the image statistics have been computed */
+  void OnStatisticsUpdated();
+
+  /**
+   * The last thumbnail made, its size and the geometry it was made in. It is
+   * cleared when the voxels or the display mapping change.
+   */
+  DisplaySlicePointer m_Thumbnail;
+  unsigned int m_ThumbnailSize = 0;
+  SmartPtr<ImageCoordinateGeometry> m_ThumbnailGeometry;
+
+  /** Called when the display mapping of this wrapper changes */
+  void OnDisplayMappingChange();
+
   /** This image selector is used to pull out the current time point */
   typedef InputSelectionImageFilter<ImageType, unsigned int> TimePointSelectFilter;
   typedef SmartPtr<TimePointSelectFilter> TimePointSelectPointer;
@@ -33,6 +33,8 @@ class AbstractNativeIntensityMapping;
 class AbstractDisplayMappingPolicy;
 class SNAPSegmentationROISettings;
 class GuidedNativeImageIO;
+class TimePointPager;
+class DisplaySliceCache;
 class Registry;
 class vtkImageImport;
 struct IRISDisplayGeometry;
@@ -200,6 +202,25 @@ public:
   /** Set the current time index */
   virtual void SetTimePointIndex(unsigned int index) = 0;
 
+  /**
+   * Get the object that decides which time points stay in memory. It only
+   * acts on 4D images that are mapped from their file.
+   */
+  irisVirtualGetMacro(TimePointPager, TimePointPager *)
+
+  /**
+   * Insert only every 2^k-th voxel into the t-digest from which the intensity
+   * quantiles are computed (see GetTDigest). The intensity range and the
+   * histogram still use every voxel. By default (zero) every voxel is used.
+   */
+  virtual void SetTDigestLog2SamplingRate(int k) = 0;
+
+  /**
+   * Get the cache of display slices, which also computes the slices ahead
+   * of the current one while the user scrolls
+   */
+  irisVirtualGetMacro(DisplaySliceCache, DisplaySliceCache *)
+
   /**
    * Set the viewport rectangle onto which the three display slices
    * will be rendered
@@ -212,6 +233,10 @@ public:
   /** Return some image info independently of pixel type */
   irisVirtualGetMacro(ImageBase, ImageBaseType *)
 
+  /** Return the image of a time point independently of pixel type. The time
+   * point is clamped to the number of time points in this image */
+  virtual ImageBaseType *GetImageBaseByTimePoint(unsigned int tp) const = 0;
+
   /** Return some image info independently of pixel type */
   irisVirtualGetMacro(Image4DBase, Image4DBaseType *)
 
@@ -310,6 +335,13 @@ public:
   /** Get a display slice correpsponding to the current index */
   virtual DisplaySlicePointer GetDisplaySlice(unsigned int dim) = 0;
 
+  /**
+   * Get a display slice made from a copy of the image shrunk by 2^level, for
+   * drawing zoomed out views. The full resolution slice is returned when the
+   * display mapping has no reduced slices.
+   */
+  virtual DisplaySlicePointer GetReducedDisplaySlice(unsigned int dim, unsigned int level) = 0;
+
   /** For each slicer, find out which image dimension does is slice along */
   virtual unsigned int GetDisplaySliceImageAxis(unsigned int slice) = 0;
 
@@ -354,11 +386,14 @@ public:
 
   /** Compute statistics over a run of voxels in the image starting at the index
    * startIdx. Appends the statistics to a running sum and sum of squared. The
-   * statistics are returned in internal (not native mapped) format */
+   * statistics are returned in internal (not native mapped) format. By
+   * default the image of the current time point is used; image selects
+   * another time point of this wrapper (see GetImageBaseByTimePoint) */
   virtual void GetRunLengthIntensityStatistics(
       const itk::ImageRegion<3> &region,
       const itk::Index<3> &startIdx, long runlength,
-      double *out_nvalid, double *out_sum, double *out_sumsq) const = 0;
+      double *out_nvalid, double *out_sum, double *out_sumsq,
+      const itk::ImageBase<3> *image = nullptr) const = 0;
 
   /**
    * This method returns a vector of values for the voxel under the cursor.
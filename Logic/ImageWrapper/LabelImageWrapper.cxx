@@ -43,6 +43,7 @@
 #include "LabelImageWrapper.h"
 #include "UndoDataManager.h"
 #include "Rebroadcaster.h"
+#include <algorithm>
 
 LabelImageWrapper::LabelImageWrapper()
 {
@@ -52,6 +53,9 @@ LabelImageWrapper::~LabelImageWrapper()
 {
   for(auto p : m_TimePointUndoManagers)
     delete p;
+
+  for(auto obs : m_DeltaObservers)
+    obs->OnLabelImageWrapperDeleted();
 }
 
 void LabelImageWrapper::UpdateWrappedImages(
@@ -65,10 +69,15 @@ void LabelImageWrapper::UpdateWrappedImages(
   for(auto p : m_TimePointUndoManagers)
     delete p;
 
-  // Set up new undo managers
+  // Set up new undo managers. Since older undo steps are compressed and
+  // eventually spilled to disk, the limit on the number of RLEs kept in the
+  // history can be generous; the memory budget is what bounds RAM use.
   m_TimePointUndoManagers.resize(this->GetNumberOfTimePoints());
   for(auto &p : m_TimePointUndoManagers)
-    p = new UndoManagerType(4, 200000);
+    {
+    p = new UndoManagerType(4, 50000000);
+    p->SetMemoryBudget(UNDO_MEMORY_BUDGET / this->GetNumberOfTimePoints());
+    }
 
   // Modified event on the image is rebroadcast as the WrapperImageChangeEvent
   Rebroadcaster::Rebroadcast(image_4d, itk::ModifiedEvent(), this, WrapperImageChangeEvent());
@@ -120,6 +129,7 @@ void LabelImageWrapper::Undo()
 
   // Get the commit for the undo
   const UndoManagerType::Commit &commit = um->GetCommitForUndo();
+  itk::ModifiedTimeType base_time = m_Image4D->GetMTime();
 
   // The label image that will undergo undo
   typedef itk::ImageRegionIterator<ImageType> IteratorType;
@@ -131,6 +141,19 @@ void LabelImageWrapper::Undo()
     // Apply the changes in the current delta
     UndoManagerType::Delta *delta = *dit;
 
+    // Sparse deltas only visit the lines that were changed
+    if(delta->IsSparse())
+      {
+      for(size_t i = 0; i < delta->GetNumberOfRLEs(); i++)
+        {
+        LabelType d = delta->GetRLEValue(i);
+        for(IteratorType lit(m_Image, delta->GetRLERegion(i)); !lit.IsAtEnd(); ++lit)
+          lit.Set(lit.Get() - d);
+        }
+      this->NotifyDeltaApplied(delta, true, base_time);
+      continue;
+      }
+
     // Iterator for the relevant region in the label image
     IteratorType lit(m_Image, delta->GetRegion());
 
@@ -146,10 +169,12 @@ void LabelImageWrapper::Undo()
         ++lit;
         }
       }
+    this->NotifyDeltaApplied(delta, true, base_time);
     }
 
   // Set modified flags
   this->PixelsModified();
+  this->NotifyDeltasFinished();
 }
 
 bool LabelImageWrapper::IsRedoPossible()
@@ -164,6 +189,7 @@ void LabelImageWrapper::Redo()
 
   // Get the commit for the redo
   const UndoManagerType::Commit &commit = um->GetCommitForRedo();
+  itk::ModifiedTimeType base_time = m_Image4D->GetMTime();
 
   // The label image that will undergo redo
   typedef itk::ImageRegionIterator<ImageType> IteratorType;
@@ -175,6 +201,19 @@ void LabelImageWrapper::Redo()
     // Apply the changes in the current delta
     UndoManagerType::Delta *delta = *dit;
 
+    // Sparse deltas only visit the lines that were changed
+    if(delta->IsSparse())
+      {
+      for(size_t i = 0; i < delta->GetNumberOfRLEs(); i++)
+        {
+        LabelType d = delta->GetRLEValue(i);
+        for(IteratorType lit(m_Image, delta->GetRLERegion(i)); !lit.IsAtEnd(); ++lit)
+          lit.Set(lit.Get() + d);
+        }
+      this->NotifyDeltaApplied(delta, false, base_time);
+      continue;
+      }
+
     // Iterator for the relevant region in the label image
     IteratorType lit(m_Image, delta->GetRegion());
 
@@ -190,10 +229,12 @@ void LabelImageWrapper::Redo()
         ++lit;
         }
       }
+    this->NotifyDeltaApplied(delta, false, base_time);
     }
 
   // Set modified flags
   this->PixelsModified();
+  this->NotifyDeltasFinished();
 }
 
 const
@@ -204,6 +245,33 @@ LabelImageWrapper
   return m_TimePointUndoManagers[m_TimePointIndex];
 }
 
+void LabelImageWrapper::AddDeltaObserver(LabelImageDeltaObserver *observer)
+{
+  if(std::find(m_DeltaObservers.begin(), m_DeltaObservers.end(), observer) == m_DeltaObservers.end())
+    m_DeltaObservers.push_back(observer);
+}
+
+void LabelImageWrapper::RemoveDeltaObserver(LabelImageDeltaObserver *observer)
+{
+  m_DeltaObservers.erase(
+        std::remove(m_DeltaObservers.begin(), m_DeltaObservers.end(), observer),
+        m_DeltaObservers.end());
+}
+
+void LabelImageWrapper::NotifyDeltaApplied(
+    UndoManagerDelta *delta, bool inverse, itk::ModifiedTimeType base_time)
+{
+  for(auto obs : m_DeltaObservers)
+    obs->OnLabelDeltaApplied(delta, inverse, base_time);
+}
+
+void LabelImageWrapper::NotifyDeltasFinished()
+{
+  itk::ModifiedTimeType time = m_Image4D->GetMTime();
+  for(auto obs : m_DeltaObservers)
+    obs->OnLabelDeltasFinished(time);
+}
+
 LabelImageWrapper::UndoManagerDelta *
 LabelImageWrapper::CompressImage() const
 {
@@ -8,6 +8,31 @@ template <typename TPixel> class UndoDataManager;
 template <typename TPixel> class UndoDelta;
 class SegmentationUpdateIterator;
 
+/**
+ * Interface for objects that follow the edits made to a label image through
+ * the deltas recorded by the undo system (painting, undo and redo), rather
+ * than reprocessing the whole image after each edit.
+ */
+class LabelImageDeltaObserver
+{
+public:
+  virtual ~LabelImageDeltaObserver() {}
+
+  /** Called after a delta has been applied to the current time point, while
+   * the image holds the result of that delta. If inverse is set, the delta
+   * was subtracted (undo). The base time is the MTime of the 4D image before
+   * the edit that the delta belongs to. */
+  virtual void OnLabelDeltaApplied(UndoDelta<LabelType> *delta, bool inverse,
+                                   itk::ModifiedTimeType base_time) = 0;
+
+  /** Called once all deltas of an edit have been applied and the image has
+   * been marked as modified. The time is the new MTime of the 4D image. */
+  virtual void OnLabelDeltasFinished(itk::ModifiedTimeType time) = 0;
+
+  /** Called when the wrapper is deleted */
+  virtual void OnLabelImageWrapperDeleted() = 0;
+};
+
 class LabelImageWrapper : public ScalarImageWrapper<LabelImageWrapperTraits>
 {
 public:
@@ -77,6 +102,17 @@ public:
   /** Get the undo manager */
   const UndoManagerType *GetUndoManager() const;
 
+  /** Add an observer to be notified of the deltas applied to the image. The
+   * wrapper does not own the observer. */
+  void AddDeltaObserver(LabelImageDeltaObserver *observer);
+
+  /** Remove an observer added with AddDeltaObserver */
+  void RemoveDeltaObserver(LabelImageDeltaObserver *observer);
+
+  /** Memory budget for the undo history of all time points, in bytes.
+   * Older undo steps beyond this budget are spilled to a temporary file. */
+  static const size_t UNDO_MEMORY_BUDGET = 256 * 1024 * 1024;
+
   /** This is not used by the undo system itself, but uses the undo code to
    * store the contents of the image as an undo delta object, which can then
    * be stored in memory compactly. The caller is responsible for deleting the
@@ -93,6 +129,13 @@ protected:
   // undo steps with little cost in performance or memory. We currently associate each time
   // point with its own undo manager
   std::vector<UndoManagerType *> m_TimePointUndoManagers;
+
+  // Notify the delta observers
+  void NotifyDeltaApplied(UndoManagerDelta *delta, bool inverse, itk::ModifiedTimeType base_time);
+  void NotifyDeltasFinished();
+
+  // Objects following the edits to the image
+  std::vector<LabelImageDeltaObserver *> m_DeltaObservers;
 };
 
 #endif // LABELIMAGEWRAPPER_H
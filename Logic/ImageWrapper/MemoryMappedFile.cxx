@@ -0,0 +1,269 @@
+#include "MemoryMappedFile.h"
+#include "itksys/SystemTools.hxx"
+#include "itksys/Encoding.hxx"
+
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <set>
+
+#ifdef WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+using itksys::SystemTools;
+
+namespace
+{
+// All current mappings, so that they can be found by ReleaseFile()
+std::mutex &registry_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::set<MemoryMappedFile *> &registry()
+{
+  static std::set<MemoryMappedFile *> mappings;
+  return mappings;
+}
+}
+
+MemoryMappedFile::MemoryMappedFile()
+{
+  m_Base = nullptr;
+  m_MappedLength = 0;
+  m_MappedOffset = 0;
+  m_Pointer = nullptr;
+  m_Attached = false;
+  m_Handle = nullptr;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+  this->Unmap();
+}
+
+size_t MemoryMappedFile::GetAllocationGranularity()
+{
+#ifdef WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+#else
+  return (size_t) sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void *MemoryMappedFile::Map(const std::string &datafile, unsigned long long offset,
+                            size_t length, const std::string &source)
+{
+  this->Unmap();
+  if(length == 0)
+    return nullptr;
+
+  // Mappings must start on a page boundary
+  size_t delta = (size_t) (offset % GetAllocationGranularity());
+  unsigned long long start = offset - delta;
+  size_t maplen = length + delta;
+
+#ifdef WIN32
+  HANDLE hfile = CreateFileW(itksys::Encoding::ToWide(datafile).c_str(), GENERIC_READ,
+                             FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(hfile == INVALID_HANDLE_VALUE)
+    return nullptr;
+
+  // The file must hold all of the requested bytes (see the class comment)
+  LARGE_INTEGER fsize;
+  if(!GetFileSizeEx(hfile, &fsize) || (unsigned long long) fsize.QuadPart < offset + length)
+    {
+    CloseHandle(hfile);
+    return nullptr;
+    }
+
+  // The mapping object keeps the file open
+  HANDLE hmap = CreateFileMappingW(hfile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  CloseHandle(hfile);
+  if(!hmap)
+    return nullptr;
+
+  void *base = MapViewOfFile(hmap, FILE_MAP_COPY, (DWORD) (start >> 32),
+                             (DWORD) (start & 0xffffffff), maplen);
+  if(!base)
+    {
+    CloseHandle(hmap);
+    return nullptr;
+    }
+  m_Handle = hmap;
+#else
+  int fd = open(datafile.c_str(), O_RDONLY);
+  if(fd < 0)
+    return nullptr;
+
+  // The file must hold all of the requested bytes (see the class comment).
+  // This is checked on the open file, which is the one that gets mapped.
+  struct stat st;
+  if(fstat(fd, &st) != 0 || (unsigned long long) st.st_size < offset + length)
+    {
+    close(fd);
+    return nullptr;
+    }
+
+  // A private mapping can be written to without affecting the file
+  void *base = mmap(nullptr, maplen, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t) start);
+  close(fd);
+  if(base == MAP_FAILED)
+    return nullptr;
+#endif
+
+  m_Base = static_cast<char *>(base);
+  m_MappedLength = maplen;
+  m_MappedOffset = start;
+  m_Pointer = m_Base + delta;
+  m_Attached = true;
+  m_DataFile = SystemTools::CollapseFullPath(datafile);
+  m_SourceFile = SystemTools::CollapseFullPath(source);
+
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  registry().insert(this);
+  return m_Pointer;
+}
+
+void MemoryMappedFile::Unmap()
+{
+  if(!m_Base)
+    return;
+
+  {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  registry().erase(this);
+  }
+
+#ifdef WIN32
+  if(m_Attached)
+    UnmapViewOfFile(m_Base);
+  else
+    VirtualFree(m_Base, 0, MEM_RELEASE);
+  if(m_Handle)
+    CloseHandle((HANDLE) m_Handle);
+#else
+  munmap(m_Base, m_MappedLength);
+#endif
+
+  m_Base = nullptr;
+  m_MappedLength = 0;
+  m_MappedOffset = 0;
+  m_Pointer = nullptr;
+  m_Attached = false;
+  m_Handle = nullptr;
+}
+
+bool MemoryMappedFile::Detach()
+{
+  if(!m_Base || !m_Attached)
+    return true;
+
+  size_t len = m_MappedLength;
+
+#ifdef WIN32
+  // Windows cannot replace a view in place, so the view is copied out,
+  // unmapped, and the same addresses are allocated again. Should another
+  // thread take the addresses in between, the view is mapped back.
+  char *copy = (char *) VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if(!copy)
+    return false;
+  memcpy(copy, m_Base, len);
+
+  UnmapViewOfFile(m_Base);
+  if(!VirtualAlloc(m_Base, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE))
+    {
+    MapViewOfFileEx((HANDLE) m_Handle, FILE_MAP_COPY, (DWORD) (m_MappedOffset >> 32),
+                    (DWORD) (m_MappedOffset & 0xffffffff), len, m_Base);
+    memcpy(m_Base, copy, len);
+    VirtualFree(copy, 0, MEM_RELEASE);
+    return false;
+    }
+  memcpy(m_Base, copy, len);
+  VirtualFree(copy, 0, MEM_RELEASE);
+
+  // Let go of the file
+  CloseHandle((HANDLE) m_Handle);
+  m_Handle = nullptr;
+#else
+  // Copy the pages into anonymous memory and put that memory in place of
+  // the mapping, keeping the addresses
+  void *anon = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(anon == MAP_FAILED)
+    return false;
+  memcpy(anon, m_Base, len);
+
+#ifdef __linux__
+  if(mremap(anon, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, m_Base) == MAP_FAILED)
+    {
+    munmap(anon, len);
+    return false;
+    }
+#else
+  if(mmap(m_Base, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED)
+    {
+    munmap(anon, len);
+    return false;
+    }
+  memcpy(m_Base, anon, len);
+  munmap(anon, len);
+#endif
+#endif
+
+  m_Attached = false;
+  return true;
+}
+
+bool MemoryMappedFile::IsMapped(const void *ptr)
+{
+  const char *p = static_cast<const char *>(ptr);
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for(MemoryMappedFile *mapping : registry())
+    {
+    if(mapping->m_Attached && p >= mapping->m_Base && p < mapping->m_Base + mapping->m_MappedLength)
+      return true;
+    }
+  return false;
+}
+
+void MemoryMappedFile::ReleasePages(void *ptr, size_t length)
+{
+#ifdef WIN32
+  // Unlocking memory that is not locked removes it from the working set
+  VirtualUnlock(ptr, length);
+#elif defined(__linux__) && defined(MADV_PAGEOUT)
+  // Only whole pages inside the range
+  size_t page = (size_t) sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t) ptr + page - 1) / page * page;
+  uintptr_t end = ((uintptr_t) ptr + length) / page * page;
+  if(end > start)
+    madvise((void *) start, end - start, MADV_PAGEOUT);
+#else
+  (void) ptr;
+  (void) length;
+#endif
+}
+
+void MemoryMappedFile::ReleaseFile(const std::string &fn)
+{
+  std::string path = SystemTools::CollapseFullPath(fn);
+
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for(MemoryMappedFile *mapping : registry())
+    {
+    if(mapping->m_Attached
+       && (SystemTools::ComparePath(mapping->m_DataFile, path)
+           || SystemTools::ComparePath(mapping->m_SourceFile, path)))
+      mapping->Detach();
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef MEMORYMAPPEDFILE_H
+#define MEMORYMAPPEDFILE_H
+
+#include "itkImportImageContainer.h"
+#include "itkObjectFactory.h"
+#include <string>
+
+/**
+ * \class MemoryMappedFile
+ * \brief A private (copy-on-write) mapping of a range of bytes in a file.
+ *
+ * The mapped memory can be read and written. Writes are never carried to
+ * the file, and pages are only read from disk when they are first touched.
+ *
+ * While the mapping exists, the contents of the memory depend on the file,
+ * so the file must not be truncated or overwritten. Before a file is
+ * written, ReleaseFile() should be called: it copies the contents of every
+ * mapping of that file into ordinary memory at the same address, so that
+ * pointers into the mapping remain valid.
+ *
+ * Map() fails unless the file is at least as long as the requested range
+ * when it is mapped. If the file is truncated afterwards (e.g., by another
+ * program), touching a page past its new end raises SIGBUS on POSIX systems
+ * (EXCEPTION_IN_PAGE_ERROR on Windows) and the application crashes. There
+ * is no portable way to guard against this, which is why only files that
+ * the user opened are mapped, and only when they are large (see
+ * GuidedNativeImageIO::MapNativeImageData).
+ */
+class MemoryMappedFile
+{
+public:
+  MemoryMappedFile();
+  ~MemoryMappedFile();
+
+  /**
+   * Map length bytes of the file starting at offset. The source is the file
+   * that the user opened (e.g., the header of a header/data pair), which is
+   * also matched by ReleaseFile(). Returns nullptr on failure, including
+   * when the file is shorter than offset + length.
+   */
+  void *Map(const std::string &datafile, unsigned long long offset,
+            size_t length, const std::string &source);
+
+  /** Release the mapping */
+  void Unmap();
+
+  void *GetPointer() const { return m_Pointer; }
+
+  /** Detach all mappings of a file, given by its data or its source name */
+  static void ReleaseFile(const std::string &fn);
+
+  /** Granularity of the offsets at which a file can be mapped */
+  static size_t GetAllocationGranularity();
+
+  /** Whether an address lies in a mapping that still comes from its file */
+  static bool IsMapped(const void *ptr);
+
+  /**
+   * Take the pages of a range of memory out of physical memory, keeping
+   * their contents. Unchanged pages of a mapping are read from the file
+   * again when accessed, changed pages are kept in the swap file. This is a
+   * hint, and does nothing on systems that do not support it.
+   */
+  static void ReleasePages(void *ptr, size_t length);
+
+protected:
+  // Replace the mapping by anonymous memory with the same contents
+  bool Detach();
+
+  MemoryMappedFile(const MemoryMappedFile &) = delete;
+  MemoryMappedFile &operator=(const MemoryMappedFile &) = delete;
+
+  // Start, length and file offset of the mapped pages, and the requested
+  // data within them
+  char *m_Base;
+  size_t m_MappedLength;
+  unsigned long long m_MappedOffset;
+  void *m_Pointer;
+
+  // Whether the pages still come from the file
+  bool m_Attached;
+
+  // The file mapping object (Windows only)
+  void *m_Handle;
+
+  // Full paths of the data file and the source file
+  std::string m_DataFile, m_SourceFile;
+};
+
+/**
+ * \class MappedImageContainer
+ * \brief A pixel container whose buffer is a file mapped into memory.
+ *
+ * The container does not manage the memory, which allows CastNativeImage
+ * to tell that the buffer cannot be reallocated.
+ */
+template <typename TElement>
+class MappedImageContainer
+  : public itk::ImportImageContainer<itk::SizeValueType, TElement>
+{
+public:
+  typedef MappedImageContainer Self;
+  typedef itk::ImportImageContainer<itk::SizeValueType, TElement> Superclass;
+  typedef itk::SmartPointer<Self> Pointer;
+  typedef itk::SmartPointer<const Self> ConstPointer;
+  itkNewMacro(Self)
+  itkTypeMacro(MappedImageContainer, ImportImageContainer)
+
+  /** Map n elements of the file starting at offset into the container */
+  bool Map(const std::string &datafile, unsigned long long offset,
+           size_t n, const std::string &source)
+  {
+    void *ptr = m_Mapping.Map(datafile, offset, n * sizeof(TElement), source);
+    if(!ptr)
+      return false;
+    this->SetImportPointer(static_cast<TElement *>(ptr), n, false);
+    return true;
+  }
+
+protected:
+  MappedImageContainer() {}
+  virtual ~MappedImageContainer() {}
+
+  MemoryMappedFile m_Mapping;
+};
+
+#endif // MEMORYMAPPEDFILE_H
@@ -22,16 +22,28 @@ void ScalarImageHistogram
 {
   digest->Update();
   this->Initialize(digest->GetImageMinimum(), digest->GetImageMaximum(), nBins);
-  double cdf_left, cdf_right;
-  for(int i = 0; i < m_BinCount; i++)
+
+  // Each fine bin is narrower than a bin of this histogram (unless the image
+  // has very few distinct values), so its count is assigned to the bin that
+  // contains its representative value
+  const StreamingHistogram &fine = digest->GetHistogram();
+  if(fine.IsEmpty())
+    return;
+
+  for(int i = 0; i < StreamingHistogram::NBINS; i++)
     {
-    cdf_left = (i > 0) ? cdf_right : digest->GetCDF(m_FirstBinStart);
-    cdf_right = digest->GetCDF(m_FirstBinStart + (i+1) * m_BinWidth);
-    unsigned long freq = (unsigned long) std::floor(0.5 + (cdf_right - cdf_left) * digest->GetTotalWeight());
-    m_Bins[i] = freq;
-    m_MaxFrequency = std::max(m_MaxFrequency, freq);
-    m_TotalSamples += freq;
+    unsigned long n = (unsigned long) fine.GetCount(i);
+    if(n)
+      {
+      int index = (int) (m_Scale * (fine.GetBinValue(i) - m_FirstBinStart));
+      index = std::min(std::max(index, 0), m_BinCount - 1);
+      m_Bins[index] += n;
+      m_TotalSamples += n;
+      }
     }
+
+  for(int i = 0; i < m_BinCount; i++)
+    m_MaxFrequency = std::max(m_MaxFrequency, m_Bins[i]);
 }
 
 void
@@ -18,7 +18,10 @@ class ScalarImageHistogram : public itk::DataObject
 public:
   irisITKObjectMacro(ScalarImageHistogram, itk::DataObject)
 
-  /** Compute the histogram from a t-digest */
+  /**
+   * Compute the histogram from a t-digest. The bins are counted by rebinning
+   * the fine histogram that the digest was built from.
+   */
   void ComputeFromTDigest(TDigestDataObject *, unsigned int nBins = 128);
 
   void Initialize(double vmin, double vmax, size_t nBins);
@@ -185,11 +185,17 @@ ScalarImageWrapper<TTraits>
 ::GetRunLengthIntensityStatistics(
     const itk::ImageRegion<3> &region,
     const itk::Index<3> &startIdx, long runlength,
-    double *out_nvalid, double *out_sum, double *out_sumsq) const
+    double *out_nvalid, double *out_sum, double *out_sumsq,
+    const itk::ImageBase<3> *image) const
 {
   if(this->IsSlicingOrthogonal())
     {
-    ConstIterator it(this->m_Image, region);
+    // The image, if given, is one of the time points of this wrapper
+    const ImageType *tpImage = image
+        ? static_cast<const ImageType *>(image)
+        : this->m_Image.GetPointer();
+
+    ConstIterator it(tpImage, region);
     it.SetIndex(startIdx);
 
     // Perform the integration
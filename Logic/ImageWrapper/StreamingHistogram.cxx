@@ -0,0 +1,120 @@
+#include "StreamingHistogram.h"
+#include <algorithm>
+#include <limits>
+
+StreamingHistogram::StreamingHistogram(bool integral)
+  : m_Integral(integral)
+{
+  Reset();
+}
+
+void StreamingHistogram::Reset()
+{
+  m_Count.clear();
+  m_Origin = 0.0;
+  m_Width = 0.0;
+  m_InverseWidth = std::numeric_limits<double>::quiet_NaN();
+  m_Min = std::numeric_limits<double>::infinity();
+  m_Max = -std::numeric_limits<double>::infinity();
+}
+
+void StreamingHistogram::Grow(double v)
+{
+  if(m_Count.empty())
+    {
+    // The first value: start with the finest bins that make sense for it
+    double w;
+    if(m_Integral)
+      w = 1.0;
+    else
+      w = (v == 0.0) ? std::ldexp(1.0, -64) : std::ldexp(1.0, std::ilogb(v) - 40);
+    Fit(v, v, w);
+    }
+  else
+    {
+    Fit(m_Min, m_Max, m_Width);
+    }
+
+  int i = (int) std::floor((v - m_Origin) * m_InverseWidth);
+  m_Count[std::min(std::max(i, 0), NBINS - 1)]++;
+}
+
+void StreamingHistogram::Fit(double lo, double hi, double w)
+{
+  // Double the width until [lo, hi] fits with at least one spare bin on each
+  // side, then center the range in the bins. Centering leaves room to grow in
+  // both directions, so that a slowly drifting range does not shift the bins
+  // on every call. The result only depends on (lo, hi, w), which Merge()
+  // relies on to bring two histograms to the same bins.
+  double new_width = w;
+  while(hi - lo > (NBINS - 2) * new_width)
+    new_width *= 2.0;
+
+  double center = 0.5 * (lo + hi);
+  double new_origin = std::floor((center - 0.5 * NBINS * new_width) / new_width) * new_width;
+
+  if(!m_Count.empty() && new_origin == m_Origin && new_width == m_Width)
+    return;
+
+  // Move the counts into the new bins. Both widths are powers of two and the
+  // origins are multiples of the widths, so each old bin lies entirely
+  // within a new bin.
+  std::vector<unsigned long long> count(NBINS, 0);
+  double inv_width = 1.0 / new_width;
+  for(int i = 0; i < (int) m_Count.size(); i++)
+    {
+    if(m_Count[i])
+      {
+      int j = (int) std::floor((GetBinStart(i) - new_origin) * inv_width);
+      count[std::min(std::max(j, 0), NBINS - 1)] += m_Count[i];
+      }
+    }
+
+  m_Count.swap(count);
+  m_Origin = new_origin;
+  m_Width = new_width;
+  m_InverseWidth = inv_width;
+}
+
+void StreamingHistogram::Merge(const StreamingHistogram &other)
+{
+  if(other.IsEmpty())
+    return;
+
+  if(this->IsEmpty())
+    {
+    *this = other;
+    return;
+    }
+
+  // Bring both histograms to the same bins
+  double lo = std::min(m_Min, other.m_Min);
+  double hi = std::max(m_Max, other.m_Max);
+  double w = std::max(m_Width, other.m_Width);
+
+  StreamingHistogram addee = other;
+  addee.Fit(lo, hi, w);
+  this->Fit(lo, hi, w);
+
+  for(int i = 0; i < NBINS; i++)
+    m_Count[i] += addee.m_Count[i];
+
+  m_Min = lo;
+  m_Max = hi;
+}
+
+unsigned long long StreamingHistogram::GetTotalCount() const
+{
+  unsigned long long total = 0;
+  for(auto n : m_Count)
+    total += n;
+  return total;
+}
+
+double StreamingHistogram::GetBinValue(int i) const
+{
+  if(m_Integral && m_Width == 1.0)
+    return GetBinStart(i);
+
+  return std::min(std::max(GetBinStart(i) + 0.5 * m_Width, m_Min), m_Max);
+}
@@ -0,0 +1,84 @@
+#ifndef STREAMINGHISTOGRAM_H
+#define STREAMINGHISTOGRAM_H
+
+#include <cmath>
+#include <vector>
+
+/**
+ * A fine histogram that can be filled in a single pass over data whose range
+ * is not known in advance. The bins have a width that is a power of two and
+ * start at a multiple of the bin width. When a value falls outside of the
+ * bins, the width is doubled (merging pairs of bins) until the value fits.
+ * Because of this alignment, histograms built from different parts of an
+ * image can always be merged exactly.
+ *
+ * When integral is set, the bin width is never smaller than one, and each
+ * bin of width one holds a single value, so the histogram is exact for
+ * integer data whose range does not exceed the number of bins.
+ *
+ * The exact minimum and maximum of the inserted values are also kept.
+ *
+ * The histogram is only meant for display. Its bins can be much wider than
+ * the spread of most of the data (e.g., with a few extreme outliers), so
+ * quantiles are taken from the t-digest built in the same pass instead.
+ */
+class StreamingHistogram
+{
+public:
+  static constexpr int NBINS = 1 << 14;
+
+  StreamingHistogram(bool integral = false);
+
+  /** Insert a (finite) value */
+  void Insert(double v)
+  {
+    if(v < m_Min) m_Min = v;
+    if(v > m_Max) m_Max = v;
+    double t = std::floor((v - m_Origin) * m_InverseWidth);
+    if(t >= 0 && t < NBINS)
+      m_Count[(int) t]++;
+    else
+      Grow(v);
+  }
+
+  /** Add the contents of another histogram */
+  void Merge(const StreamingHistogram &other);
+
+  /** Clear the histogram */
+  void Reset();
+
+  bool IsEmpty() const { return m_Count.empty(); }
+  bool IsIntegral() const { return m_Integral; }
+
+  double GetMinimum() const { return m_Min; }
+  double GetMaximum() const { return m_Max; }
+  double GetBinWidth() const { return m_Width; }
+  double GetBinStart(int i) const { return m_Origin + i * m_Width; }
+  unsigned long long GetCount(int i) const { return m_Count.empty() ? 0 : m_Count[i]; }
+
+  /** Total number of values inserted */
+  unsigned long long GetTotalCount() const;
+
+  /**
+   * A representative value for the contents of a bin: the value itself for
+   * bins that hold a single integer, otherwise the bin center, clamped to
+   * the range of the data.
+   */
+  double GetBinValue(int i) const;
+
+protected:
+  // Called for the first value and for values outside of the bins
+  void Grow(double v);
+
+  // Coarsen the bins so that they cover [lo, hi] with width at least w
+  void Fit(double lo, double hi, double w);
+
+  bool m_Integral;
+  std::vector<unsigned long long> m_Count;
+  double m_Origin, m_Width, m_Min, m_Max;
+
+  // NaN while the histogram is empty, so that Insert() calls Grow()
+  double m_InverseWidth;
+};
+
+#endif // STREAMINGHISTOGRAM_H
@@ -4,26 +4,33 @@
 #include <itkDataObject.h>
 #include <itkNumericTraits.h>
 #include "SNAPCommon.h"
+#include "StreamingHistogram.h"
 #include <itkSimpleDataObjectDecorator.h>
 #include <digestible/digestible.h>
 #include <itkVectorImage.h>
 #include <itkImageToImageFilter.h>
 #include <itkImageSink.h>
+#include <vector>
 
 /**
  * A wrapper around the t-digest data structure that can be used in ITK
- * pipelines and can provide basic statistics about an image
+ * pipelines and can provide basic statistics about an image. Along with the
+ * digest, it holds a fine histogram of the image, which can be rebinned into
+ * display histograms.
  */
 class TDigestDataObject : public itk::DataObject
 {
 public:
   irisITKObjectMacro(TDigestDataObject, itk::DataObject)
 
-  float GetImageMaximum() const { return m_Digest.max(); }
-  float GetImageMinimum() const { return m_Digest.min(); }
+  float GetImageMaximum() const { return m_ImageMaximum; }
+  float GetImageMinimum() const { return m_ImageMinimum; }
   float GetImageQuantile(double q) const { return m_Digest.quantile(100.0 * q); }
   float GetCDF(float value) const { return m_Digest.cumulative_distribution(value); }
-  unsigned GetTotalWeight() const { return m_Digest.size(); }
+  unsigned long long GetTotalWeight() const { return m_Digest.size(); }
+
+  /** The fine histogram of all (finite) values in the image */
+  const StreamingHistogram &GetHistogram() const { return m_Histogram; }
 
   template <class TInputImage> friend class TDigestImageFilter;
 
@@ -33,13 +40,21 @@ protected:
   TDigestDataObject() : m_Digest(DIGEST_SIZE) {}
   virtual ~TDigestDataObject() {}
 
-  // The t-digest - the compression parameter determines accuracy and memory use
-  typedef digestible::tdigest<float, unsigned> TDigest;
+  // The t-digest - the compression parameter determines accuracy and memory
+  // use. The weights are 64-bit, as large 4D images have more than 2^32 voxels.
+  typedef digestible::tdigest<float, unsigned long long> TDigest;
   TDigest m_Digest;
 
+  // The fine histogram
+  StreamingHistogram m_Histogram;
+
   // The number of NaN pixels
   unsigned long m_NaNCount = 0;
 
+  // The exact range of the image, which also covers the time points that
+  // are not in the digest
+  float m_ImageMinimum = 0.0f, m_ImageMaximum = 0.0f;
+
   // Intensity transform
   double m_TransformScale, m_TransformShift;
 };
@@ -47,8 +62,14 @@ protected:
 /**
  * This ITK-style filter approximates the quantiles of an image. It uses the
  * t-digest algorithm by T. Dunning to approximate the CDF of an image with
- * good properties. The computation is very fast, taking about 50ms for a
- * large 3D image.
+ * good properties.
+ *
+ * The image is read in a single threaded pass that computes the exact min
+ * and max, a fine histogram (see StreamingHistogram) and a t-digest of every
+ * value. Each thread sorts the values it reads in batches and inserts runs of
+ * equal values into its own digest as single weighted centroids, which is
+ * much cheaper than inserting values one at a time (around 60ns per value).
+ * The per-thread histograms and digests are merged at the end.
  *
  * The image is just passed through as is. Quantiles can be obtained using the
  * GetQuantile() method after the filter has run.
@@ -111,14 +132,27 @@ public:
   void SetIntensityTransform(double scale, double shift);
 
   /**
-   * Only insert a fraction of pixels into the TDigest. The fraction inserted will
-   * be approximately 2^log_2_sampling_rate i.e., if log_2_sampling_rate is 4, then
-   * every 16th pixel will be sampled, on average. Sampling uses a pseudo-random
-   * number generator to skip pixels. Min, max and the number of NaN values are still
-   * computed from the entire image. Sampling is recommended for very large images
-   * for performance reasons, since TDigest insertion is around 60ns per pixel.
+   * Only insert a fraction of the values into the t-digest. If the rate is
+   * k, every 2^k-th value is inserted. The min, max, histogram and number of
+   * NaN values are still computed from the entire image. By default (zero)
+   * every value is inserted, which is fast enough for most images. The rate
+   * is set from the default behavior settings (see DefaultBehaviorSettings).
    */
-  void SetLog2SamplingRate(int log_2_sampling_rate);
+  itkSetMacro(Log2SamplingRate, int)
+  itkGetMacro(Log2SamplingRate, int)
+
+  /**
+   * Only read some of the time points of a 4D image. If the number is n > 0
+   * and the image has more time points than that, n evenly spaced time
+   * points, including the first and the last, are added to the histogram
+   * and the digest. The other time points are only scanned for the min and
+   * max, which are always those of the whole image, since the display lookup
+   * tables of integer images are indexed by the intensity between them. This
+   * keeps the costly part of the pass small for images with many time
+   * points. By default (zero) all time points are added.
+   */
+  itkSetMacro(MaximumNumberOfTimePoints, unsigned int)
+  itkGetMacro(MaximumNumberOfTimePoints, unsigned int)
 
   /**
    * Get the t-digest output, wrapped as an itk::DataObject. Before using this object
@@ -157,10 +191,18 @@ private:
   // Intensity transform
   double m_TransformScale, m_TransformShift;
 
-  // Sampling rate
+  // Sampling rate for the digest
   int m_Log2SamplingRate;
 
-  // Mutex for combining digests
+  // Number of time points to add to the digest, and which ones are added in
+  // the current pass
+  unsigned int m_MaximumNumberOfTimePoints;
+  std::vector<bool> m_TimePointIncluded;
+
+  // Range of the finite values of the time points that are not added
+  double m_SkippedMinimum, m_SkippedMaximum;
+
+  // Mutex for combining histograms
   std::mutex m_Mutex;
 
 };
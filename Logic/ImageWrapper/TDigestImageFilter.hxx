@@ -6,21 +6,23 @@
 #include "TDigestImageFilter.h"
 #include <itkImageRegionConstIterator.h>
 #include <itkVectorImage.h>
-#include <random>
+#include <algorithm>
 #include <chrono>
+#include <limits>
+#include <vector>
 
 // Type-specific functions are placed in their own namespace
 namespace TDigestImageFilter_impl {
 
 // This is the function applied to each component
-template <class TValue, class TDigest>
-constexpr void add_value(const TValue &value, TDigest &tdigest, unsigned long &nan_count)
+template <class TValue>
+constexpr void add_value(const TValue &value, StreamingHistogram &hist, unsigned long &nan_count)
 {
   if constexpr (std::is_floating_point<TValue>::value)
     {
-    // Finite values are added to the TDigest
+    // Finite values are added to the histogram
     if(std::isfinite(value))
-      tdigest.insert(value);
+      hist.Insert(value);
     else if(std::isnan(value))
       nan_count++;
 
@@ -28,31 +30,56 @@ constexpr void add_value(const TValue &value, TDigest &tdigest, unsigned long &n
     }
   else
     {
-    tdigest.insert(value);
+    hist.Insert(value);
     }
 };
 
-// This is the function applied to each component
-template <class TValue>
-constexpr void skip_value(const TValue &value, TValue &skip_min, TValue &skip_max, unsigned long &nan_count)
+// Add a batch of values to the histogram and to the digest. Every value goes
+// into the histogram, and every 2^log2_sampling_rate-th finite value into the
+// digest. The values for the digest are sorted, so that a run of equal values
+// is inserted as one weighted centroid and the digest receives them in order,
+// which is much cheaper than inserting them one by one.
+template <class TValue, class TDigest>
+void add_batch(TValue *values, int n, int log2_sampling_rate, unsigned long long &counter,
+               StreamingHistogram &hist, TDigest &tdigest, unsigned long &nan_count)
 {
-  if constexpr (std::is_floating_point<TValue>::value)
+  const unsigned long long mask = (1ull << log2_sampling_rate) - 1;
+  int m = 0;
+  for(int i = 0; i < n; i++)
     {
-    // Finite values are added to the TDigest
-    if(std::isfinite(value))
+    add_value(values[i], hist, nan_count);
+    if constexpr (std::is_floating_point<TValue>::value)
       {
-      skip_min = std::min(value, skip_min);
-      skip_max = std::min(value, skip_max);
+      if(!std::isfinite(values[i]))
+        continue;
       }
-    else if(std::isnan(value))
-      nan_count++;
+    if((counter++ & mask) == 0)
+      values[m++] = values[i];
     }
-  else
+
+  std::sort(values, values + m);
+  for(int i = 0, j; i < m; i = j)
     {
-    skip_min = std::min(value, skip_min);
-    skip_max = std::min(value, skip_max);
+    for(j = i + 1; j < m && values[j] == values[i]; j++) {}
+    tdigest.insert((float) values[i], (unsigned long long) (j - i));
     }
-};
+}
+
+// Update the range of the finite values in a buffer
+template <class TValue>
+void update_range(const TValue *values, int n, double &vmin, double &vmax)
+{
+  for(int i = 0; i < n; i++)
+    {
+    if constexpr (std::is_floating_point<TValue>::value)
+      {
+      if(!std::isfinite(values[i]))
+        continue;
+      }
+    vmin = std::min(vmin, (double) values[i]);
+    vmax = std::max(vmax, (double) values[i]);
+    }
+}
 
 template <class TImage, class TDigest>
 class Helper
@@ -167,6 +194,7 @@ TDigestImageFilter<TInputImage>
   m_TransformScale = 1.0;
   m_TransformShift = 0.0;
   m_Log2SamplingRate = 0;
+  m_MaximumNumberOfTimePoints = 0;
 }
 
 template <class TInputImage>
@@ -179,15 +207,6 @@ TDigestImageFilter<TInputImage>
   this->Modified();
 }
 
-template <class TInputImage>
-void
-TDigestImageFilter<TInputImage>
-::SetLog2SamplingRate(int log_2_sampling_rate)
-{
-  this->m_Log2SamplingRate = log_2_sampling_rate;
-  this->Modified();
-}
-
 /*
 template< class TInputImage >
 void
@@ -232,7 +251,24 @@ TDigestImageFilter<TInputImage>
 ::BeforeStreamedGenerateData()
 {
   m_TDigestDataObject->m_Digest.reset();
+  m_TDigestDataObject->m_Histogram = StreamingHistogram(!std::is_floating_point<ComponentType>::value);
   m_TDigestDataObject->m_NaNCount = 0;
+  m_SkippedMinimum = std::numeric_limits<double>::infinity();
+  m_SkippedMaximum = -std::numeric_limits<double>::infinity();
+
+  // Choose the time points to add to the digest
+  m_TimePointIncluded.clear();
+  if(InputImageDimension == 4 && m_MaximumNumberOfTimePoints > 0)
+    {
+    unsigned int nt = this->GetInput()->GetBufferedRegion().GetSize()[InputImageDimension - 1];
+    unsigned int n = m_MaximumNumberOfTimePoints;
+    if(nt > n)
+      {
+      m_TimePointIncluded.resize(nt, false);
+      for(unsigned int i = 0; i < n; i++)
+        m_TimePointIncluded[n > 1 ? (i * (nt - 1) + (n - 1) / 2) / (n - 1) : 0] = true;
+      }
+    }
 }
 
 template< class TInputImage >
@@ -243,95 +279,85 @@ TDigestImageFilter<TInputImage>
   // Get the input image
   const TInputImage *img = this->GetInput();
 
-  // Fill the digest for this thread
+  // Fill the histogram and the digest for this thread
+  StreamingHistogram thread_hist(!std::is_floating_point<ComponentType>::value);
   typename TDigestDataObject::TDigest thread_digest(TDigestDataObject::DIGEST_SIZE);
   unsigned long thread_nan_count = 0;
+  unsigned long long sample_counter = 0;
+
+  // The parts of the region that are added to the digest, and those that
+  // are only scanned for the range, one per time point if only some time
+  // points are included
+  std::vector<RegionType> parts, skipped;
+  if(m_TimePointIncluded.size())
+    {
+    const unsigned int d = InputImageDimension - 1;
+    itk::IndexValueType t0 = img->GetBufferedRegion().GetIndex()[d];
+    for(itk::IndexValueType t = region.GetIndex()[d];
+        t < region.GetIndex()[d] + (itk::IndexValueType) region.GetSize()[d]; t++)
+      {
+      RegionType part = region;
+      part.SetIndex(d, t);
+      part.SetSize(d, 1);
+      if(m_TimePointIncluded[t - t0])
+        parts.push_back(part);
+      else
+        skipped.push_back(part);
+      }
+    }
+  else
+    {
+    parts.push_back(region);
+    }
 
   // An iterator used to parse the image
   typedef itk::ImageRegionConstIterator<TInputImage> Iterator;
-  Iterator it(img, region);
 
   // A helper class used to access pixels depending on iterator type
   using HelperType = Helper<TInputImage, typename TDigestDataObject::TDigest>;
 
-  // A buffer used to hold data extracted by the image iterator, assuming the overhead
-  // of copying the data to this buffer will be negligible. The buffer size should be
-  // at least as large as the number of components for multicomponent images
-  int buffer_size = std::max(1024u, img->GetNumberOfComponentsPerPixel());
+  // A buffer used to hold data extracted by the image iterator, which is
+  // sorted before it is added to the digest. The buffer size should be at
+  // least as large as the number of components for multicomponent images
+  int buffer_size = std::max(16384u, img->GetNumberOfComponentsPerPixel());
   int buffer_read = 0;
+  std::vector<ComponentType> buffer(buffer_size);
 
-  // Determine the sampling rate. Samples will be taken pseudorandomly from the
-  // buffer, so the buffer should be sized proportional to the sampling rate.
-  int sampling_rate = 1 << this->m_Log2SamplingRate;
-  buffer_size = std::max(buffer_size, 128 * sampling_rate);
-
-  // Allocate the buffer
-  ComponentType *buffer = new ComponentType[buffer_size];
-
-  // Split depending on whether we are randomly sampling or not
-  if(sampling_rate == 1)
+  for(const RegionType &part : parts)
     {
-    // If not sampling, the procedure is basic
+    Iterator it(img, part);
     while(!it.IsAtEnd())
       {
       // Copy a chunk of the image to the buffer
-      HelperType::to_buffer(it, buffer, buffer_size, buffer_read);
+      HelperType::to_buffer(it, buffer.data(), buffer_size, buffer_read);
 
-      // Digest the buffer
-      for(int i = 0; i < buffer_read; i++)
-        add_value(buffer[i], thread_digest, thread_nan_count);
+      // Add the buffer to the histogram and the digest
+      add_batch(buffer.data(), buffer_read, m_Log2SamplingRate, sample_counter,
+                thread_hist, thread_digest, thread_nan_count);
       }
     }
-  else
-    {
-    // Random generator for the sampling
-    std::random_device r;
-    std::seed_seq seed2{r(), r(), r(), r(), r(), r(), r(), r()};
-    std::ranlux48_base rand_src(seed2);
-
-    // Keep track of the min/max of the skipped pixels, they need to be added to the digest
-    unsigned long dummy_nan_count;
-    ComponentType skip_min = std::numeric_limits<ComponentType>::max();
-    ComponentType skip_max = std::numeric_limits<ComponentType>::min();
+  thread_digest.merge();
 
-    // If not sampling, the procedure is basic
+  // The time points that are not added only contribute to the range
+  double skipped_min = std::numeric_limits<double>::infinity();
+  double skipped_max = -std::numeric_limits<double>::infinity();
+  for(const RegionType &part : skipped)
+    {
+    Iterator it(img, part);
     while(!it.IsAtEnd())
       {
-      // Copy a chunk of the image to the buffer
-      HelperType::to_buffer(it, buffer, buffer_size, buffer_read);
-
-      // Use the entire buffer to determine min/max and number of nans
-      for(int i = 0; i < buffer_read; i++)
-        skip_value(buffer[i], skip_min, skip_max, thread_nan_count);
-
-      // Sample from the buffer with replacement
-      std::uniform_int_distribution<int> uniform_dist(0, buffer_read - 1);
-      int n_samples = buffer_read / sampling_rate;
-      for(int j = 0; j < n_samples; j++)
-        {
-        int i = uniform_dist(rand_src);
-        add_value(buffer[i], thread_digest, dummy_nan_count);
-        }
+      HelperType::to_buffer(it, buffer.data(), buffer_size, buffer_read);
+      update_range(buffer.data(), buffer_read, skipped_min, skipped_max);
       }
-
-    // Incorporate the min/max into the digest.
-    if(skip_max > thread_digest.max())
-      thread_digest.insert(skip_max);
-    if(skip_min > thread_digest.min())
-      thread_digest.insert(skip_min);
     }
 
-  // Get rid of the buffer
-  delete[] buffer;
-
-  // Complete the digest
-  thread_digest.merge();
-
-  // Use mutex to update the global heaps
+  // Use mutex to update the global histogram and digest. The digest is
+  // merged in AfterStreamedGenerateData.
   std::lock_guard<std::mutex> guard(m_Mutex);
-
-  // Add current digest so the main digest
+  m_TDigestDataObject->m_Histogram.Merge(thread_hist);
   m_TDigestDataObject->m_Digest.insert(thread_digest);
+  m_SkippedMinimum = std::min(m_SkippedMinimum, skipped_min);
+  m_SkippedMaximum = std::max(m_SkippedMaximum, skipped_max);
 
   // Update global nan count
   m_TDigestDataObject->m_NaNCount += thread_nan_count;
@@ -342,21 +368,29 @@ void
 TDigestImageFilter<TInputImage>
 ::AfterStreamedGenerateData()
 {
+  // Merge the digests of the threads
+  const StreamingHistogram &hist = m_TDigestDataObject->m_Histogram;
+  m_TDigestDataObject->m_Digest.merge();
+
   // Mark the output as modified (do we need to?)
   m_TDigestDataObject->Modified();
 
-  // Get the image min and max. Here we have to cast to the original data
-  // type and there is a small possibility of rounding errors.
-  if constexpr (std::is_floating_point<ComponentType>::value)
+  // Get the image min and max, from the histogram and from the time points
+  // that were not added to it. These are kept as doubles, which represent
+  // all the component types exactly, except for 64-bit integers.
+  double imin = m_SkippedMinimum, imax = m_SkippedMaximum;
+  if(!hist.IsEmpty())
     {
-    m_ImageMinDataObject->Set(m_TDigestDataObject->GetImageMinimum());
-    m_ImageMaxDataObject->Set(m_TDigestDataObject->GetImageMaximum());
+    imin = std::min(imin, hist.GetMinimum());
+    imax = std::max(imax, hist.GetMaximum());
     }
-  else
-    {
-    m_ImageMinDataObject->Set((ComponentType) std::floor(m_TDigestDataObject->GetImageMinimum()));
-    m_ImageMaxDataObject->Set((ComponentType) std::ceil(m_TDigestDataObject->GetImageMaximum()));
-  }
+  if(imin > imax)
+    imin = imax = 0.0;
+
+  m_ImageMinDataObject->Set((ComponentType) imin);
+  m_ImageMaxDataObject->Set((ComponentType) imax);
+  m_TDigestDataObject->m_ImageMinimum = (float) imin;
+  m_TDigestDataObject->m_ImageMaximum = (float) imax;
 
   /*
   printf("TDigest: range: %f to %f, Percentiles: 1: %f, 5: %f, 50: %f, 95: %f, 99: %f\n",
@@ -0,0 +1,161 @@
+#include "TimePointPager.h"
+#include "MemoryMappedFile.h"
+
+#include <algorithm>
+
+// Stride at which the prefetch thread touches the memory. No smaller than
+// the page size on any of the supported systems.
+static const size_t PREFETCH_STRIDE = 4096;
+
+TimePointPager::TimePointPager()
+{
+  m_Window = 2;
+  m_MaximumRecentTimePoints = 4;
+  m_Buffer = nullptr;
+  m_BytesPerTimePoint = 0;
+  m_NumberOfTimePoints = 0;
+  m_CurrentTimePoint = 0;
+  m_Direction = 1;
+  m_Busy = false;
+  m_Stop = false;
+  m_Cancel = false;
+}
+
+TimePointPager::~TimePointPager()
+{
+  {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  m_Stop = true;
+  m_Cancel = true;
+  }
+  m_Condition.notify_all();
+  if(m_Thread.joinable())
+    m_Thread.join();
+}
+
+void TimePointPager::SetBuffer(void *buffer, size_t bytesPerTimePoint, unsigned int nt)
+{
+  // Stop reading from the old buffer
+  this->Prefetch(std::vector<unsigned int>());
+
+  m_Buffer = static_cast<char *>(buffer);
+  m_BytesPerTimePoint = bytesPerTimePoint;
+  m_NumberOfTimePoints = nt;
+  m_CurrentTimePoint = 0;
+  m_Direction = 1;
+  m_RecentTimePoints.clear();
+
+  // Nothing is known about what has been accessed so far
+  m_Loaded.assign(nt, true);
+}
+
+void TimePointPager::SetCurrentTimePoint(unsigned int tp)
+{
+  if(!m_Buffer || tp >= m_NumberOfTimePoints)
+    return;
+
+  if(tp != m_CurrentTimePoint)
+    m_Direction = (tp > m_CurrentTimePoint) ? 1 : -1;
+  m_CurrentTimePoint = tp;
+
+  m_RecentTimePoints.remove(tp);
+  m_RecentTimePoints.push_front(tp);
+  while(m_RecentTimePoints.size() > m_MaximumRecentTimePoints + 1)
+    m_RecentTimePoints.pop_back();
+
+  // The window, ahead of the current time point first
+  std::vector<unsigned int> window;
+  for(int side : { m_Direction, -m_Direction })
+    {
+    for(unsigned int k = 1; k <= m_Window; k++)
+      {
+      long t = (long) tp + side * (long) k;
+      if(t >= 0 && t < (long) m_NumberOfTimePoints)
+        window.push_back((unsigned int) t);
+      }
+    }
+
+  this->Prefetch(window);
+
+  m_Loaded[tp] = true;
+  for(unsigned int t : window)
+    m_Loaded[t] = true;
+  this->Trim();
+}
+
+void TimePointPager::ReleaseInactiveTimePoints()
+{
+  if(!m_Buffer)
+    return;
+
+  m_Loaded.assign(m_NumberOfTimePoints, true);
+  m_RecentTimePoints.clear();
+  m_RecentTimePoints.push_back(m_CurrentTimePoint);
+  this->Trim();
+}
+
+void TimePointPager::Trim()
+{
+  for(unsigned int t = 0; t < m_NumberOfTimePoints; t++)
+    {
+    if(!m_Loaded[t])
+      continue;
+
+    unsigned int dist = (t > m_CurrentTimePoint) ? t - m_CurrentTimePoint : m_CurrentTimePoint - t;
+    if(dist <= m_Window
+       || std::find(m_RecentTimePoints.begin(), m_RecentTimePoints.end(), t) != m_RecentTimePoints.end())
+      continue;
+
+    MemoryMappedFile::ReleasePages(m_Buffer + t * m_BytesPerTimePoint, m_BytesPerTimePoint);
+    m_Loaded[t] = false;
+    }
+}
+
+void TimePointPager::Prefetch(const std::vector<unsigned int> &tps)
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+
+  // Abandon the time point being read, and wait for the thread to let go
+  m_Queue.clear();
+  m_Cancel = true;
+  m_Condition.wait(lock, [this]() { return !m_Busy; });
+  m_Cancel = false;
+
+  if(tps.empty())
+    return;
+
+  m_Queue.assign(tps.begin(), tps.end());
+  if(!m_Thread.joinable())
+    m_Thread = std::thread(&TimePointPager::PrefetchThread, this);
+
+  lock.unlock();
+  m_Condition.notify_all();
+}
+
+void TimePointPager::PrefetchThread()
+{
+  std::unique_lock<std::mutex> lock(m_Mutex);
+  while(true)
+    {
+    m_Condition.wait(lock, [this]() { return m_Stop || !m_Queue.empty(); });
+    if(m_Stop)
+      return;
+
+    unsigned int tp = m_Queue.front();
+    m_Queue.pop_front();
+    m_Busy = true;
+    const volatile char *p = m_Buffer + tp * m_BytesPerTimePoint;
+    size_t n = m_BytesPerTimePoint;
+    lock.unlock();
+
+    // Reading a byte from each page brings the page into memory
+    char sum = 0;
+    for(size_t off = 0; off < n && !m_Cancel; off += PREFETCH_STRIDE)
+      sum += p[off];
+    (void) sum;
+
+    lock.lock();
+    m_Busy = false;
+    m_Condition.notify_all();
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef TIMEPOINTPAGER_H
+#define TIMEPOINTPAGER_H
+
+#include "SNAPCommon.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \class TimePointPager
+ * \brief Keeps only the recently used time points of a file-backed 4D image
+ * in memory.
+ *
+ * When a 4D image is mapped from its file (see MemoryMappedFile), its time
+ * points are only read from disk as they are accessed. This class decides
+ * which of them stay in memory: the current time point, the time points
+ * within a window around it, and the most recently used others. The rest
+ * are released when they fall out of that set, and are read again if they
+ * are accessed later. Releasing keeps the contents of the memory, including
+ * any changes made to it.
+ *
+ * When the current time point changes, the time points ahead of it in the
+ * direction of travel are read by a background thread, so that stepping
+ * through the time points does not wait for the disk.
+ */
+class TimePointPager : public itk::Object
+{
+public:
+  irisITKObjectMacro(TimePointPager, itk::Object)
+
+  /**
+   * Set the buffer holding the time points one after another. The buffer
+   * must remain valid until it is replaced or the pager is destroyed.
+   */
+  void SetBuffer(void *buffer, size_t bytesPerTimePoint, unsigned int nt);
+
+  /** Number of time points on either side of the current one kept in memory */
+  irisGetSetMacro(Window, unsigned int)
+
+  /** Number of recently used time points kept in memory outside the window */
+  irisGetSetMacro(MaximumRecentTimePoints, unsigned int)
+
+  /** Called when the current time point changes */
+  void SetCurrentTimePoint(unsigned int tp);
+
+  /**
+   * Release all time points outside the window. Call after an operation
+   * that visited many time points, such as computing image statistics.
+   */
+  void ReleaseInactiveTimePoints();
+
+protected:
+  TimePointPager();
+  virtual ~TimePointPager();
+
+  // Release time points that are not wanted
+  void Trim();
+
+  // Replace the prefetch queue, waiting for a time point in progress
+  void Prefetch(const std::vector<unsigned int> &tps);
+
+  void PrefetchThread();
+
+  unsigned int m_Window, m_MaximumRecentTimePoints;
+
+  char *m_Buffer;
+  size_t m_BytesPerTimePoint;
+  unsigned int m_NumberOfTimePoints;
+  unsigned int m_CurrentTimePoint;
+  int m_Direction;
+
+  // Most recently used first
+  std::list<unsigned int> m_RecentTimePoints;
+
+  // Time points that may be in memory
+  std::vector<bool> m_Loaded;
+
+  // Prefetching thread and its queue
+  std::thread m_Thread;
+  std::mutex m_Mutex;
+  std::condition_variable m_Condition;
+  std::deque<unsigned int> m_Queue;
+  bool m_Busy, m_Stop;
+  std::atomic<bool> m_Cancel;
+};
+
+#endif // TIMEPOINTPAGER_H
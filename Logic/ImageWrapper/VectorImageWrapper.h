@@ -144,11 +144,14 @@ public:
 
   /** Compute statistics over a run of voxels in the image starting at the index
    * startIdx. Appends the statistics to a running sum and sum of squared. The
-   * statistics are returned in internal (not native mapped) format */
+   * statistics are returned in internal (not native mapped) format. By
+   * default the image of the current time point is used; image selects
+   * another time point of this wrapper (see GetImageBaseByTimePoint) */
   virtual void GetRunLengthIntensityStatistics(
       const itk::ImageRegion<3> &region,
       const itk::Index<3> &startIdx, long runlength,
-      double *out_nvalid, double *out_sum, double *out_sumsq) const ITK_OVERRIDE;
+      double *out_nvalid, double *out_sum, double *out_sumsq,
+      const itk::ImageBase<3> *image) const ITK_OVERRIDE;
 
   /**
    * This method returns a vector of values for the voxel under the cursor.
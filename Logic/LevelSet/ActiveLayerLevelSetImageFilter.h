@@ -0,0 +1,93 @@
+#ifndef ACTIVELAYERLEVELSETIMAGEFILTER_H
+#define ACTIVELAYERLEVELSETIMAGEFILTER_H
+
+#include "itkSparseFieldLevelSetImageFilter.h"
+#include <vector>
+
+/**
+ * A sparse field level set solver whose work follows the active layer.
+ *
+ * The ParallelSparseFieldLevelSetImageFilter assigns each thread a slab of
+ * the image along the last axis. When the level set starts from a few small
+ * bubbles, most slabs contain no part of the front, and most threads have
+ * nothing to do. This filter instead computes the updates for the active
+ * layer in small chunks of nodes, which the threads take from a shared
+ * counter as they finish the previous chunk, so that all threads stay busy
+ * however the front is distributed in the image.
+ *
+ * The layers are maintained as in the SparseFieldLevelSetImageFilter. The
+ * output does not depend on the number of threads (the LevelSetSolvers test
+ * checks this). It is not compared with the output of the serial filter,
+ * and it agrees with that of the ParallelSparseFieldLevelSetImageFilter
+ * closely but not exactly, since that filter updates the front in a
+ * different order. All of the work done per iteration is proportional to
+ * the size of the sparse field, rather than to the size of the image. This
+ * includes the update of the background pixels at the end of each run,
+ * which only visits the part of the image swept by the front since the
+ * previous run.
+ *
+ * The difference function must be an itk::LevelSetFunction, because the
+ * per-thread global data are combined to compute the time step.
+ */
+template <class TInputImage, class TOutputImage>
+class ActiveLayerLevelSetImageFilter
+    : public itk::SparseFieldLevelSetImageFilter<TInputImage, TOutputImage>
+{
+public:
+
+  typedef ActiveLayerLevelSetImageFilter                                   Self;
+  typedef itk::SparseFieldLevelSetImageFilter<TInputImage, TOutputImage> Superclass;
+  typedef itk::SmartPointer<Self>                                       Pointer;
+  typedef itk::SmartPointer<const Self>                            ConstPointer;
+
+  typedef typename Superclass::OutputImageType                  OutputImageType;
+  typedef typename Superclass::IndexType                              IndexType;
+  typedef typename Superclass::ValueType                              ValueType;
+  typedef typename Superclass::TimeStepType                        TimeStepType;
+  typedef typename OutputImageType::RegionType                       RegionType;
+  typedef itk::LevelSetFunction<OutputImageType>          LevelSetFunctionType;
+
+  itkStaticConstMacro(ImageDimension, unsigned int, Superclass::ImageDimension);
+
+  itkTypeMacro(ActiveLayerLevelSetImageFilter, SparseFieldLevelSetImageFilter)
+  itkNewMacro(Self)
+
+  /** Set the number of active layer nodes handed to a thread at a time */
+  itkSetMacro(ChunkSize, unsigned int)
+  itkGetMacro(ChunkSize, unsigned int)
+
+protected:
+
+  ActiveLayerLevelSetImageFilter();
+  virtual ~ActiveLayerLevelSetImageFilter() {}
+
+  virtual void Initialize() ITK_OVERRIDE;
+
+  virtual TimeStepType CalculateChange() ITK_OVERRIDE;
+
+  virtual void PostProcessOutput() ITK_OVERRIDE;
+
+  // Compute the update for one active layer node, as the superclass does
+  ValueType ComputeNodeUpdate(itk::NeighborhoodIterator<OutputImageType> &it,
+                              void *globalData, ValueType minNorm);
+
+  // Add the part of the image within reach of the active layer to the swept
+  // region
+  void AddToSweptRegion(const IndexType &lower, const IndexType &upper);
+
+  unsigned int m_ChunkSize;
+
+  // Indices of the active layer nodes in the current iteration
+  std::vector<IndexType> m_ActiveIndices;
+
+  // Bounding box of the part of the image swept by the sparse field since
+  // the last call to PostProcessOutput()
+  IndexType m_SweptLower, m_SweptUpper;
+  bool m_SweptEmpty;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "ActiveLayerLevelSetImageFilter.txx"
+#endif
+
+#endif // ACTIVELAYERLEVELSETIMAGEFILTER_H
@@ -0,0 +1,215 @@
+#ifndef ACTIVELAYERLEVELSETIMAGEFILTER_TXX
+#define ACTIVELAYERLEVELSETIMAGEFILTER_TXX
+
+#include "ActiveLayerLevelSetImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkMultiThreaderBase.h"
+#include <algorithm>
+#include <atomic>
+
+template <class TInputImage, class TOutputImage>
+ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>
+::ActiveLayerLevelSetImageFilter()
+{
+  m_ChunkSize = 256;
+  m_SweptEmpty = true;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>
+::Initialize()
+{
+  if(!dynamic_cast<LevelSetFunctionType *>(this->GetDifferenceFunction().GetPointer()))
+    itkExceptionMacro(<< "The difference function must be a LevelSetFunction");
+
+  // The superclass sets all of the background pixels
+  Superclass::Initialize();
+  m_SweptEmpty = true;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>
+::AddToSweptRegion(const IndexType &lower, const IndexType &upper)
+{
+  // Nodes leave the sparse field from its outermost layer, which is within
+  // this many voxels of the active layer after the update
+  itk::IndexValueType reach = this->GetNumberOfLayers() + 1;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    {
+    m_SweptLower[d] = m_SweptEmpty ? lower[d] - reach : std::min(m_SweptLower[d], lower[d] - reach);
+    m_SweptUpper[d] = m_SweptEmpty ? upper[d] + reach : std::max(m_SweptUpper[d], upper[d] + reach);
+    }
+  m_SweptEmpty = false;
+}
+
+template <class TInputImage, class TOutputImage>
+typename ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>::ValueType
+ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>
+::ComputeNodeUpdate(itk::NeighborhoodIterator<OutputImageType> &it,
+                    void *globalData, ValueType minNorm)
+{
+  typename Superclass::FiniteDifferenceFunctionType *df = this->GetDifferenceFunction();
+
+  // Without interpolation, the update is computed at the voxel center
+  ValueType centerValue = it.GetCenterPixel();
+  if(!this->GetInterpolateSurfaceLocation() || centerValue == 0)
+    return df->ComputeUpdate(it, globalData);
+
+  // Otherwise, it is computed at the zero crossing, at the offset
+  // -phi(x) * grad(phi(x)) / norm(grad(phi))^2 from the center
+  typename Superclass::FiniteDifferenceFunctionType::FloatOffsetType offset;
+  ValueType norm_grad_phi_squared = 0.0;
+  for(unsigned int i = 0; i < ImageDimension; i++)
+    {
+    ValueType forwardValue = it.GetNext(i);
+    ValueType backwardValue = it.GetPrevious(i);
+
+    if(forwardValue * backwardValue >= 0)
+      {
+      // Neighbors are same sign OR at least one neighbor is zero. Pick the
+      // larger magnitude derivative
+      ValueType dx_forward = forwardValue - centerValue;
+      ValueType dx_backward = centerValue - backwardValue;
+      offset[i] = std::abs(dx_forward) > std::abs(dx_backward) ? dx_forward : dx_backward;
+      }
+    else
+      {
+      // Neighbors are opposite sign, pick the direction of the 0 surface
+      offset[i] = (forwardValue * centerValue < 0)
+          ? forwardValue - centerValue : centerValue - backwardValue;
+      }
+
+    norm_grad_phi_squared += offset[i] * offset[i];
+    }
+
+  for(unsigned int i = 0; i < ImageDimension; i++)
+    offset[i] = (offset[i] * centerValue) / (norm_grad_phi_squared + minNorm);
+
+  return df->ComputeUpdate(it, globalData, offset);
+}
+
+template <class TInputImage, class TOutputImage>
+typename ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>::TimeStepType
+ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>
+::CalculateChange()
+{
+  typename Superclass::FiniteDifferenceFunctionType *df = this->GetDifferenceFunction();
+  OutputImageType *output = this->GetOutput();
+
+  ValueType minNorm = 1.0e-6;
+  if(this->GetUseImageSpacing())
+    {
+    double minSpacing = output->GetSpacing()[0];
+    for(unsigned int d = 1; d < ImageDimension; d++)
+      minSpacing = std::min(minSpacing, output->GetSpacing()[d]);
+    minNorm *= minSpacing;
+    }
+
+  // List the active layer, so that it can be handed out in chunks, and
+  // record the part of the image reached by the sparse field
+  m_ActiveIndices.clear();
+  m_ActiveIndices.reserve(this->m_Layers[0]->Size());
+  IndexType lower, upper;
+  for(typename Superclass::LayerType::ConstIterator it = this->m_Layers[0]->Begin();
+      it != this->m_Layers[0]->End(); ++it)
+    {
+    const IndexType &idx = it->m_Value;
+    for(unsigned int d = 0; d < ImageDimension; d++)
+      {
+      lower[d] = m_ActiveIndices.empty() ? idx[d] : std::min(lower[d], idx[d]);
+      upper[d] = m_ActiveIndices.empty() ? idx[d] : std::max(upper[d], idx[d]);
+      }
+    m_ActiveIndices.push_back(idx);
+    }
+
+  size_t n = m_ActiveIndices.size();
+  if(n)
+    this->AddToSweptRegion(lower, upper);
+
+  // The updates are stored in the order of the active layer, which is the
+  // order in which the superclass applies them
+  this->m_UpdateBuffer.resize(n);
+
+  // Each thread has its own global data, which holds the largest changes
+  // seen by the thread as well as scratch space for the function
+  size_t nChunks = (n + m_ChunkSize - 1) / m_ChunkSize;
+  size_t nThreads = std::max((size_t) 1, std::min((size_t) this->GetNumberOfWorkUnits(), nChunks));
+  std::vector<void *> globalData(nThreads);
+  for(size_t t = 0; t < nThreads; t++)
+    globalData[t] = df->GetGlobalDataPointer();
+
+  std::atomic<size_t> next(0);
+  this->GetMultiThreader()->ParallelizeArray(0, nThreads, [&](itk::SizeValueType t)
+    {
+    itk::NeighborhoodIterator<OutputImageType> it(
+          df->GetRadius(), output, output->GetRequestedRegion());
+
+    for(size_t c = next++; c < nChunks; c = next++)
+      {
+      size_t k1 = std::min(n, (c + 1) * m_ChunkSize);
+      for(size_t k = c * m_ChunkSize; k < k1; k++)
+        {
+        it.SetLocation(m_ActiveIndices[k]);
+        this->m_UpdateBuffer[k] = this->ComputeNodeUpdate(it, globalData[t], minNorm);
+        }
+      }
+    }, nullptr);
+
+  // The time step depends on the largest changes over all nodes
+  typedef typename LevelSetFunctionType::GlobalDataStruct GlobalDataStruct;
+  GlobalDataStruct *gd = static_cast<GlobalDataStruct *>(globalData[0]);
+  for(size_t t = 1; t < nThreads; t++)
+    {
+    GlobalDataStruct *gt = static_cast<GlobalDataStruct *>(globalData[t]);
+    gd->m_MaxAdvectionChange = std::max(gd->m_MaxAdvectionChange, gt->m_MaxAdvectionChange);
+    gd->m_MaxPropagationChange = std::max(gd->m_MaxPropagationChange, gt->m_MaxPropagationChange);
+    gd->m_MaxCurvatureChange = std::max(gd->m_MaxCurvatureChange, gt->m_MaxCurvatureChange);
+    df->ReleaseGlobalDataPointer(gt);
+    }
+
+  TimeStepType timeStep = df->ComputeGlobalTimeStep(gd);
+  df->ReleaseGlobalDataPointer(gd);
+
+  return timeStep;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+ActiveLayerLevelSetImageFilter<TInputImage, TOutputImage>
+::PostProcessOutput()
+{
+  // Pixels that left the sparse field keep the value they had in the
+  // outermost layer. As in the superclass, they are assigned values beyond
+  // the outermost layer, but only in the part of the image swept by the
+  // sparse field, since background pixels elsewhere are already assigned.
+  if(m_SweptEmpty)
+    return;
+
+  OutputImageType *output = this->GetOutput();
+  RegionType region;
+  region.SetIndex(m_SweptLower);
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    region.SetSize(d, m_SweptUpper[d] - m_SweptLower[d] + 1);
+  m_SweptEmpty = true;
+
+  if(!region.Crop(output->GetRequestedRegion()))
+    return;
+
+  ValueType max_layer = static_cast<ValueType>(this->GetNumberOfLayers());
+  ValueType outside_value = (max_layer + 1) * this->m_ConstantGradientValue;
+  ValueType inside_value = -(max_layer + 1) * this->m_ConstantGradientValue;
+
+  itk::ImageRegionConstIterator<typename Superclass::StatusImageType> itStatus(
+        this->m_StatusImage, region);
+  itk::ImageRegionIterator<OutputImageType> itOut(output, region);
+  for(; !itOut.IsAtEnd(); ++itOut, ++itStatus)
+    {
+    if(itStatus.Get() == this->m_StatusNull || itStatus.Get() == this->m_StatusBoundaryPixel)
+      itOut.Set(itOut.Get() > this->m_ValueZero ? outside_value : inside_value);
+    }
+}
+
+#endif // ACTIVELAYERLEVELSETIMAGEFILTER_TXX
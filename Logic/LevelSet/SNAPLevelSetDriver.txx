@@ -52,6 +52,7 @@
 #include "itkImageDuplicator.h"
 
 #include "itkParallelSparseFieldLevelSetImageFilter.h"
+#include "ActiveLayerLevelSetImageFilter.h"
 
 // Disable some windows debug length messages
 #if defined(_MSC_VER)
@@ -201,6 +202,26 @@ SNAPLevelSetDriver<VDimension>
     // a filter
     m_LevelSetFilter = filter.GetPointer();
 
+    // Perform the special configuration tasks on the filter
+    filter->SetInput(m_InitializationCopyImage);
+    filter->SetNumberOfLayers(3);
+    filter->SetIsoSurfaceValue(0.0f);
+    filter->SetDifferenceFunction(m_LevelSetFunction);
+    }
+  else if(m_Parameters.GetSolver() == SnakeParameters::SPARSE_FIELD_SOLVER)
+    {
+    // Sparse field solver that divides the active layer between threads,
+    // so that the work per iteration scales with the size of the front
+    typedef ActiveLayerLevelSetImageFilter<
+        FloatImageType, FloatImageType> LevelSetFilterType;
+
+    typedef typename LevelSetFilterType::Pointer LevelSetFilterPointer;
+    LevelSetFilterPointer filter = LevelSetFilterType::New();
+
+    // Cast this specific filter down to the lowest common denominator that is
+    // a filter
+    m_LevelSetFilter = filter.GetPointer();
+
     // Perform the special configuration tasks on the filter
     filter->SetInput(m_InitializationCopyImage);
     filter->SetNumberOfLayers(3);
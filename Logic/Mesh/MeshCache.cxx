@@ -0,0 +1,349 @@
+#include "MeshCache.h"
+#include "MeshOptions.h"
+#include "Registry.h"
+#include "itksys/Directory.hxx"
+#include "itksys/MD5.h"
+#include "itksys/SystemTools.hxx"
+#include "itk_zlib.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+using itksys::SystemTools;
+
+// Identifies the format of the entries. Increment when the format changes,
+// or when the meshing code changes in a way that affects the output
+static const char MESH_CACHE_MAGIC[8] = { 'S', 'N', 'A', 'P', 'M', 'S', 'H', '1' };
+
+static const char *MESH_CACHE_EXTENSION = ".mesh";
+
+namespace
+{
+// Little helpers for packing and unpacking the payload
+template <class T>
+void pack(std::vector<unsigned char> &buf, const T &value)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(&value);
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+template <class T>
+bool unpack(const std::vector<unsigned char> &buf, size_t &pos, T &value)
+{
+  if(pos + sizeof(T) > buf.size())
+    return false;
+  memcpy(&value, &buf[pos], sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+void packCells(std::vector<unsigned char> &buf, vtkCellArray *cells)
+{
+  unsigned int nCells = cells ? (unsigned int) cells->GetNumberOfCells() : 0;
+  pack(buf, nCells);
+  if(!nCells)
+    return;
+
+  vtkIdType npts;
+  const vtkIdType *pts;
+  cells->InitTraversal();
+  while(cells->GetNextCell(npts, pts))
+    {
+    pack(buf, (unsigned int) npts);
+    for(vtkIdType i = 0; i < npts; i++)
+      pack(buf, (unsigned int) pts[i]);
+    }
+}
+
+bool unpackCells(const std::vector<unsigned char> &buf, size_t &pos,
+                 vtkIdType nPoints, vtkCellArray *cells)
+{
+  unsigned int nCells;
+  if(!unpack(buf, pos, nCells))
+    return false;
+
+  std::vector<vtkIdType> ids;
+  for(unsigned int c = 0; c < nCells; c++)
+    {
+    unsigned int npts, id;
+    if(!unpack(buf, pos, npts) || pos + 4 * (size_t) npts > buf.size())
+      return false;
+    ids.resize(npts);
+    for(unsigned int i = 0; i < npts; i++)
+      {
+      unpack(buf, pos, id);
+      if(id >= (unsigned int) nPoints)
+        return false;
+      ids[i] = id;
+      }
+    cells->InsertNextCell(npts, ids.data());
+    }
+  return true;
+}
+}
+
+MeshCache::MeshCache()
+{
+  m_MaximumSize = 512ull * 1024 * 1024;
+}
+
+void MeshCache::SetDirectory(const std::string &dir)
+{
+  m_Directory = dir;
+  if(m_Directory.size() && !SystemTools::MakeDirectory(m_Directory))
+    m_Directory.clear();
+}
+
+std::string MeshCache::ComputeKey(const std::string &description)
+{
+  char hex_code[33];
+  hex_code[32] = 0;
+  itksysMD5 *md5 = itksysMD5_New();
+  itksysMD5_Initialize(md5);
+  itksysMD5_Append(md5, (unsigned char *) MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+  itksysMD5_Append(md5, (unsigned char *) description.c_str(), description.size());
+  itksysMD5_FinalizeHex(md5, hex_code);
+  itksysMD5_Delete(md5);
+  return std::string(hex_code);
+}
+
+std::string MeshCache::GetSourceId(const std::string &filename)
+{
+  if(filename.empty())
+    return std::string();
+
+  std::ostringstream oss;
+  oss << SystemTools::CollapseFullPath(filename) << "\n"
+      << SystemTools::FileLength(filename) << " "
+      << SystemTools::ModifiedTime(filename);
+  return oss.str();
+}
+
+std::string MeshCache::GetOptionsDescription(const MeshOptions *options)
+{
+  Registry reg;
+  options->WriteToRegistry(reg);
+  std::ostringstream oss;
+  reg.Print(oss);
+  return oss.str();
+}
+
+std::string MeshCache::GetEntryFileName(const std::string &key) const
+{
+  return m_Directory + "/" + key + MESH_CACHE_EXTENSION;
+}
+
+bool MeshCache::Load(const std::string &key, vtkPolyData *mesh)
+{
+  if(!IsEnabled())
+    return false;
+
+  std::string fn = GetEntryFileName(key);
+  FILE *f = fopen(fn.c_str(), "rb");
+  if(!f)
+    return false;
+
+  // Header: magic, unpacked size, packed size
+  char magic[sizeof(MESH_CACHE_MAGIC)];
+  unsigned long long usize = 0, psize = 0;
+  bool ok = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+            && !memcmp(magic, MESH_CACHE_MAGIC, sizeof(magic))
+            && fread(&usize, sizeof(usize), 1, f) == 1
+            && fread(&psize, sizeof(psize), 1, f) == 1
+            && psize == (unsigned long long) SystemTools::FileLength(fn) - 24;
+
+  std::vector<unsigned char> packed, buf;
+  if(ok)
+    {
+    packed.resize(psize);
+    ok = psize > 0 && fread(&packed[0], 1, psize, f) == psize;
+    }
+  fclose(f);
+
+  // Deflate cannot compress by more than about 1000:1
+  ok = ok && usize / 1024 <= psize;
+  if(ok)
+    {
+    buf.resize(usize);
+    uLongf len = (uLongf) usize;
+    ok = usize > 0 && uncompress(&buf[0], &len, &packed[0], psize) == Z_OK && len == usize;
+    }
+
+  // Points and normals
+  size_t pos = 0;
+  unsigned int nPoints = 0;
+  unsigned char hasNormals = 0;
+  vtkSmartPointer<vtkFloatArray> xyz = vtkSmartPointer<vtkFloatArray>::New();
+  vtkSmartPointer<vtkFloatArray> nrm;
+  ok = ok && unpack(buf, pos, nPoints) && unpack(buf, pos, hasNormals);
+  if(ok)
+    {
+    size_t nbytes = 3 * sizeof(float) * (size_t) nPoints;
+    ok = pos + (hasNormals ? 2 : 1) * nbytes <= buf.size();
+    if(ok)
+      {
+      xyz->SetNumberOfComponents(3);
+      xyz->SetNumberOfTuples(nPoints);
+      memcpy(xyz->GetPointer(0), &buf[pos], nbytes);
+      pos += nbytes;
+      if(hasNormals)
+        {
+        nrm = vtkSmartPointer<vtkFloatArray>::New();
+        nrm->SetName("Normals");
+        nrm->SetNumberOfComponents(3);
+        nrm->SetNumberOfTuples(nPoints);
+        memcpy(nrm->GetPointer(0), &buf[pos], nbytes);
+        pos += nbytes;
+        }
+      }
+    }
+
+  // Cells
+  vtkSmartPointer<vtkCellArray> cells[4];
+  for(int i = 0; i < 4; i++)
+    {
+    cells[i] = vtkSmartPointer<vtkCellArray>::New();
+    ok = ok && unpackCells(buf, pos, nPoints, cells[i]);
+    }
+
+  if(!ok || pos != buf.size())
+    {
+    // Corrupt or stale entry
+    SystemTools::RemoveFile(fn);
+    return false;
+    }
+
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  points->SetData(xyz);
+
+  mesh->Initialize();
+  mesh->SetPoints(points);
+  mesh->SetVerts(cells[0]);
+  mesh->SetLines(cells[1]);
+  mesh->SetPolys(cells[2]);
+  mesh->SetStrips(cells[3]);
+  if(nrm)
+    mesh->GetPointData()->SetNormals(nrm);
+
+  // Mark the entry as recently used
+  SystemTools::Touch(fn, false);
+  return true;
+}
+
+bool MeshCache::Store(const std::string &key, vtkPolyData *mesh)
+{
+  if(!IsEnabled() || !mesh)
+    return false;
+
+  // The key describes the mesh, so an existing entry is the same mesh
+  std::string fn = GetEntryFileName(key);
+  if(SystemTools::FileExists(fn))
+    {
+    SystemTools::Touch(fn, false);
+    return false;
+    }
+
+  // Points and normals as 32-bit floats
+  std::vector<unsigned char> buf;
+  unsigned int nPoints = (unsigned int) mesh->GetNumberOfPoints();
+  vtkDataArray *normals = mesh->GetPointData()->GetNormals();
+  unsigned char hasNormals = (normals && normals->GetNumberOfComponents() == 3
+                              && normals->GetNumberOfTuples() == nPoints) ? 1 : 0;
+  pack(buf, nPoints);
+  pack(buf, hasNormals);
+  for(unsigned int i = 0; i < nPoints; i++)
+    {
+    double *p = mesh->GetPoint(i);
+    for(int d = 0; d < 3; d++)
+      pack(buf, (float) p[d]);
+    }
+  if(hasNormals)
+    {
+    for(unsigned int i = 0; i < nPoints; i++)
+      {
+      double *n = normals->GetTuple3(i);
+      for(int d = 0; d < 3; d++)
+        pack(buf, (float) n[d]);
+      }
+    }
+
+  packCells(buf, mesh->GetVerts());
+  packCells(buf, mesh->GetLines());
+  packCells(buf, mesh->GetPolys());
+  packCells(buf, mesh->GetStrips());
+
+  uLongf psize = compressBound(buf.size());
+  std::vector<unsigned char> packed(psize);
+  if(compress2(&packed[0], &psize, &buf[0], buf.size(), 1) != Z_OK)
+    return false;
+
+  // Write to a temporary file first, so that a reader (possibly another
+  // instance of SNAP) never sees a partial entry
+  std::string tmp = fn + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if(!f)
+    return false;
+
+  unsigned long long usize = buf.size(), psize64 = psize;
+  bool ok = fwrite(MESH_CACHE_MAGIC, 1, sizeof(MESH_CACHE_MAGIC), f) == sizeof(MESH_CACHE_MAGIC)
+            && fwrite(&usize, sizeof(usize), 1, f) == 1
+            && fwrite(&psize64, sizeof(psize64), 1, f) == 1
+            && fwrite(&packed[0], 1, psize, f) == psize;
+  ok = (fclose(f) == 0) && ok;
+
+  if(!ok || !SystemTools::RenameFile(tmp, fn))
+    {
+    SystemTools::RemoveFile(tmp);
+    return false;
+    }
+  return true;
+}
+
+void MeshCache::Trim()
+{
+  if(!IsEnabled())
+    return;
+
+  itksys::Directory dir;
+  if(!dir.Load(m_Directory))
+    return;
+
+  // List the entries with their last use time
+  struct Entry { long time; unsigned long long size; std::string fn; };
+  std::vector<Entry> entries;
+  unsigned long long total = 0;
+  for(unsigned long i = 0; i < dir.GetNumberOfFiles(); i++)
+    {
+    std::string name = dir.GetFile(i);
+    if(SystemTools::GetFilenameLastExtension(name) != MESH_CACHE_EXTENSION)
+      continue;
+    Entry e;
+    e.fn = m_Directory + "/" + name;
+    e.time = SystemTools::ModifiedTime(e.fn);
+    e.size = SystemTools::FileLength(e.fn);
+    total += e.size;
+    entries.push_back(e);
+    }
+
+  if(total <= m_MaximumSize)
+    return;
+
+  // Remove the least recently used entries first
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.time < b.time; });
+  for(size_t i = 0; i < entries.size() && total > m_MaximumSize; i++)
+    {
+    if(SystemTools::RemoveFile(entries[i].fn))
+      total -= entries[i].size;
+    }
+}
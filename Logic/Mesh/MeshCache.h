@@ -0,0 +1,78 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "SNAPCommon.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include <string>
+
+class vtkPolyData;
+class MeshOptions;
+
+/**
+ * \class MeshCache
+ * \brief A persistent cache of computed meshes in a local directory.
+ *
+ * Each entry is a mesh stored under a key, which should identify everything
+ * the mesh depends on (e.g., the segmentation, the label and its checksum,
+ * and the mesh options). Use ComputeKey() to hash such a description into
+ * a key. Meshes are stored in a compact binary format: the points, normals
+ * and cells are packed with 32-bit floats and indices and then deflated.
+ *
+ * When the total size of the entries exceeds the maximum size, the least
+ * recently used entries are removed. The cache is disabled while its
+ * directory is empty, and I/O errors are treated as cache misses.
+ */
+class MeshCache : public itk::Object
+{
+public:
+  irisITKObjectMacro(MeshCache, itk::Object)
+
+  /** Set the directory where the entries are kept. It is created if needed */
+  void SetDirectory(const std::string &dir);
+  const std::string &GetDirectory() const { return m_Directory; }
+
+  /** Maximum total size of the entries, in bytes (default 512 MB) */
+  irisSetMacro(MaximumSize, unsigned long long)
+  irisGetMacro(MaximumSize, unsigned long long)
+
+  /** Is the cache enabled? */
+  bool IsEnabled() const { return m_Directory.size() > 0; }
+
+  /** Hash a description of a mesh into a key */
+  static std::string ComputeKey(const std::string &description);
+
+  /** A string identifying the file a segmentation was loaded from, for use
+   * in keys: its full path, size and modification time, so that entries
+   * computed from an older version of the file (or from another file that
+   * was saved under the same name) are not reused. Empty if there is no
+   * file name */
+  static std::string GetSourceId(const std::string &filename);
+
+  /** A string describing the mesh options, for use in keys */
+  static std::string GetOptionsDescription(const MeshOptions *options);
+
+  /** Load the entry with the given key into a mesh. Returns false if there
+   * is no valid entry for the key */
+  bool Load(const std::string &key, vtkPolyData *mesh);
+
+  /** Store a mesh under the given key. An existing entry for the key is
+   * only marked as recently used. Returns true if a new entry was written */
+  bool Store(const std::string &key, vtkPolyData *mesh);
+
+  /** Remove the least recently used entries until the total size of the
+   * entries is within the maximum size. This lists the directory, so it
+   * should be called once after storing new entries */
+  void Trim();
+
+protected:
+  MeshCache();
+  virtual ~MeshCache() {}
+
+  std::string GetEntryFileName(const std::string &key) const;
+
+  std::string m_Directory;
+  unsigned long long m_MaximumSize;
+};
+
+#endif // MESHCACHE_H
@@ -52,6 +52,8 @@
 #include "SNAPImageData.h"
 #include "AllPurposeProgressAccumulator.h"
 #include "MeshOptions.h"
+#include "MeshCache.h"
+#include "SystemInterface.h"
 
 // ITK includes
 #include "itkRegionOfInterestImageFilter.h"
@@ -97,6 +99,18 @@ MeshManager
 {
   m_Driver = driver;
   m_GlobalState = m_Driver->GetGlobalState();  
+
+  // Keep the meshes of segmentation labels in the user's data directory, so
+  // that they do not have to be recomputed when the segmentation is reopened
+  m_MeshCache = MeshCache::New();
+  try
+    {
+    m_MeshCache->SetDirectory(m_Driver->GetSystemInterface()->GetMeshCacheDirectory());
+    }
+  catch(IRISException &)
+    {
+    // The cache stays disabled
+    }
 }
 
 MultiLabelMeshPipeline *
@@ -187,6 +201,9 @@ MeshManager
       // Pass the options to the pipeline
     pipeline->SetMeshOptions(m_GlobalState->GetMeshOptions());
 
+    // Reuse meshes computed earlier for this segmentation
+    pipeline->SetMeshCache(m_MeshCache, MeshCache::GetSourceId(wrapper->GetFileName()));
+
     // Update the meshes
     pipeline->UpdateMeshes(command);
     }
@@ -195,6 +212,30 @@ MeshManager
   this->Modified();
 }
 
+void
+MeshManager
+::StoreMeshesInCache(LabelImageWrapper *wrapper)
+{
+  if(!wrapper || wrapper->HasUnsavedChanges() || !m_MeshCache->IsEnabled())
+    return;
+
+  MultiLabelMeshPipelineTable *pipelineTable =
+      static_cast<MultiLabelMeshPipelineTable *>(wrapper->GetUserData("MeshPipelineTable"));
+  if(!pipelineTable)
+    return;
+
+  // The file name may have changed since the meshes were computed
+  std::string source_id = MeshCache::GetSourceId(wrapper->GetFileName());
+  if(source_id.empty())
+    return;
+
+  for(auto &it : pipelineTable->GetPipelines())
+    {
+    it.second->SetMeshCache(m_MeshCache, source_id);
+    it.second->StoreMeshesInCache();
+    }
+}
+
 MeshManager::MeshCollection MeshManager::GetMeshes(unsigned int timepoint)
 {
   // Empty collection that is returned by default
@@ -45,6 +45,7 @@ class vtkPolyData;
 class MultiLabelMeshPipeline;
 class LevelSetMeshPipeline;
 class LabelImageWrapper;
+class MeshCache;
 
 #include "SNAPCommon.h"
 #include "AllPurposeProgressAccumulator.h"
@@ -97,6 +98,14 @@ public:
    */
   itk::ModifiedTimeType GetBuildTime(unsigned int timepoint);
 
+  /**
+   * Add the meshes computed for a segmentation to the persistent mesh cache.
+   * Nothing is stored if the segmentation has unsaved changes, since the
+   * meshes would not match the file. Call after saving the segmentation and
+   * before closing it, rather than after every mesh update.
+   */
+  void StoreMeshesInCache(LabelImageWrapper *wrapper);
+
 protected:
 
   MeshManager();
@@ -111,6 +120,9 @@ protected:
   // Progress accumulator for multi-object rendering
   itk::SmartPointer<AllPurposeProgressAccumulator> m_Progress;
 
+  // Persistent cache of the meshes of segmentation labels
+  itk::SmartPointer<MeshCache> m_MeshCache;
+
   //Check if apImage is a proper 3D, i.e. the third dimension is
   //different than 1
   bool Is3DProper(const itk::ImageBase<3> * apImage) const;
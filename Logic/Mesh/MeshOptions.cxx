@@ -74,6 +74,12 @@ MeshOptions
     NewSimpleProperty("MeshSmoothingFeatureEdgeSmoothing", false);
   m_MeshSmoothingBoundarySmoothingModel = 
     NewSimpleProperty("MeshSmoothingBoundarySmoothing", false);
+
+  // Begin discrete meshing params
+  m_UseDiscreteMeshingModel =
+    NewSimpleProperty("UseDiscreteMeshing", false);
+  m_DiscreteRelaxationIterationsModel =
+    NewRangedProperty("DiscreteRelaxationIterations", 10u,0u,100u,1u);
 }
 
 /*
@@ -69,6 +69,13 @@ public:
   irisSimplePropertyAccessMacro(MeshSmoothingFeatureEdgeSmoothing,bool)
   irisSimplePropertyAccessMacro(MeshSmoothingBoundarySmoothing,bool)
 
+  // Multi-label segmentations: extract the surfaces of all labels in one
+  // pass with shared boundaries (MultiLabelSurfaceNets) instead of meshing
+  // each label separately. The surfaces are smoothed by relaxation, and the
+  // Gaussian, decimation and mesh smoothing options do not apply.
+  irisSimplePropertyAccessMacro(UseDiscreteMeshing,bool)
+  irisRangedPropertyAccessMacro(DiscreteRelaxationIterations,unsigned int)
+
 protected:
   MeshOptions();
 
@@ -95,6 +102,10 @@ private:
   SmartPtr<ConcreteRangedFloatProperty> m_MeshSmoothingFeatureAngleModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_MeshSmoothingFeatureEdgeSmoothingModel;
   SmartPtr<ConcreteSimpleBooleanProperty> m_MeshSmoothingBoundarySmoothingModel;
+
+  // Begin discrete meshing params
+  SmartPtr<ConcreteSimpleBooleanProperty> m_UseDiscreteMeshingModel;
+  SmartPtr<ConcreteRangedUIntProperty> m_DiscreteRelaxationIterationsModel;
 };
 
 #endif // __MeshOptions_h_
@@ -43,11 +43,25 @@
 // SNAP includes
 #include "IRISVectorTypesToITKConversion.h"
 #include "VTKMeshPipeline.h"
+#include "MeshCache.h"
 #include "MeshOptions.h"
+#include "MultiLabelSurfaceNets.h"
 #include "vtkUnsignedShortArray.h"
 
 // ITK includes
 #include "itkBinaryThresholdImageFilter.h"
+#include "itkMultiThreaderBase.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
@@ -73,6 +87,9 @@ MultiLabelMeshPipeline
   // Set the initial mesh options
   m_MeshOptions = MeshOptions::New();
   m_VTKPipeline->SetMeshOptions(m_MeshOptions);
+
+  // Use the default number of threads for concurrent meshing
+  m_NumberOfWorkers = 0;
 }
 
 MultiLabelMeshPipeline
@@ -147,6 +164,326 @@ MultiLabelMeshPipeline
   return true;
 }
 
+MultiLabelMeshPipeline::InputImageType::RegionType
+MultiLabelMeshPipeline
+::GetMeshRegion(const MeshInfo &mi) const
+{
+  InputImageType::RegionType region;
+  for(int d = 0; d < 3; d++)
+    {
+    unsigned long len =
+        (unsigned long) (1 + mi.BoundingBox[1][d] - mi.BoundingBox[0][d]);
+    region.SetIndex(d, mi.BoundingBox[0][d]);
+    region.SetSize(d, len);
+    }
+  region.PadByRadius(5);
+  region.Crop(m_InputImage->GetLargestPossibleRegion());
+  return region;
+}
+
+void
+MultiLabelMeshPipeline
+::ExtractLabelImage(LabelType label,
+                    const InputImageType::RegionType &region,
+                    InternalImageType *out) const
+{
+  // Same geometry as the output of the ROI filter: the region starts at
+  // index zero and the origin is moved to the corner of the region
+  InternalImageType::RegionType outRegion;
+  outRegion.SetSize(region.GetSize());
+
+  InternalImageType::PointType origin;
+  m_InputImage->TransformIndexToPhysicalPoint(region.GetIndex(), origin);
+
+  out->SetRegions(outRegion);
+  out->SetOrigin(origin);
+  out->SetSpacing(m_InputImage->GetSpacing());
+  out->SetDirection(m_InputImage->GetDirection());
+  out->Allocate();
+
+  // Lines of the RLE image are stored as z * ny + y, with x relative to the
+  // start of the buffered region
+  const InputImageType::RegionType &buffered = m_InputImage->GetBufferedRegion();
+  const InputImageType::RLLine *lines = m_InputImage->GetBuffer()->GetBufferPointer();
+  long ny = buffered.GetSize(1);
+  long x0 = region.GetIndex(0) - buffered.GetIndex(0);
+  long x1 = x0 + region.GetSize(0);
+  long y0 = region.GetIndex(1) - buffered.GetIndex(1);
+  long z0 = region.GetIndex(2) - buffered.GetIndex(2);
+
+  float *p = out->GetBufferPointer();
+  for(long z = z0; z < z0 + (long) region.GetSize(2); z++)
+    {
+    for(long y = y0; y < y0 + (long) region.GetSize(1); y++)
+      {
+      const InputImageType::RLLine &line = lines[z * ny + y];
+      long t = 0;
+      for(size_t i = 0; i < line.size() && t < x1; i++)
+        {
+        long a = std::max(t, x0), b = std::min(t + (long) line[i].first, x1);
+        t += line[i].first;
+        if(a < b)
+          p = std::fill_n(p, b - a, line[i].second == label ? 1.0f : -1.0f);
+        }
+      }
+    }
+}
+
+void
+MultiLabelMeshPipeline
+::ComputeMeshesInParallel(const MeshJobList &jobs, unsigned int n_workers,
+                          AllPurposeProgressAccumulator *progress)
+{
+  // Hand out the largest labels first, so that a big label picked up last
+  // does not keep one worker busy while the others sit idle
+  MeshJobList queue = jobs;
+  std::stable_sort(queue.begin(), queue.end(),
+                   [](const MeshJobList::value_type &a, const MeshJobList::value_type &b)
+  { return a.second->Count > b.second->Count; });
+
+  double total = 0.0;
+  for(MeshJobList::const_iterator it = queue.begin(); it != queue.end(); ++it)
+    total += it->second->Count;
+
+  // Progress is reported by the calling thread only, since observers of
+  // the accumulator (e.g., the GUI) are not thread-safe
+  void *source = progress->RegisterGenericSource(1, total);
+
+  std::atomic<size_t> next(0);
+  std::mutex vtk_mutex, state_mutex;
+  std::condition_variable state_changed;
+  double done = 0.0;
+  unsigned int n_running = n_workers;
+  std::exception_ptr error;
+
+  auto worker = [&]()
+  {
+    // Each worker owns a pipeline with the current mesh options. VTK object
+    // creation goes through the shared object factory, so it is serialized
+    std::unique_ptr<VTKMeshPipeline> pipeline;
+    {
+    std::lock_guard<std::mutex> lock(vtk_mutex);
+    pipeline.reset(new VTKMeshPipeline());
+    pipeline->SetMeshOptions(m_MeshOptions);
+    }
+
+    try
+      {
+      for(size_t k = next++; k < queue.size(); k = next++)
+        {
+        LabelType label = queue[k].first;
+        MeshInfo *mi = queue[k].second;
+
+        InternalImagePointer image = InternalImageType::New();
+        ExtractLabelImage(label, GetMeshRegion(*mi), image);
+        pipeline->SetImage(image);
+        pipeline->ComputeMesh(mi->Mesh, &vtk_mutex);
+
+        std::lock_guard<std::mutex> lock(state_mutex);
+        done += mi->Count;
+        state_changed.notify_one();
+        }
+      }
+    catch(...)
+      {
+      // Stop handing out labels and pass the error to the calling thread
+      next = queue.size();
+      std::lock_guard<std::mutex> lock(state_mutex);
+      if(!error)
+        error = std::current_exception();
+      }
+
+    {
+    std::lock_guard<std::mutex> lock(vtk_mutex);
+    pipeline.reset();
+    }
+
+    std::lock_guard<std::mutex> lock(state_mutex);
+    --n_running;
+    state_changed.notify_one();
+  };
+
+  std::vector<std::thread> threads;
+  for(unsigned int i = 0; i < n_workers; i++)
+    threads.push_back(std::thread(worker));
+
+  // Forward progress while the workers run
+  {
+  std::unique_lock<std::mutex> lock(state_mutex);
+  while(n_running > 0)
+    {
+    state_changed.wait_for(lock, std::chrono::milliseconds(100));
+    double fraction = total > 0 ? done / total : 1.0;
+    lock.unlock();
+    AllPurposeProgressAccumulator::GenericProgressCallback(source, std::min(fraction, 0.999));
+    lock.lock();
+    }
+  }
+
+  for(unsigned int i = 0; i < n_workers; i++)
+    threads[i].join();
+
+  AllPurposeProgressAccumulator::GenericProgressCallback(source, 1.0);
+  progress->UnregsterGenericSource(source);
+
+  if(error)
+    std::rethrow_exception(error);
+}
+
+// Grow a region to include the bounding box of a label padded by a margin
+static void AddBoundingBoxToRegion(itk::ImageRegion<3> &region, bool &empty,
+                                   const MultiLabelMeshPipeline::MeshInfo &mi,
+                                   long pad)
+{
+  itk::Index<3> lo, hi;
+  for(int d = 0; d < 3; d++)
+    {
+    lo[d] = mi.BoundingBox[0][d] - pad;
+    hi[d] = mi.BoundingBox[1][d] + pad;
+    if(!empty)
+      {
+      lo[d] = std::min(lo[d], region.GetIndex(d));
+      hi[d] = std::max(hi[d], (itk::IndexValueType) (region.GetIndex(d) + region.GetSize(d)) - 1);
+      }
+    }
+  region.SetIndex(lo);
+  for(int d = 0; d < 3; d++)
+    region.SetSize(d, hi[d] + 1 - lo[d]);
+  empty = false;
+}
+
+void
+MultiLabelMeshPipeline
+::ComputeDiscreteMeshes(const MeshJobList &jobs,
+                        const itk::ImageRegion<3> &changed,
+                        AllPurposeProgressAccumulator *progress)
+{
+  if(jobs.empty() && !changed.GetNumberOfPixels())
+    return;
+
+  void *source = progress->RegisterGenericSource(1, 1.0f);
+
+  MultiLabelSurfaceNets nets;
+  nets.SetImage(m_InputImage);
+  nets.SetRelaxationIterations(m_MeshOptions->GetDiscreteRelaxationIterations());
+
+  // A vertex depends on the voxels within the relaxation reach of its
+  // corner, and the corners of a label lie within one voxel of its bounding
+  // box. So the surface of every label whose bounding box comes within that
+  // distance of a changed voxel may have moved, whether the label touches
+  // the changed labels along a face, an edge, a corner or not at all.
+  long pad = nets.GetRequiredPadding();
+  itk::ImageRegion<3> reach = changed;
+  reach.PadByRadius(pad + 1);
+
+  // Only the labels still in the image are meshed. The surfaces are the same
+  // as in a sweep of the whole image when the sweep covers their bounding
+  // boxes padded by the reach of the relaxation
+  bool all_changed = jobs.size() == m_MeshInfo.size();
+  itk::ImageRegion<3> region;
+  bool empty = true;
+  std::vector<LabelType> rebuilt;
+  for(MeshInfoMap::const_iterator mit = m_MeshInfo.begin(); mit != m_MeshInfo.end(); ++mit)
+    {
+    // Crop() tells whether the bounding box overlaps the reach
+    itk::ImageRegion<3> box;
+    bool box_empty = true;
+    AddBoundingBoxToRegion(box, box_empty, mit->second, 0);
+    if(all_changed || box.Crop(reach))
+      {
+      rebuilt.push_back(mit->first);
+      AddBoundingBoxToRegion(region, empty, mit->second, pad);
+      }
+    }
+  AllPurposeProgressAccumulator::GenericProgressCallback(source, 0.1);
+
+  if(!all_changed && !empty)
+    nets.SetRegion(region);
+  if(!empty)
+    nets.Update();
+  AllPurposeProgressAccumulator::GenericProgressCallback(source, 0.5);
+
+  for(size_t k = 0; k < rebuilt.size(); k++)
+    {
+    LabelType label = rebuilt[k];
+    MeshInfo &mi = m_MeshInfo[label];
+
+    // Replace rather than modify a mesh that may be in use elsewhere
+    mi.Mesh = vtkSmartPointer<vtkPolyData>::New();
+    nets.GetMesh(label, mi.Mesh);
+
+    AllPurposeProgressAccumulator::GenericProgressCallback(
+          source, 0.5 + 0.49 * (k + 1) / rebuilt.size());
+    }
+
+  AllPurposeProgressAccumulator::GenericProgressCallback(source, 1.0);
+  progress->UnregsterGenericSource(source);
+}
+
+void
+MultiLabelMeshPipeline
+::SetMeshCache(MeshCache *cache, const std::string &source_id)
+{
+  m_MeshCache = cache;
+  m_MeshCacheSourceId = source_id;
+}
+
+void
+MultiLabelMeshPipeline
+::StoreMeshesInCache()
+{
+  // Only meshes computed with the per-label pipeline are cached
+  if(!m_MeshCache || !m_MeshCache->IsEnabled() || !m_InputImage
+     || m_MeshOptions->GetUseDiscreteMeshing())
+    return;
+
+  // The keys include the checksums of the labels, so a mesh computed before
+  // the last edits is stored under a key that no file will match
+  std::string cache_prefix = GetMeshCacheDescription();
+  bool stored = false;
+  for(MeshInfoMap::iterator it = m_MeshInfo.begin(); it != m_MeshInfo.end(); ++it)
+    {
+    MeshInfo &info = it->second;
+    if(info.Mesh && !info.Stored)
+      {
+      stored |= m_MeshCache->Store(GetMeshCacheKey(cache_prefix, it->first, info), info.Mesh);
+      info.Stored = true;
+      }
+    }
+
+  // Trimming lists the cache directory, so it is only done for new entries
+  if(stored)
+    m_MeshCache->Trim();
+}
+
+std::string
+MultiLabelMeshPipeline
+::GetMeshCacheDescription() const
+{
+  // The meshes depend on the geometry of the image and on the options
+  std::ostringstream oss;
+  oss << m_MeshCacheSourceId << "\n";
+  oss << m_InputImage->GetLargestPossibleRegion().GetIndex()
+      << m_InputImage->GetLargestPossibleRegion().GetSize() << "\n";
+  oss.precision(17);
+  oss << m_InputImage->GetOrigin() << m_InputImage->GetSpacing() << "\n";
+  oss << m_InputImage->GetDirection() << "\n";
+  oss << MeshCache::GetOptionsDescription(m_MeshOptions);
+  return oss.str();
+}
+
+std::string
+MultiLabelMeshPipeline
+::GetMeshCacheKey(const std::string &description, LabelType label,
+                  const MeshInfo &info) const
+{
+  std::ostringstream oss;
+  oss << description << "\n" << label << " " << info.CheckSum << " " << info.Count;
+  for(int d = 0; d < 3; d++)
+    oss << " " << info.BoundingBox[0][d] << " " << info.BoundingBox[1][d];
+  return MeshCache::ComputeKey(oss.str());
+}
+
 #include "itkImageLinearConstIteratorWithIndex.h"
 #include "itk_zlib.h"
 
@@ -248,12 +585,20 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
   // as the checksum for every label and the extent for every label. Now we
   // can determine which meshes actually need to be updated
 
+  // The region where voxels may have changed: the old and new bounding
+  // boxes of the labels that changed or were removed
+  itk::ImageRegion<3> changed;
+  bool changed_empty = true;
+
   // First we go through the stored mesh map and delete all meshes that are no
   // longer present in the image
   for(MeshInfoMap::iterator it = m_MeshInfo.begin(); it != m_MeshInfo.end();)
     {
     if(meshmap.find(it->first) == meshmap.end())
+      {
+      AddBoundingBoxToRegion(changed, changed_empty, it->second, 0);
       m_MeshInfo.erase(it++);
+      }
     else
       it++;
     }
@@ -262,6 +607,11 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
   SmartPtr<AllPurposeProgressAccumulator> progress = AllPurposeProgressAccumulator::New();
   progress->AddObserver(itk::ProgressEvent(), progressCommand);
 
+  // Meshes computed with the per-label pipeline may be found in the cache
+  bool use_cache = m_MeshCache && m_MeshCache->IsEnabled()
+      && !m_MeshOptions->GetUseDiscreteMeshing();
+  std::string cache_prefix = use_cache ? GetMeshCacheDescription() : std::string();
+
   // Next we check which meshes are new or updated and mark them as needing to
   // be recomputed
   for(MeshInfoMap::const_iterator it = meshmap.begin(); it != meshmap.end(); ++it)
@@ -273,11 +623,26 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
     if(info.Count != it->second.Count || info.CheckSum != it->second.CheckSum)
       {
       // Cache the current information
+      if(info.Count)
+        AddBoundingBoxToRegion(changed, changed_empty, info, 0);
       info.CheckSum = it->second.CheckSum;
       info.Count = it->second.Count;
       info.BoundingBox[0] = it->second.BoundingBox[0];
       info.BoundingBox[1] = it->second.BoundingBox[1];
       info.Mesh = NULL;
+      AddBoundingBoxToRegion(changed, changed_empty, info, 0);
+
+      // Use the mesh stored in the cache, if any
+      if(use_cache)
+        {
+        vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+        if(m_MeshCache->Load(GetMeshCacheKey(cache_prefix, it->first, info), mesh))
+          {
+          info.Mesh = mesh;
+          info.Stored = true;
+          continue;
+          }
+        }
 
       //auto src = m_VTKPipeline->GetProgressAccumulator();
 
@@ -286,26 +651,43 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
       }
     }
 
-  // Now compute the meshes
+  // Collect the labels that need to be meshed
+  MeshJobList jobs;
   for(MeshInfoMap::iterator it = m_MeshInfo.begin(); it != m_MeshInfo.end(); it++)
     {
     if(it->second.Mesh == NULL)
       {
-      // Create the mesh
-      MeshInfo &mi = it->second;
-      mi.Mesh = vtkSmartPointer<vtkPolyData>::New();
+      it->second.Mesh = vtkSmartPointer<vtkPolyData>::New();
+      it->second.Stored = false;
+      jobs.push_back(std::make_pair(it->first, &it->second));
+      }
+    }
 
-      // TODO: make this more elegant
-      InputImageType::RegionType bbWiderRegion;
-      for(int d = 0; d < 3; d++)
-        {
-        unsigned long len =
-            (unsigned long) (1 + mi.BoundingBox[1][d] - mi.BoundingBox[0][d]);
-        bbWiderRegion.SetIndex(d, mi.BoundingBox[0][d]);
-        bbWiderRegion.SetSize(d, len);
-        }
-      bbWiderRegion.PadByRadius(5);
-      bbWiderRegion.Crop(m_InputImage->GetLargestPossibleRegion());
+  unsigned int n_workers = m_NumberOfWorkers > 0
+      ? m_NumberOfWorkers
+      : itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  n_workers = std::min(n_workers, (unsigned int) jobs.size());
+
+  if(m_MeshOptions->GetUseDiscreteMeshing())
+    {
+    // All labels are extracted together, reporting progress as one source
+    progress->UnregisterAllSources();
+    ComputeDiscreteMeshes(jobs, changed, progress);
+    }
+  else if(n_workers > 1)
+    {
+    // The VTK pipeline sources registered above are replaced by a single
+    // source whose progress is the fraction of voxels meshed
+    progress->UnregisterAllSources();
+    ComputeMeshesInParallel(jobs, n_workers, progress);
+    }
+  else
+    {
+    // Now compute the meshes
+    for(MeshJobList::iterator it = jobs.begin(); it != jobs.end(); ++it)
+      {
+      MeshInfo &mi = *it->second;
+      InputImageType::RegionType bbWiderRegion = GetMeshRegion(mi);
 
       // Pass the region to the ROI filter and propagate the filter
       m_ROIFilter->SetInput(m_InputImage);
@@ -319,7 +701,7 @@ void MultiLabelMeshPipeline::UpdateMeshes(itk::Command *progressCommand)
 
       // Graft the polydata to the last filter in the pipeline
       m_VTKPipeline->SetImage(m_ThrehsoldFilter->GetOutput());
-      m_VTKPipeline->ComputeMesh(it->second.Mesh);
+      m_VTKPipeline->ComputeMesh(mi.Mesh);
 
       // Update progress
       progress->StartNextRun(m_VTKPipeline->GetProgressAccumulator());
@@ -349,6 +731,7 @@ MultiLabelMeshPipeline::MeshInfo::MeshInfo()
 {
   this->Mesh = NULL;
   this->Count = 0;
+  this->Stored = false;
   this->CheckSum = adler32(0L, NULL, 0);
 }
 
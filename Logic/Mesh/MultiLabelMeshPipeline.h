@@ -59,6 +59,7 @@ class MeshOptions;
 class VTKMeshPipeline;
 class vtkPolyData;
 class AllPurposeProgressAccumulator;
+class MeshCache;
 
 
 /**
@@ -70,6 +71,12 @@ class AllPurposeProgressAccumulator;
  * whether it has been updated relative to the corresponding mesh. This makes
  * it possible for selective mesh recomputation, leading to fast mesh computation
  * even for big segmentations.
+ *
+ * Labels that need to be recomputed are independent of each other, so
+ * UpdateMeshes() can mesh them concurrently on a pool of workers, each with
+ * its own VTK pipeline (see SetNumberOfWorkers). Alternatively, when the
+ * UseDiscreteMeshing mesh option is on, the surfaces of all labels are
+ * extracted together in one pass over the image (MultiLabelSurfaceNets).
  */
 class MultiLabelMeshPipeline : public itk::Object
 {
@@ -90,6 +97,9 @@ public:
     // The number of voxels
     unsigned long Count;
 
+    // Whether the mesh is in the persistent mesh cache
+    bool Stored;
+
     MeshInfo();
     ~MeshInfo();
   };
@@ -132,6 +142,25 @@ public:
   /** Update the meshes */
   void UpdateMeshes(itk::Command *progressCommand);
 
+  /** Use a persistent cache of meshes. UpdateMeshes() loads the meshes of
+   * changed labels from the cache when they are found there. The meshes it
+   * computes are only added by StoreMeshesInCache(). The source id (see
+   * MeshCache::GetSourceId) is included in the cache keys. Pass NULL to
+   * disable the cache. */
+  void SetMeshCache(MeshCache *cache, const std::string &source_id);
+
+  /** Add the computed meshes that are not yet in the cache to it. Since
+   * the keys include the source id, this is only useful when the image is
+   * the same as the file it was loaded from or saved to, e.g., after saving
+   * the segmentation or when closing it without changes. */
+  void StoreMeshesInCache();
+
+  /** Number of labels meshed concurrently by UpdateMeshes(). A value of 1
+   * meshes one label at a time on the calling thread. A value of 0 (default)
+   * uses the ITK global default number of threads. */
+  itkSetMacro(NumberOfWorkers, unsigned int)
+  itkGetConstMacro(NumberOfWorkers, unsigned int)
+
   /** Get the collection of computed meshes */
   std::map<LabelType, vtkSmartPointer<vtkPolyData> > GetMeshCollection();
 
@@ -184,6 +213,45 @@ private:
   // The VTK pipeline
   VTKMeshPipeline *           m_VTKPipeline;
 
+  // Persistent mesh cache and the id of the segmentation in the cache
+  SmartPtr<MeshCache> m_MeshCache;
+  std::string m_MeshCacheSourceId;
+
+  // Description of the image geometry and mesh options for cache keys
+  std::string GetMeshCacheDescription() const;
+
+  // Cache key for the mesh of a label
+  std::string GetMeshCacheKey(const std::string &description, LabelType label,
+                              const MeshInfo &info) const;
+
+  // Number of concurrent meshing workers, 0 for the ITK default
+  unsigned int m_NumberOfWorkers;
+
+  // A label whose mesh needs to be recomputed
+  typedef std::vector<std::pair<LabelType, MeshInfo *> > MeshJobList;
+
+  // The region meshed for a label: its bounding box padded by a margin and
+  // cropped to the image
+  InputImageType::RegionType GetMeshRegion(const MeshInfo &mi) const;
+
+  // Fill a float image covering the region with 1 inside the label and -1
+  // outside. Reads the run-length lines of the input directly, so that it
+  // can be called from several threads at once.
+  void ExtractLabelImage(LabelType label,
+                         const InputImageType::RegionType &region,
+                         InternalImageType *out) const;
+
+  // Mesh the labels concurrently, reporting progress on the calling thread
+  void ComputeMeshesInParallel(const MeshJobList &jobs, unsigned int n_workers,
+                               AllPurposeProgressAccumulator *progress);
+
+  // Mesh the changed labels in one pass (MeshOptions::UseDiscreteMeshing),
+  // along with every label whose surface may have moved because it lies
+  // within the reach of the relaxation of the changed region
+  void ComputeDiscreteMeshes(const MeshJobList &jobs,
+                             const itk::ImageRegion<3> &changed,
+                             AllPurposeProgressAccumulator *progress);
+
   // Helper routine for the update command
   void UpdateMeshInfoHelper(
       MeshInfo *current_meshinfo,
@@ -209,6 +277,9 @@ public:
   // Get a pipeline from timepoint. If timepoint does not exist, return nullptr
   SmartPtr<MultiLabelMeshPipeline> GetPipeline(unsigned int timepoint);
 
+  // Get the pipelines of all timepoints
+  const MeshPipelineTableType &GetPipelines() const { return m_table; }
+
   // Set pipeline for a timepoint. If timepoint exists, overwrite existing pipeline
   void SetPipeline(unsigned int timepoint, SmartPtr<MultiLabelMeshPipeline> pipeline);
 
@@ -0,0 +1,451 @@
+#include "MultiLabelSurfaceNets.h"
+#include "ImageWrapperBase.h"
+#include "itkMultiThreaderBase.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cmath>
+
+MultiLabelSurfaceNets::MultiLabelSurfaceNets()
+{
+  m_RelaxationIterations = 10;
+  m_AdjacencyOnly = false;
+  m_UseRequestedRegion = false;
+  m_Size[0] = m_Size[1] = m_Size[2] = 0;
+  m_PlaneZ = 0;
+  m_LastLabel = 0;
+  m_LastFaces = NULL;
+}
+
+void MultiLabelSurfaceNets::SetImage(const InputImageType *image)
+{
+  m_Image = image;
+}
+
+void MultiLabelSurfaceNets::SetRegion(const RegionType &region)
+{
+  m_RequestedRegion = region;
+  m_UseRequestedRegion = true;
+}
+
+static const unsigned int NO_VERTEX = ~0u;
+
+MultiLabelSurfaceNets::VertexId
+MultiLabelSurfaceNets::GetVertex(long i, long j, long k)
+{
+  // Faces of slice z only touch the corner planes z and z + 1
+  int plane = (int) (k - m_PlaneZ);
+  size_t slot = i + (m_Size[0] + 1) * j;
+  VertexId &id = m_CornerPlane[plane][slot];
+  if(id == NO_VERTEX)
+    {
+    id = (VertexId) m_Corners.size();
+    m_Corners.push_back(slot + (m_Size[0] + 1) * (CornerKey) (m_Size[1] + 1) * k);
+    m_UsedCorners[plane].push_back(slot);
+    }
+  return id;
+}
+
+void MultiLabelSurfaceNets::AddFace(
+    int d, long x, long y, long z, LabelType lower, LabelType upper)
+{
+  if(lower == upper)
+    return;
+
+  if(m_AdjacencyOnly)
+    {
+    if(lower && upper)
+      m_Adjacency.insert(std::make_pair(std::min(lower, upper), std::max(lower, upper)));
+    return;
+    }
+
+  // The face lies in the plane of corners v + e_d, and is spanned by the
+  // two other axes, taken in cyclic order so that its normal is +e_d
+  long c[3] = { x, y, z };
+  c[d]++;
+  int u = (d + 1) % 3, w = (d + 2) % 3;
+  long cu[3] = { c[0], c[1], c[2] }; cu[u]++;
+  long cuw[3] = { cu[0], cu[1], cu[2] }; cuw[w]++;
+  long cw[3] = { c[0], c[1], c[2] }; cw[w]++;
+
+  VertexId v[4] = {
+    GetVertex(c[0], c[1], c[2]), GetVertex(cu[0], cu[1], cu[2]),
+    GetVertex(cuw[0], cuw[1], cuw[2]), GetVertex(cw[0], cw[1], cw[2]) };
+
+  for(int side = 0; side < 2; side++)
+    {
+    LabelType label = side ? upper : lower;
+    if(label == 0)
+      continue;
+
+    if(!m_LastFaces || label != m_LastLabel)
+      {
+      m_LastFaces = &m_Faces[label];
+      m_LastLabel = label;
+      }
+
+    // Outward normal is +e_d for the lower voxel and -e_d for the upper one
+    if(side == 0)
+      m_LastFaces->insert(m_LastFaces->end(), v, v + 4);
+    else
+      {
+      VertexId r[4] = { v[0], v[3], v[2], v[1] };
+      m_LastFaces->insert(m_LastFaces->end(), r, r + 4);
+      }
+    }
+
+  if(lower && upper)
+    m_Adjacency.insert(std::make_pair(std::min(lower, upper), std::max(lower, upper)));
+}
+
+void MultiLabelSurfaceNets::AddFacesBetweenLines(
+    int d, const Line *lower, const Line *upper, long y, long z)
+{
+  // Walk the runs of both lines, treating a missing line as background
+  size_t il = 0, iu = 0;
+  long el = lower ? (long) (*lower)[0].first : m_Size[0];
+  long eu = upper ? (long) (*upper)[0].first : m_Size[0];
+  long x = 0;
+  while(x < m_Size[0])
+    {
+    LabelType ll = lower ? (*lower)[il].second : 0;
+    LabelType lu = upper ? (*upper)[iu].second : 0;
+    long e = std::min(el, eu);
+    if(ll != lu)
+      for(; x < e; x++)
+        AddFace(d, x, y, z, ll, lu);
+    x = e;
+
+    if(x == el && x < m_Size[0])
+      el += (*lower)[++il].first;
+    if(x == eu && x < m_Size[0])
+      eu += (*upper)[++iu].first;
+    }
+}
+
+void MultiLabelSurfaceNets::ClipLine(long y, long z, Line &out) const
+{
+  const RegionType &buffered = m_Image->GetBufferedRegion();
+  long ny = buffered.GetSize(1);
+  long ly = m_Region.GetIndex(1) - buffered.GetIndex(1) + y;
+  long lz = m_Region.GetIndex(2) - buffered.GetIndex(2) + z;
+  const InputImageType::RLLine &line =
+      m_Image->GetBuffer()->GetBufferPointer()[lz * ny + ly];
+
+  // Runs are relative to the start of the buffered line
+  long x0 = m_Region.GetIndex(0) - buffered.GetIndex(0), x1 = x0 + m_Size[0];
+  out.clear();
+  long t = 0;
+  for(size_t i = 0; i < line.size() && t < x1; i++)
+    {
+    long e = t + (long) line[i].first;
+    if(e > x0)
+      out.push_back(std::make_pair(std::min(e, x1) - std::max(t, x0), line[i].second));
+    t = e;
+    }
+}
+
+void MultiLabelSurfaceNets::Update()
+{
+  Sweep(false);
+  Relax();
+}
+
+void MultiLabelSurfaceNets::UpdateAdjacency()
+{
+  Sweep(true);
+  m_EdgeStart.assign(1, 0);
+  m_EdgeEnd.clear();
+}
+
+void MultiLabelSurfaceNets::Sweep(bool adjacency_only)
+{
+  m_AdjacencyOnly = adjacency_only;
+  m_Corners.clear();
+  m_Positions.clear();
+  m_Faces.clear();
+  m_Adjacency.clear();
+  m_LastFaces = NULL;
+
+  m_Region = m_Image->GetBufferedRegion();
+  if(m_UseRequestedRegion && !m_Region.Crop(m_RequestedRegion))
+    m_Region.SetSize(RegionType::SizeType());
+  for(int d = 0; d < 3; d++)
+    m_Size[d] = m_Region.GetSize(d);
+
+  long nx = m_Size[0], ny = m_Size[1], nz = m_Size[2];
+  if(nx == 0 || ny == 0 || nz == 0)
+    return;
+
+  // Corner planes for the first slice
+  size_t plane_size = (size_t) (nx + 1) * (ny + 1);
+  for(int p = 0; p < 2; p++)
+    {
+    m_CornerPlane[p].assign(adjacency_only ? 0 : plane_size, NO_VERTEX);
+    m_UsedCorners[p].clear();
+    }
+
+  // Clipped lines of the current and of the previous slice
+  std::vector<Line> slice(ny), prev_slice(ny);
+
+  for(long z = 0; z < nz; z++)
+    {
+    m_PlaneZ = z;
+    for(long y = 0; y < ny; y++)
+      {
+      Line &line = slice[y];
+      ClipLine(y, z, line);
+
+      // Faces along x are at the run boundaries and the ends of the line
+      LabelType prev = 0;
+      long t = 0;
+      for(size_t i = 0; i < line.size(); i++)
+        {
+        AddFace(0, t - 1, y, z, prev, line[i].second);
+        prev = line[i].second;
+        t += line[i].first;
+        }
+      AddFace(0, nx - 1, y, z, prev, 0);
+
+      // Faces along y and z, with this line as the upper line, and also as
+      // the lower line at the far end of the region
+      AddFacesBetweenLines(1, y > 0 ? &slice[y - 1] : NULL, &line, y - 1, z);
+      AddFacesBetweenLines(2, z > 0 ? &prev_slice[y] : NULL, &line, y, z - 1);
+      if(y == ny - 1)
+        AddFacesBetweenLines(1, &line, NULL, y, z);
+      if(z == nz - 1)
+        AddFacesBetweenLines(2, &line, NULL, y, z);
+      }
+    slice.swap(prev_slice);
+
+    // Plane z + 1 becomes the first plane of the next slice, and plane z is
+    // reset to become its second plane
+    if(!adjacency_only)
+      {
+      for(size_t i = 0; i < m_UsedCorners[0].size(); i++)
+        m_CornerPlane[0][m_UsedCorners[0][i]] = NO_VERTEX;
+      m_UsedCorners[0].clear();
+      m_CornerPlane[0].swap(m_CornerPlane[1]);
+      m_UsedCorners[0].swap(m_UsedCorners[1]);
+      }
+    }
+
+  // The corner planes are only needed while the faces are collected
+  for(int p = 0; p < 2; p++)
+    {
+    std::vector<VertexId>().swap(m_CornerPlane[p]);
+    std::vector<size_t>().swap(m_UsedCorners[p]);
+    }
+
+  // Initial positions at the corners, in voxel units relative to the region
+  // (voxel centers are at integer positions, so corner i lies at i - 0.5)
+  size_t nv = m_Corners.size();
+  m_Positions.resize(3 * nv);
+  for(size_t i = 0; i < nv; i++)
+    {
+    CornerKey key = m_Corners[i];
+    m_Positions[3 * i] = (key % (nx + 1)) - 0.5f;
+    key /= (nx + 1);
+    m_Positions[3 * i + 1] = (key % (ny + 1)) - 0.5f;
+    m_Positions[3 * i + 2] = (key / (ny + 1)) - 0.5f;
+    }
+}
+
+void MultiLabelSurfaceNets::Relax()
+{
+  size_t nv = m_Corners.size();
+  m_EdgeStart.assign(nv + 1, 0);
+  m_EdgeEnd.clear();
+  if(m_RelaxationIterations == 0 || nv == 0)
+    return;
+
+  // Collect the unique edges of all faces (each face edge is shared by the
+  // two labels on either side of the face, and by the adjacent faces)
+  std::vector<std::pair<VertexId, VertexId> > edges;
+  for(FaceMap::const_iterator it = m_Faces.begin(); it != m_Faces.end(); ++it)
+    {
+    const std::vector<VertexId> &f = it->second;
+    for(size_t q = 0; q < f.size(); q += 4)
+      for(int k = 0; k < 4; k++)
+        {
+        VertexId a = f[q + k], b = f[q + (k + 1) % 4];
+        edges.push_back(std::make_pair(a, b));
+        edges.push_back(std::make_pair(b, a));
+        }
+    }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  m_EdgeEnd.resize(edges.size());
+  for(size_t e = 0; e < edges.size(); e++)
+    {
+    m_EdgeStart[edges[e].first + 1]++;
+    m_EdgeEnd[e] = edges[e].second;
+    }
+  for(size_t i = 0; i < nv; i++)
+    m_EdgeStart[i + 1] += m_EdgeStart[i];
+  std::vector<std::pair<VertexId, VertexId> >().swap(edges);
+
+  // Jacobi iterations over blocks of vertices. Each vertex stays within
+  // half a voxel of its corner, i.e., within the cell of the surface net
+  const std::vector<float> corners(m_Positions);
+  std::vector<float> next(m_Positions.size());
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  size_t nblocks = std::min(nv, (size_t) mt->GetNumberOfWorkUnits() * 4);
+  for(unsigned int iter = 0; iter < m_RelaxationIterations; iter++)
+    {
+    mt->ParallelizeArray(0, nblocks, [&](itk::SizeValueType b)
+      {
+      size_t v0 = nv * b / nblocks, v1 = nv * (b + 1) / nblocks;
+      for(size_t v = v0; v < v1; v++)
+        {
+        size_t n = m_EdgeStart[v + 1] - m_EdgeStart[v];
+        for(int d = 0; d < 3; d++)
+          {
+          float sum = 0.0f;
+          for(size_t e = m_EdgeStart[v]; e < m_EdgeStart[v + 1]; e++)
+            sum += m_Positions[3 * m_EdgeEnd[e] + d];
+
+          float c = corners[3 * v + d];
+          float p = n ? sum / n : m_Positions[3 * v + d];
+          next[3 * v + d] = std::max(c - 0.5f, std::min(c + 0.5f, p));
+          }
+        }
+      }, nullptr);
+    m_Positions.swap(next);
+    }
+}
+
+std::set<LabelType> MultiLabelSurfaceNets::GetLabels() const
+{
+  std::set<LabelType> labels;
+  for(FaceMap::const_iterator it = m_Faces.begin(); it != m_Faces.end(); ++it)
+    labels.insert(it->first);
+  return labels;
+}
+
+std::set<LabelType> MultiLabelSurfaceNets::GetAdjacentLabels(LabelType label) const
+{
+  std::set<LabelType> adj;
+  for(std::set<std::pair<LabelType, LabelType> >::const_iterator it = m_Adjacency.begin();
+      it != m_Adjacency.end(); ++it)
+    {
+    if(it->first == label)
+      adj.insert(it->second);
+    else if(it->second == label)
+      adj.insert(it->first);
+    }
+  return adj;
+}
+
+size_t MultiLabelSurfaceNets::GetNumberOfFaces(LabelType label) const
+{
+  FaceMap::const_iterator it = m_Faces.find(label);
+  return it == m_Faces.end() ? 0 : it->second.size() / 4;
+}
+
+void MultiLabelSurfaceNets::GetMesh(LabelType label, vtkPolyData *out) const
+{
+  vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+  vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+  vtkSmartPointer<vtkFloatArray> normals = vtkSmartPointer<vtkFloatArray>::New();
+  normals->SetNumberOfComponents(3);
+  normals->SetName("Normals");
+
+  FaceMap::const_iterator it = m_Faces.find(label);
+  if(it != m_Faces.end())
+    {
+    // Local numbering of the vertices used by this label
+    const std::vector<VertexId> &faces = it->second;
+    std::vector<VertexId> used(faces);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    // Voxel units to the coordinates of the VTK image (origin and spacing,
+    // no direction), then to NIFTI, as in VTKMeshPipeline
+    ImageWrapperBase::TransformType vtk2nii =
+        ImageWrapperBase::ConstructVTKtoNiftiTransform(
+          m_Image->GetDirection().GetVnlMatrix().as_ref(),
+          m_Image->GetOrigin().GetVnlVector(),
+          m_Image->GetSpacing().GetVnlVector());
+    double origin[3], spacing[3];
+    for(int d = 0; d < 3; d++)
+      {
+      // Positions are relative to the swept region
+      spacing[d] = m_Image->GetSpacing()[d];
+      origin[d] = m_Image->GetOrigin()[d] + m_Region.GetIndex(d) * spacing[d];
+      }
+
+    points->SetNumberOfPoints(used.size());
+    std::vector<double> xyz(3 * used.size());
+    for(size_t i = 0; i < used.size(); i++)
+      {
+      double p[4];
+      for(int d = 0; d < 3; d++)
+        p[d] = origin[d] + m_Positions[3 * used[i] + d] * spacing[d];
+      p[3] = 1.0;
+      for(int r = 0; r < 3; r++)
+        {
+        xyz[3 * i + r] = vtk2nii(r, 0) * p[0] + vtk2nii(r, 1) * p[1]
+            + vtk2nii(r, 2) * p[2] + vtk2nii(r, 3) * p[3];
+        }
+      points->SetPoint(i, &xyz[3 * i]);
+      }
+
+    // A negative determinant flips the orientation of the faces
+    double det =
+        vtk2nii(0, 0) * (vtk2nii(1, 1) * vtk2nii(2, 2) - vtk2nii(1, 2) * vtk2nii(2, 1))
+      - vtk2nii(0, 1) * (vtk2nii(1, 0) * vtk2nii(2, 2) - vtk2nii(1, 2) * vtk2nii(2, 0))
+      + vtk2nii(0, 2) * (vtk2nii(1, 0) * vtk2nii(2, 1) - vtk2nii(1, 1) * vtk2nii(2, 0));
+    bool flip = det < 0;
+
+    // Split each face into two triangles and accumulate area-weighted normals
+    std::vector<double> nrm(3 * used.size(), 0.0);
+    for(size_t q = 0; q < faces.size(); q += 4)
+      {
+      vtkIdType id[4];
+      for(int k = 0; k < 4; k++)
+        id[k] = std::lower_bound(used.begin(), used.end(), faces[q + k]) - used.begin();
+      if(flip)
+        std::swap(id[1], id[3]);
+
+      for(int t = 0; t < 2; t++)
+        {
+        vtkIdType tri[3] = { id[0], id[1 + t], id[2 + t] };
+        polys->InsertNextCell(3, tri);
+
+        const double *a = &xyz[3 * tri[0]], *b = &xyz[3 * tri[1]], *c = &xyz[3 * tri[2]];
+        double ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        double ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        double n[3] = { ab[1] * ac[2] - ab[2] * ac[1],
+                        ab[2] * ac[0] - ab[0] * ac[2],
+                        ab[0] * ac[1] - ab[1] * ac[0] };
+        for(int k = 0; k < 3; k++)
+          for(int d = 0; d < 3; d++)
+            nrm[3 * tri[k] + d] += n[d];
+        }
+      }
+
+    normals->SetNumberOfTuples(used.size());
+    for(size_t i = 0; i < used.size(); i++)
+      {
+      double *n = &nrm[3 * i];
+      double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if(len > 0)
+        for(int d = 0; d < 3; d++)
+          n[d] /= len;
+      normals->SetTuple(i, n);
+      }
+    }
+
+  out->Initialize();
+  out->SetPoints(points);
+  out->SetPolys(polys);
+  out->GetPointData()->SetNormals(normals);
+}
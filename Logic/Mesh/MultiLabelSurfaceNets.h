@@ -0,0 +1,159 @@
+#ifndef MULTILABELSURFACENETS_H
+#define MULTILABELSURFACENETS_H
+
+#include "SNAPCommon.h"
+#include "ImageWrapperTraits.h"
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class vtkPolyData;
+
+/**
+ * \class MultiLabelSurfaceNets
+ * \brief Extracts the surfaces of all labels in a segmentation in a single
+ * pass over its run-length lines.
+ *
+ * The boundary between two voxels with different labels is a face that
+ * belongs to the surfaces of both labels (with opposite orientation), and
+ * the surface of every label is the set of its boundary faces. Faces along
+ * x are found at run boundaries, and faces along y and z by merging the runs
+ * of neighboring lines, so the work is proportional to the number of runs
+ * and boundary faces rather than to the number of voxels. Voxels outside of
+ * the image are treated as background, so the surfaces are closed.
+ *
+ * The vertices at the voxel corners are shared by all labels, and are then
+ * relaxed as in surface nets: each vertex moves toward the average of its
+ * neighbors, but never leaves the voxel-sized cell centered on its corner.
+ * Since all labels are relaxed together, the surfaces of adjacent labels
+ * share their common boundary exactly.
+ *
+ * The sweep can be restricted to a region of the image, outside of which
+ * the image is treated as background. A vertex only depends on the voxels
+ * within RelaxationIterations + 1 voxels of its corner, so the surface of a
+ * label is the same as in a sweep of the whole image as long as the region
+ * contains its bounding box padded by that margin (GetRequiredPadding).
+ * The image is swept one slice at a time, and the vertices are looked up
+ * in the two planes of corners that the faces of a slice touch, so the
+ * memory used for the lookup is proportional to the area of a slice.
+ */
+class MultiLabelSurfaceNets
+{
+public:
+  typedef LabelImageWrapperTraits::ImageType InputImageType;
+
+  MultiLabelSurfaceNets();
+
+  typedef InputImageType::RegionType RegionType;
+
+  /** Set the input segmentation image */
+  void SetImage(const InputImageType *image);
+
+  /** Restrict the sweep to a region of the image, which is cropped to the
+   * buffered region (by default, the whole buffered region is swept) */
+  void SetRegion(const RegionType &region);
+
+  /** Number of relaxation iterations. With zero iterations, the surfaces
+   * follow the voxel faces exactly (default 10) */
+  void SetRelaxationIterations(unsigned int n)
+    { m_RelaxationIterations = n; }
+
+  /** Padding of the bounding box of a label needed for its surface to be
+   * the same as in a sweep of the whole image */
+  long GetRequiredPadding() const
+    { return m_RelaxationIterations + 1; }
+
+  /** Extract and relax the surfaces of all labels in the region */
+  void Update();
+
+  /** Only find which labels are adjacent in the region, without building
+   * any surfaces */
+  void UpdateAdjacency();
+
+  /** Labels that have a surface (all nonzero labels present in the image) */
+  std::set<LabelType> GetLabels() const;
+
+  /** Labels that share part of their boundary with the given label */
+  std::set<LabelType> GetAdjacentLabels(LabelType label) const;
+
+  /** Number of shared vertices after Update() */
+  size_t GetNumberOfVertices() const
+    { return m_Corners.size(); }
+
+  /** Number of faces of the surface of a label */
+  size_t GetNumberOfFaces(LabelType label) const;
+
+  /** Fill a polydata with the triangulated surface of a label, with point
+   * normals, in the same (NIFTI) coordinates as VTKMeshPipeline */
+  void GetMesh(LabelType label, vtkPolyData *out) const;
+
+protected:
+  typedef unsigned long long CornerKey;
+  typedef unsigned int VertexId;
+
+  // The runs of a line within the region, with x relative to the region
+  typedef std::vector<std::pair<long, LabelType> > Line;
+
+  // Sweep the region, building the faces unless only the adjacency is needed
+  void Sweep(bool adjacency_only);
+
+  // Copy the part of the image line through (y, z) of the region that
+  // lies within the region
+  void ClipLine(long y, long z, Line &out) const;
+
+  // Find or create the vertex at a voxel corner (corners range from 0 to
+  // the region size along each axis, and k is the current slice or the
+  // next one)
+  VertexId GetVertex(long i, long j, long k);
+
+  // Add the face along axis d between the voxel v and the voxel v + e_d,
+  // where either voxel may lie outside of the region
+  void AddFace(int d, long x, long y, long z, LabelType lower, LabelType upper);
+
+  // Add the faces along axis d (1 or 2) between two neighboring lines.
+  // Either line may be null, standing for a line of background outside of
+  // the region. (y, z) is the index of the lower line.
+  void AddFacesBetweenLines(int d, const Line *lower, const Line *upper,
+                            long y, long z);
+
+  // Surface nets relaxation of the vertex positions
+  void Relax();
+
+  // The input image, the requested region, and the region actually swept
+  itk::SmartPointer<const InputImageType> m_Image;
+  RegionType m_RequestedRegion;
+  bool m_UseRequestedRegion;
+  RegionType m_Region;
+  long m_Size[3];
+
+  unsigned int m_RelaxationIterations;
+  bool m_AdjacencyOnly;
+
+  // Vertex ids of the corners in the planes z and z + 1 of the current
+  // slice z, and the corners of each plane that have a vertex
+  std::vector<VertexId> m_CornerPlane[2];
+  std::vector<size_t> m_UsedCorners[2];
+  long m_PlaneZ;
+
+  // Shared vertices: corner indices and relaxed positions in voxel units
+  std::vector<CornerKey> m_Corners;
+  std::vector<float> m_Positions;
+
+  // Faces of each label, as four vertices ordered counter-clockwise when
+  // seen from outside of the label
+  typedef std::unordered_map<LabelType, std::vector<VertexId> > FaceMap;
+  FaceMap m_Faces;
+  LabelType m_LastLabel;
+  std::vector<VertexId> *m_LastFaces;
+
+  // Pairs of labels sharing a boundary, smaller label first
+  std::set<std::pair<LabelType, LabelType> > m_Adjacency;
+
+  // Unique edges of the surfaces, in compressed row format
+  std::vector<size_t> m_EdgeStart;
+  std::vector<VertexId> m_EdgeEnd;
+};
+
+#endif // MULTILABELSURFACENETS_H
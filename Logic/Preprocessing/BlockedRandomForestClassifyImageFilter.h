@@ -0,0 +1,122 @@
+#ifndef BLOCKEDRANDOMFORESTCLASSIFYIMAGEFILTER_H
+#define BLOCKEDRANDOMFORESTCLASSIFYIMAGEFILTER_H
+
+#include "itkImageToImageFilter.h"
+#include "SNAPCommon.h"
+#include "RFForestAccess.h"
+#include <vector>
+
+template <class TPixel, class TLabel, int VDim> class RandomForestClassifier;
+
+/**
+ * @brief Computes the random forest speed image from multiple multi-component
+ * images, classifying the voxels a tile at a time.
+ *
+ * The output agrees with that of RandomForestClassifyImageFilter, which
+ * classifies one voxel at a time by walking every tree of the forest, to
+ * within one unit of the output pixel type: the class probabilities are
+ * summed in a different order, which may change the rounding of the output
+ * value. BlockedRandomForestTest checks this tolerance. Here
+ * the features of a tile of voxels are gathered into a structure-of-arrays
+ * buffer, one array of TileSize values per feature, and each tree is walked
+ * for all the voxels of the tile before moving on to the next tree. The
+ * nodes of the tree being walked then stay in the cache for the whole tile.
+ * The trees are flattened into arrays of nodes by RFForestAccess before each
+ * update.
+ *
+ * The filter is not yet used by the preprocessing pipeline, which still runs
+ * RandomForestClassifyImageFilter.
+ */
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+class BlockedRandomForestClassifyImageFilter :
+    public itk::ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+
+  /** Pixel Type of the input image */
+  typedef TInputImage                                    InputImageType;
+  typedef typename InputImageType::PixelType             InputPixelType;
+  typedef typename InputImageType::RegionType      InputImageRegionType;
+
+  /** Define the corresponding vector image */
+  typedef TInputVectorImage                        InputVectorImageType;
+
+  /** Pixel Type of the output image */
+  typedef TOutputImage                                  OutputImageType;
+  typedef typename OutputImageType::PixelType           OutputPixelType;
+  typedef typename OutputImageType::RegionType    OutputImageRegionType;
+  typedef typename OutputImageType::Pointer          OutputImagePointer;
+
+  /** Standard class typedefs. */
+  typedef BlockedRandomForestClassifyImageFilter                   Self;
+  typedef itk::ImageSource<OutputImageType>                  Superclass;
+  typedef itk::SmartPointer<Self>                               Pointer;
+  typedef itk::SmartPointer<const Self>                    ConstPointer;
+
+  /** Method for creation through the object factory. */
+  itkNewMacro(Self)
+
+  /** Image dimension. */
+  itkStaticConstMacro(ImageDimension, unsigned int,
+                      TInputImage::ImageDimension);
+
+  /** Classifier type */
+  typedef RandomForestClassifier<InputPixelType, TLabel, ImageDimension> ClassifierType;
+
+  /** Add a scalar input image */
+  void AddScalarImage(InputImageType *image);
+
+  /** Add a vector (multi-component) input image */
+  void AddVectorImage(InputVectorImageType *image);
+
+  /** Set the classifier */
+  void SetClassifier(ClassifierType *classifier);
+
+  /** Get the classifier */
+  itkGetMacro(Classifier, ClassifierType *)
+
+  /** Number of voxels classified together (default 256) */
+  itkSetMacro(TileSize, unsigned int)
+  itkGetMacro(TileSize, unsigned int)
+
+  /** The output also depends on the classifier */
+  itk::ModifiedTimeType GetMTime() const ITK_OVERRIDE;
+
+  /** We need to override this method because of multiple input types */
+  void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+protected:
+
+  BlockedRandomForestClassifyImageFilter();
+  virtual ~BlockedRandomForestClassifyImageFilter() {}
+
+  void PrintSelf(std::ostream& os, itk::Indent indent) const ITK_OVERRIDE;
+
+  void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
+
+  // Output value for a voxel, given its probability for each class
+  OutputPixelType ComputeOutputValue(const double *prob) const;
+
+  typedef RFForestAccess<ClassifierType> ForestAccess;
+  typedef typename ForestAccess::FlatForest FlatForest;
+
+  SmartPtr<ClassifierType> m_Classifier;
+
+  unsigned int m_TileSize;
+
+  // The trees of the classifier, flattened
+  FlatForest m_FlatForest;
+
+  // Weights of the classes, positive for the foreground classes, and the
+  // bias of the classifier
+  std::vector<double> m_ClassWeights;
+  double m_Bias;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "BlockedRandomForestClassifyImageFilter.txx"
+#endif
+
+#endif // BLOCKEDRANDOMFORESTCLASSIFYIMAGEFILTER_H
@@ -0,0 +1,200 @@
+#ifndef BLOCKEDRANDOMFORESTCLASSIFYIMAGEFILTER_TXX
+#define BLOCKEDRANDOMFORESTCLASSIFYIMAGEFILTER_TXX
+
+#include "BlockedRandomForestClassifyImageFilter.h"
+#include "RandomForestClassifier.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "ImageCollectionConstIteratorWithIndex.h"
+#include <algorithm>
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::BlockedRandomForestClassifyImageFilter()
+{
+  m_TileSize = 256;
+  m_Bias = 0.5;
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::AddScalarImage(InputImageType *image)
+{
+  this->AddInput(image);
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::AddVectorImage(InputVectorImageType *image)
+{
+  this->AddInput(image);
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::SetClassifier(ClassifierType *classifier)
+{
+  m_Classifier = classifier;
+
+  // Do not keep the trees of a classifier that is no longer used
+  if(!classifier)
+    m_FlatForest = FlatForest();
+
+  this->Modified();
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+itk::ModifiedTimeType
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::GetMTime() const
+{
+  itk::ModifiedTimeType mtime = Superclass::GetMTime();
+  if(m_Classifier)
+    mtime = std::max(mtime, m_Classifier->GetMTime());
+  return mtime;
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::GenerateInputRequestedRegion()
+{
+  itk::ImageSource<TOutputImage>::GenerateInputRequestedRegion();
+
+  // The patches around the output voxels are sampled from the inputs
+  for( itk::InputDataObjectIterator it( this ); !it.IsAtEnd(); it++ )
+    {
+    itk::ImageBase<ImageDimension> *input =
+        dynamic_cast<itk::ImageBase<ImageDimension> *>(it.GetInput());
+    if(input)
+      {
+      InputImageRegionType inputRegion;
+      this->CallCopyOutputRegionToInputRegion( inputRegion, this->GetOutput()->GetRequestedRegion() );
+      if(m_Classifier)
+        inputRegion.PadByRadius(m_Classifier->GetPatchRadius());
+      inputRegion.Crop(input->GetLargestPossibleRegion());
+      input->SetRequestedRegion(inputRegion);
+      }
+    }
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::PrintSelf(std::ostream &os, itk::Indent indent) const
+{
+  os << indent << "BlockedRandomForestClassifyImageFilter" << std::endl;
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::BeforeThreadedGenerateData()
+{
+  assert(m_Classifier);
+
+  // The forest is flattened once per update and shared by the threads
+  ForestAccess::Flatten(m_Classifier, m_FlatForest);
+
+  const typename ClassifierType::WeightArray &weights = m_Classifier->GetClassWeights();
+  m_ClassWeights.assign(weights.begin(), weights.end());
+  m_ClassWeights.resize(m_FlatForest.NumberOfClasses, 0.0);
+  m_Bias = m_Classifier->GetBiasParameter();
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+typename BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>::OutputPixelType
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::ComputeOutputValue(const double *prob) const
+{
+  // The class probabilities are the averages over the trees. Their sum,
+  // positive for foreground classes and negative for background classes,
+  // is shifted towards the foreground by a bias above 0.5
+  int nTrees = (int) m_FlatForest.Roots.size();
+  double p = 0;
+  for(int c = 0; c < m_FlatForest.NumberOfClasses; c++)
+    p += m_ClassWeights[c] * prob[c];
+  p = p / nTrees + 2.0 * m_Bias - 1.0;
+
+  return (OutputPixelType)(std::max(-1.0, std::min(1.0, p)) * 0x7fff);
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage, class TLabel>
+void
+BlockedRandomForestClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage, TLabel>
+::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
+{
+  OutputImagePointer outputPtr = this->GetOutput(0);
+
+  typedef itk::ImageRegionIteratorWithIndex<TOutputImage> OutputIter;
+  OutputIter it_out(outputPtr, outputRegionForThread);
+
+  // Create a collection iterator
+  typedef ImageCollectionConstIteratorWithIndex<TInputImage, TInputVectorImage> CollectionIter;
+
+  // Configure the input collection iterator
+  CollectionIter cit(m_Classifier->GetPatchRadius(), outputRegionForThread);
+  for( itk::InputDataObjectIterator it( this ); !it.IsAtEnd(); it++ )
+    cit.AddImage(it.GetInput());
+
+  // The patch features, ordered by component and then by patch location,
+  // followed by the coordinates if they are used
+  int nPatch = cit.GetTotalComponents() * cit.GetNeighborhoodSize();
+  bool useCoordinates = m_Classifier->GetUseCoordinateFeatures();
+  int nFeatures = useCoordinates ? nPatch + ImageDimension : nPatch;
+
+  // The flattened trees
+  const FlatForest &ff = m_FlatForest;
+  const int *feature = ff.Feature.data(), *child = ff.Child.data();
+  const float *threshold = ff.Threshold.data();
+  int nClass = ff.NumberOfClasses;
+
+  // The features of a tile, one array of TileSize values per feature, and
+  // the sums of the class probabilities of the leaves, one row per voxel
+  const int TILE = (int) m_TileSize;
+  std::vector<float> x_tile(nFeatures * TILE);
+  std::vector<double> prob(TILE * nClass);
+  vnl_vector<double> x(nPatch);
+
+  while ( !it_out.IsAtEnd() )
+    {
+    // Gather the features of a tile of voxels
+    OutputIter it_tile = it_out;
+    int nt = 0;
+    for(; nt < TILE && !it_out.IsAtEnd(); ++nt, ++it_out, ++cit)
+      {
+      cit.GetNeighborhoodValues(x);
+      for(int f = 0; f < nPatch; f++)
+        x_tile[f * TILE + nt] = (float) x[f];
+
+      if(useCoordinates)
+        for(unsigned int d = 0; d < ImageDimension; d++)
+          x_tile[(nPatch + d) * TILE + nt] = (float) it_out.GetIndex()[d];
+      }
+
+    // Walk each tree for all the voxels of the tile
+    std::fill(prob.begin(), prob.begin() + nt * nClass, 0.0);
+    for(int root : ff.Roots)
+      {
+      for(int i = 0; i < nt; i++)
+        {
+        int n = root;
+        while(feature[n] >= 0)
+          n = child[n] + (x_tile[feature[n] * TILE + i] < threshold[n] ? 0 : 1);
+
+        const double *leaf = &ff.LeafProbability[child[n] * nClass];
+        double *p = &prob[i * nClass];
+        for(int c = 0; c < nClass; c++)
+          p[c] += leaf[c];
+        }
+      }
+
+    // Store the output values
+    for(int i = 0; i < nt; ++i, ++it_tile)
+      it_tile.Set(this->ComputeOutputValue(&prob[i * nClass]));
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include "EdgeGradientMagnitudeCache.h"
+#include <itkSmoothingRecursiveGaussianImageFilter.h>
+#include <itkGradientMagnitudeImageFilter.h>
+
+EdgeGradientMagnitudeCache::EdgeGradientMagnitudeCache()
+{
+  m_BlurFilter = BlurFilter::New();
+  m_BlurFilter->ReleaseDataFlagOn();
+
+  // The gradient magnitude is kept, it is what this object caches
+  m_GradMagFilter = GradMagFilter::New();
+  m_GradMagFilter->SetInput(m_BlurFilter->GetOutput());
+
+  m_Output = ImageType::New();
+  m_OutputTime = 0;
+}
+
+EdgeGradientMagnitudeCache::~EdgeGradientMagnitudeCache()
+{
+}
+
+void EdgeGradientMagnitudeCache::SetInput(ImageType *image)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  if(image != m_BlurFilter->GetInput())
+    {
+    m_BlurFilter->SetInput(image);
+    this->Modified();
+    }
+}
+
+EdgeGradientMagnitudeCache::ImageType *
+EdgeGradientMagnitudeCache::GetInput() const
+{
+  return const_cast<ImageType *>(m_BlurFilter->GetInput());
+}
+
+EdgeGradientMagnitudeCache::ImageType *
+EdgeGradientMagnitudeCache::Update(float scale)
+{
+  std::lock_guard<std::mutex> lock(m_Mutex);
+
+  // The scale is given in voxels, as it was for the discrete Gaussian
+  ImageType *input = const_cast<ImageType *>(m_BlurFilter->GetInput());
+  input->UpdateOutputInformation();
+
+  BlurFilter::SigmaArrayType sigma;
+  for(unsigned int d = 0; d < 3; d++)
+    sigma[d] = scale * input->GetSpacing()[d];
+
+  // Avoid modifying the filter if the scale is the same
+  if(sigma != m_BlurFilter->GetSigmaArray())
+    m_BlurFilter->SetSigmaArray(sigma);
+
+  // This does nothing if the gradient magnitude is up to date
+  m_GradMagFilter->UpdateLargestPossibleRegion();
+
+  ImageType *gradmag = m_GradMagFilter->GetOutput();
+  if(gradmag->GetMTime() != m_OutputTime)
+    {
+    m_Output->Graft(gradmag);
+    m_OutputTime = gradmag->GetMTime();
+    }
+
+  return m_Output;
+}
+
+itk::ProcessObject *EdgeGradientMagnitudeCache::GetBlurFilter() const
+{
+  return m_BlurFilter;
+}
@@ -0,0 +1,72 @@
+#ifndef EDGEGRADIENTMAGNITUDECACHE_H
+#define EDGEGRADIENTMAGNITUDECACHE_H
+
+#include "SNAPCommon.h"
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkImage.h"
+#include <mutex>
+
+namespace itk {
+  template <class TIn, class TOut> class SmoothingRecursiveGaussianImageFilter;
+  template <class TIn, class TOut> class GradientMagnitudeImageFilter;
+  class ProcessObject;
+}
+
+/**
+ * The gradient magnitude of a Gaussian-blurred image, computed over the
+ * whole image and kept until the image or the blur scale change.
+ *
+ * The blur is a recursive (IIR) Gaussian, so that its cost does not depend
+ * on the scale. Since the recursive filters process entire lines of the
+ * image, computing even one slice takes a pass over most of the volume, and
+ * it is cheaper to compute the whole volume once. The edge preprocessing
+ * filters for the three preview slices and for the whole volume share one
+ * cache, so that changing the remapping parameters, or moving the preview
+ * slices, only re-applies the remapping functor.
+ */
+class EdgeGradientMagnitudeCache : public itk::Object
+{
+public:
+
+  irisITKObjectMacro(EdgeGradientMagnitudeCache, itk::Object)
+
+  typedef itk::Image<float, 3>                                      ImageType;
+
+  /** Set the image to blur */
+  void SetInput(ImageType *image);
+
+  /** Get the image to blur */
+  ImageType *GetInput() const;
+
+  /**
+   * Get the gradient magnitude of the image blurred with the given standard
+   * deviation, in voxel units. It is only recomputed if the image or the
+   * scale have changed. The returned image has no source, so that pipelines
+   * that read from it do not update this cache.
+   */
+  ImageType *Update(float scale);
+
+  /** The filter that takes most of the time, for progress reporting */
+  itk::ProcessObject *GetBlurFilter() const;
+
+protected:
+
+  EdgeGradientMagnitudeCache();
+  virtual ~EdgeGradientMagnitudeCache();
+
+  typedef itk::SmoothingRecursiveGaussianImageFilter<ImageType, ImageType> BlurFilter;
+  typedef itk::GradientMagnitudeImageFilter<ImageType, ImageType>       GradMagFilter;
+
+  SmartPtr<BlurFilter> m_BlurFilter;
+  SmartPtr<GradMagFilter> m_GradMagFilter;
+
+  // Shares the buffer of the gradient magnitude filter's output
+  SmartPtr<ImageType> m_Output;
+  itk::ModifiedTimeType m_OutputTime;
+
+  // The preview filters may be updated from more than one thread
+  std::mutex m_Mutex;
+};
+
+#endif // EDGEGRADIENTMAGNITUDECACHE_H
@@ -38,6 +38,7 @@
 #include "itkCommand.h"
 #include "itkImageToImageFilter.h"
 #include "EdgePreprocessingSettings.h"
+#include "EdgeGradientMagnitudeCache.h"
 
 #include "GPUSettings.h"
 #ifdef SNAP_USE_GPU
@@ -106,6 +107,9 @@ private:
  * 
  * This functor implements a Gaussian blur, followed by a gradient magnitude
  * operator, followed by a 'contrast enhancement' intensity remapping filter.
+ * If the settings select the recursive Gaussian, the blurred gradient
+ * magnitude is taken from an EdgeGradientMagnitudeCache, which may be shared
+ * with other filters applied to the same image.
  */
 template <typename TInputImage,typename TOutputImage>
 class EdgePreprocessingImageFilter: 
@@ -163,6 +167,14 @@ public:
   /** Get the parameters pointer */
   EdgePreprocessingSettings *GetParameters();
 
+  /**
+    Share the blurred gradient magnitude with other filters, when blurring
+    with the recursive Gaussian. The input of the cache must hold the same
+    image as the input of this filter. If NULL, the filter uses a cache of its
+    own input. The filter lets go of the previous cache and of its output.
+    */
+  void SetGradientMagnitudeCache(EdgeGradientMagnitudeCache *cache);
+
 protected:
 
   EdgePreprocessingImageFilter();
@@ -205,6 +217,7 @@ private:
   SmartPtr<BlurFilter> m_BlurFilter;
   SmartPtr<GradMagFilter> m_GradMagFilter;
   SmartPtr<RemapFilter> m_RemapFilter;
+  SmartPtr<EdgeGradientMagnitudeCache> m_GradientMagnitudeCache;
 
 #ifdef SNAP_USE_GPU
   SmartPtr<GPUImageSource> m_GPUImageSource;
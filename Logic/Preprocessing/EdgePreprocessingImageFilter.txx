@@ -56,6 +56,8 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   m_CastFilter = CastFilter::New();
   m_CastFilter->ReleaseDataFlagOn();
 
+  m_RemapFilter = RemapFilter::New();
+
 #ifndef SNAP_USE_GPU
   m_BlurFilter = BlurFilter::New();
   m_BlurFilter->SetInput(m_CastFilter->GetOutput());
@@ -68,6 +70,11 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   m_GradMagFilter = GradMagFilter::New();
   m_GradMagFilter->SetInput(m_BlurFilter->GetOutput());
   m_GradMagFilter->ReleaseDataFlagOn();
+
+  // With the recursive Gaussian, the input of this filter is blurred by a
+  // cache, unless a shared one is provided. The input of the remapping
+  // filter is chosen on each update
+  this->SetGradientMagnitudeCache(NULL);
 #else
   m_GPUImageSource = GPUImageSource::New();
   m_GPUImageSource->SetInput(m_CastFilter->GetOutput());
@@ -87,10 +94,9 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   m_GradMagFilter->SetInput(m_GPUBlurFilter->GetOutput());
   //m_GradMagFilter->SetInput(m_ROIFilter->GetOutput());
   m_GradMagFilter->ReleaseDataFlagOn();
-#endif
 
-  m_RemapFilter = RemapFilter::New();
   m_RemapFilter->SetInput(m_GradMagFilter->GetOutput());
+#endif
 }
 
 template<typename TInputImage,typename TOutputImage>
@@ -113,7 +119,10 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
   pac->SetMiniPipelineFilter(this);
 
 #ifndef SNAP_USE_GPU
-  pac->RegisterInternalFilter(m_BlurFilter, 0.8);
+  if(settings->GetUseRecursiveGaussian())
+    pac->RegisterInternalFilter(m_GradientMagnitudeCache->GetBlurFilter(), 0.8);
+  else
+    pac->RegisterInternalFilter(m_BlurFilter, 0.8);
 #else
   pac->RegisterInternalFilter(m_GPUBlurFilter, 0.8);
 #endif
@@ -125,9 +134,21 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
 
   // Configure the Gaussian
 #ifndef SNAP_USE_GPU
-  m_BlurFilter->SetUseImageSpacingOff();
-  m_BlurFilter->SetVariance(
-        settings->GetGaussianBlurScale() * settings->GetGaussianBlurScale());
+  if(settings->GetUseRecursiveGaussian())
+    {
+    // The blurred gradient magnitude is only computed if the image or the
+    // blur scale have changed, so that changes to the remapping parameters
+    // are fast. The cache provides it as an image without a source.
+    m_RemapFilter->SetInput(
+          m_GradientMagnitudeCache->Update(settings->GetGaussianBlurScale()));
+    }
+  else
+    {
+    m_BlurFilter->SetUseImageSpacingOff();
+    m_BlurFilter->SetVariance(
+          settings->GetGaussianBlurScale() * settings->GetGaussianBlurScale());
+    m_RemapFilter->SetInput(m_GradMagFilter->GetOutput());
+    }
 #else
   m_GPUBlurFilter->SetUseImageSpacingOff();
   m_GPUBlurFilter->SetVariance(
@@ -169,6 +190,31 @@ EdgePreprocessingImageFilter<TInputImage,TOutputImage>
     }
 }
 
+template<typename TInputImage,typename TOutputImage>
+void
+EdgePreprocessingImageFilter<TInputImage,TOutputImage>
+::SetGradientMagnitudeCache(EdgeGradientMagnitudeCache *cache)
+{
+  SmartPtr<EdgeGradientMagnitudeCache> newCache = cache;
+  if(!newCache)
+    {
+    newCache = EdgeGradientMagnitudeCache::New();
+    newCache->SetInput(m_CastFilter->GetOutput());
+    }
+
+  if(newCache != m_GradientMagnitudeCache)
+    {
+    m_GradientMagnitudeCache = newCache;
+
+#ifndef SNAP_USE_GPU
+    // Do not hold on to the output of the previous cache
+    m_RemapFilter->SetInput(nullptr);
+#endif
+
+    this->Modified();
+    }
+}
+
 template<typename TInputImage,typename TOutputImage>
 EdgePreprocessingSettings *
 EdgePreprocessingImageFilter<TInputImage,TOutputImage>
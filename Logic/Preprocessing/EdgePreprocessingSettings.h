@@ -59,6 +59,15 @@ public:
 
   itkGetConstMacro(RemappingExponent,float)
   itkSetMacro(RemappingExponent,float)
+
+  /**
+   * Blur with a recursive Gaussian instead of the discrete one. Its cost does
+   * not depend on the blur scale, and the blurred gradient magnitude of the
+   * whole image is kept between updates, so that changing the remapping
+   * parameters is fast. Off by default.
+   */
+  itkGetConstMacro(UseRecursiveGaussian,bool)
+  itkSetMacro(UseRecursiveGaussian,bool)
   
   /** Compare two sets of settings */
   bool operator == (const EdgePreprocessingSettings &other) const;
@@ -86,6 +95,7 @@ private:
   float m_GaussianBlurScale;
   float m_RemappingSteepness;
   float m_RemappingExponent;
+  bool m_UseRecursiveGaussian;
 };
 
 #endif // __EdgePreprocessingSettings_h_
@@ -1,59 +1,36 @@
 #include "EMGaussianMixtures.h"
+#include <itkMultiThreaderBase.h>
+#include <vnl/vnl_math.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <ctime>
+#include <limits>
 
-EMGaussianMixtures::EMGaussianMixtures(double **x, int dataSize, int dataDim, int numOfClass)
-  :m_x(x), m_numOfData(dataSize), m_dimOfGaussian(dataDim), m_numOfGaussian(numOfClass), m_setPriorFlag(0), m_numOfIteration(0), m_fail(0)
+EMGaussianMixtures::EMGaussianMixtures(const double *x, int dataSize, int dataDim, int numOfClass)
+  :m_x(x), m_numOfData(dataSize), m_dimOfGaussian(dataDim), m_numOfGaussian(numOfClass), m_numOfIteration(0), m_fail(0)
 {
-  m_latent = new double*[dataSize];
-  m_probs = new double[dataSize*numOfClass];
-  for (int i = 0; i < dataSize; i++)
-    {
-    m_latent[i] = &m_probs[i*numOfClass];
-    }
-  m_log_pdf = new double*[dataSize];
-  m_probs2 = new double[dataSize*numOfClass];
-  for (int i = 0; i < dataSize; i++)
-    {
-    m_log_pdf[i] = &m_probs2[i*numOfClass];
-    }
-  m_tmp1 = new double[numOfClass];
-  m_tmp2 = new double[dataDim];
-  m_tmp3 = new double[dataDim*dataDim];
-  m_sum = new double[numOfClass];
-  m_weight = new double[numOfClass];
-
   m_gmm = GaussianMixtureModel::New();
   m_gmm->Initialize(dataDim, numOfClass);
 
   m_maxIteration = 30;
   m_precision = 1.0e-7;
-  m_logLikelihood = std::numeric_limits<double>::infinity();
+  m_parameterTolerance = 1.0e-3;
+  m_batchSize = 0;
+  this->Reset();
 }
 
 EMGaussianMixtures::~EMGaussianMixtures()
 {
-  delete m_probs;
-  delete m_probs2;
-  delete m_latent;
-  delete m_log_pdf;
-  delete m_tmp1;
-  delete m_tmp2;
-  delete m_tmp3;
-  delete m_sum;
-  delete m_weight;
 }
 
 void EMGaussianMixtures::Reset(void)
 {
   m_numOfIteration = 0;
   m_fail = 0;
-  m_logLikelihood = std::numeric_limits<double>::infinity();
-  for (int i = 0; i < m_numOfData*m_numOfGaussian; i++)
-    {
-    m_probs[i] = 0;
-    m_probs2[i] = 0;
-    }
+  m_logLikelihood = -std::numeric_limits<double>::infinity();
+  m_batchStart = 0;
+  m_numOfBatches = 0;
+  m_parameterChange = std::numeric_limits<double>::infinity();
 }
 
 void EMGaussianMixtures::SetMaxIteration(int maxIteration)
@@ -66,6 +43,21 @@ void EMGaussianMixtures::SetPrecision(double precision)
   m_precision = precision;
 }
 
+void EMGaussianMixtures::SetBatchSize(int batchSize)
+{
+  m_batchSize = batchSize;
+}
+
+void EMGaussianMixtures::SetParameterTolerance(double tolerance)
+{
+  m_parameterTolerance = tolerance;
+}
+
+bool EMGaussianMixtures::IsStepwise(void) const
+{
+  return m_batchSize > 0 && m_batchSize < m_numOfData;
+}
+
 void EMGaussianMixtures::SetParameters(int index, const VectorType &mean, const MatrixType &covariance, double weight)
 {
   m_gmm->SetGaussian(index, mean, covariance);
@@ -85,384 +77,363 @@ void EMGaussianMixtures::SetGaussianMixtureModel(GaussianMixtureModel *gmm)
     }
 }
 
-void EMGaussianMixtures::SetPrior(double **prior)
-{
-  m_prior = prior;
-  m_setPriorFlag = 1;
-}
-
-void EMGaussianMixtures::RemovePrior(void)
-{
-  m_prior = 0;
-  m_setPriorFlag = 0;
-}
-
 int EMGaussianMixtures::GetMaxIteration(void)
 {
   return m_maxIteration;
 }
 
-double ** EMGaussianMixtures::Update(void)
+void EMGaussianMixtures::Update(void)
 {
-  double currentLogLikelihood = 0;
   m_numOfIteration = 0;
   m_fail = 0;
-  while ((fabs(m_logLikelihood - currentLogLikelihood) > m_precision) && (m_numOfIteration < m_maxIteration))
+  if(this->IsStepwise())
     {
-    if (m_logLikelihood < currentLogLikelihood)
+    do
       {
-      m_fail = 1;
-      std::cout << "!!!!!! Log Likelihood increase, EM fails" << std::endl;
-      std::cout << "old=" <<m_logLikelihood << std::endl << "new=" << currentLogLikelihood << std::endl;
-      // break;
+      this->UpdateOnce();
       }
-    ++m_numOfIteration;
-    m_logLikelihood = currentLogLikelihood;
-    EvaluatePDF();
-    currentLogLikelihood = EvaluateLogLikelihood();
-    UpdateLatent();
-    UpdateMean();
-    UpdateCovariance();
-    if (m_setPriorFlag == 0)
+    while (m_parameterChange > m_parameterTolerance && m_numOfIteration < m_maxIteration);
+    }
+  else
+    {
+    double previous;
+    do
       {
-      UpdateWeight();
+      previous = m_logLikelihood;
+      this->UpdateOnce();
       }
-
-    std::cout << std::endl <<"=====================" << std::endl;
-    std::cout << "After " << m_numOfIteration << " Iteration:" << std::endl;
-    std::cout << "log likelihood:" << std::endl << m_logLikelihood << std::endl;
-    PrintParameters();
-    //getchar();
+    while (fabs(m_logLikelihood - previous) > m_precision && m_numOfIteration < m_maxIteration);
     }
-  return m_latent;
 }
 
-double ** EMGaussianMixtures::UpdateOnce(void)
+void EMGaussianMixtures::UpdateOnce(void)
 {
-  long start = 0;
-  long end = 0;
-  start = clock();
-  EvaluatePDF();
-  end = clock();
-  std::cout << "evaluate pdf spending " << (end-start)/1000 << std::endl;
-  start = clock();
-  double currentLogLikelihood = EvaluateLogLikelihood();
-  end = clock();
-  std::cout << "evaluate likelihood spending " << (end-start)/1000 << std::endl;
-  if (m_logLikelihood < currentLogLikelihood)
-    {
-    m_fail = 1;
-    std::cout << "!!!!!! Log Likelihood increase, EM fails" << std::endl;
-    std::cout << "old=" <<m_logLikelihood << std::endl << "new=" << currentLogLikelihood << std::endl;
-    }
-  if (fabs(m_logLikelihood - currentLogLikelihood) <= m_precision)
-    {
-    std::cout << "Log Likelihood converged" << std::endl;
-    }
-  if (m_numOfIteration >= m_maxIteration)
+  double previous = m_logLikelihood;
+  long n = m_numOfData;
+
+  if(!this->IsStepwise())
     {
-    std::cout << "Reach the maximum iteration number" << std::endl;
+    // All samples at once
+    Statistics stats;
+    this->PrepareModel();
+    this->AccumulateStatistics(0, n, stats);
+    this->UpdateModel(stats);
+    m_logLikelihood = stats.logLikelihood / n;
+
+    if (m_logLikelihood < previous)
+      {
+      m_fail = 1;
+      std::cout << "!!!!!! Log Likelihood decrease, EM fails" << std::endl;
+      std::cout << "old=" << previous << std::endl << "new=" << m_logLikelihood << std::endl;
+      }
+
+    if (fabs(m_logLikelihood - previous) <= m_precision)
+      {
+      std::cout << "Log Likelihood converged" << std::endl;
+      }
     }
-  ++m_numOfIteration;
-  m_logLikelihood = currentLogLikelihood;
-  
-  start = clock();
-  UpdateLatent();
-  end = clock();
-  std::cout << "latent spending " << (end-start)/1000 << std::endl;
-  start = clock();
-  UpdateMean();
-  end = clock();
-  std::cout << "mean spending " << (end-start)/1000 << std::endl;
-  start = clock();
-  UpdateCovariance();
-  end = clock();
-  std::cout << "covariance spending " << (end-start)/1000 << std::endl;
-  if (m_setPriorFlag == 0)
+  else
     {
-    start = clock();
-    UpdateWeight();
-    end = clock();
-    std::cout << "weight spending " << (end-start)/1000 << std::endl;
-    }
+    // A pass through the samples in mini-batches, taken in turn from the
+    // samples, which are in random order
+    long m = m_batchSize, nBatches = (n + m - 1) / m;
+    double logLikelihood = 0.0;
+    std::vector<double> w0, mu0, sd0;
+    this->GetParameters(w0, mu0, sd0);
+    for(long b = 0; b < nBatches; b++)
+      {
+      Statistics stats, wrap;
+      this->PrepareModel();
+      long i0 = m_batchStart, i1 = std::min(n, i0 + m);
+      this->AccumulateStatistics(i0, i1, stats);
+      if(i1 - i0 < m)
+        {
+        this->AccumulateStatistics(0, m - (i1 - i0), wrap);
+        stats.Add(wrap);
+        }
+      m_batchStart = (i0 + m) % n;
 
-  std::cout << std::endl <<"=====================" << std::endl;
-  std::cout << "After " << m_numOfIteration << " Iteration:" << std::endl;
-  std::cout << "log likelihood:" << std::endl << m_logLikelihood << std::endl;
-  PrintParameters();
-  //getchar();
-  return m_latent;
-}
+      // Step size of stepwise EM, which must decrease, but slowly enough
+      // for the model to forget its initial state
+      double step = pow(m_numOfBatches + 2.0, -0.6);
+      this->UpdateModelStepwise(stats, m, step);
+      m_numOfBatches++;
 
-void EMGaussianMixtures::EvaluatePDF(void)
-{
-  for (int i = 0; i < m_numOfData; i++)
-    {
-    for (int j = 0; j < m_numOfGaussian; j++)
+      logLikelihood += stats.logLikelihood;
+      }
+
+    m_logLikelihood = logLikelihood / (nBatches * m);
+
+    // Largest change of a weight, or of a mean relative to the standard
+    // deviation of its Gaussian before the pass
+    std::vector<double> w1, mu1, sd1;
+    this->GetParameters(w1, mu1, sd1);
+    m_parameterChange = 0.0;
+    for (size_t j = 0; j < w0.size(); j++)
+      m_parameterChange = std::max(m_parameterChange, fabs(w1[j] - w0[j]));
+    for (size_t a = 0; a < mu0.size(); a++)
       {
-      m_log_pdf[i][j] = m_gmm->EvaluateLogPDF(j, m_x[i]);
+      if(vnl_math::isfinite(mu0[a]) && vnl_math::isfinite(mu1[a]) && sd0[a] > 0)
+        m_parameterChange = std::max(m_parameterChange, fabs(mu1[a] - mu0[a]) / sd0[a]);
       }
-    }
-  if (m_setPriorFlag == 0)
-    {
-    for (int j = 0; j < m_numOfGaussian; j++)
+
+    if (m_parameterChange <= m_parameterTolerance)
       {
-      m_weight[j] = m_gmm->GetWeight(j);
+      std::cout << "Parameters converged" << std::endl;
       }
     }
-}
 
-#include <vnl/vnl_math.h>
+  ++m_numOfIteration;
+  std::cout << "After " << m_numOfIteration << " Iteration: "
+            << "log likelihood " << m_logLikelihood << std::endl;
+}
 
-double EMGaussianMixtures::ComputePosterior(int nGauss, double *log_pdf, double *w, double *log_w, int j)
+void EMGaussianMixtures::PrepareModel(void)
 {
-  // Instead of directly computing the expression
-  //   latent[i][j] = w[j] * N(x_i; m_j, Sigma_j) / Sum_k[w[k] * N(x_i; m_k, Sigma_k)]
-  // which is equivalently
-  //   latent[i][j] = exp(a_j) / Sum_k[ exp(a_k) ]
-  // where
-  //   a_j = log( w[j] * N(x_i; m_j, Sigma_j) )
-  // we compute
-  //   latent[i][j] = 1 / (1 + Sum_(k!=j)[ exp(a_k - a_j) ])
-  // which is numerically stable
+  int k = m_numOfGaussian, d = m_dimOfGaussian;
 
-  // If the weight of the class is zero, the posterior is automatically zero
-  if(w[j] == 0)
-    return 0;
+  m_logPDF.SetModel(m_gmm);
 
-  // We are computing m_latent[i][j]
-  double denom = 1.0;
+  m_weight.resize(k);
+  m_logWeight.resize(k);
+  m_delta.resize(k);
+  m_center.resize(k * d);
+  for (int j = 0; j < k; j++)
+    {
+    m_weight[j] = m_gmm->GetWeight(j);
+    m_logWeight[j] = log(m_weight[j]);
+    m_delta[j] = m_gmm->GetGaussian(j)->isDeltaFunction();
+
+    // The moments are taken about the current mean, which is close to the
+    // new mean, so that the covariance is computed accurately in one pass
+    const VectorType &mean = m_gmm->GetMean(j);
+    for (int a = 0; a < d; a++)
+      m_center[j * d + a] = vnl_math::isfinite(mean[a]) ? mean[a] : 0.0;
+    }
+}
 
-  // The log of w[j] * pdf[j];
-  double exp_j = (log_w[j] + log_pdf[j]);
-  for (int k = 0; k < nGauss; k++)
+void EMGaussianMixtures::GetParameters(
+    std::vector<double> &w, std::vector<double> &mu, std::vector<double> &sd)
+{
+  int k = m_numOfGaussian, d = m_dimOfGaussian;
+  w.resize(k);
+  mu.resize(k * d);
+  sd.resize(k * d);
+  for (int j = 0; j < k; j++)
     {
-    if(j != k && w[k] > 0)
+    w[j] = m_gmm->GetWeight(j);
+    const VectorType &mean = m_gmm->GetMean(j);
+    const MatrixType &cov = m_gmm->GetCovariance(j);
+    for (int a = 0; a < d; a++)
       {
-      // The log of (w[k] * pdf[k]) / (w[j] * pdf[j])
-      double exponent = (log_w[k] + log_pdf[k]) - exp_j;
-      if(exponent < -20)
-        {
-        // (w[k] * pdf[k]) / (w[j] * pdf[j]) is effectively zero
-        continue;
-        }
-      else if(exponent > 20)
-        {
-        // latent[i][j] is effectively zero
-        denom = vnl_huge_val(1.0);
-        break;
-        }
-      else
-        {
-        denom += exp(exponent);
-        }
+      mu[j * d + a] = mean[a];
+      sd[j * d + a] = sqrt(std::max(cov(a, a), 0.0));
       }
     }
-
-  // Now compute 1/denom
-  double post = 1.0 / denom;
-  return post;
 }
 
-void EMGaussianMixtures::UpdateLatent(void)
+void EMGaussianMixtures::AccumulateStatistics(long i0, long i1, Statistics &stats)
 {
-  double sum = 0;
-  for (int i = 0; i < m_numOfGaussian; i++)
-    {
-    m_sum[i] = 0;
-    }
+  // The chunks are the same for any number of threads
+  const long CHUNK = 4096;
+  long nChunks = (i1 - i0 + CHUNK - 1) / CHUNK;
+  std::vector<Statistics> chunkStats(nChunks);
 
-  // Compute log of the weights and store in logw
-  vnl_vector<double> logw(m_numOfGaussian);
-  for(int i = 0; i < m_numOfGaussian; i++)
-    logw(i) = log(m_weight[i]);
-  
-  if (m_setPriorFlag == 0)
+  itk::MultiThreaderBase::Pointer mt = itk::MultiThreaderBase::New();
+  mt->ParallelizeArray(0, nChunks, [&](itk::SizeValueType c)
     {
-    for (int i = 0; i < m_numOfData; i++)
-      {
-      for (int j = 0; j < m_numOfGaussian; j++)
-        {
-        m_latent[i][j] = ComputePosterior(m_numOfGaussian, m_log_pdf[i], m_weight, logw.data_block(), j);
-        m_sum[j] += m_latent[i][j];
-        }
+    long c0 = i0 + c * CHUNK, c1 = std::min(i1, c0 + CHUNK);
+    this->AccumulateChunk(c0, c1, chunkStats[c]);
+    }, nullptr);
 
+  stats.Initialize(m_numOfGaussian, m_dimOfGaussian);
+  for (long c = 0; c < nChunks; c++)
+    stats.Add(chunkStats[c]);
+}
 
-      /*
-      sum = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
-        {
-        m_tmp1[j] = m_weight[j] * m_pdf[i][j];
-        sum += m_tmp1[j];
-        }
-      if(sum == 0)
-        {
-        for (int j = 0; j < m_numOfGaussian; j++)
-          {
-          m_latent[i][j] = 1.0 / m_numOfGaussian;
-          m_sum[j] += m_latent[i][j];
-          }
-        }
-      else
-        {
-        for (int j = 0; j < m_numOfGaussian; j++)
-          {
-          m_latent[i][j] = m_tmp1[j] / sum;
-          m_sum[j] += m_latent[i][j];
-          }
-        }
-        */
-      }
-    }
-  else
+void EMGaussianMixtures::AccumulateChunk(long i0, long i1, Statistics &stats)
+{
+  int k = m_numOfGaussian, d = m_dimOfGaussian;
+  long n = i1 - i0;
+  stats.Initialize(k, d);
+
+  // E-step: log-densities of the whole chunk
+  std::vector<double> log_pdf(n * k), delta(d);
+  m_logPDF.Evaluate(m_x + i0 * d, n, log_pdf.data());
+
+  for (long i = 0; i < n; i++)
     {
-    /**= THIS IS NOT USED
-    for (int i = 0; i < m_numOfData; i++)
+    const double *xi = m_x + (i0 + i) * d;
+    double *lp = &log_pdf[i * k];
+
+    // The likelihood leaves out the delta functions
+    double p = 0;
+    for (int j = 0; j < k; j++)
+      {
+      if(!m_delta[j])
+        p += m_weight[j] * exp(lp[j]);
+      }
+    stats.logLikelihood += log(p);
+
+    for (int j = 0; j < k; j++)
       {
-      sum = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
+      double post = ComputePosterior(k, lp, m_weight.data(), m_logWeight.data(), j);
+      if(post == 0)
+        continue;
+
+      // Moments about the reference point, only the upper triangle of the
+      // second moment is accumulated
+      const double *c = &m_center[j * d];
+      double *s = &stats.s[j * d], *S = &stats.S[j * d * d];
+      stats.n[j] += post;
+      for (int a = 0; a < d; a++)
         {
-        m_tmp1[j] = m_prior[i][j] * m_pdf[i][j];
-        sum += m_tmp1[j];
+        delta[a] = xi[a] - c[a];
+        s[a] += post * delta[a];
         }
-      for (int j = 0; j < m_numOfGaussian; j++)
+      for (int a = 0; a < d; a++)
         {
-        m_latent[i][j] = m_tmp1[j] / sum;
-        m_sum[j] += m_latent[i][j];
+        double pa = post * delta[a];
+        for (int b = a; b < d; b++)
+          S[a * d + b] += pa * delta[b];
         }
       }
-      */
     }
 }
 
-void EMGaussianMixtures::UpdateMean(void)
+void EMGaussianMixtures::UpdateModel(const Statistics &stats)
 {
-  for (int i = 0; i < m_numOfGaussian; i++)
+  int k = m_numOfGaussian, d = m_dimOfGaussian;
+  for (int j = 0; j < k; j++)
     {
-    for (int j = 0; j < m_dimOfGaussian; j++)
-      {
-      m_tmp2[j] = 0;
-      }
-    
-    for (int j = 0; j < m_numOfData; j++)
-      {
-      for (int k = 0; k < m_dimOfGaussian; k++)
-        {
-        m_tmp2[k] += m_latent[j][i] * m_x[j][k];
-        }
-      }
+    VectorType mean(d);
+    MatrixType cov(d, d);
+    double nj = stats.n[j];
 
     // This can lead to a possible divide by zero situation. In case the sum
-    // of latent variables for class i is zero, we set the mean of that class
-    // to infinity
-    if(m_sum[i] > 0)
+    // of latent variables for class j is zero, we set the mean of that class
+    // to infinity and the covariance to zero
+    if(nj > 0)
       {
-      for (int j = 0; j < m_dimOfGaussian; j++)
-        {
-        m_tmp2[j] = m_tmp2[j] / m_sum[i];
-        }
+      const double *c = &m_center[j * d], *s = &stats.s[j * d], *S = &stats.S[j * d * d];
+      for (int a = 0; a < d; a++)
+        mean[a] = c[a] + s[a] / nj;
+      for (int a = 0; a < d; a++)
+        for (int b = a; b < d; b++)
+          cov(a, b) = cov(b, a) = S[a * d + b] / nj - (s[a] / nj) * (s[b] / nj);
       }
     else
       {
-      for (int j = 0; j < m_dimOfGaussian; j++)
-        {
-        m_tmp2[j] = - std::numeric_limits<double>::infinity();
-        }
+      mean.fill(-std::numeric_limits<double>::infinity());
+      cov.fill(0.0);
       }
 
-
-    m_gmm->SetMean(i, VectorType(m_tmp2, m_dimOfGaussian));
+    m_gmm->SetGaussian(j, mean, cov);
+    m_gmm->SetWeight(j, nj / m_numOfData);
     }
 }
 
-void EMGaussianMixtures::UpdateCovariance(void)
+void EMGaussianMixtures::UpdateModelStepwise(const Statistics &stats, long size, double step)
 {
-  for (int i = 0; i < m_numOfGaussian; i++)
+  int k = m_numOfGaussian, d = m_dimOfGaussian;
+  for (int j = 0; j < k; j++)
     {
-    const VectorType &current_mean = m_gmm->GetMean(i);
-    
-    for (int j = 0; j < m_dimOfGaussian; j++)
-      {
-      for (int k = 0; k < m_dimOfGaussian; k++)
-        {
-        m_tmp3[j*m_dimOfGaussian+k] = 0;
-        }
-      }
-    
-    for (int j = 0; j < m_numOfData; j++)
+    // The new model is a weighted combination of the current model and of
+    // the model of the batch, i.e., of their sufficient statistics
+    double nj = stats.n[j];
+    VectorType mean = m_gmm->GetMean(j);
+    MatrixType cov = m_gmm->GetCovariance(j);
+    bool empty = !vnl_math::isfinite(mean[0]);
+    double a = empty ? 0.0 : (1 - step) * m_weight[j];
+    double b = step * nj / size;
+    if(a + b <= 0)
       {
-      for (int k = 0; k < m_dimOfGaussian; k++)
-        {
-        m_tmp2[k] = m_x[j][k] - current_mean[k];
-        }
-      for (int k = 0; k < m_dimOfGaussian; k++)
-        {
-        for (int l = 0; l < m_dimOfGaussian; l++)
-          {
-          m_tmp3[k*m_dimOfGaussian+l] += m_tmp2[k] * m_tmp2[l] * m_latent[j][i];
-          }
-        }
+      m_gmm->SetWeight(j, 0.0);
+      continue;
       }
 
-    if(m_sum[i] > 0)
+    // Mean and covariance of the batch
+    VectorType meanB(d, 0.0);
+    MatrixType covB(d, d, 0.0);
+    if(nj > 0)
       {
-      for (int j = 0; j < m_dimOfGaussian*m_dimOfGaussian; j++)
-        {
-        m_tmp3[j] = m_tmp3[j] / m_sum[i];
-        }
+      const double *c = &m_center[j * d], *s = &stats.s[j * d], *S = &stats.S[j * d * d];
+      for (int p = 0; p < d; p++)
+        meanB[p] = c[p] + s[p] / nj;
+      for (int p = 0; p < d; p++)
+        for (int q = p; q < d; q++)
+          covB(p, q) = covB(q, p) = S[p * d + q] / nj - (s[p] / nj) * (s[q] / nj);
       }
-    else
+
+    // Combine the two, each about the new mean
+    VectorType meanNew(d);
+    for (int p = 0; p < d; p++)
+      meanNew[p] = ((empty ? 0.0 : a * mean[p]) + b * meanB[p]) / (a + b);
+
+    MatrixType covNew(d, d);
+    for (int p = 0; p < d; p++)
       {
-      for (int j = 0; j < m_dimOfGaussian*m_dimOfGaussian; j++)
+      for (int q = p; q < d; q++)
         {
-        m_tmp3[j] = 0.0;
+        double va = empty ? 0.0 : a * (cov(p, q) + (mean[p] - meanNew[p]) * (mean[q] - meanNew[q]));
+        double vb = b * (covB(p, q) + (meanB[p] - meanNew[p]) * (meanB[q] - meanNew[q]));
+        covNew(p, q) = covNew(q, p) = (va + vb) / (a + b);
         }
       }
 
-
-    m_gmm->SetCovariance(i, MatrixType(m_tmp3, m_dimOfGaussian, m_dimOfGaussian));
+    m_gmm->SetGaussian(j, meanNew, covNew);
+    m_gmm->SetWeight(j, a + b);
     }
 }
 
-void EMGaussianMixtures::UpdateWeight(void)
+double EMGaussianMixtures::ComputePosterior(int nGauss, const double *log_pdf, const double *w, const double *log_w, int j)
 {
-  for (int i = 0; i < m_numOfGaussian; i++)
-    {
-    m_gmm->SetWeight(i, m_sum[i]/m_numOfData);
-    }
-}
+  // Instead of directly computing the expression
+  //   latent[i][j] = w[j] * N(x_i; m_j, Sigma_j) / Sum_k[w[k] * N(x_i; m_k, Sigma_k)]
+  // which is equivalently
+  //   latent[i][j] = exp(a_j) / Sum_k[ exp(a_k) ]
+  // where
+  //   a_j = log( w[j] * N(x_i; m_j, Sigma_j) )
+  // we compute
+  //   latent[i][j] = 1 / (1 + Sum_(k!=j)[ exp(a_k - a_j) ])
+  // which is numerically stable
 
-double EMGaussianMixtures::EvaluateLogLikelihood(void)
-{
-  double tmp1 = 0;
-  double tmp2 = 0;
-  if (m_setPriorFlag == 0)
+  // If the weight of the class is zero, the posterior is automatically zero
+  if(w[j] == 0)
+    return 0;
+
+  // We are computing m_latent[i][j]
+  double denom = 1.0;
+
+  // The log of w[j] * pdf[j];
+  double exp_j = (log_w[j] + log_pdf[j]);
+  for (int k = 0; k < nGauss; k++)
     {
-    for (int i = 0; i < m_numOfData; i++)
+    if(j != k && w[k] > 0)
       {
-      tmp1 = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
+      // The log of (w[k] * pdf[k]) / (w[j] * pdf[j])
+      double exponent = (log_w[k] + log_pdf[k]) - exp_j;
+      if(exponent < -20)
         {
-        if(!m_gmm->GetGaussian(j)->isDeltaFunction())
-          tmp1 += m_weight[j] * exp(m_log_pdf[i][j]);
+        // (w[k] * pdf[k]) / (w[j] * pdf[j]) is effectively zero
+        continue;
         }
-      tmp2 += log(tmp1);
-      }
-    }
-  else
-    {
-    for (int i = 0; i < m_numOfData; i++)
-      {
-      tmp1 = 0;
-      for (int j = 0; j < m_numOfGaussian; j++)
+      else if(exponent > 20)
+        {
+        // latent[i][j] is effectively zero
+        denom = vnl_huge_val(1.0);
+        break;
+        }
+      else
         {
-        if(!m_gmm->GetGaussian(j)->isDeltaFunction())
-          tmp1 += m_prior[i][j] * exp(m_log_pdf[i][j]);
+        denom += exp(exponent);
         }
-      tmp2 += log(tmp1);
       }
     }
-  return tmp1;
+
+  // Now compute 1/denom
+  double post = 1.0 / denom;
+  return post;
 }
 
 void EMGaussianMixtures::PrintParameters(void)
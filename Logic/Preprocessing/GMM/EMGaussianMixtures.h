@@ -2,12 +2,31 @@
 #define EM_GAUSSIAN_MIXTURES_H
 
 #include "GaussianMixtureModel.h"
+#include "GaussianMixtureLogPDF.h"
 #include "SNAPCommon.h"
+#include <vector>
 
+/**
+ * Expectation-maximization for a Gaussian mixture model.
+ *
+ * The samples are a matrix with one sample per row, which is not copied.
+ * Each iteration splits the samples into fixed chunks, which are processed
+ * by all threads. Each chunk computes the posteriors of its samples and
+ * accumulates the weighted moments of the samples into its own sums, which
+ * are added up in chunk order, so that the result does not depend on the
+ * number of threads.
+ *
+ * With a batch size set, each iteration is a pass through the samples in
+ * mini-batches. After each batch, the model is moved towards the model
+ * estimated from the batch, by a step that decreases with the number of
+ * batches seen (stepwise EM). The log likelihood of such a pass is noisy,
+ * so Update() then stops when a pass no longer changes the parameters by
+ * more than the parameter tolerance.
+ */
 class EMGaussianMixtures
 {
 public:
-  EMGaussianMixtures(double **x, int dataSize, int dataDim, int numOfClass);
+  EMGaussianMixtures(const double *x, int dataSize, int dataDim, int numOfClass);
   ~EMGaussianMixtures();
 
   typedef Gaussian::MatrixType MatrixType;
@@ -21,48 +40,109 @@ public:
                      const MatrixType &covariance,
                      double weight);
   void SetGaussianMixtureModel(GaussianMixtureModel *gmm);
-  void SetPrior(double **prior);
-  void RemovePrior(void);
+
+  /**
+   * Set the number of samples in a mini-batch. With the default of zero,
+   * every iteration uses all of the samples at once.
+   */
+  void SetBatchSize(int batchSize);
+  int GetBatchSize() const { return m_batchSize; }
+
+  /**
+   * Set the largest change of the parameters over a pass at which stepwise
+   * EM is considered converged. The change is that of the weights, and of
+   * the means in units of the standard deviation of their Gaussian.
+   */
+  void SetParameterTolerance(double tolerance);
+
+  /** Largest change of the parameters over the last pass of stepwise EM */
+  double GetParameterChange() const { return m_parameterChange; }
 
   GaussianMixtureModel *GetGaussianMixtureModel() const { return m_gmm; }
 
-  
   int GetMaxIteration(void);
 
-  double ** Update(void);
-  double ** UpdateOnce(void);
-  double EvaluateLogLikelihood(void);
+  /** Iterate until the log likelihood, or with mini-batches the parameters, converge */
+  void Update(void);
+
+  /** Perform one iteration */
+  void UpdateOnce(void);
+
+  /** Average log likelihood of the samples before the last iteration */
+  double GetLogLikelihood() const { return m_logLikelihood; }
+
   void PrintParameters(void);
 
-  static double ComputePosterior(int nGauss, double *log_pdf, double *w, double *log_w, int j);
+  static double ComputePosterior(int nGauss, const double *log_pdf, const double *w, const double *log_w, int j);
 
 private:
-  void EvaluatePDF(void);
-  void UpdateLatent(void);
-  void UpdateMean(void);
-  void UpdateCovariance(void);
-  void UpdateWeight(void);
-  
-  double **m_latent;
-  double **m_log_pdf;
-  double **m_prior;
-  double **m_x;
-  double *m_probs;
-  double *m_probs2;
-  double *m_tmp1;
-  double *m_tmp2;
-  double *m_tmp3;
-  double *m_sum;
-  double *m_weight;
-  double m_logLikelihood;
+
+  // Sums over a set of samples of the posterior of each Gaussian, and of
+  // the first and second moments of the samples about the reference point
+  // of the Gaussian, weighted by the posterior
+  struct Statistics
+  {
+    std::vector<double> n, s, S;
+    double logLikelihood;
+
+    void Initialize(int k, int d)
+    {
+      n.assign(k, 0.0); s.assign(k * d, 0.0); S.assign(k * d * d, 0.0);
+      logLikelihood = 0.0;
+    }
+
+    void Add(const Statistics &other)
+    {
+      for(size_t i = 0; i < n.size(); i++) n[i] += other.n[i];
+      for(size_t i = 0; i < s.size(); i++) s[i] += other.s[i];
+      for(size_t i = 0; i < S.size(); i++) S[i] += other.S[i];
+      logLikelihood += other.logLikelihood;
+    }
+  };
+
+  // Compute the statistics of the samples in the range [i0, i1)
+  void AccumulateStatistics(long i0, long i1, Statistics &stats);
+
+  // Statistics of a chunk of samples, computed by one thread
+  void AccumulateChunk(long i0, long i1, Statistics &stats);
+
+  // Update the model from the statistics of all samples
+  void UpdateModel(const Statistics &stats);
+
+  // Move the model towards the model of a mini-batch of the given size
+  void UpdateModelStepwise(const Statistics &stats, long size, double step);
+
+  // Precompute what the E-step needs from the current model
+  void PrepareModel(void);
+
+  // Whether iterations are passes of stepwise EM
+  bool IsStepwise(void) const;
+
+  // The weights, means and standard deviations of the model, for measuring
+  // how much a pass of stepwise EM changes it
+  void GetParameters(std::vector<double> &w, std::vector<double> &mu, std::vector<double> &sd);
+
+  const double *m_x;
   int m_numOfGaussian;
   int m_dimOfGaussian;
+  int m_numOfData;
   int m_maxIteration;
   int m_numOfIteration;
-  int m_numOfData;
-  int m_setPriorFlag;
+  int m_batchSize;
   int m_fail;
   double m_precision;
+  double m_logLikelihood;
+  double m_parameterTolerance;
+  double m_parameterChange;
+
+  // Mini-batch position in the samples and number of batches seen
+  long m_batchStart;
+  long m_numOfBatches;
+
+  // Log-density evaluator, weights and reference points of the current model
+  GaussianMixtureLogPDF m_logPDF;
+  std::vector<double> m_weight, m_logWeight, m_center;
+  std::vector<bool> m_delta;
 
   SmartPtr<GaussianMixtureModel> m_gmm;
 };
@@ -0,0 +1,206 @@
+#include "GaussianMixtureLogPDF.h"
+#include "GaussianMixtureModel.h"
+#include <vnl/vnl_math.h>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+  #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define GAUSSIANMIXTURELOGPDF_SSE2
+#endif
+
+// y = x - s, for a row of a block
+static inline void SubtractFromRow(const double *x, double s, double *y)
+{
+  const int N = GaussianMixtureLogPDF::BLOCK;
+#if defined(__AVX__)
+  __m256d vs = _mm256_set1_pd(s);
+  for(int l = 0; l < N; l += 4)
+    _mm256_storeu_pd(y + l, _mm256_sub_pd(_mm256_loadu_pd(x + l), vs));
+#elif defined(GAUSSIANMIXTURELOGPDF_SSE2)
+  __m128d vs = _mm_set1_pd(s);
+  for(int l = 0; l < N; l += 2)
+    _mm_storeu_pd(y + l, _mm_sub_pd(_mm_loadu_pd(x + l), vs));
+#else
+  for(int l = 0; l < N; l++)
+    y[l] = x[l] - s;
+#endif
+}
+
+// y = y - a * z, for a row of a block
+static inline void SubtractScaledRow(double a, const double *z, double *y)
+{
+  const int N = GaussianMixtureLogPDF::BLOCK;
+#if defined(__AVX__)
+  __m256d va = _mm256_set1_pd(a);
+  for(int l = 0; l < N; l += 4)
+    _mm256_storeu_pd(y + l, _mm256_sub_pd(_mm256_loadu_pd(y + l),
+                                          _mm256_mul_pd(va, _mm256_loadu_pd(z + l))));
+#elif defined(GAUSSIANMIXTURELOGPDF_SSE2)
+  __m128d va = _mm_set1_pd(a);
+  for(int l = 0; l < N; l += 2)
+    _mm_storeu_pd(y + l, _mm_sub_pd(_mm_loadu_pd(y + l),
+                                    _mm_mul_pd(va, _mm_loadu_pd(z + l))));
+#else
+  for(int l = 0; l < N; l++)
+    y[l] -= a * z[l];
+#endif
+}
+
+// y = s * y and q = q + y^2, for a row of a block
+static inline void ScaleRowAndAddSquare(double s, double *y, double *q)
+{
+  const int N = GaussianMixtureLogPDF::BLOCK;
+#if defined(__AVX__)
+  __m256d vs = _mm256_set1_pd(s);
+  for(int l = 0; l < N; l += 4)
+    {
+    __m256d vy = _mm256_mul_pd(_mm256_loadu_pd(y + l), vs);
+    _mm256_storeu_pd(y + l, vy);
+    _mm256_storeu_pd(q + l, _mm256_add_pd(_mm256_loadu_pd(q + l), _mm256_mul_pd(vy, vy)));
+    }
+#elif defined(GAUSSIANMIXTURELOGPDF_SSE2)
+  __m128d vs = _mm_set1_pd(s);
+  for(int l = 0; l < N; l += 2)
+    {
+    __m128d vy = _mm_mul_pd(_mm_loadu_pd(y + l), vs);
+    _mm_storeu_pd(y + l, vy);
+    _mm_storeu_pd(q + l, _mm_add_pd(_mm_loadu_pd(q + l), _mm_mul_pd(vy, vy)));
+    }
+#else
+  for(int l = 0; l < N; l++)
+    {
+    y[l] *= s;
+    q[l] += y[l] * y[l];
+    }
+#endif
+}
+
+GaussianMixtureLogPDF::GaussianMixtureLogPDF()
+  : m_gmm(NULL), m_numOfGaussian(0), m_dimOfGaussian(0)
+{
+}
+
+void GaussianMixtureLogPDF::SetModel(GaussianMixtureModel *gmm)
+{
+  m_gmm = gmm;
+  m_numOfGaussian = gmm->GetNumberOfGaussians();
+  m_dimOfGaussian = gmm->GetNumberOfComponents();
+
+  int d = m_dimOfGaussian, ntri = d * (d + 1) / 2;
+  m_mean.assign(m_numOfGaussian * d, 0.0);
+  m_factor.assign(m_numOfGaussian * ntri, 0.0);
+  m_logNorm.assign(m_numOfGaussian, 0.0);
+  m_positiveDefinite.assign(m_numOfGaussian, false);
+
+  for(int j = 0; j < m_numOfGaussian; j++)
+    {
+    const Gaussian::VectorType &mean = gmm->GetMean(j);
+    const Gaussian::MatrixType &cov = gmm->GetCovariance(j);
+    std::copy(mean.begin(), mean.end(), m_mean.begin() + j * d);
+
+    // Cholesky decomposition, row by row. The diagonal entries are kept
+    // until the row is done, and then replaced by their inverses.
+    double *L = &m_factor[j * ntri];
+    double logdet = 0.0;
+    bool pd = true;
+    for(int r = 0; r < d && pd; r++)
+      {
+      double *Lr = L + r * (r + 1) / 2;
+      for(int c = 0; c <= r; c++)
+        {
+        const double *Lc = L + c * (c + 1) / 2;
+        double s = cov(r, c);
+        for(int k = 0; k < c; k++)
+          s -= Lr[k] * Lc[k];
+
+        if(c < r)
+          {
+          Lr[c] = s * Lc[c];
+          }
+        else if(s > 0)
+          {
+          Lr[r] = 1.0 / sqrt(s);
+          logdet += log(s);
+          }
+        else
+          {
+          pd = false;
+          }
+        }
+      }
+
+    m_positiveDefinite[j] = pd;
+    m_logNorm[j] = -0.5 * (d * log(2 * vnl_math::pi) + logdet);
+    }
+}
+
+void GaussianMixtureLogPDF::EvaluateBlock(int j, const double *xt, int n, double *y, double *out) const
+{
+  const int N = BLOCK;
+  int d = m_dimOfGaussian, ntri = d * (d + 1) / 2;
+
+  if(!m_positiveDefinite[j])
+    {
+    Gaussian *g = m_gmm->GetGaussian(j);
+    Gaussian::VectorType xv(d), scratch(d);
+    for(int l = 0; l < n; l++)
+      {
+      for(int c = 0; c < d; c++)
+        xv[c] = xt[c * N + l];
+      out[l] = g->EvaluateLogPDF(xv, scratch);
+      }
+    return;
+    }
+
+  // Forward substitution, one row of the block at a time, accumulating the
+  // squared norm of z in out
+  const double *mean = &m_mean[j * d];
+  const double *L = &m_factor[j * ntri];
+  std::fill(out, out + N, 0.0);
+  for(int r = 0; r < d; r++)
+    {
+    const double *Lr = L + r * (r + 1) / 2;
+    double *yr = y + r * N;
+    SubtractFromRow(xt + r * N, mean[r], yr);
+    for(int c = 0; c < r; c++)
+      SubtractScaledRow(Lr[c], y + c * N, yr);
+    ScaleRowAndAddSquare(Lr[r], yr, out);
+    }
+
+  for(int l = 0; l < n; l++)
+    out[l] = m_logNorm[j] - 0.5 * out[l];
+}
+
+void GaussianMixtureLogPDF::Evaluate(const double *x, long n, double *log_pdf) const
+{
+  const int N = BLOCK;
+  int d = m_dimOfGaussian, k = m_numOfGaussian;
+
+  // The block of samples, one component per row, and scratch space for the
+  // forward substitution
+  std::vector<double> xt(d * N, 0.0), y(d * N), out(N);
+
+  for(long i0 = 0; i0 < n; i0 += N)
+    {
+    int nb = (int) std::min((long) N, n - i0);
+    const double *xb = x + i0 * d;
+    for(int l = 0; l < nb; l++)
+      for(int c = 0; c < d; c++)
+        xt[c * N + l] = xb[l * d + c];
+
+    // The unused lanes of the last block are computed but not stored
+    for(int l = nb; l < N; l++)
+      for(int c = 0; c < d; c++)
+        xt[c * N + l] = 0.0;
+
+    for(int j = 0; j < k; j++)
+      {
+      this->EvaluateBlock(j, xt.data(), nb, y.data(), out.data());
+      for(int l = 0; l < nb; l++)
+        log_pdf[(i0 + l) * k + j] = out[l];
+      }
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef GAUSSIAN_MIXTURE_LOG_PDF_H
+#define GAUSSIAN_MIXTURE_LOG_PDF_H
+
+#include <vector>
+
+class GaussianMixtureModel;
+
+/**
+ * Evaluates the log of the density of each Gaussian of a mixture model for
+ * many samples at once.
+ *
+ * The Cholesky factor L of each covariance matrix and the log of the
+ * normalizing constant are computed when the model is set. The log-density
+ * of x is then -|z|^2/2 plus the constant, where z solves L z = x - mean.
+ * The samples are processed in blocks, stored one component per row, so
+ * that the forward substitution works on a whole row of a block at a time,
+ * using AVX or SSE2 where the compiler targets them.
+ *
+ * Gaussians whose covariance matrix is not positive definite, including
+ * the delta functions, are evaluated by Gaussian::EvaluateLogPDF(), which
+ * handles the directions of zero variance.
+ *
+ * Evaluate() may be called from several threads at once, as long as the
+ * model is not changed.
+ */
+class GaussianMixtureLogPDF
+{
+public:
+
+  /** Number of samples processed together */
+  enum { BLOCK = 64 };
+
+  GaussianMixtureLogPDF();
+
+  /** Compute the Cholesky factors and normalizers of the model's Gaussians */
+  void SetModel(GaussianMixtureModel *gmm);
+
+  int GetNumberOfGaussians() const { return m_numOfGaussian; }
+  int GetNumberOfComponents() const { return m_dimOfGaussian; }
+
+  /**
+   * Compute the log-density of every Gaussian for n samples, stored one
+   * sample per row in x. The output has one row per sample and one column
+   * per Gaussian.
+   */
+  void Evaluate(const double *x, long n, double *log_pdf) const;
+
+private:
+
+  // Log-density of one Gaussian for a block of samples
+  void EvaluateBlock(int j, const double *xt, int n, double *y, double *out) const;
+
+  GaussianMixtureModel *m_gmm;
+  int m_numOfGaussian;
+  int m_dimOfGaussian;
+
+  // For each Gaussian, the mean, the lower triangle of L by rows with the
+  // inverse of the diagonal in place of the diagonal, and the normalizer
+  std::vector<double> m_mean;
+  std::vector<double> m_factor;
+  std::vector<double> m_logNorm;
+  std::vector<bool> m_positiveDefinite;
+};
+
+#endif
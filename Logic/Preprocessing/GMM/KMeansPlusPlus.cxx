@@ -3,7 +3,7 @@
 #include "time.h"
 #include "stdlib.h"
 
-KMeansPlusPlus::KMeansPlusPlus(double **x, int dataSize, int dataDim, int numOfClusters)
+KMeansPlusPlus::KMeansPlusPlus(const double *x, int dataSize, int dataDim, int numOfClusters)
   :m_dataSize(dataSize), m_dataDim(dataDim), m_numOfClusters(numOfClusters)
 {
   m_x = x;
@@ -48,7 +48,7 @@ void KMeansPlusPlus::Initialize(void)
   for (int i = 0; i < m_dataSize; i++)
     {
     m_xCenter[i] = m_centers[0];
-    m_distance[i] = Distance(m_x[i], m_x[m_centers[0]]);
+    m_distance[i] = Distance(m_x + i * m_dataDim, m_x + m_centers[0] * m_dataDim);
     distSum += m_distance[i];
     }
   m_xCounter[0] = m_dataSize;
@@ -75,7 +75,7 @@ void KMeansPlusPlus::Initialize(void)
     distSum = 0;
     for (int j = 0; j < m_dataSize; j++)
       {
-      if (m_distance[j] > Distance(m_x[j], m_x[m_centers[i]]))
+      if (m_distance[j] > Distance(m_x + j * m_dataDim, m_x + m_centers[i] * m_dataDim))
         {
         ++m_xCounter[i];
         for (int k = 0; k < i; k++)
@@ -86,7 +86,7 @@ void KMeansPlusPlus::Initialize(void)
             break;
             }
           }
-        m_distance[j] = Distance(m_x[j], m_x[m_centers[i]]);
+        m_distance[j] = Distance(m_x + j * m_dataDim, m_x + m_centers[i] * m_dataDim);
         m_xCenter[j] = m_centers[i];
         }
       distSum += m_distance[j];
@@ -108,7 +108,7 @@ void KMeansPlusPlus::Initialize(void)
         tmpMean = m_gmm->GetMean(j);
         for (int k = 0; k < m_dataDim; k++)
           {
-          tmpMean[k] = tmpMean[k] + m_x[i][k];
+          tmpMean[k] = tmpMean[k] + m_x[i * m_dataDim + k];
           }
         m_gmm->SetMean(j, tmpMean);
         break;
@@ -146,7 +146,7 @@ void KMeansPlusPlus::Initialize(void)
       {
       if (m_xCenter[i] == m_centers[j])
         {
-        double dist = Distance(m_x[i], m_gmm->GetMean(j).data_block());
+        double dist = Distance(m_x + i * m_dataDim, m_gmm->GetMean(j).data_block());
         if (radius[j] < dist)
           {
           radius[j] = dist;
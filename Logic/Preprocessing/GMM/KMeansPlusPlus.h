@@ -7,14 +7,14 @@
 class KMeansPlusPlus
 {
 public:
-  KMeansPlusPlus(double **x, int dataSize, int dataDim, int numOfClusters);
+  KMeansPlusPlus(const double *x, int dataSize, int dataDim, int numOfClusters);
   ~KMeansPlusPlus();
 
   double Distance(const double *x, const double *y);
   void Initialize(void);
   GaussianMixtureModel * GetGaussianMixtureModel(void);
 private:
-  double **m_x;
+  const double *m_x;
   int *m_xCenter;
   int *m_centers;
   int *m_xCounter;
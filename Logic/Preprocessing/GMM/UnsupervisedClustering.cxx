@@ -12,8 +12,8 @@ UnsupervisedClustering::UnsupervisedClustering()
 {
   m_ClusteringEM = NULL;
   m_NumberOfClusters = 3;
-  m_DataArray = NULL;
   m_NumberOfSamples = 0;
+  m_BatchSize = 65536;
 }
 
 UnsupervisedClustering::~UnsupervisedClustering()
@@ -23,17 +23,6 @@ UnsupervisedClustering::~UnsupervisedClustering()
     delete m_ClusteringEM;
     delete m_ClusteringInitializer;
     }
-
-  if(m_DataArray)
-    {
-    // Delete the main data buffer
-    delete m_DataArray[0];
-
-    // Delete the pointers into the buffer
-    delete m_DataArray;
-    }
-
-
 }
 
 
@@ -44,8 +33,10 @@ void UnsupervisedClustering::SetDataSource(SNAPImageData *imageData)
     m_DataSource = imageData;
     m_SamplesDirty = true;
 
+    // EM is multi-threaded and fast enough to use many samples, which keeps
+    // the clusters from changing between runs due to sampling
     int nvox = m_DataSource->GetMain()->GetNumberOfVoxels();
-    m_NumberOfSamples = (nvox > 10000) ? 10000 : nvox;
+    m_NumberOfSamples = (nvox > 1000000) ? 1000000 : nvox;
     }
 }
 
@@ -59,15 +50,6 @@ void UnsupervisedClustering::SetMixtureModel(GaussianMixtureModel *model)
 
 void UnsupervisedClustering::SampleDataSource()
 {
-  if(m_DataArray)
-    {
-    // Delete the main data buffer
-    delete m_DataArray[0];
-
-    // Delete the pointers into the buffer
-    delete m_DataArray;
-    }
-
   // Figure out the number of data components
   unsigned int nComp = 0;
   for(LayerIterator lit = m_DataSource->GetLayers(
@@ -82,10 +64,7 @@ void UnsupervisedClustering::SampleDataSource()
   int nsam = (m_NumberOfSamples == 0) ? nvox : m_NumberOfSamples;
 
   // Create data structure for the EM code
-  m_DataArray = new double *[nsam];
-  double *buffer = new double[nsam * nComp];
-  for(int i = 0; i < nsam; i++, buffer+=nComp)
-    m_DataArray[i] = buffer;
+  m_DataArray.assign((size_t) nsam * nComp, 0.0);
 
   // Create a random walk through the speed image, which should be initialized
   // at this point. We iterate over the speed image because we can easily access
@@ -118,9 +97,13 @@ void UnsupervisedClustering::SampleDataSource()
     for(LayerIterator lit = m_DataSource->GetLayers(MAIN_ROLE | OVERLAY_ROLE);
         !lit.IsAtEnd(); ++lit)
       {
+      // The sample is copied into the row, since constructing a vnl_vector
+      // from a pointer copies the data
       ImageWrapperBase *iw = lit.GetLayer();
-      vnl_vector<double> svec(m_DataArray[pVoxel] + iOffset, iw->GetNumberOfComponents());
+      vnl_vector<double> svec(iw->GetNumberOfComponents());
       iw->SampleIntensityAtReferenceIndex(idx, iw->GetTimePointIndex(), false, svec);
+      std::copy(svec.begin(), svec.begin() + iw->GetNumberOfComponents(),
+                m_DataArray.begin() + (size_t) pVoxel * nComp + iOffset);
       iOffset += iw->GetNumberOfComponents();
       }
 
@@ -156,6 +139,13 @@ void UnsupervisedClustering::SetNumberOfSamples(int nSamples)
     }
 }
 
+void UnsupervisedClustering::SetBatchSize(int batchSize)
+{
+  m_BatchSize = batchSize;
+  if(m_ClusteringEM)
+    m_ClusteringEM->SetBatchSize(batchSize);
+}
+
 void UnsupervisedClustering::InitializeClusters()
 {
   this->InitializeEM();
@@ -167,7 +157,7 @@ void UnsupervisedClustering::InitializeEM()
   assert(m_DataSource);
 
   // Make sure samples exist
-  if(m_SamplesDirty || m_DataArray == NULL)
+  if(m_SamplesDirty || m_DataArray.empty())
     this->SampleDataSource();
 
   if(m_ClusteringEM)
@@ -178,12 +168,12 @@ void UnsupervisedClustering::InitializeEM()
 
   // Allocate the EM algorithm
   m_ClusteringEM = new EMGaussianMixtures(
-        m_DataArray, m_NumberOfVoxels,
+        m_DataArray.data(), m_NumberOfVoxels,
         m_NumberOfComponents, m_NumberOfClusters);
 
   // Allocate the K means ++
   m_ClusteringInitializer = new KMeansPlusPlus(
-        m_DataArray, m_NumberOfVoxels,
+        m_DataArray.data(), m_NumberOfVoxels,
         m_NumberOfComponents, m_NumberOfClusters);
 
   m_ClusteringInitializer->Initialize();
@@ -192,6 +182,7 @@ void UnsupervisedClustering::InitializeEM()
         m_ClusteringInitializer->GetGaussianMixtureModel());
 
   m_ClusteringEM->SetMaxIteration(10);
+  m_ClusteringEM->SetBatchSize(m_BatchSize);
 
   // Get the GMM
   m_MixtureModel = m_ClusteringEM->GetGaussianMixtureModel();
@@ -222,7 +213,7 @@ void UnsupervisedClustering::SortClustersByRelevance()
     int s = m_CenterSamples[i];
     for(int k = 0; k < ng; k++)
       {
-      log_pdf[k] = m_MixtureModel->EvaluateLogPDF(k, m_DataArray[s]);
+      log_pdf[k] = m_MixtureModel->EvaluateLogPDF(k, &m_DataArray[(size_t) s * m_NumberOfComponents]);
       }
 
     for(int k = 0; k < ng; k++)
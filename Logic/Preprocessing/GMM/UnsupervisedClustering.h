@@ -4,6 +4,7 @@
 #include <itkObject.h>
 #include <itkObjectFactory.h>
 #include <SNAPCommon.h>
+#include <vector>
 
 class KMeansPlusPlus;
 class EMGaussianMixtures;
@@ -22,6 +23,13 @@ public:
 
   irisGetMacro(NumberOfSamples, int)
 
+  /**
+   * Number of samples in each mini-batch of EM. When there are more samples
+   * than this, each iteration is a pass of stepwise EM through the samples
+   * in mini-batches, which converges in fewer passes than batch EM.
+   */
+  irisGetMacro(BatchSize, int)
+
   irisGetMacro(MixtureModel, GaussianMixtureModel *)
 
   void SetMixtureModel(GaussianMixtureModel *model);
@@ -30,6 +38,8 @@ public:
 
   void SetNumberOfSamples(int nSamples);
 
+  void SetBatchSize(int batchSize);
+
   void InitializeClusters();
 
   void Iterate();
@@ -51,11 +61,13 @@ protected:
   SNAPImageData *m_DataSource;
 
   int m_NumberOfClusters, m_NumberOfComponents, m_NumberOfVoxels, m_NumberOfSamples;
+  int m_BatchSize;
 
   bool m_SamplesDirty;
 
+  // The samples, one per row
   // TODO: probably double is larger than we need
-  double **m_DataArray;
+  std::vector<double> m_DataArray;
 
   // A set of samples located near the center of the image, used to sort
   // initial clusters in terms of relevance to the user
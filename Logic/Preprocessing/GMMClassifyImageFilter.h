@@ -3,10 +3,22 @@
 
 #include "itkImageToImageFilter.h"
 #include "GaussianMixtureModel.h"
+#include "GaussianMixtureLogPDF.h"
+#include <vector>
 
 /**
  * @brief A class that takes multiple multi-component images and uses a
  * Gaussian mixture model to combine them into a single probability map.
+ *
+ * The Cholesky factors of the covariance matrices are computed once, when
+ * the means or covariances of the model change, and the voxels are
+ * evaluated in batches by GaussianMixtureLogPDF.
+ *
+ * With CacheLogPDF on, the filter keeps the log-densities of the voxels in
+ * the last requested region. When only the weights of the clusters or the
+ * foreground clusters change, and the region and inputs are the same, the
+ * output is recomputed from the cached log-densities. This is meant for
+ * the preview of a slice, which is updated as the user drags the weights.
  */
 template <class TInputImage, class TInputVectorImage, class TOutputImage>
 class GMMClassifyImageFilter :
@@ -51,6 +63,10 @@ public:
   /** Set the mixture model */
   void SetMixtureModel(GaussianMixtureModel *model);
 
+  /** Keep the log-densities of the last requested region (default off) */
+  itkSetMacro(CacheLogPDF, bool)
+  itkGetMacro(CacheLogPDF, bool)
+
   /** We need to override this method because of multiple input types */
   void GenerateInputRequestedRegion() ITK_OVERRIDE;
 
@@ -61,9 +77,37 @@ protected:
 
   void PrintSelf(std::ostream& os, itk::Indent indent) const ITK_OVERRIDE;
 
+  void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  void AfterThreadedGenerateData() ITK_OVERRIDE;
+
   void DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread) ITK_OVERRIDE;
 
+  // Output value for a voxel, given the log-density of each Gaussian
+  OutputPixelType ComputeOutputValue(const double *log_pdf) const;
+
+  // Position of a voxel of the cached region in the cache
+  long GetCacheOffset(const itk::Index<ImageDimension> &idx) const;
+
   GaussianMixtureModel *m_MixtureModel;
+
+  // Log-densities of the Gaussians, and the means and covariances that
+  // they were computed from
+  GaussianMixtureLogPDF m_LogPDF;
+  std::vector<double> m_GaussianParameters;
+
+  // Weights, their logs, and 1 for foreground or -1 for background clusters
+  std::vector<double> m_Weight, m_LogWeight, m_Sign;
+
+  // Cache of the log-densities, one row per voxel of the cached region
+  bool m_CacheLogPDF;
+  std::vector<double> m_Cache;
+  OutputImageRegionType m_CacheRegion;
+  std::vector<itk::ModifiedTimeType> m_CacheInputTimes;
+  bool m_CacheFilled;
+
+  // Whether the current update reads the output from the cache
+  bool m_UseCache;
 };
 
 #ifndef ITK_MANUAL_INSTANTIATION
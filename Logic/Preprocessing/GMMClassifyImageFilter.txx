@@ -3,14 +3,19 @@
 
 #include "GMMClassifyImageFilter.h"
 #include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
 #include "EMGaussianMixtures.h"
 #include "ImageCollectionConstIteratorWithIndex.h"
+#include <algorithm>
 
 template <class TInputImage, class TInputVectorImage, class TOutputImage>
 GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
 ::GMMClassifyImageFilter()
 {
   m_MixtureModel = NULL;
+  m_CacheLogPDF = false;
+  m_CacheFilled = false;
+  m_UseCache = false;
 }
 
 template <class TInputImage, class TInputVectorImage, class TOutputImage>
@@ -25,6 +30,15 @@ GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
 ::SetMixtureModel(GaussianMixtureModel *model)
 {
   m_MixtureModel = model;
+
+  // Without a model, there is nothing to reuse
+  if(!model)
+    {
+    m_GaussianParameters.clear();
+    m_Cache.clear();
+    m_CacheFilled = false;
+    }
+
   this->Modified();
 }
 
@@ -84,35 +98,131 @@ GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
 template <class TInputImage, class TInputVectorImage, class TOutputImage>
 void
 GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
-::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
+::BeforeThreadedGenerateData()
 {
-  // Get the number of inputs
   assert(m_MixtureModel);
-  OutputImagePointer outputPtr = this->GetOutput(0);
+  int ng = m_MixtureModel->GetNumberOfGaussians();
+  int nc = m_MixtureModel->GetNumberOfComponents();
 
-  // Create a collection iterator
-  typedef ImageCollectionConstIteratorWithIndex<TInputImage, TInputVectorImage> CollectionIter;
+  // Weights and signs of the clusters, which are cheap to recompute
+  m_Weight.resize(ng);
+  m_LogWeight.resize(ng);
+  m_Sign.resize(ng);
+  for(int k = 0; k < ng; k++)
+    {
+    m_Sign[k] = m_MixtureModel->IsForeground(k) ? 1.0 : -1.0;
+    m_Weight[k] = m_MixtureModel->GetWeight(k);
+    m_LogWeight[k] = log(m_Weight[k]);
+    }
+
+  // The model does not report its own changes, so compare the means and
+  // covariances to those the Cholesky factors were computed from
+  std::vector<double> param;
+  param.reserve(ng * nc * (nc + 1));
+  for(int k = 0; k < ng; k++)
+    {
+    const Gaussian::VectorType &mean = m_MixtureModel->GetMean(k);
+    const Gaussian::MatrixType &cov = m_MixtureModel->GetCovariance(k);
+    param.insert(param.end(), mean.begin(), mean.end());
+    param.insert(param.end(), cov.begin(), cov.end());
+    }
+
+  bool sameGaussians =
+      param == m_GaussianParameters
+      && m_LogPDF.GetNumberOfGaussians() == ng
+      && m_LogPDF.GetNumberOfComponents() == nc;
 
-  typedef itk::ImageRegionIterator<TOutputImage> OutputIter;
+  if(!sameGaussians)
+    {
+    m_LogPDF.SetModel(m_MixtureModel);
+    m_GaussianParameters.swap(param);
+    }
+
+  // The cache can be used if neither the Gaussians, nor the region, nor
+  // the inputs have changed since it was filled
+  const OutputImageRegionType &region = this->GetOutput()->GetRequestedRegion();
+  std::vector<itk::ModifiedTimeType> inputTimes;
+  for( itk::InputDataObjectIterator it( this ); !it.IsAtEnd(); it++ )
+    inputTimes.push_back(it.GetInput()->GetMTime());
+
+  m_UseCache =
+      m_CacheLogPDF && m_CacheFilled && sameGaussians
+      && region == m_CacheRegion && inputTimes == m_CacheInputTimes;
+
+  if(m_CacheLogPDF && !m_UseCache)
+    {
+    m_CacheRegion = region;
+    m_CacheInputTimes = inputTimes;
+    m_Cache.resize(region.GetNumberOfPixels() * ng);
+    m_CacheFilled = false;
+    }
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage>
+void
+GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
+::AfterThreadedGenerateData()
+{
+  // The cache is only valid once every thread has filled its part
+  if(m_CacheLogPDF)
+    m_CacheFilled = true;
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage>
+typename GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>::OutputPixelType
+GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
+::ComputeOutputValue(const double *log_pdf) const
+{
+  // Sum of the posteriors, positive for foreground clusters and negative
+  // for background clusters
+  int ng = (int) m_Weight.size();
+  double pdiff = 0;
+  for(int k = 0; k < ng; k++)
+    {
+    double p = EMGaussianMixtures::ComputePosterior(
+          ng, log_pdf, m_Weight.data(), m_LogWeight.data(), k);
+    pdiff += p * m_Sign[k];
+    }
+
+  return (OutputPixelType)(pdiff * 0x7fff);
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage>
+long
+GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
+::GetCacheOffset(const itk::Index<ImageDimension> &idx) const
+{
+  long offset = 0, stride = 1;
+  for(unsigned int d = 0; d < ImageDimension; d++)
+    {
+    offset += (idx[d] - m_CacheRegion.GetIndex(d)) * stride;
+    stride *= m_CacheRegion.GetSize(d);
+    }
+  return offset;
+}
+
+template <class TInputImage, class TInputVectorImage, class TOutputImage>
+void
+GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
+::DynamicThreadedGenerateData(const OutputImageRegionType &outputRegionForThread)
+{
+  OutputImagePointer outputPtr = this->GetOutput(0);
+  int ng = m_LogPDF.GetNumberOfGaussians();
+
+  typedef itk::ImageRegionIteratorWithIndex<TOutputImage> OutputIter;
   OutputIter it_out(outputPtr, outputRegionForThread);
 
-  vnl_vector<double> x(m_MixtureModel->GetNumberOfComponents());
-  vnl_vector<double> x_scratch(m_MixtureModel->GetNumberOfComponents());
-  vnl_vector<double> z_scratch(m_MixtureModel->GetNumberOfComponents());
-  vnl_vector<double> log_pdf(m_MixtureModel->GetNumberOfGaussians());
-  vnl_vector<double> log_w(m_MixtureModel->GetNumberOfGaussians());
-  vnl_vector<double> w(m_MixtureModel->GetNumberOfGaussians());
-  vnl_vector<double> p(m_MixtureModel->GetNumberOfGaussians());
-
-  // Create a multiplier vector (1 for foreground, -1 for background)
-  vnl_vector<double> pfactor(m_MixtureModel->GetNumberOfGaussians());
-  for(int i = 0; i < m_MixtureModel->GetNumberOfGaussians(); i++)
+  // Only the weights have changed: recompute the posteriors from the cache
+  if(m_UseCache)
     {
-    pfactor[i] = m_MixtureModel->IsForeground(i) ? 1.0 : -1.0;
-    log_w[i] = log(m_MixtureModel->GetWeight(i));
-    w[i] = m_MixtureModel->GetWeight(i);
+    for(; !it_out.IsAtEnd(); ++it_out)
+      it_out.Set(this->ComputeOutputValue(&m_Cache[this->GetCacheOffset(it_out.GetIndex()) * ng]));
+    return;
     }
 
+  // Create a collection iterator
+  typedef ImageCollectionConstIteratorWithIndex<TInputImage, TInputVectorImage> CollectionIter;
+
   // Configure the input collection iterator
   itk::Size<ImageDimension> radius; radius.Fill(0);
   CollectionIter cit(radius, outputRegionForThread);
@@ -120,35 +230,36 @@ GMMClassifyImageFilter<TInputImage, TInputVectorImage, TOutputImage>
     cit.AddImage(it.GetInput());
 
   // Get the number of components
-  int nComp = cit.GetTotalComponents();
+  int nComp = m_LogPDF.GetNumberOfComponents();
+  assert(nComp == cit.GetTotalComponents());
+
+  // The samples of a batch of voxels, one per row, and their log-densities
+  const int BATCH = 4 * GaussianMixtureLogPDF::BLOCK;
+  std::vector<double> x_batch(BATCH * nComp), log_pdf(BATCH * ng);
+  vnl_vector<double> x(nComp);
 
-  // Iterate through all the voxels
   while ( !it_out.IsAtEnd() )
     {
-    cit.GetNeighborhoodValues(x);
-
-    // Evaluate the posterior probability robustly
-    for(int k = 0; k < m_MixtureModel->GetNumberOfGaussians(); k++)
+    // Gather a batch of voxels
+    OutputIter it_batch = it_out;
+    int nb = 0;
+    for(; nb < BATCH && !it_out.IsAtEnd(); ++nb, ++it_out, ++cit)
       {
-      log_pdf[k] = m_MixtureModel->EvaluateLogPDF(k, x, x_scratch);
+      cit.GetNeighborhoodValues(x);
+      std::copy(x.begin(), x.end(), x_batch.begin() + nb * nComp);
       }
 
-    // Evaluate the GMM for each of the clusters
-    double pdiff = 0;
-    for(int k = 0; k < m_MixtureModel->GetNumberOfGaussians(); k++)
-      {
-      p[k] = EMGaussianMixtures::ComputePosterior(
-            m_MixtureModel->GetNumberOfGaussians(),
-            log_pdf.data_block(), w.data_block(), log_w.data_block(), k);
+    // Evaluate all the Gaussians for the whole batch
+    m_LogPDF.Evaluate(x_batch.data(), nb, log_pdf.data());
 
-      pdiff += p[k] * pfactor[k];
+    // Store the values, and the log-densities if they are cached
+    for(int i = 0; i < nb; ++i, ++it_batch)
+      {
+      const double *lp = &log_pdf[i * ng];
+      if(m_CacheLogPDF)
+        std::copy(lp, lp + ng, m_Cache.begin() + this->GetCacheOffset(it_batch.GetIndex()) * ng);
+      it_batch.Set(this->ComputeOutputValue(lp));
       }
-
-    // Store the value
-    it_out.Set((OutputPixelType)(pdiff * 0x7fff));
-
-    ++it_out;
-    ++cit;
     }
 }
 
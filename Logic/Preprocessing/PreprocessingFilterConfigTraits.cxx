@@ -43,6 +43,7 @@
 #include "UnsupervisedClustering.h"
 #include "RFClassificationEngine.h"
 #include "Rebroadcaster.h"
+#include "EdgeGradientMagnitudeCache.h"
 
 
 ScalarImageWrapperBase::FloatImageType *
@@ -132,7 +133,24 @@ EdgePreprocessingFilterConfigTraits
 ::AttachInputs(SNAPImageData *sid, FilterType *filter, int channel)
 {
   ScalarImageWrapperBase *scalar = sid->GetMain()->GetDefaultScalarRepresentation();
-  filter->SetInput(CreateCastToFloatPipelineForLayer(scalar, channel));
+
+  InputImageType *input = CreateCastToFloatPipelineForLayer(scalar, channel);
+  filter->SetInput(input);
+
+  // The filters for the volume and for the three preview slices all request
+  // the whole input image, so when they blur with the recursive Gaussian they
+  // share one cache of the blurred gradient magnitude. It is created for the
+  // first channel, and reads the same image as that channel's filter.
+  SmartPtr<EdgeGradientMagnitudeCache> cache =
+      dynamic_cast<EdgeGradientMagnitudeCache *>(scalar->GetUserData(CacheUserDataKey()));
+  if(channel == 0 || !cache)
+    {
+    cache = EdgeGradientMagnitudeCache::New();
+    cache->SetInput(input);
+    scalar->SetUserData(CacheUserDataKey(), cache);
+    }
+
+  filter->SetGradientMagnitudeCache(cache);
   filter->SetInputImageMaximumGradientMagnitude(
         scalar->GetImageGradientMagnitudeUpperLimit());
 }
@@ -142,6 +160,16 @@ EdgePreprocessingFilterConfigTraits
 ::DetachInputs(SNAPImageData *sid, FilterType *filter)
 {
   filter->SetInput(nullptr);
+  filter->SetGradientMagnitudeCache(nullptr);
+
+  // Release the blurred gradient magnitude, which is kept with the layer
+  // that AttachInputs() reads from
+  if(sid->GetMain())
+    {
+    ScalarImageWrapperBase *scalar = sid->GetMain()->GetDefaultScalarRepresentation();
+    if(scalar)
+      scalar->RemoveUserData(CacheUserDataKey());
+    }
 
   // We must get rid of all the mini-pipelines created during the use of this filter
   RemoveAllCastToFloatPipelines(sid);
@@ -180,6 +208,10 @@ GMMPreprocessingFilterConfigTraits
   UnsupervisedClustering *uc = sid->GetParent()->GetClusteringEngine();
   assert(uc);
   filter->SetMixtureModel(uc->GetMixtureModel());
+
+  // The preview filters keep the log-densities of their slice, so that
+  // changing the weight of a cluster only recomputes the posteriors
+  filter->SetCacheLogPDF(channel > 0);
 }
 
 void
@@ -129,6 +129,11 @@ public:
   static ScalarImageWrapperBase* GetDefaultScalarLayer(SNAPImageData *sid) { return NULL; }
   static void SetActiveScalarLayer(
       ScalarImageWrapperBase *layer, FilterType *filter, int channel) {}
+
+protected:
+  // The key under which the blurred gradient magnitude cache shared by the
+  // filters is stored with the main image layer
+  static const char *CacheUserDataKey() { return "EdgeGradientMagnitudeCache"; }
 };
 
 
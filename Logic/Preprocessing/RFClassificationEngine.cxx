@@ -1,10 +1,14 @@
 #include "RFClassificationEngine.h"
 #include "RandomForestClassifier.h"
+#include "RFForestAccess.h"
 
 #include "SNAPImageData.h"
 #include "ImageWrapper.h"
 #include "ImageCollectionConstIteratorWithIndex.h"
 #include "RLEImageRegionIterator.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
 
 // Includes from the random forest library
 #include "Library/classification.h"
@@ -20,6 +24,12 @@ RFClassificationEngine<TPixel,TLabel,VDim>::RFClassificationEngine()
   m_TreeDepth = 30;
   m_PatchRadius.Fill(0);
   m_UseCoordinateFeatures = false;
+  m_MaximumNumberOfSamples = 100000;
+  m_IncrementalTraining = false;
+  m_TrainedTreeDepth = -1;
+  m_NumberOfTreesGrown = 0;
+  m_NumberOfFeaturesComputed = 0;
+  this->ClearFeatureCache();
 }
 
 template <class TPixel, class TLabel, int VDim>
@@ -39,6 +49,8 @@ void RFClassificationEngine<TPixel,TLabel,VDim>::SetDataSource(SNAPImageData *im
 
     // Reset the classifier
     m_Classifier->Reset();
+    m_TrainedTreeDepth = -1;
+    this->ClearFeatureCache();
     }
 }
 
@@ -46,47 +58,48 @@ template <class TPixel, class TLabel, int VDim>
 void RFClassificationEngine<TPixel,TLabel,VDim>::ResetClassifier()
 {
   m_Classifier->Reset();
+  m_TrainedTreeDepth = -1;
 }
 
 template <class TPixel, class TLabel, int VDim>
-void RFClassificationEngine<TPixel,TLabel,VDim>:: TrainClassifier()
+void RFClassificationEngine<TPixel,TLabel,VDim>::ClearFeatureCache()
 {
-  assert(m_DataSource && m_DataSource->IsMainLoaded());
-
-  // All the images will be cast to float. For this to be efficient, the snake mode
-  // must convert all the images to float during processing. Otherwise we will be
-  // creating huge additional chunks of memory during RF training
-  typedef itk::Image<float, 3> FloatImage;
-  typedef itk::VectorImage<float, 3> FloatVectorImage;
-
-  // TODO: in the future, we should only recompute the sample when we know
-  // that the data has changed. However, currently, we are just going to
-  // compute a new sample every time
+  m_CacheOffsets.clear();
+  m_CacheLabels.clear();
+  m_CacheFeatures.clear();
+  m_CacheChangedRows.clear();
+  m_CacheColumns = 0;
+  m_CacheImages.clear();
+  m_CacheRegion = itk::ImageRegion<3>();
+  m_CacheRadius.Fill(0);
+  m_CacheCoordinates = false;
+}
 
-  // Delete the sample
-  if(m_Sample)
-    delete m_Sample;
+// Hash of a voxel offset, uniformly distributed in [0, 1). This is the
+// finalizer of the splitmix64 generator.
+static double HashVoxelOffset(long offset)
+{
+  unsigned long long h = (unsigned long long) offset + 0x9e3779b97f4a7c15ull;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  h = h ^ (h >> 31);
+  return (h >> 11) * (1.0 / 9007199254740992.0);
+}
 
+template <class TPixel, class TLabel, int VDim>
+unsigned long RFClassificationEngine<TPixel,TLabel,VDim>::UpdateFeatureCache()
+{
   // Get the segmentation image - which determines the samples
   // TODO: this is defaulting to the first image - is this correct?
   LabelImageWrapper *wrpSeg = m_DataSource->GetFirstSegmentationLayer();
   const LabelImageWrapper::ImageType *imgSeg = wrpSeg->GetImage();
-  typedef itk::ImageRegionConstIteratorWithIndex<LabelImageWrapper::ImageType> LabelIter;
+  typedef LabelImageWrapper::ImageType::RLLine RLLine;
 
   // Shrink the buffered region by radius because we can't handle BCs
-  itk::ImageRegion<3> reg = imgSeg->GetBufferedRegion();
+  const itk::ImageRegion<3> &buffered = imgSeg->GetBufferedRegion();
+  itk::ImageRegion<3> reg = buffered;
   reg.ShrinkByRadius(m_PatchRadius);
 
-  // We need to iterate throught the label image once to determine the
-  // number of samples to allocate.
-  unsigned long nSamples = 0;
-  for(LabelIter lit(imgSeg, reg); !lit.IsAtEnd(); ++lit)
-    if(lit.Value())
-      nSamples++;
-
-  // TODO: if the number of samples is greater than max number of training samples,
-  // we should choose a random subset of samples.
-
   // Compute the patch size
   int patch_size = 1;
   for(unsigned int i = 0; i < 3; i++)
@@ -104,6 +117,7 @@ void RFClassificationEngine<TPixel,TLabel,VDim>:: TrainClassifier()
   // Compute the offset tables and dimensions of the patches
   int total_comp = 0;
   std::vector<SampleData> sample_data;
+  std::vector<std::pair<itk::Object *, itk::ModifiedTimeType> > images;
   for(auto it = m_DataSource->GetLayers(MAIN_ROLE | OVERLAY_ROLE); !it.IsAtEnd(); ++it)
     {
     // Compute the patch offset table
@@ -121,74 +135,223 @@ void RFClassificationEngine<TPixel,TLabel,VDim>:: TrainClassifier()
 
     // Update total components
     total_comp += n_comp;
+
+    // Record the image the features are sampled from
+    itk::Object *image = it.GetLayer()->GetImageBase();
+    images.push_back(std::make_pair(image, image->GetMTime()));
     }
 
   // Allocate the patches
   int nColumns = m_UseCoordinateFeatures ? total_comp + 3 : total_comp;
 
-  // Create a new sample
-  m_Sample = new SampleType(nSamples, nColumns);
+  // The cached features can only be reused if they were sampled the same way
+  // from the same images
+  bool cacheValid =
+      m_CacheImages == images && m_CacheRegion == buffered &&
+      m_CacheRadius == m_PatchRadius && m_CacheCoordinates == m_UseCoordinateFeatures &&
+      m_CacheColumns == nColumns;
 
-  // Allocate the sample storage and matrices that point to its storage
-  vnl_vector<double> current_sample(total_comp);
+  if(!cacheValid)
+    {
+    this->ClearFeatureCache();
+    m_CacheImages = images;
+    m_CacheRegion = buffered;
+    m_CacheRadius = m_PatchRadius;
+    m_CacheCoordinates = m_UseCoordinateFeatures;
+    m_CacheColumns = nColumns;
+    }
 
-  // Now fill out the samples
-  int iSample = 0;
-  for(LabelIter lit(imgSeg, reg); !lit.IsAtEnd(); ++lit)
+  // Lines of the RLE image are stored as z * ny + y, with x relative to the
+  // start of the buffered region. The labeled voxels are found by going
+  // through the runs, which is much faster than visiting every voxel.
+  const RLLine *lines = imgSeg->GetBuffer()->GetBufferPointer();
+  long nx = buffered.GetSize(0), ny = buffered.GetSize(1);
+  long x0 = reg.GetIndex(0) - buffered.GetIndex(0), x1 = x0 + reg.GetSize(0);
+  long y0 = reg.GetIndex(1) - buffered.GetIndex(1), y1 = y0 + reg.GetSize(1);
+  long z0 = reg.GetIndex(2) - buffered.GetIndex(2), z1 = z0 + reg.GetSize(2);
+
+  // Count the labeled voxels, to determine what fraction of them to use
+  unsigned long nLabeled = 0;
+  for(long z = z0; z < z1; z++)
     {
-    LabelType label = lit.Value();
-    if(label)
+    for(long y = y0; y < y1; y++)
       {
-      // Fill in the data
-      auto &column = m_Sample->data[iSample];
+      const RLLine &line = lines[z * ny + y];
+      long t = 0;
+      for(size_t i = 0; i < line.size() && t < x1; i++)
+        {
+        long a = std::max(t, x0), b = std::min(t + (long) line[i].first, x1);
+        t += line[i].first;
+        if(a < b && line[i].second)
+          nLabeled += b - a;
+        }
+      }
+    }
 
-      // Sample from each image
-      int k = 0;
-      for(auto &sd : sample_data)
+  double rate = nLabeled > m_MaximumNumberOfSamples
+      ? m_MaximumNumberOfSamples / (double) nLabeled : 1.0;
+
+  // Go through the training voxels in the order of their offsets, which is
+  // also the order of the cache, taking the features of the voxels already
+  // in the cache and sampling the features of the others
+  std::vector<long> offsets;
+  std::vector<LabelType> labels;
+  std::vector<float> features;
+  offsets.reserve(std::min(nLabeled, m_MaximumNumberOfSamples + m_MaximumNumberOfSamples / 8));
+  labels.reserve(offsets.capacity());
+  features.reserve(offsets.capacity() * nColumns);
+  std::vector<unsigned long> changedRows;
+
+  unsigned long nChanged = 0, nComputed = 0;
+  size_t iCache = 0, nCache = m_CacheOffsets.size();
+  for(long z = z0; z < z1; z++)
+    {
+    for(long y = y0; y < y1; y++)
+      {
+      const RLLine &line = lines[z * ny + y];
+      long t = 0;
+      for(size_t i = 0; i < line.size() && t < x1; i++)
         {
-        // Sample this patch
-        double *p = sd.sample_matrix.data_block();
-        sd.layer->SamplePatchAsDouble(lit.GetIndex(), sd.offset_table, p);
-
-        // This in-place transpose operation is required because the RF classes expect the
-        // sample to be ordered first by component and then by patch location, but the
-        // SamplePatchAsDouble samples first by patch location, then by component
-        if(sd.sample_matrix.rows() > 1)
-          sd.sample_matrix.inplace_transpose();
-
-        // Copy data to actual sample
-        for(unsigned int i = 0; i < sd.n_comp; i++)
-          column[k++] = (float) p[i];
+        long a = std::max(t, x0), b = std::min(t + (long) line[i].first, x1);
+        t += line[i].first;
+        LabelType label = line[i].second;
+        if(!label)
+          continue;
+
+        for(long x = a; x < b; x++)
+          {
+          long offset = (z * ny + y) * nx + x;
+          if(rate < 1.0 && HashVoxelOffset(offset) >= rate)
+            continue;
+
+          // Cached voxels that come before this one are no longer labeled
+          while(iCache < nCache && m_CacheOffsets[iCache] < offset)
+            { iCache++; nChanged++; }
+
+          offsets.push_back(offset);
+          labels.push_back(label);
+          size_t row = features.size();
+          features.resize(row + nColumns);
+
+          if(iCache < nCache && m_CacheOffsets[iCache] == offset)
+            {
+            // The features do not depend on the label
+            std::copy(m_CacheFeatures.begin() + iCache * nColumns,
+                      m_CacheFeatures.begin() + (iCache + 1) * nColumns,
+                      features.begin() + row);
+            if(m_CacheLabels[iCache] != label)
+              {
+              changedRows.push_back(offsets.size() - 1);
+              nChanged++;
+              }
+            iCache++;
+            continue;
+            }
+
+          itk::Index<3> idx = {{ x, y, z }};
+          for(int d = 0; d < 3; d++)
+            idx[d] += buffered.GetIndex(d);
+
+          // Sample from each image
+          float *column = &features[row];
+          int k = 0;
+          for(auto &sd : sample_data)
+            {
+            // Sample this patch, one row per patch location
+            sd.layer->SamplePatchAsDouble(idx, sd.offset_table, sd.sample_matrix.data_block());
+
+            // The RF classes expect the sample to be ordered first by component and
+            // then by patch location, so the matrix is copied column by column
+            for(unsigned int c = 0; c < sd.sample_matrix.cols(); c++)
+              for(unsigned int j = 0; j < sd.sample_matrix.rows(); j++)
+                column[k++] = (float) sd.sample_matrix(j, c);
+            }
+
+          // Add the coordinate features if used
+          if(m_UseCoordinateFeatures)
+            for(int d = 0; d < 3; d++)
+              column[k++] = idx[d];
+
+          changedRows.push_back(offsets.size() - 1);
+          nChanged++;
+          nComputed++;
+          }
         }
+      }
+    }
 
-      // Add the coordinate features if used
-      if(m_UseCoordinateFeatures)
-        for(int d = 0; d < 3; d++)
-          column[k++] = lit.GetIndex()[d];
+  // The remaining cached voxels are no longer labeled either
+  nChanged += nCache - iCache;
 
-      // Fill in the label
-      m_Sample->label[iSample] = label;
-      ++iSample;
-      }
+  m_CacheOffsets.swap(offsets);
+  m_CacheLabels.swap(labels);
+  m_CacheFeatures.swap(features);
+  m_CacheChangedRows.swap(changedRows);
+  m_NumberOfFeaturesComputed = nComputed;
+
+  return nChanged;
+}
+
+template <class TPixel, class TLabel, int VDim>
+void RFClassificationEngine<TPixel,TLabel,VDim>::FillSample(const std::vector<unsigned long> &rows)
+{
+  if(m_Sample)
+    delete m_Sample;
+
+  int nColumns = m_CacheColumns;
+  m_Sample = new SampleType(rows.size(), nColumns);
+  for(unsigned long iSample = 0; iSample < rows.size(); iSample++)
+    {
+    auto &column = m_Sample->data[iSample];
+    const float *row = &m_CacheFeatures[rows[iSample] * nColumns];
+    for(int k = 0; k < nColumns; k++)
+      column[k] = row[k];
+    m_Sample->label[iSample] = m_CacheLabels[rows[iSample]];
     }
+}
 
-  // Check that the sample has at least two distinct labels
-  bool isValidSample = false;
-  for(int iSample = 1; iSample < m_Sample->Size(); iSample++)
-    if(m_Sample->label[iSample] != m_Sample->label[iSample-1])
-      { isValidSample = true; break; }
+template <class TPixel, class TLabel, int VDim>
+std::vector<unsigned long>
+RFClassificationEngine<TPixel,TLabel,VDim>::SelectIncrementalRows(unsigned long nChanged)
+{
+  // The new and relabeled voxels
+  std::vector<unsigned long> rows = m_CacheChangedRows;
+  std::vector<bool> changed(m_CacheOffsets.size(), false);
+  for(unsigned long iRow : m_CacheChangedRows)
+    changed[iRow] = true;
+
+  // The other voxels of each class
+  std::map<LabelType, std::vector<unsigned long> > unchanged;
+  for(unsigned long iRow = 0; iRow < m_CacheOffsets.size(); iRow++)
+    if(!changed[iRow])
+      unchanged[m_CacheLabels[iRow]].push_back(iRow);
+
+  // Draw evenly spaced voxels from each class, as many in total as the
+  // number of voxels that changed. Since the rows are ordered by offset,
+  // the voxels drawn are spread over the labeled region.
+  if(unchanged.size())
+    {
+    unsigned long nPerClass = std::max(1ul, (nChanged + unchanged.size() - 1) / unchanged.size());
+    for(auto &it : unchanged)
+      {
+      const std::vector<unsigned long> &classRows = it.second;
+      unsigned long n = std::min(nPerClass, (unsigned long) classRows.size());
+      for(unsigned long i = 0; i < n; i++)
+        rows.push_back(classRows[(i * classRows.size()) / n]);
+      }
+    }
 
-  // Now there is a valid sample. The text task is to train the classifier
-  if(!isValidSample)
-    throw IRISException("A classifier cannot be trained because the training "
-                        "data contain fewer than two classes. Please label "
-                        "examples of two or more tissue classes in the image.");
+  return rows;
+}
 
+template <class TPixel, class TLabel, int VDim>
+void RFClassificationEngine<TPixel,TLabel,VDim>::GrowForest(ClassifierType *classifier, int nTrees)
+{
   // Set up the classifier parameters
   TrainingParameters params;
   // TODO:
   params.treeDepth = m_TreeDepth;
-  params.treeNum = m_ForestSize;
+  params.treeNum = nTrees;
   params.candidateNodeClassifierNum = 10;
   params.candidateClassifierThresholdNum = 10;
   params.subSamplePercent = 0;
@@ -207,6 +370,88 @@ void RFClassificationEngine<TPixel,TLabel,VDim>:: TrainClassifier()
   typedef Classification<float, LabelType, RFAxisClassifierType> ClassificationType;
   ClassificationType classification;
 
+  // Prepare the classifier
+  classifier->Reset();
+
+  // Perform classifier training
+  classification.Learning(
+        params, *m_Sample,
+        *classifier->GetForest(),
+        classifier->GetValidLabel(),
+        classifier->GetClassToLabelMapping());
+}
+
+template <class TPixel, class TLabel, int VDim>
+void RFClassificationEngine<TPixel,TLabel,VDim>:: TrainClassifier()
+{
+  assert(m_DataSource && m_DataSource->IsMainLoaded());
+
+  // All the images will be cast to float. For this to be efficient, the snake mode
+  // must convert all the images to float during processing. Otherwise we will be
+  // creating huge additional chunks of memory during RF training
+  typedef itk::Image<float, 3> FloatImage;
+  typedef itk::VectorImage<float, 3> FloatVectorImage;
+
+  // Only the features of voxels labeled since the last training are sampled
+  unsigned long nChanged = this->UpdateFeatureCache();
+  unsigned long nSamples = m_CacheOffsets.size();
+
+  // Check that the sample has at least two distinct labels
+  bool isValidSample = false;
+  for(unsigned long iSample = 1; iSample < nSamples; iSample++)
+    if(m_CacheLabels[iSample] != m_CacheLabels[iSample-1])
+      { isValidSample = true; break; }
+
+  // Now there is a valid sample. The text task is to train the classifier
+  if(!isValidSample)
+    throw IRISException("A classifier cannot be trained because the training "
+                        "data contain fewer than two classes. Please label "
+                        "examples of two or more tissue classes in the image.");
+
+  // The number of trees to replace is proportional to the fraction of the
+  // training voxels that changed. This only makes sense if the forest was
+  // grown from the cached features with the current parameters.
+  int nTrees = m_ForestSize;
+  if(m_IncrementalTraining && m_TrainedTreeDepth == m_TreeDepth &&
+     m_Classifier->IsValidClassifier() &&
+     (int) m_Classifier->GetForest()->GetForestSize() == m_ForestSize)
+    {
+    nTrees = (int) std::ceil(m_ForestSize * (double) nChanged / nSamples);
+
+    // Nothing to learn from
+    if(nTrees == 0)
+      {
+      m_NumberOfTreesGrown = 0;
+      return;
+      }
+    }
+
+  // Replace the oldest trees with trees grown from the new and relabeled
+  // voxels, together with an equal number of the other training voxels drawn
+  // from each class, so that the new trees do not forget the earlier
+  // training. The whole forest is grown again if the new trees do not have
+  // the same classes as the forest, e.g., when a new label was painted.
+  if(nTrees < m_ForestSize)
+    {
+    this->FillSample(this->SelectIncrementalRows(nChanged));
+    SmartPtr<ClassifierType> grown = ClassifierType::New();
+    this->GrowForest(grown, nTrees);
+    if(grown->GetClassToLabelMapping() == m_Classifier->GetClassToLabelMapping())
+      {
+      RFForestAccess<ClassifierType>::ReplaceOldestTrees(m_Classifier, grown);
+      m_Classifier->GetValidLabel() = grown->GetValidLabel();
+      m_Classifier->Modified();
+      m_NumberOfTreesGrown = nTrees;
+      return;
+      }
+    }
+
+  // Create the sample from the whole cache
+  std::vector<unsigned long> allRows(nSamples);
+  for(unsigned long iSample = 0; iSample < nSamples; iSample++)
+    allRows[iSample] = iSample;
+  this->FillSample(allRows);
+
   // Before resetting the classifier, we want to retain whatever the
   // weighting of the classes was
   std::map<LabelType, double> old_label_weights;
@@ -224,15 +469,10 @@ void RFClassificationEngine<TPixel,TLabel,VDim>:: TrainClassifier()
       }
     }
 
-  // Prepare the classifier
-  m_Classifier->Reset();
-
-  // Perform classifier training
-  classification.Learning(
-        params, *m_Sample,
-        *m_Classifier->GetForest(),
-        m_Classifier->GetValidLabel(),
-        m_Classifier->GetClassToLabelMapping());
+  // Grow the whole forest
+  this->GrowForest(m_Classifier, m_ForestSize);
+  m_TrainedTreeDepth = m_TreeDepth;
+  m_NumberOfTreesGrown = m_ForestSize;
 
   // Reset the class weights to the number of classes and assign default
   int n_classes = m_Classifier->GetClassToLabelMapping().size(), n_fore = 0, n_back = 0;
@@ -279,6 +519,7 @@ void RFClassificationEngine<TPixel,TLabel,VDim>::SetClassifier(ClassifierType *r
 {
   // Set the classifier
   m_Classifier = rf;
+  m_TrainedTreeDepth = -1;
 
   // Update the forest size
   m_ForestSize = m_Classifier->GetForest()->GetForestSize();
@@ -5,6 +5,8 @@
 #include <itkObjectFactory.h>
 #include "SNAPCommon.h"
 #include <itkSize.h>
+#include <itkImageRegion.h>
+#include <vector>
 
 template <class TPixel, class TLabel, int VDim> class RandomForestClassifier;
 template <class TData, class TLabel> class MLData;
@@ -59,6 +61,43 @@ public:
   itkGetMacro(UseCoordinateFeatures, bool)
   itkSetMacro(UseCoordinateFeatures, bool)
 
+  /**
+   * Maximum number of labeled voxels used for training. When more voxels are
+   * labeled, a random subset of about this size is used. Whether a voxel is
+   * in the subset depends only on its position and on the number of labeled
+   * voxels, so the subset changes little from one training to the next.
+   */
+  itkGetMacro(MaximumNumberOfSamples, unsigned long)
+  itkSetMacro(MaximumNumberOfSamples, unsigned long)
+
+  /**
+   * Whether retraining only replaces as many of the oldest trees as needed
+   * to account for the training voxels that changed since the last training.
+   * The new trees are grown from the new and relabeled voxels, and from as
+   * many of the other training voxels drawn evenly from each class. The
+   * whole forest is still grown again when the new trees do not have the
+   * classes of the forest, or when the forest parameters or the features
+   * change.
+   */
+  itkGetMacro(IncrementalTraining, bool)
+  itkSetMacro(IncrementalTraining, bool)
+
+  /**
+   * Number of trees grown by the last training: the forest size if the whole
+   * forest was grown, fewer if only the oldest trees were replaced, and zero
+   * if the training voxels had not changed.
+   */
+  itkGetMacro(NumberOfTreesGrown, int)
+
+  /**
+   * Number of training voxels whose features were computed by the last
+   * training. The features of the other voxels came from the cache.
+   */
+  itkGetMacro(NumberOfFeaturesComputed, unsigned long)
+
+  /** The training voxels, as offsets into the buffer of the label image */
+  const std::vector<long> &GetTrainingVoxelOffsets() const { return m_CacheOffsets; }
+
   /** Get the number of components passed to the classifier */
   int GetNumberOfComponents() const;
 
@@ -89,10 +128,58 @@ protected:
   // Are coordinates included as features
   bool m_UseCoordinateFeatures;
 
+  // Maximum number of training voxels
+  unsigned long m_MaximumNumberOfSamples;
+
+  // Are only some of the trees replaced on retraining
+  bool m_IncrementalTraining;
+
   // Cached samples used to train the classifier
   typedef MLData<float, LabelType> SampleType;
   SampleType *m_Sample;
 
+  // Compute the features of the training voxels, reusing those in the cache,
+  // and return the number of training voxels added, removed or relabeled
+  unsigned long UpdateFeatureCache();
+
+  // Rows of the cache used to grow the trees that replace the oldest ones,
+  // given the number of training voxels that changed
+  std::vector<unsigned long> SelectIncrementalRows(unsigned long nChanged);
+
+  // Create the sample from the given rows of the cache
+  void FillSample(const std::vector<unsigned long> &rows);
+
+  // Grow a forest with the given number of trees from the current sample
+  void GrowForest(ClassifierType *classifier, int nTrees);
+
+  // Forget the cached features
+  void ClearFeatureCache();
+
+  // The training voxels of the last training, as offsets into the buffer of
+  // the label image in increasing order, with their labels and their
+  // features, stored one row per voxel. The rows of the voxels that were
+  // added or relabeled by the last update of the cache are listed too.
+  std::vector<long> m_CacheOffsets;
+  std::vector<LabelType> m_CacheLabels;
+  std::vector<float> m_CacheFeatures;
+  std::vector<unsigned long> m_CacheChangedRows;
+  int m_CacheColumns;
+
+  // What the cached features were computed from: the images of the layers
+  // with their modification times, the label image region and the features
+  std::vector<std::pair<itk::Object *, itk::ModifiedTimeType> > m_CacheImages;
+  itk::ImageRegion<3> m_CacheRegion;
+  RadiusType m_CacheRadius;
+  bool m_CacheCoordinates;
+
+  // Depth of the trees in the current forest if it was grown from the cached
+  // features, and -1 otherwise
+  int m_TrainedTreeDepth;
+
+  // What the last training did
+  int m_NumberOfTreesGrown;
+  unsigned long m_NumberOfFeaturesComputed;
+
 };
 
 #endif // RFCLASSIFICATIONENGINE_H
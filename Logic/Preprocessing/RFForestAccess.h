@@ -0,0 +1,137 @@
+#ifndef RFFORESTACCESS_H
+#define RFFORESTACCESS_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Operations on the trees of the forest held by a RandomForestClassifier.
+ *
+ * The forest is defined by the random forest library in the c3d submodule,
+ * which only exposes its trees and their nodes through public data members
+ * (the forest's trees_, and the tree and node members read by TreeRoot(),
+ * IsLeaf(), LeftChild(), RightChild(), SplitFeature(), SplitThreshold() and
+ * LeafProbabilities() below). This class is the only place in ITK-SNAP where
+ * these members are accessed, so that the rest of the code does not depend
+ * on how the forest stores its trees.
+ */
+template <class TClassifier>
+class RFForestAccess
+{
+public:
+
+  typedef TClassifier ClassifierType;
+
+  /**
+   * The trees of a forest, flattened into arrays of nodes so that a tree can
+   * be walked without following pointers. The two children of an inner node
+   * are stored next to each other, and Child is the index of the left one;
+   * samples whose feature Feature is below Threshold go to the left. For a
+   * leaf, Feature is -1 and Child is the index of the leaf, whose class
+   * probabilities start at LeafProbability[Child * NumberOfClasses].
+   */
+  struct FlatForest
+  {
+    int NumberOfClasses = 0;
+    std::vector<int> Roots;
+    std::vector<int> Feature;
+    std::vector<float> Threshold;
+    std::vector<int> Child;
+    std::vector<double> LeafProbability;
+  };
+
+  /**
+   * Replace the oldest trees of the forest of a classifier with the trees of
+   * the forest of another classifier. The two classifiers must have the same
+   * class to label mapping. New trees are added at the end of the forest, so
+   * the oldest are first.
+   *
+   * The library's forest holds its trees as raw pointers and deletes them
+   * when it is destroyed, and it has no method to remove a tree. The trees
+   * are therefore exchanged between the two forests rather than deleted
+   * here: the source forest receives the replaced trees, which are deleted
+   * with it.
+   */
+  static void ReplaceOldestTrees(ClassifierType *classifier, ClassifierType *source)
+  {
+    auto &trees = classifier->GetForest()->trees_;
+    auto &fresh = source->GetForest()->trees_;
+    size_t n = std::min(fresh.size(), trees.size());
+
+    std::swap_ranges(trees.begin(), trees.begin() + n, fresh.begin());
+    std::rotate(trees.begin(), trees.begin() + n, trees.end());
+  }
+
+  /** Flatten the trees of the forest of a classifier */
+  static void Flatten(ClassifierType *classifier, FlatForest &flat)
+  {
+    flat = FlatForest();
+    flat.NumberOfClasses = (int) classifier->GetClassToLabelMapping().size();
+
+    for(auto *tree : classifier->GetForest()->trees_)
+      {
+      int root = AddNodes(flat, 1);
+      flat.Roots.push_back(root);
+      FlattenNode(TreeRoot(tree), flat, root);
+      }
+  }
+
+protected:
+
+  // Accessors for the members of the trees and nodes of the library
+  template <class TTree> static auto TreeRoot(TTree *tree)
+    -> decltype(tree->root_) { return tree->root_; }
+
+  template <class TNode> static bool IsLeaf(const TNode *node)
+    { return node->isLeaf_; }
+
+  template <class TNode> static const TNode *LeftChild(const TNode *node)
+    { return node->left_; }
+
+  template <class TNode> static const TNode *RightChild(const TNode *node)
+    { return node->right_; }
+
+  template <class TNode> static int SplitFeature(const TNode *node)
+    { return (int) node->split_->featureIndex_; }
+
+  template <class TNode> static float SplitThreshold(const TNode *node)
+    { return (float) node->split_->threshold_; }
+
+  template <class TNode> static const std::vector<double> &LeafProbabilities(const TNode *node)
+    { return node->statistics_->prob_; }
+
+  // Append n uninitialized nodes and return the index of the first
+  static int AddNodes(FlatForest &flat, int n)
+  {
+    int first = (int) flat.Feature.size();
+    flat.Feature.resize(first + n, -1);
+    flat.Threshold.resize(first + n, 0.0f);
+    flat.Child.resize(first + n, -1);
+    return first;
+  }
+
+  // Store a node of the library at the given position, and its subtree
+  template <class TNode>
+  static void FlattenNode(const TNode *node, FlatForest &flat, int index)
+  {
+    if(IsLeaf(node))
+      {
+      const std::vector<double> &prob = LeafProbabilities(node);
+      flat.Feature[index] = -1;
+      flat.Child[index] = (int) (flat.LeafProbability.size() / flat.NumberOfClasses);
+      for(int c = 0; c < flat.NumberOfClasses; c++)
+        flat.LeafProbability.push_back(prob[c]);
+      }
+    else
+      {
+      int left = AddNodes(flat, 2);
+      flat.Feature[index] = SplitFeature(node);
+      flat.Threshold[index] = SplitThreshold(node);
+      flat.Child[index] = left;
+      FlattenNode(LeftChild(node), flat, left);
+      FlattenNode(RightChild(node), flat, left + 1);
+      }
+  }
+};
+
+#endif // RFFORESTACCESS_H
@@ -5,6 +5,10 @@
 #include <vector>
 #include <itkImageBase.h>
 #include <itkImage.h>
+#include "RLESettings.h"
+#ifdef SNAP_RLE_FLAT_STORAGE
+#include "RLELineArena.h"
+#endif
 
 /** Run-Length Encoded image.
 * It saves memory for label images at the expense of processing times.
@@ -16,6 +20,11 @@
 * It is best if pixel type and counter type have the same byte size
 * (for memory alignment purposes).
 *
+* When built with SNAP_RLE_FLAT_STORAGE, the runs of all lines are kept in
+* a shared RLELineArena instead of one std::vector per line. Each line then
+* only stores its offset, length and capacity into the arena, and edits that
+* fit into the line's slack are made in place.
+*
 * Copied and adapted from itk::Image.
 */
 template< typename TPixel, unsigned int VImageDimension = 3, typename CounterType = unsigned short >
@@ -48,7 +57,11 @@ public:
     typedef std::pair<CounterType, PixelType> RLSegment;
 
     /** A Run-Length encoded line of pixels. */
+#ifdef SNAP_RLE_FLAT_STORAGE
+    typedef RLEArenaLine<RLSegment> RLLine;
+#else
     typedef std::vector<RLSegment> RLLine;
+#endif
 
     /** Internal Pixel representation. Used to maintain a uniform API
     * with Image Adaptors and allow to keep a particular internal
@@ -107,6 +120,7 @@ public:
         Superclass::Initialize();
         m_OnTheFlyCleanup = true;
         myBuffer = BufferType::New();
+        ReleaseArena();
     }
 
     /** Fill the image buffer with a value.  Be sure to call Allocate()
@@ -211,6 +225,15 @@ public:
             CleanUp(); //put the image into a clean state
     }
 
+    /** Repack the runs of all lines into a single contiguous block, in
+    * scan order, leaving each line some slack for subsequent edits.
+    * Only has an effect with SNAP_RLE_FLAT_STORAGE; with per-line vectors
+    * it just trims excess capacity. */
+    void Compact();
+
+    /** Number of bytes used to store the runs and the per-line headers */
+    itk::SizeValueType GetRunStorageMemorySize() const;
+
     /** Pixel contaner support */
     typedef typename BufferType::PixelContainer PixelContainer;
 
@@ -232,10 +255,11 @@ protected:
     {
         m_OnTheFlyCleanup = true;
         myBuffer = BufferType::New();
+        m_Arena = nullptr;
     }
     void PrintSelf(std::ostream & os, itk::Indent indent) const ITK_OVERRIDE;
 
-    virtual ~RLEImage() {}
+    virtual ~RLEImage() { ReleaseArena(); }
 
     /** Compute helper matrices used to transform Index coordinates to
     * PhysicalPoint coordinates and back. This method is virtual and will be
@@ -250,6 +274,17 @@ protected:
     /** Merges adjacent segments with duplicate values in a single line. */
     void CleanUpLine(RLLine & line) const;
 
+    /** Give up the image's reference to its run arena (if any). Lines
+    * that still hold runs in the arena keep it alive. */
+    void ReleaseArena()
+    {
+#ifdef SNAP_RLE_FLAT_STORAGE
+        if (m_Arena)
+            m_Arena->UnRegister();
+#endif
+        m_Arena = nullptr;
+    }
+
 private:
     bool m_OnTheFlyCleanup; //should same-valued segments be merged on the fly
 
@@ -258,6 +293,15 @@ private:
 
     /** Memory for the current buffer. */
     mutable typename BufferType::Pointer myBuffer;
+
+#ifdef SNAP_RLE_FLAT_STORAGE
+    typedef RLELineArena<RLSegment> ArenaType;
+#else
+    typedef void ArenaType;
+#endif
+
+    /** Arena holding the runs of all lines (flat storage only). */
+    ArenaType *m_Arena;
 };
 
 
@@ -49,6 +49,15 @@ void RLEImage<TPixel, VImageDimension, CounterType>::Allocate(bool initialize)
     this->ComputeOffsetTable();
     //SizeValueType num = static_cast<SizeValueType>(this->GetOffsetTable()[VImageDimension]);
     myBuffer->Allocate(false);
+#ifdef SNAP_RLE_FLAT_STORAGE
+    // Bind every line to a slot of a single, freshly created arena
+    itk::SizeValueType nLines = myBuffer->GetBufferedRegion().GetNumberOfPixels();
+    ReleaseArena();
+    m_Arena = ArenaType::New(nLines * ArenaType::MinimumCapacity);
+    RLLine *lines = myBuffer->GetBufferPointer();
+    for (itk::SizeValueType i = 0; i < nLines; i++)
+        lines[i].Bind(m_Arena, 1);
+#endif
     //if (initialize) //there is assumption that the image is fully formed after a call to allocate
     {
         RLSegment segment(CounterType(this->GetBufferedRegion().GetSize(0)), TPixel());
@@ -71,28 +80,75 @@ void RLEImage<TPixel, VImageDimension, CounterType>
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
 void RLEImage<TPixel, VImageDimension, CounterType>::CleanUpLine(RLLine & line) const
 {
-    CounterType x = 0;
-    RLLine out;
-    out.reserve(this->GetLargestPossibleRegion().GetSize(0));
-    do
+    // Merge in place, so that the line keeps its storage
+    if (line.empty())
+        return;
+    itk::SizeValueType w = 0;
+    for (itk::SizeValueType x = 1; x < line.size(); x++)
     {
-        out.push_back(line[x]);
-        while (++x < line.size() && line[x].second == line[x - 1].second)
-            out.back().first += line[x].first;
-    } while (x < line.size());
-    out.swap(line);
+        if (line[x].second == line[w].second)
+            line[w].first += line[x].first;
+        else
+            line[++w] = line[x];
+    }
+    line.resize(w + 1);
 }
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
 void RLEImage<TPixel, VImageDimension, CounterType>::CleanUp() const
 {
-    assert(!myBuffer.empty());
     if (this->GetLargestPossibleRegion().GetSize(0) == 0)
         return;
+    long nLines = myBuffer->GetBufferedRegion().GetNumberOfPixels();
+    RLLine *lines = myBuffer->GetBufferPointer();
 #pragma omp parallel for
-    for (CounterType z = 0; z < myBuffer.size(); z++)
-        for (CounterType y = 0; y < myBuffer[0].size(); y++)
-            CleanUpLine(myBuffer[z][y]);
+    for (long i = 0; i < nLines; i++)
+        CleanUpLine(lines[i]);
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+void RLEImage<TPixel, VImageDimension, CounterType>::Compact()
+{
+    itk::SizeValueType nLines = myBuffer->GetBufferedRegion().GetNumberOfPixels();
+    RLLine *lines = myBuffer->GetBufferPointer();
+    if (!lines)
+        return;
+#ifdef SNAP_RLE_FLAT_STORAGE
+    // Size the new arena exactly, leaving at least one run of slack per line
+    itk::SizeValueType total = 0;
+    for (itk::SizeValueType i = 0; i < nLines; i++)
+        total += ArenaType::RoundCapacity(lines[i].size() + 1);
+
+    ArenaType *arena = ArenaType::New(total);
+    for (itk::SizeValueType i = 0; i < nLines; i++)
+        lines[i].Bind(arena, lines[i].size() + 1);
+
+    // The old arena is freed once the last line has left it
+    ReleaseArena();
+    m_Arena = arena;
+#else
+    for (itk::SizeValueType i = 0; i < nLines; i++)
+        lines[i].shrink_to_fit();
+#endif
+}
+
+template< typename TPixel, unsigned int VImageDimension, typename CounterType >
+itk::SizeValueType RLEImage<TPixel, VImageDimension, CounterType>::GetRunStorageMemorySize() const
+{
+    itk::SizeValueType nLines = myBuffer->GetBufferedRegion().GetNumberOfPixels();
+    const RLLine *lines = myBuffer->GetBufferPointer();
+    itk::SizeValueType bytes = nLines * sizeof(RLLine);
+#ifdef SNAP_RLE_FLAT_STORAGE
+    if (m_Arena)
+        bytes += m_Arena->GetMemorySize();
+    for (itk::SizeValueType i = 0; lines && i < nLines; i++)
+        if (lines[i].GetArena() != m_Arena)
+            bytes += lines[i].capacity() * sizeof(RLSegment);
+#else
+    for (itk::SizeValueType i = 0; lines && i < nLines; i++)
+        bytes += lines[i].capacity() * sizeof(RLSegment);
+#endif
+    return bytes;
 }
 
 template< typename TPixel, unsigned int VImageDimension, typename CounterType >
@@ -255,6 +311,14 @@ void RLEImage<TPixel, VImageDimension, CounterType>
     int prec = os.precision(3);
     os << indent << "Compressed size in relation to original size: "<< cr*100 <<"%" << std::endl;
     os.precision(prec);
+    os << indent << "Run storage size (bytes): " << GetRunStorageMemorySize() << std::endl;
+#ifdef SNAP_RLE_FLAT_STORAGE
+    if (m_Arena)
+        os << indent << "Run arena blocks: " << m_Arena->GetNumberOfBlocks()
+           << ", used/released/reserved segments: " << m_Arena->GetUsedSegments()
+           << "/" << m_Arena->GetReleasedSegments()
+           << "/" << m_Arena->GetReservedSegments() << std::endl;
+#endif
 }
 
 #endif //RLEImage_txx
@@ -0,0 +1,445 @@
+#ifndef RLELineArena_h
+#define RLELineArena_h
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** Shared storage for the run-length lines of an RLEImage.
+* All runs of an image are kept in a small number of large, contiguous
+* blocks instead of one heap allocation per line. The first block is sized
+* to hold every line of the image (plus some slack), so that a freshly
+* allocated or compacted image occupies a single contiguous arena.
+*
+* Line capacities are rounded up to powers of two. Slots released by lines
+* that outgrow their capacity are kept on per-capacity free lists and are
+* reused by subsequent allocations of the same size class.
+*
+* The arena is reference counted by the lines that hold storage in it,
+* so it outlives its owning image as long as any line still refers to it.
+* Allocation and release are thread-safe.
+*/
+template< typename TSegment >
+class RLELineArena
+{
+public:
+    typedef RLELineArena Self;
+    typedef TSegment SegmentType;
+    typedef std::size_t SizeType;
+
+    /** Create an arena whose first block holds initialCapacity segments. */
+    static Self *New(SizeType initialCapacity)
+    {
+        return new Self(initialCapacity);
+    }
+
+    /** Reference counting (the creator holds the first reference). */
+    void Register() { ++m_ReferenceCount; }
+
+    void UnRegister()
+    {
+        if (--m_ReferenceCount == 0)
+            delete this;
+    }
+
+    /** Round a requested line capacity up to the arena size class. */
+    static SizeType RoundCapacity(SizeType n)
+    {
+        SizeType c = MinimumCapacity;
+        while (c < n)
+            c <<= 1;
+        return c;
+    }
+
+    /** Allocate a slot of exactly n segments (n must be a size class). */
+    TSegment *Allocate(SizeType n)
+    {
+        assert(n == RoundCapacity(n));
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        // Reuse a released slot of the same size class if there is one
+        unsigned int sc = SizeClass(n);
+        if (sc < m_FreeLists.size() && !m_FreeLists[sc].empty())
+        {
+            TSegment *slot = m_FreeLists[sc].back();
+            m_FreeLists[sc].pop_back();
+            m_ReleasedSegments -= n;
+            m_UsedSegments += n;
+            return slot;
+        }
+
+        // Carve the slot from the current block, or start a new block
+        if (m_Blocks.empty() || m_Blocks.back().Size - m_Blocks.back().Used < n)
+        {
+            SizeType size = std::max(n, std::max(SizeType(BlockGranularity), m_ReservedSegments / 4));
+            m_Blocks.push_back(Block(size));
+            m_ReservedSegments += size;
+        }
+
+        Block &b = m_Blocks.back();
+        TSegment *slot = b.Data.get() + b.Used;
+        b.Used += n;
+        m_UsedSegments += n;
+        return slot;
+    }
+
+    /** Return a slot of n segments previously obtained from Allocate. */
+    void Release(TSegment *slot, SizeType n)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        unsigned int sc = SizeClass(n);
+        if (sc >= m_FreeLists.size())
+            m_FreeLists.resize(sc + 1);
+        m_FreeLists[sc].push_back(slot);
+        m_ReleasedSegments += n;
+        m_UsedSegments -= n;
+    }
+
+    /** Number of segments held by live lines (including their slack) */
+    SizeType GetUsedSegments() const { return m_UsedSegments; }
+
+    /** Number of segments sitting on the free lists */
+    SizeType GetReleasedSegments() const { return m_ReleasedSegments; }
+
+    /** Total number of segments reserved in all blocks */
+    SizeType GetReservedSegments() const { return m_ReservedSegments; }
+
+    /** Number of blocks in the arena (1 after compaction) */
+    SizeType GetNumberOfBlocks() const { return m_Blocks.size(); }
+
+    /** Memory footprint of the arena in bytes */
+    SizeType GetMemorySize() const
+    {
+        return m_ReservedSegments * sizeof(TSegment) + sizeof(Self);
+    }
+
+    /** Smallest line capacity handed out by the arena */
+    static const SizeType MinimumCapacity = 4;
+
+    /** Smallest block allocated when the arena has to grow */
+    static const SizeType BlockGranularity = 1 << 16;
+
+protected:
+    RLELineArena(SizeType initialCapacity)
+        : m_ReferenceCount(1), m_UsedSegments(0), m_ReleasedSegments(0), m_ReservedSegments(0)
+    {
+        if (initialCapacity > 0)
+        {
+            m_Blocks.push_back(Block(initialCapacity));
+            m_ReservedSegments = initialCapacity;
+        }
+    }
+
+    ~RLELineArena() {}
+
+    static unsigned int SizeClass(SizeType n)
+    {
+        unsigned int sc = 0;
+        for (SizeType c = MinimumCapacity; c < n; c <<= 1)
+            sc++;
+        return sc;
+    }
+
+    struct Block
+    {
+        Block(SizeType size) : Data(new TSegment[size]), Size(size), Used(0) {}
+        std::unique_ptr<TSegment[]> Data;
+        SizeType Size, Used;
+    };
+
+    std::atomic<long> m_ReferenceCount;
+    std::mutex m_Mutex;
+    std::vector<Block> m_Blocks;
+    std::vector<std::vector<TSegment *> > m_FreeLists;
+    SizeType m_UsedSegments, m_ReleasedSegments, m_ReservedSegments;
+
+private:
+    RLELineArena(const Self &); //purposely not implemented
+    void operator=(const Self &); //purposely not implemented
+};
+
+
+/** A run-length line whose segments live in an RLELineArena.
+* It provides the subset of the std::vector interface that RLEImage and
+* its consumers rely upon, so it can be used as a drop-in RLLine type.
+*
+* A line that is bound to an arena rewrites its runs in place as long as
+* they fit into its capacity (the slack left by the arena size classes),
+* and relocates within the same arena otherwise. A line that has not been
+* bound to an arena (e.g. a temporary) owns a private heap buffer.
+*
+* Copy construction yields an unbound line; assignment keeps the arena
+* binding of the destination, so FillBuffer() and iterator writes
+* into an allocated image stay within the image's arena.
+*/
+template< typename TSegment >
+class RLEArenaLine
+{
+public:
+    typedef RLEArenaLine Self;
+    typedef RLELineArena<TSegment> ArenaType;
+    typedef TSegment value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef TSegment & reference;
+    typedef const TSegment & const_reference;
+    typedef TSegment * pointer;
+    typedef const TSegment * const_pointer;
+    typedef TSegment * iterator;
+    typedef const TSegment * const_iterator;
+
+    RLEArenaLine()
+        : m_Data(nullptr), m_Size(0), m_Capacity(0), m_Arena(nullptr) {}
+
+    explicit RLEArenaLine(size_type n, const TSegment & value = TSegment())
+        : m_Data(nullptr), m_Size(0), m_Capacity(0), m_Arena(nullptr)
+    {
+        resize(n, value);
+    }
+
+    RLEArenaLine(const Self & other)
+        : m_Data(nullptr), m_Size(0), m_Capacity(0), m_Arena(nullptr)
+    {
+        assign(other.begin(), other.end());
+    }
+
+    RLEArenaLine(Self && other)
+        : m_Data(other.m_Data), m_Size(other.m_Size),
+          m_Capacity(other.m_Capacity), m_Arena(other.m_Arena)
+    {
+        other.m_Data = nullptr;
+        other.m_Size = other.m_Capacity = 0;
+        other.m_Arena = nullptr;
+    }
+
+    ~RLEArenaLine() { ReleaseStorage(); }
+
+    Self & operator=(const Self & other)
+    {
+        if (this != &other)
+            assign(other.begin(), other.end());
+        return *this;
+    }
+
+    /** Moving only steals the storage if both lines use the same arena, so
+    * that the destination does not silently change its binding. */
+    Self & operator=(Self && other)
+    {
+        if (this != &other)
+        {
+            if (m_Arena == other.m_Arena)
+                swap(other);
+            else
+                assign(other.begin(), other.end());
+        }
+        return *this;
+    }
+
+    /** Bind the line to an arena, moving its runs into an arena slot
+    * with room for at least capacity segments. */
+    void Bind(ArenaType *arena, size_type capacity)
+    {
+        capacity = ArenaType::RoundCapacity(std::max(capacity, size_type(m_Size)));
+        TSegment *data = arena->Allocate(capacity);
+        std::copy(m_Data, m_Data + m_Size, data);
+        arena->Register();
+        ReleaseStorage();
+        m_Data = data;
+        m_Capacity = static_cast<unsigned int>(capacity);
+        m_Arena = arena;
+    }
+
+    /** The arena holding this line's runs, or nullptr for heap storage */
+    ArenaType *GetArena() const { return m_Arena; }
+
+    size_type size() const { return m_Size; }
+    size_type capacity() const { return m_Capacity; }
+    bool empty() const { return m_Size == 0; }
+
+    TSegment *data() { return m_Data; }
+    const TSegment *data() const { return m_Data; }
+
+    iterator begin() { return m_Data; }
+    iterator end() { return m_Data + m_Size; }
+    const_iterator begin() const { return m_Data; }
+    const_iterator end() const { return m_Data + m_Size; }
+
+    reference operator[](size_type i) { return m_Data[i]; }
+    const_reference operator[](size_type i) const { return m_Data[i]; }
+
+    reference front() { return m_Data[0]; }
+    const_reference front() const { return m_Data[0]; }
+    reference back() { return m_Data[m_Size - 1]; }
+    const_reference back() const { return m_Data[m_Size - 1]; }
+
+    void clear() { m_Size = 0; }
+
+    void reserve(size_type n)
+    {
+        if (n > m_Capacity)
+            Reallocate(n);
+    }
+
+    void resize(size_type n, const TSegment & value = TSegment())
+    {
+        reserve(n);
+        for (size_type i = m_Size; i < n; i++)
+            m_Data[i] = value;
+        m_Size = static_cast<unsigned int>(n);
+    }
+
+    void push_back(const TSegment & value)
+    {
+        if (m_Size == m_Capacity)
+        {
+            TSegment copy = value; // value may refer into this line
+            Grow(m_Size + 1);
+            m_Data[m_Size++] = copy;
+        }
+        else
+            m_Data[m_Size++] = value;
+    }
+
+    void pop_back() { m_Size--; }
+
+    template< typename TInputIterator >
+    void assign(TInputIterator first, TInputIterator last)
+    {
+        size_type n = std::distance(first, last);
+        if (n > m_Capacity)
+        {
+            // Copy out first in case the source lives in our own buffer
+            std::vector<TSegment> tmp(first, last);
+            Reallocate(n, false);
+            std::copy(tmp.begin(), tmp.end(), m_Data);
+        }
+        else
+            std::copy(first, last, m_Data);
+        m_Size = static_cast<unsigned int>(n);
+    }
+
+    iterator insert(const_iterator pos, const TSegment & value)
+    {
+        return insert(pos, size_type(1), value);
+    }
+
+    iterator insert(const_iterator pos, size_type n, const TSegment & value)
+    {
+        TSegment copy = value;
+        size_type i = MakeRoom(pos, n);
+        std::fill(m_Data + i, m_Data + i + n, copy);
+        return m_Data + i;
+    }
+
+    template< typename TInputIterator >
+    iterator insert(const_iterator pos, TInputIterator first, TInputIterator last)
+    {
+        std::vector<TSegment> tmp(first, last);
+        size_type i = MakeRoom(pos, tmp.size());
+        std::copy(tmp.begin(), tmp.end(), m_Data + i);
+        return m_Data + i;
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        return erase(pos, pos + 1);
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        size_type i = first - m_Data, j = last - m_Data;
+        std::copy(m_Data + j, m_Data + m_Size, m_Data + i);
+        m_Size -= static_cast<unsigned int>(j - i);
+        return m_Data + i;
+    }
+
+    void swap(Self & other)
+    {
+        std::swap(m_Data, other.m_Data);
+        std::swap(m_Size, other.m_Size);
+        std::swap(m_Capacity, other.m_Capacity);
+        std::swap(m_Arena, other.m_Arena);
+    }
+
+    bool operator==(const Self & other) const
+    {
+        return m_Size == other.m_Size && std::equal(begin(), end(), other.begin());
+    }
+
+    bool operator!=(const Self & other) const { return !(*this == other); }
+
+protected:
+    /** Open a gap of n segments at pos, returning the gap's offset */
+    size_type MakeRoom(const_iterator pos, size_type n)
+    {
+        size_type i = pos - m_Data;
+        if (m_Size + n > m_Capacity)
+            Grow(m_Size + n);
+        std::copy_backward(m_Data + i, m_Data + m_Size, m_Data + m_Size + n);
+        m_Size += static_cast<unsigned int>(n);
+        return i;
+    }
+
+    void Grow(size_type n)
+    {
+        Reallocate(std::max(n, size_type(m_Capacity) * 2));
+    }
+
+    /** Move the line into a larger slot of the same arena (or heap) */
+    void Reallocate(size_type n, bool preserve = true)
+    {
+        TSegment *data;
+        size_type capacity;
+        if (m_Arena)
+        {
+            capacity = ArenaType::RoundCapacity(n);
+            data = m_Arena->Allocate(capacity);
+        }
+        else
+        {
+            capacity = n;
+            data = new TSegment[capacity];
+        }
+
+        if (preserve)
+            std::copy(m_Data, m_Data + m_Size, data);
+
+        ArenaType *arena = m_Arena;
+        if (arena)
+            arena->Register();
+        ReleaseStorage();
+        m_Data = data;
+        m_Capacity = static_cast<unsigned int>(capacity);
+        m_Arena = arena;
+    }
+
+    void ReleaseStorage()
+    {
+        if (m_Arena)
+        {
+            m_Arena->Release(m_Data, m_Capacity);
+            m_Arena->UnRegister();
+        }
+        else
+            delete[] m_Data;
+        m_Data = nullptr;
+        m_Capacity = 0;
+        m_Arena = nullptr;
+    }
+
+    TSegment *m_Data;
+    unsigned int m_Size, m_Capacity;
+    ArenaType *m_Arena;
+};
+
+template< typename TSegment >
+inline void swap(RLEArenaLine<TSegment> & a, RLEArenaLine<TSegment> & b)
+{
+    a.swap(b);
+}
+
+#endif //RLELineArena_h
@@ -151,6 +151,12 @@ public:
   void SetUseNearestNeighbor(bool flag);
   bool GetUseNearestNeighbor() const;
 
+  /**
+   * The orthogonal slicer. Its slicing axes and directions are current after
+   * UpdateOutputInformation() has been called in orthogonal mode.
+   */
+  OrthogonalSlicerType *GetOrthogonalSlicer() const { return m_OrthogonalSlicer; }
+
 protected:
 
   AdaptiveSlicingPipeline();
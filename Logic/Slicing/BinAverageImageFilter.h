@@ -0,0 +1,62 @@
+#ifndef BINAVERAGEIMAGEFILTER_H
+#define BINAVERAGEIMAGEFILTER_H
+
+#include "SNAPCommon.h"
+#include <itkImageToImageFilter.h>
+
+/**
+ * This filter reduces the resolution of a scalar 3D image by an integer
+ * factor, replacing each bin of factor^3 voxels by their average. It is used
+ * to build the levels of an image pyramid for displaying zoomed out slices.
+ *
+ * Axes of size one are not shrunk. Along the other axes, the output has
+ * ceil(size / factor) voxels, the last of which averages the voxels that are
+ * left over. The output voxels are centered on their bins. The input may be
+ * an image adaptor.
+ */
+template <class TInputImage, class TOutputImage>
+class BinAverageImageFilter
+    : public itk::ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+
+  typedef BinAverageImageFilter<TInputImage, TOutputImage>               Self;
+  typedef itk::ImageToImageFilter<TInputImage, TOutputImage>       Superclass;
+  typedef itk::SmartPointer<Self>                                     Pointer;
+  typedef itk::SmartPointer<const Self>                          ConstPointer;
+
+  typedef TInputImage                                          InputImageType;
+  typedef TOutputImage                                        OutputImageType;
+  typedef typename OutputImageType::PixelType                 OutputPixelType;
+  typedef typename OutputImageType::RegionType               OutputRegionType;
+
+  itkTypeMacro(BinAverageImageFilter, ImageToImageFilter)
+  itkNewMacro(Self)
+
+  /** Set the factor by which the image is shrunk along each axis */
+  itkSetMacro(ShrinkFactor, unsigned int)
+  itkGetMacro(ShrinkFactor, unsigned int)
+
+  /** The shrink factor that applies to an axis of the given size */
+  unsigned int GetShrinkFactorForAxisSize(itk::SizeValueType size) const
+    { return size > 1 ? m_ShrinkFactor : 1; }
+
+protected:
+
+  BinAverageImageFilter();
+  virtual ~BinAverageImageFilter() {}
+
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
+
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  virtual void DynamicThreadedGenerateData(const OutputRegionType &region) ITK_OVERRIDE;
+
+  unsigned int m_ShrinkFactor;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "BinAverageImageFilter.txx"
+#endif
+
+#endif // BINAVERAGEIMAGEFILTER_H
@@ -0,0 +1,129 @@
+#ifndef BINAVERAGEIMAGEFILTER_TXX
+#define BINAVERAGEIMAGEFILTER_TXX
+
+#include "BinAverageImageFilter.h"
+#include <itkImageScanlineConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <itkContinuousIndex.h>
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <vector>
+
+template <class TInputImage, class TOutputImage>
+BinAverageImageFilter<TInputImage, TOutputImage>
+::BinAverageImageFilter()
+{
+  m_ShrinkFactor = 2;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+BinAverageImageFilter<TInputImage, TOutputImage>
+::GenerateOutputInformation()
+{
+  const InputImageType *input = this->GetInput();
+  OutputImageType *output = this->GetOutput();
+  if(!input || !output)
+    return;
+
+  typename InputImageType::RegionType inRegion = input->GetLargestPossibleRegion();
+  typename OutputImageType::SizeType size;
+  typename OutputImageType::SpacingType spacing;
+  itk::ContinuousIndex<double, 3> cixFirstBin;
+  for(unsigned int d = 0; d < 3; d++)
+    {
+    unsigned int f = this->GetShrinkFactorForAxisSize(inRegion.GetSize(d));
+    size[d] = (inRegion.GetSize(d) + f - 1) / f;
+    spacing[d] = input->GetSpacing()[d] * f;
+    cixFirstBin[d] = inRegion.GetIndex(d) + 0.5 * (f - 1);
+    }
+
+  // The first voxel is at the center of the first bin
+  typename OutputImageType::PointType origin;
+  input->TransformContinuousIndexToPhysicalPoint(cixFirstBin, origin);
+
+  output->SetLargestPossibleRegion(OutputRegionType(size));
+  output->SetSpacing(spacing);
+  output->SetOrigin(origin);
+  output->SetDirection(input->GetDirection());
+}
+
+template <class TInputImage, class TOutputImage>
+void
+BinAverageImageFilter<TInputImage, TOutputImage>
+::GenerateInputRequestedRegion()
+{
+  // Request the entire input image
+  InputImageType *input = const_cast<InputImageType *>(this->GetInput());
+  if(input)
+    input->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TInputImage, class TOutputImage>
+void
+BinAverageImageFilter<TInputImage, TOutputImage>
+::DynamicThreadedGenerateData(const OutputRegionType &region)
+{
+  const InputImageType *input = this->GetInput();
+  OutputImageType *output = this->GetOutput();
+
+  typename InputImageType::RegionType inRegion = input->GetLargestPossibleRegion();
+  unsigned int f[3];
+  for(unsigned int d = 0; d < 3; d++)
+    f[d] = this->GetShrinkFactorForAxisSize(inRegion.GetSize(d));
+
+  // Sums and voxel counts for a line of output voxels
+  unsigned int nx = region.GetSize(0);
+  std::vector<double> sum(nx);
+  std::vector<unsigned int> count(nx);
+
+  typename OutputImageType::IndexType idx = region.GetIndex();
+  for(unsigned int z = 0; z < region.GetSize(2); z++)
+    {
+    idx[2] = region.GetIndex(2) + z;
+    for(unsigned int y = 0; y < region.GetSize(1); y++)
+      {
+      idx[1] = region.GetIndex(1) + y;
+
+      // The input voxels in the bins of this line, clipped to the image
+      typename InputImageType::RegionType binRegion;
+      for(unsigned int d = 0; d < 3; d++)
+        {
+        itk::IndexValueType i0 = inRegion.GetIndex(d) + idx[d] * (itk::IndexValueType) f[d];
+        itk::IndexValueType n = (d == 0) ? nx * f[0] : f[d];
+        itk::IndexValueType iEnd = std::min(i0 + n, inRegion.GetUpperIndex()[d] + 1);
+        binRegion.SetIndex(d, i0);
+        binRegion.SetSize(d, iEnd - i0);
+        }
+
+      std::fill(sum.begin(), sum.end(), 0.0);
+      std::fill(count.begin(), count.end(), 0u);
+
+      itk::ImageScanlineConstIterator<InputImageType> it(input, binRegion);
+      while(!it.IsAtEnd())
+        {
+        for(unsigned int k = 0; !it.IsAtEndOfLine(); ++it, ++k)
+          {
+          sum[k / f[0]] += it.Get();
+          count[k / f[0]]++;
+          }
+        it.NextLine();
+        }
+
+      // Write the averages
+      itk::ImageRegionIterator<OutputImageType> itOut(
+            output, OutputRegionType(idx, {{ nx, 1, 1 }}));
+      for(unsigned int i = 0; i < nx; ++i, ++itOut)
+        {
+        double mean = count[i] ? sum[i] / count[i] : 0.0;
+        if constexpr(std::is_integral<OutputPixelType>::value)
+          itOut.Set(static_cast<OutputPixelType>(std::floor(mean + 0.5)));
+        else
+          itOut.Set(static_cast<OutputPixelType>(mean));
+        }
+      }
+    }
+}
+
+#endif // BINAVERAGEIMAGEFILTER_TXX
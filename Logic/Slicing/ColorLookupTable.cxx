@@ -26,6 +26,26 @@ void ColorLookupTable<TInputPixel, TDisplayPixel>
   }
 }
 
+template<class TInputPixel, class TDisplayPixel>
+void ColorLookupTable<TInputPixel, TDisplayPixel>
+::Graft(const itk::DataObject *data)
+{
+  Superclass::Graft(data);
+  const Self *source = dynamic_cast<const Self *>(data);
+  if(source)
+    {
+    m_LUT = source->m_LUT;
+    m_ColorBelow = source->m_ColorBelow;
+    m_ColorAbove = source->m_ColorAbove;
+    m_ColorNaN = source->m_ColorNaN;
+    m_StartValue = source->m_StartValue;
+    m_EndValue = source->m_EndValue;
+    m_IntensityToLUTIndexScaleFactor = source->m_IntensityToLUTIndexScaleFactor;
+    m_LUTIndexToCurveDomainScale = source->m_LUTIndexToCurveDomainScale;
+    m_LUTIndexToCurveDomainShift = source->m_LUTIndexToCurveDomainShift;
+    }
+}
+
 // Template instantiation
 #define ColorLookupTableInstantiateMacro(type) \
   template class ColorLookupTable<type, itk::RGBAPixel<unsigned char> >; \
@@ -88,6 +88,9 @@ public:
   /** Color used for NAN */
   itkSetMacro(ColorNaN, TDisplayPixel)
 
+  /** Copy the table and its metadata from another lookup table */
+  virtual void Graft(const itk::DataObject *data) ITK_OVERRIDE;
+
 
 protected:
   ColorLookupTable() {}
@@ -285,6 +285,15 @@ public:
   itkGetMacro(BypassMainInput, bool)
   itkSetMacro(BypassMainInput, bool)
 
+  /**
+   * When slicing across the run-length axis (X), look up the run containing
+   * the slice index in each line by binary search over a cached table of
+   * cumulative run ends, instead of walking each line from the start. The
+   * table is rebuilt whenever the input image is modified. On by default.
+   */
+  itkGetMacro(UseRunEndIndex, bool)
+  itkSetMacro(UseRunEndIndex, bool)
+
 protected:
 
   IRISSlicer();
@@ -312,6 +321,10 @@ protected:
 
   void GenerateData() ITK_OVERRIDE;
 
+  /** Rebuild the cumulative run end table for the given image, unless it
+    * is already up to date with respect to the image's modified time. */
+  void UpdateRunEndIndex(const InputImageType *image);
+
   /** Uncompresses a RLE line into a buffer pointed by out.
     * After each pixel is written, adds stride to the pointer.
     * The buffer needs to have enough room.
@@ -362,6 +375,17 @@ private:
   // Whether the main input should always be bypassed
   bool m_BypassMainInput;
 
+  // Whether to use the run end table for slicing along X
+  bool m_UseRunEndIndex;
+
+  // Cumulative run ends of all lines, concatenated in buffer order, and
+  // the offset of each line's first entry in that array
+  std::vector<CounterType> m_RunEnd;
+  std::vector<itk::SizeValueType> m_RunEndOffset;
+
+  // The image and its modified time for which the run end table was built
+  const InputImageType *m_RunEndIndexImage;
+  itk::ModifiedTimeType m_RunEndIndexMTime;
 };
 
 #ifndef ITK_MANUAL_INSTANTIATION
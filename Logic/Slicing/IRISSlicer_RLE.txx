@@ -38,6 +38,8 @@
 #include "itkImage.h"
 #include "itkVectorImage.h"
 #include "itkVectorImageToImageAdaptor.h"
+#include "itkMultiThreaderBase.h"
+#include <algorithm>
 
 //now goes version specialized for RLEImage
 template< typename TPixel, typename CounterType, class TOutputImage, class TPreviewImage>
@@ -64,6 +66,13 @@ IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
 
   // Initialize to a zero slice index
   m_SliceIndex = 0;
+
+  m_BypassMainInput = false;
+
+  // The run end table is built on demand
+  m_UseRunEndIndex = true;
+  m_RunEndIndexImage = nullptr;
+  m_RunEndIndexMTime = 0;
 }
 
 template< typename TPixel, typename CounterType, class TOutputImage, class TPreviewImage>
@@ -198,6 +207,42 @@ void IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
 
 #define sign(forward) (forward ? 1 : -1)
 
+template< typename TPixel, typename CounterType, class TOutputImage, class TPreviewImage>
+void IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
+::UpdateRunEndIndex(const InputImageType *image)
+{
+  if (image == m_RunEndIndexImage && image->GetMTime() == m_RunEndIndexMTime
+      && !m_RunEndOffset.empty())
+    return;
+
+  const typename InputImageType::BufferType *buffer = image->GetBuffer();
+  const typename InputImageType::RLLine *lines = buffer->GetBufferPointer();
+  itk::SizeValueType nLines = buffer->GetBufferedRegion().GetNumberOfPixels();
+
+  // Offsets of each line's entries in the concatenated table
+  m_RunEndOffset.resize(nLines + 1);
+  m_RunEndOffset[0] = 0;
+  for (itk::SizeValueType i = 0; i < nLines; i++)
+    m_RunEndOffset[i + 1] = m_RunEndOffset[i] + lines[i].size();
+  m_RunEnd.resize(m_RunEndOffset[nLines]);
+
+  // Fill in the cumulative run ends, one line at a time in parallel
+  this->GetMultiThreader()->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+  this->GetMultiThreader()->ParallelizeArray(
+        0, nLines,
+        [this, lines](itk::SizeValueType i)
+    {
+    const typename InputImageType::RLLine &line = lines[i];
+    CounterType *end = &m_RunEnd[m_RunEndOffset[i]];
+    CounterType t = 0;
+    for (itk::SizeValueType x = 0; x < line.size(); x++)
+      end[x] = (t += line[x].first);
+    }, nullptr);
+
+  m_RunEndIndexImage = image;
+  m_RunEndIndexMTime = image->GetMTime();
+}
+
 template< typename TPixel, typename CounterType, class TOutputImage, class TPreviewImage>
 void IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
 ::GenerateData()
@@ -239,79 +284,106 @@ void IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
 
   typename OutputImageType::PixelType *outSlice = &outputPtr->GetPixel(oStartInd);
 
+  // The lines of the RLE image, stored with y varying fastest
+  const typename InputImageType::RLLine *lines = inputPtr->GetBuffer()->GetBufferPointer();
+
+  // Each work unit fills a band of the output slice. The bands are aligned
+  // with the outer loop over RLE lines, so that they never overlap.
+  itk::MultiThreaderBase *mt = this->GetMultiThreader();
+  mt->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+
   if (m_SliceDirectionImageAxis == 2) //slicing along z
     {
-#pragma omp parallel for
-    for (int y = 0; y < szVol[1]; y++)
+    if (m_LineDirectionImageAxis != 1 && m_LineDirectionImageAxis != 0)
+      throw itk::ExceptionObject(__FILE__, __LINE__, "SliceDirectionImageAxis and SliceDirectionImageAxis cannot both have a value of 2!", __FUNCTION__);
+
+    mt->ParallelizeArray(0, szVol[1], [&](itk::SizeValueType yy)
       {
-      typename InputImageType::BufferType::IndexType lineIndex = { { y, (int) m_SliceIndex } };
-      const typename InputImageType::RLLine & line = inputPtr->GetBuffer()->GetPixel(lineIndex);
+      long y = (long) yy;
+      const typename InputImageType::RLLine & line = lines[m_SliceIndex * szVol[1] + y];
       if (m_LineDirectionImageAxis == 1) //y is line coordinate
         {
         assert(m_PixelDirectionImageAxis == 0); //x is pixel coordinate
         uncompressLine(line, outSlice + s_line*y*szVol[0], s_pixel * 1);
         }
-      else if (m_LineDirectionImageAxis == 0) //x is line coordinate
+      else //x is line coordinate
         {
         assert(m_PixelDirectionImageAxis == 1); //y is pixel coordinate
         uncompressLine(line, outSlice + s_pixel*y, s_line*szVol[1]);
         }
-      else
-        throw itk::ExceptionObject(__FILE__, __LINE__, "SliceDirectionImageAxis and SliceDirectionImageAxis cannot both have a value of 2!", __FUNCTION__);
-      }
+      }, nullptr);
     }
   else if (m_SliceDirectionImageAxis == 1) //slicing along y
     {
-#pragma omp parallel for
-    for (int z = 0; z < szVol[2]; z++)
+    if (m_LineDirectionImageAxis != 2 && m_LineDirectionImageAxis != 0)
+      throw itk::ExceptionObject(__FILE__, __LINE__, "SliceDirectionImageAxis and SliceDirectionImageAxis cannot both have a value of 1!", __FUNCTION__);
+
+    mt->ParallelizeArray(0, szVol[2], [&](itk::SizeValueType zz)
       {
-      typename InputImageType::BufferType::IndexType lineIndex = { { (int) m_SliceIndex, z } };
-      const typename InputImageType::RLLine & line = inputPtr->GetBuffer()->GetPixel(lineIndex);
+      long z = (long) zz;
+      const typename InputImageType::RLLine & line = lines[z * szVol[1] + m_SliceIndex];
       if (m_LineDirectionImageAxis == 2) //z is line coordinate
         {
         assert(m_PixelDirectionImageAxis == 0); //x is pixel coordinate
         uncompressLine(line, outSlice + s_line*z*szVol[0], s_pixel * 1);
         }
-      else if (m_LineDirectionImageAxis == 0) //x is line coordinate
+      else //x is line coordinate
         {
         assert(m_PixelDirectionImageAxis == 2); //z is pixel coordinate
         uncompressLine(line, outSlice + s_pixel*z, s_line*szVol[2]);
         }
-      else
-        throw itk::ExceptionObject(__FILE__, __LINE__, "SliceDirectionImageAxis and SliceDirectionImageAxis cannot both have a value of 1!", __FUNCTION__);
-      }
+      }, nullptr);
     }
   else //slicing along x, the low-preformance case
     {
     assert(m_SliceDirectionImageAxis == 0);
-#pragma omp parallel for
-    for (int z = 0; z < szVol[2]; z++)
-      for (int y = 0; y < szVol[1]; y++)
+    if (m_LineDirectionImageAxis != 2 && m_LineDirectionImageAxis != 1)
+      throw itk::ExceptionObject(__FILE__, __LINE__, "SliceDirectionImageAxis and SliceDirectionImageAxis cannot both have a value of 0!", __FUNCTION__);
+
+    // Offsets into the output slice of a unit step in y and z
+    long o_y, o_z;
+    if (m_LineDirectionImageAxis == 2) //z is line coordinate
+      {
+      assert(m_PixelDirectionImageAxis == 1); //y is pixel coordinate
+      o_z = s_line * szVol[1];
+      o_y = s_pixel;
+      }
+    else //y is line coordinate
+      {
+      assert(m_PixelDirectionImageAxis == 2); //z is pixel coordinate
+      o_z = s_pixel;
+      o_y = s_line * szVol[2];
+      }
+
+    if (m_UseRunEndIndex)
+      UpdateRunEndIndex(inputPtr);
+
+    mt->ParallelizeArray(0, szVol[2], [&](itk::SizeValueType zz)
+      {
+      long z = (long) zz;
+      for (long y = 0; y < szVol[1]; y++)
         {
-        typename InputImageType::BufferType::IndexType lineIndex = { { y, z } };
-        const typename InputImageType::RLLine & line = inputPtr->GetBuffer()->GetPixel(lineIndex);
-        int t = 0;
-        for (int x = 0; x < line.size(); x++)
+        itk::SizeValueType iLine = z * szVol[1] + y;
+        const typename InputImageType::RLLine & line = lines[iLine];
+        itk::SizeValueType x;
+        if (m_UseRunEndIndex
+            && m_RunEndOffset[iLine + 1] - m_RunEndOffset[iLine] == line.size())
+          {
+          // Binary search for the first run that ends past the slice index
+          const CounterType *first = m_RunEnd.data() + m_RunEndOffset[iLine];
+          const CounterType *last = m_RunEnd.data() + m_RunEndOffset[iLine + 1];
+          x = std::upper_bound(first, last, (CounterType) m_SliceIndex) - first;
+          }
+        else
           {
-          t += line[x].first;
-          if (t > m_SliceIndex)
-            {
-            if (m_LineDirectionImageAxis == 2) //z is line coordinate
-              {
-              assert(m_PixelDirectionImageAxis == 1); //y is pixel coordinate
-              *(outSlice + s_line*z*szVol[1] + s_pixel *y) = line[x].second;;
-              }
-            else if (m_LineDirectionImageAxis == 1) //y is line coordinate
-              {
-              assert(m_PixelDirectionImageAxis == 2); //z is pixel coordinate
-              *(outSlice + s_pixel*z + s_line *y*szVol[2]) = line[x].second;
-              }
-            else
-              throw itk::ExceptionObject(__FILE__, __LINE__, "SliceDirectionImageAxis and SliceDirectionImageAxis cannot both have a value of 0!", __FUNCTION__);
-            break;
-            }
+          CounterType t = 0;
+          for (x = 0; x < line.size(); x++)
+            if ((t += line[x].first) > m_SliceIndex)
+              break;
           }
+        *(outSlice + z * o_z + y * o_y) = line[x].second;
         }
+      }, nullptr);
     }
 }
 
@@ -334,6 +406,7 @@ void IRISSlicer<RLEImage<TPixel, 3, CounterType>, TOutputImage, TPreviewImage>
   os << indent << "Lines Traversed Forward: " << m_LineTraverseForward << std::endl;
   os << indent << "Pixel Image Axis: " << m_PixelDirectionImageAxis << std::endl;
   os << indent << "Pixels Traversed Forward: " << m_PixelTraverseForward << std::endl;
+  os << indent << "Use Run End Index: " << m_UseRunEndIndex << std::endl;
 }
 
 template< typename TPixel, typename CounterType, class TOutputImage, class TPreviewImage>
@@ -48,6 +48,7 @@
 #include "itkDataObjectDecorator.h"
 #include "itkVectorImage.h"
 #include "itkImageAdaptor.h"
+#include "FastLinearLineSampler.h"
 
 using itk::DataObjectDecorator;
 using itk::ProcessObject;
@@ -75,6 +76,13 @@ public:
 
   inline void ProcessVoxel(double *cix, bool use_nn, OutputComponentType **out_ptr);
 
+  /**
+   * Process n voxels along a line, starting at cix and advancing it by step
+   * after each voxel
+   */
+  inline void ProcessLine(double *cix, const double *step, int n, bool use_nn,
+                          OutputComponentType **out_ptr);
+
   inline void SkipVoxels(int n, OutputComponentType **out_ptr);
 
 protected:
@@ -83,6 +91,12 @@ protected:
   typedef FastLinearInterpolator<TInputImage, double, TInputImage::ImageDimension> Interpolator;
   Interpolator m_Interpolator;
 
+  // Sampler for the parts of the line inside the image, used for 3D images
+  // with a single component
+  typedef typename TInputImage::InternalPixelType InputComponentType;
+  FastLinearLineSampler<InputComponentType> m_LineSampler;
+  bool m_UseLineSampler;
+
   // Number of components
   int m_NumComponents;
 
@@ -108,6 +122,8 @@ public:
   ~DefaultNonOrthogonalSlicerWorkerTraits();
 
   inline void ProcessVoxel(double *cix, bool use_nn, OutputComponentType **out_ptr);
+  inline void ProcessLine(double *cix, const double *step, int n, bool use_nn,
+                          OutputComponentType **out_ptr);
   inline void SkipVoxels(int n, OutputComponentType **out_ptr);
 
 protected:
@@ -146,6 +162,8 @@ public:
   ~DefaultNonOrthogonalSlicerWorkerTraits();
 
   inline void ProcessVoxel(double *cix, bool use_nn, OutputComponentType **out_ptr);
+  inline void ProcessLine(double *cix, const double *step, int n, bool use_nn,
+                          OutputComponentType **out_ptr);
   inline void SkipVoxels(int n, OutputComponentType **out_ptr);
 
 protected:
@@ -188,6 +206,9 @@ public:
 
   inline void ProcessVoxel(double *cix, bool use_nn, OutputComponentType **out_ptr);
 
+  inline void ProcessLine(double *cix, const double *step, int n, bool use_nn,
+                          OutputComponentType **out_ptr);
+
   inline void SkipVoxels(int n, OutputComponentType **out_ptr);
 
 protected:
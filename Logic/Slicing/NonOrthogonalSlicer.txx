@@ -241,14 +241,8 @@ NonOrthogonalSlicer<TInputImage, TOutputImage, TWorkerTraits>
         }
 
       // Process the voxels that cross the image cube
-      for(int i = kStart; i <= kEnd; i++)
-        {
-        worker.ProcessVoxel(cixSample.GetDataPointer(), use_nn, &outPixelPtr);
-
-        // Update the sample location
-        for(int d = 0; d < InputImageDimension; d++)
-          cixSample[d] += cixStep[d];
-        }
+      worker.ProcessLine(cixSample.GetDataPointer(), cixStep.GetDataPointer(),
+                         kEnd - kStart + 1, use_nn, &outPixelPtr);
 
       // Process the rest
       if(kEnd < line_len - 1)
@@ -272,6 +266,14 @@ DefaultNonOrthogonalSlicerWorkerTraits<TInputImage, TOutputImage>
 {
   m_NumComponents = m_Interpolator.GetPointerIncrement();
   m_Buffer = new double[m_NumComponents];
+
+  m_UseLineSampler = (TInputImage::ImageDimension == 3 && m_NumComponents == 1);
+  if(m_UseLineSampler)
+    {
+    const typename TInputImage::SizeType &size = image->GetLargestPossibleRegion().GetSize();
+    m_LineSampler = FastLinearLineSampler<InputComponentType>(
+                      image->GetBufferPointer(), size[0], size[1], size[2]);
+    }
 }
 
 template <class TInputImage, class TOutputImage>
@@ -303,6 +305,41 @@ DefaultNonOrthogonalSlicerWorkerTraits<TInputImage, TOutputImage>
     }
 }
 
+template <class TInputImage, class TOutputImage>
+void
+DefaultNonOrthogonalSlicerWorkerTraits<TInputImage, TOutputImage>
+::ProcessLine(double *cix, const double *step, int n, bool use_nn, OutputComponentType **out_ptr)
+{
+  // The voxels whose neighborhood is entirely inside the image are handed to
+  // the line sampler, the ones near the edges are checked one by one
+  int first = 0, last = 0;
+  if(m_UseLineSampler)
+    m_LineSampler.ComputeInsideSpan(cix, step, n, first, last);
+
+  for(int i = 0; i < first; i++)
+    {
+    ProcessVoxel(cix, use_nn, out_ptr);
+    for(unsigned int d = 0; d < TInputImage::ImageDimension; d++)
+      cix[d] += step[d];
+    }
+
+  if(last > first)
+    {
+    if(use_nn)
+      m_LineSampler.InterpolateNearestNeighbor(cix, step, last - first, *out_ptr);
+    else
+      m_LineSampler.Interpolate(cix, step, last - first, *out_ptr);
+    *out_ptr += last - first;
+    }
+
+  for(int i = last; i < n; i++)
+    {
+    ProcessVoxel(cix, use_nn, out_ptr);
+    for(unsigned int d = 0; d < TInputImage::ImageDimension; d++)
+      cix[d] += step[d];
+    }
+}
+
 template <class TInputImage, class TOutputImage>
 void
 DefaultNonOrthogonalSlicerWorkerTraits<TInputImage, TOutputImage>
@@ -363,6 +400,21 @@ DefaultNonOrthogonalSlicerWorkerTraits<
     *(*out_ptr)++ = 0;
 }
 
+template <typename TPixelType, unsigned int Dimension, typename TOutputImage>
+void
+DefaultNonOrthogonalSlicerWorkerTraits<
+  itk::VectorImageToImageAdaptor<TPixelType, Dimension>,
+  TOutputImage>
+::ProcessLine(double *cix, const double *step, int n, bool use_nn, OutputComponentType **out_ptr)
+{
+  for(int i = 0; i < n; i++)
+    {
+    ProcessVoxel(cix, use_nn, out_ptr);
+    for(unsigned int d = 0; d < Dimension; d++)
+      cix[d] += step[d];
+    }
+}
+
 template <typename TPixelType, unsigned int Dimension, typename TOutputImage>
 void
 DefaultNonOrthogonalSlicerWorkerTraits<
@@ -431,6 +483,21 @@ DefaultNonOrthogonalSlicerWorkerTraits<
     }
 }
 
+template <typename TPixelType, unsigned int Dimension, typename TAccessor, typename TOutputImage>
+void
+DefaultNonOrthogonalSlicerWorkerTraits<
+  itk::ImageAdaptor<itk::VectorImage<TPixelType, Dimension>, TAccessor>,
+  TOutputImage>
+::ProcessLine(double *cix, const double *step, int n, bool use_nn, OutputComponentType **out_ptr)
+{
+  for(int i = 0; i < n; i++)
+    {
+    ProcessVoxel(cix, use_nn, out_ptr);
+    for(unsigned int d = 0; d < Dimension; d++)
+      cix[d] += step[d];
+    }
+}
+
 template <typename TPixelType, unsigned int Dimension, typename TAccessor, typename TOutputImage>
 void
 DefaultNonOrthogonalSlicerWorkerTraits<
@@ -480,6 +547,19 @@ DefaultNonOrthogonalSlicerWorkerTraits<RLEImage<TPixel, Dimension, TCounter>, TO
     }
 }
 
+template <typename TPixel, unsigned int Dimension, typename TCounter, typename TOutputImage>
+void
+DefaultNonOrthogonalSlicerWorkerTraits<RLEImage<TPixel, Dimension, TCounter>, TOutputImage>
+::ProcessLine(double *cix, const double *step, int n, bool use_nn, OutputComponentType **out_ptr)
+{
+  for(int i = 0; i < n; i++)
+    {
+    ProcessVoxel(cix, use_nn, out_ptr);
+    for(unsigned int d = 0; d < Dimension; d++)
+      cix[d] += step[d];
+    }
+}
+
 template <typename TPixel, unsigned int Dimension, typename TCounter, typename TOutputImage>
 void
 DefaultNonOrthogonalSlicerWorkerTraits<RLEImage<TPixel, Dimension, TCounter>, TOutputImage>
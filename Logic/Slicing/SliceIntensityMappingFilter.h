@@ -0,0 +1,163 @@
+#ifndef SLICEINTENSITYMAPPINGFILTER_H
+#define SLICEINTENSITYMAPPINGFILTER_H
+
+#include "SNAPCommon.h"
+#include "DisplaySliceCache.h"
+#include <itkImageToImageFilter.h>
+
+template <class TInputPixel, class TDisplayPixel> class ColorLookupTable;
+
+/**
+ * This filter produces the display slice of an image in a single threaded
+ * pass. It reads the voxels of the slice straight from the 3D image and maps
+ * them through the lookup table, so that the intermediate slice produced by
+ * the slicer and mapped by LookupTableIntensityMappingFilter is never made.
+ *
+ * The geometry of the slice is taken from a slicing pipeline (TSlicer, an
+ * AdaptiveSlicingPipeline), which is not itself an input of this filter but
+ * whose changes cause the filter to update. The direct path is used for
+ * orthogonal slicing. For oblique slicing, or when the slicer has a preview
+ * input, the slicer is updated and its output is mapped instead.
+ *
+ * With a DisplaySliceCache, orthogonal slices are looked up in the cache
+ * before they are computed. When consecutive updates move through the
+ * slices, the next slices in the same direction are computed ahead in the
+ * background.
+ *
+ * The input may also be a level of an image pyramid made from the slicer's
+ * input by BinAverageImageFilter (TInputImage), in which case the shrink
+ * factor of the level must be set. The display slice then has fewer, larger
+ * pixels than the slicer's output, covering the same extent. Oblique and
+ * preview slices are always made at full resolution.
+ */
+template <class TSlicer, class TOutputImage,
+          class TInputImage = typename TSlicer::InputImageType>
+class SliceIntensityMappingFilter
+    : public itk::ImageToImageFilter<TInputImage, TOutputImage>
+{
+public:
+
+  typedef SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage> Self;
+  typedef TInputImage                                          InputImageType;
+  typedef itk::ImageToImageFilter<InputImageType, TOutputImage>    Superclass;
+  typedef itk::SmartPointer<Self>                                     Pointer;
+  typedef itk::SmartPointer<const Self>                          ConstPointer;
+
+  typedef TSlicer                                                  SlicerType;
+  typedef typename SlicerType::OutputImageType                      SliceType;
+  typedef typename SliceType::PixelType                        SlicePixelType;
+  typedef TOutputImage                                        OutputImageType;
+  typedef typename OutputImageType::PixelType                 OutputPixelType;
+  typedef typename OutputImageType::RegionType               OutputRegionType;
+
+  // Output LUT
+  typedef ColorLookupTable<SlicePixelType, OutputPixelType>   LookupTableType;
+
+  // Access to the voxels of the image
+  typedef typename InputImageType::AccessorFunctorType    AccessorFunctorType;
+  typedef typename InputImageType::InternalPixelType            ComponentType;
+
+  // This is necessary to use itkGet/SetInputMacros to avoid gcc compiling error
+  using ProcessObject = itk::ProcessObject;
+
+  itkTypeMacro(SliceIntensityMappingFilter, ImageToImageFilter)
+  itkNewMacro(Self)
+
+  /** Set the intensity remapping curve - for contrast adjustment */
+  itkSetInputMacro(LookupTable, LookupTableType)
+
+  /** Get the intensity remapping curve - for contrast adjustment */
+  itkGetInputMacro(LookupTable, LookupTableType)
+
+  /** Set the slicing pipeline that defines the slice */
+  void SetSlicer(SlicerType *slicer);
+
+  /** Get the slicing pipeline that defines the slice */
+  SlicerType *GetSlicer() const { return m_Slicer; }
+
+  /** Set the cache of display slices (optional) */
+  void SetSliceCache(DisplaySliceCache *cache);
+
+  /** Get the cache of display slices */
+  DisplaySliceCache *GetSliceCache() const { return m_SliceCache; }
+
+  /** Set the factor by which the input is shrunk from the slicer's input */
+  itkSetMacro(ShrinkFactor, unsigned int)
+
+  /** Get the factor by which the input is shrunk from the slicer's input */
+  itkGetMacro(ShrinkFactor, unsigned int)
+
+  /** Brings in changes to the slicer, which is not an input */
+  void UpdateOutputInformation() ITK_OVERRIDE;
+
+  /** Process a single pixel */
+  OutputPixelType MapPixel(const SlicePixelType &pixel);
+
+protected:
+
+  SliceIntensityMappingFilter();
+  virtual ~SliceIntensityMappingFilter() {}
+
+  virtual void VerifyInputInformation() const ITK_OVERRIDE { }
+
+  virtual void GenerateOutputInformation() ITK_OVERRIDE;
+
+  virtual void GenerateInputRequestedRegion() ITK_OVERRIDE;
+
+  virtual void BeforeThreadedGenerateData() ITK_OVERRIDE;
+
+  virtual void DynamicThreadedGenerateData(const OutputRegionType &region) ITK_OVERRIDE;
+
+  virtual void AfterThreadedGenerateData() ITK_OVERRIDE;
+
+  // Map nLines lines of nPixels voxels, starting at pSource, to the rows of out
+  static void MapLines(AccessorFunctorType accessor, const ComponentType *pSource,
+                       itk::OffsetValueType pixelStride, itk::OffsetValueType lineStride,
+                       unsigned int nPixels, unsigned int nLines,
+                       const LookupTableType *lut, OutputPixelType *out,
+                       itk::OffsetValueType outLineStride);
+
+  // Ask the cache to compute the slices ahead of the current one
+  void PrefetchSlices();
+
+  // Whether the slice is read from the input rather than the slicer's output
+  bool IsSlicedDirectly() const;
+
+  // The shrink factor along an axis of the slicer's input
+  unsigned int GetShrinkFactorForAxis(unsigned int axis) const;
+
+  // The slicing pipeline, and the pipeline time of its output when last seen
+  SmartPtr<SlicerType> m_Slicer;
+  itk::ModifiedTimeType m_SlicerPipelineMTime;
+
+  // The output of the slicer, when it is mapped instead of the image
+  const SliceType *m_SliceSource;
+
+  // Buffer offset of the first pixel of the slice, and the buffer offsets
+  // between neighboring pixels and lines
+  itk::OffsetValueType m_StartOffset, m_PixelStride, m_LineStride;
+
+  // Buffer offset between slices, the current slice and the number of slices
+  itk::OffsetValueType m_SliceStride;
+  itk::IndexValueType m_SliceIndex, m_NumberOfSlices;
+
+  // The slice cache, the key of the current slice and of the one before it,
+  // and whether the current slice was found in the cache
+  SmartPtr<DisplaySliceCache> m_SliceCache;
+  DisplaySliceCache::SliceKey m_CacheKey, m_LastCacheKey;
+  bool m_UseCache, m_CacheHit;
+
+  // Copy of the lookup table for the background thread, and the time of the
+  // lookup table it was made from
+  SmartPtr<LookupTableType> m_LUTSnapshot;
+  itk::ModifiedTimeType m_LUTTime, m_LUTSnapshotTime;
+
+  // Shrink factor of the input relative to the slicer's input
+  unsigned int m_ShrinkFactor;
+};
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "SliceIntensityMappingFilter.txx"
+#endif
+
+#endif // SLICEINTENSITYMAPPINGFILTER_H
@@ -0,0 +1,410 @@
+#ifndef SLICEINTENSITYMAPPINGFILTER_TXX
+#define SLICEINTENSITYMAPPINGFILTER_TXX
+
+#include "SliceIntensityMappingFilter.h"
+#include "ColorLookupTable.h"
+#include <itkImageRegionConstIterator.h>
+#include <itkImageRegionIterator.h>
+#include <algorithm>
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::SliceIntensityMappingFilter()
+{
+  // The image and the LUT are inputs
+  this->SetNumberOfIndexedInputs(1);
+  this->AddRequiredInputName("LookupTable");
+
+  m_SlicerPipelineMTime = 0;
+  m_SliceSource = nullptr;
+  m_StartOffset = m_PixelStride = m_LineStride = 0;
+  m_SliceStride = 0;
+  m_SliceIndex = 0;
+  m_NumberOfSlices = 1;
+  m_CacheKey = m_LastCacheKey = DisplaySliceCache::SliceKey();
+  m_UseCache = m_CacheHit = false;
+  m_LUTTime = m_LUTSnapshotTime = 0;
+  m_ShrinkFactor = 1;
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::SetSlicer(SlicerType *slicer)
+{
+  if(m_Slicer != slicer)
+    {
+    m_Slicer = slicer;
+    m_SlicerPipelineMTime = 0;
+    this->Modified();
+    }
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::SetSliceCache(DisplaySliceCache *cache)
+{
+  if(m_SliceCache != cache)
+    {
+    m_SliceCache = cache;
+    m_LastCacheKey = DisplaySliceCache::SliceKey();
+    this->Modified();
+    }
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::UpdateOutputInformation()
+{
+  // Changes to the slice index, the transforms and the inputs of the slicer
+  // all show up in the pipeline time of its output
+  if(m_Slicer)
+    {
+    m_Slicer->UpdateOutputInformation();
+    itk::ModifiedTimeType t = m_Slicer->GetOutput()->GetPipelineMTime();
+    if(t != m_SlicerPipelineMTime)
+      {
+      m_SlicerPipelineMTime = t;
+      this->Modified();
+      }
+    }
+
+  Superclass::UpdateOutputInformation();
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::GenerateOutputInformation()
+{
+  // The display slice has the geometry of the slicer's output
+  OutputImageType *output = this->GetOutput();
+  output->CopyInformation(m_Slicer->GetOutput());
+  if(m_ShrinkFactor <= 1 || !this->IsSlicedDirectly())
+    return;
+
+  // Each pixel of a reduced slice covers a bin of pixels of the full slice,
+  // and is placed at the center of its bin
+  typename SlicerType::OrthogonalSlicerType *slicer = m_Slicer->GetOrthogonalSlicer();
+  unsigned int axis[2] = { slicer->GetPixelDirectionImageAxis(),
+                           slicer->GetLineDirectionImageAxis() };
+  bool forward[2] = { slicer->GetPixelTraverseForward(),
+                      slicer->GetLineTraverseForward() };
+
+  typename SlicerType::InputImageType::SizeType szFull =
+      m_Slicer->GetInput()->GetLargestPossibleRegion().GetSize();
+  typename InputImageType::SizeType szReduced =
+      this->GetInput()->GetLargestPossibleRegion().GetSize();
+
+  OutputRegionType region = output->GetLargestPossibleRegion();
+  typename OutputImageType::SpacingType spacing = output->GetSpacing();
+  typename OutputImageType::PointType origin = output->GetOrigin();
+  for(unsigned int a = 0; a < 2; a++)
+    {
+    unsigned int f = this->GetShrinkFactorForAxis(axis[a]);
+    double n = szFull[axis[a]], m = szReduced[axis[a]];
+
+    // When an axis is traversed backwards, the slice starts with the last
+    // bin, which may be only partly filled
+    double first = forward[a] ? 0.0 : n - m * f;
+    origin[a] += spacing[a] * (first + 0.5 * (f - 1));
+    spacing[a] *= f;
+    region.SetSize(a, szReduced[axis[a]]);
+    }
+
+  output->SetLargestPossibleRegion(region);
+  output->SetSpacing(spacing);
+  output->SetOrigin(origin);
+  if(!region.IsInside(output->GetRequestedRegion()))
+    output->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::GenerateInputRequestedRegion()
+{
+  // Request the entire input image
+  InputImageType *input = const_cast<InputImageType *>(this->GetInput());
+  if(input)
+    input->SetRequestedRegionToLargestPossibleRegion();
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::BeforeThreadedGenerateData()
+{
+  const InputImageType *input = this->GetInput();
+
+  // Use the slicer for everything other than plain orthogonal slicing
+  m_SliceSource = nullptr;
+  m_UseCache = m_CacheHit = false;
+  const itk::DataObject *slicerInput = m_Slicer->GetInput();
+  if(!this->IsSlicedDirectly()
+     || (m_ShrinkFactor <= 1 && slicerInput != input))
+    {
+    m_Slicer->Update();
+    m_SliceSource = m_Slicer->GetOutput();
+    return;
+    }
+
+  // The slicing axes, set up by the slicer's UpdateOutputInformation()
+  typename SlicerType::OrthogonalSlicerType *slicer = m_Slicer->GetOrthogonalSlicer();
+  unsigned int axPixel = slicer->GetPixelDirectionImageAxis();
+  unsigned int axLine = slicer->GetLineDirectionImageAxis();
+  unsigned int axSlice = slicer->GetSliceDirectionImageAxis();
+
+  // Strides of the image axes in the buffer. As in IRISSlicer, the number of
+  // components comes from the pixel container, since the image may be an
+  // adaptor of a vector image
+  typename InputImageType::SizeType szVol = input->GetBufferedRegion().GetSize();
+  itk::OffsetValueType stride[3] = { 1, (itk::OffsetValueType) szVol[0],
+                                     (itk::OffsetValueType) (szVol[0] * szVol[1]) };
+  itk::OffsetValueType nvoxels = stride[2] * szVol[2];
+  itk::OffsetValueType ncomp = nvoxels ? input->GetPixelContainer()->Size() / nvoxels : 1;
+  for(int d = 0; d < 3; d++)
+    stride[d] *= ncomp;
+
+  m_PixelStride = (slicer->GetPixelTraverseForward() ? 1 : -1) * stride[axPixel];
+  m_LineStride = (slicer->GetLineTraverseForward() ? 1 : -1) * stride[axLine];
+
+  // The first voxel of the slice
+  itk::OffsetValueType xStart[3];
+  xStart[axPixel] = slicer->GetPixelTraverseForward() ? 0 : szVol[axPixel] - 1;
+  xStart[axLine] = slicer->GetLineTraverseForward() ? 0 : szVol[axLine] - 1;
+  xStart[axSlice] = szVol[axSlice] == 1 ? 0 : std::min(
+        (itk::OffsetValueType) (slicer->GetSliceIndex() / this->GetShrinkFactorForAxis(axSlice)),
+        (itk::OffsetValueType) szVol[axSlice] - 1);
+
+  m_StartOffset = 0;
+  for(int d = 0; d < 3; d++)
+    m_StartOffset += stride[d] * xStart[d];
+
+  // The neighboring slices, for prefetching
+  m_SliceStride = stride[axSlice];
+  m_SliceIndex = xStart[axSlice];
+  m_NumberOfSlices = szVol[axSlice];
+
+  // Look for the slice in the cache. Only whole slices are cached.
+  OutputImageType *output = this->GetOutput();
+  if(m_SliceCache && output->GetBufferedRegion() == output->GetLargestPossibleRegion())
+    {
+    const LookupTableType *lut = this->GetLookupTable();
+    m_LUTTime = std::max(lut->GetMTime(), lut->GetUpdateMTime());
+
+    m_CacheKey.start = m_StartOffset;
+    m_CacheKey.pixel_stride = m_PixelStride;
+    m_CacheKey.line_stride = m_LineStride;
+    m_CacheKey.width = output->GetBufferedRegion().GetSize(0);
+    m_CacheKey.height = output->GetBufferedRegion().GetSize(1);
+
+    DisplaySliceCache::SourceState state;
+    state.buffer = input->GetBufferPointer();
+    state.image_time = std::max(input->GetMTime(), input->GetUpdateMTime());
+    state.lut_time = m_LUTTime;
+
+    m_UseCache = true;
+    m_CacheHit = m_SliceCache->Lookup(state, m_CacheKey, output->GetBufferPointer());
+    }
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::DynamicThreadedGenerateData(const OutputRegionType &region)
+{
+  OutputImageType *output = this->GetOutput();
+  const LookupTableType *lut = this->GetLookupTable();
+
+  // Zero is mapped to transparent black when it is outside of the LUT's
+  // range, as in LookupTableIntensityMappingFilter
+  bool zero_out_of_range = !lut->CheckRange(0);
+
+  // Map the slicer's output
+  if(m_SliceSource)
+    {
+    itk::ImageRegionConstIterator<SliceType> inputIt(m_SliceSource, region);
+    itk::ImageRegionIterator<OutputImageType> outputIt(output, region);
+    for(; !inputIt.IsAtEnd(); ++inputIt, ++outputIt)
+      {
+      SlicePixelType xin = inputIt.Get();
+      OutputPixelType xout;
+      if(zero_out_of_range && xin == 0)
+        xout.Fill(0);
+      else
+        xout = lut->MapIntensityToDisplay(xin);
+      outputIt.Set(xout);
+      }
+    return;
+    }
+
+  // The slice was copied from the cache
+  if(m_CacheHit)
+    return;
+
+  // Read the slice from the image, using the pixel accessor as IRISSlicer does
+  const InputImageType *input = this->GetInput();
+  AccessorFunctorType accessor_functor;
+  accessor_functor.SetPixelAccessor(input->GetPixelAccessor());
+  accessor_functor.SetBegin(input->GetBufferPointer());
+
+  typename OutputImageType::IndexType idxOrigin = output->GetLargestPossibleRegion().GetIndex();
+  typename OutputImageType::IndexType idx = region.GetIndex();
+  const ComponentType *pSource = input->GetBufferPointer() + m_StartOffset
+      + (idx[0] - idxOrigin[0]) * m_PixelStride
+      + (idx[1] - idxOrigin[1]) * m_LineStride;
+
+  MapLines(accessor_functor, pSource, m_PixelStride, m_LineStride,
+           region.GetSize(0), region.GetSize(1), lut,
+           output->GetBufferPointer() + output->ComputeOffset(idx),
+           output->GetBufferedRegion().GetSize(0));
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::AfterThreadedGenerateData()
+{
+  if(!m_UseCache)
+    return;
+
+  // Keep the slice for when it is shown again
+  if(!m_CacheHit)
+    m_SliceCache->Store(m_CacheKey, this->GetOutput()->GetBufferPointer());
+
+  this->PrefetchSlices();
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::MapLines(AccessorFunctorType accessor, const ComponentType *pSource,
+           itk::OffsetValueType pixelStride, itk::OffsetValueType lineStride,
+           unsigned int nPixels, unsigned int nLines,
+           const LookupTableType *lut, OutputPixelType *out,
+           itk::OffsetValueType outLineStride)
+{
+  // Zero is mapped to transparent black when it is outside of the LUT's
+  // range, as in LookupTableIntensityMappingFilter
+  bool zero_out_of_range = !lut->CheckRange(0);
+
+  for(unsigned int j = 0; j < nLines; j++, pSource += lineStride, out += outLineStride)
+    {
+    const ComponentType *p = pSource;
+    for(unsigned int i = 0; i < nPixels; i++, p += pixelStride)
+      {
+      accessor.SetBegin(p);
+      SlicePixelType xin = accessor.Get(*p);
+      if(zero_out_of_range && xin == 0)
+        out[i].Fill(0);
+      else
+        out[i] = lut->MapIntensityToDisplay(xin);
+      }
+    }
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+void
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::PrefetchSlices()
+{
+  // The direction of travel, from the last slice with the same layout
+  const DisplaySliceCache::SliceKey &last = m_LastCacheKey;
+  int direction = 0;
+  if(last.pixel_stride == m_CacheKey.pixel_stride && last.line_stride == m_CacheKey.line_stride
+     && last.width == m_CacheKey.width && last.height == m_CacheKey.height)
+    {
+    if(m_CacheKey.start > last.start)
+      direction = 1;
+    else if(m_CacheKey.start < last.start)
+      direction = -1;
+    }
+  m_LastCacheKey = m_CacheKey;
+
+  // Leave the queue alone unless the slice has changed
+  if(direction == 0 || m_SliceCache->GetPrefetchDepth() == 0)
+    return;
+
+  // The background thread reads a copy of the lookup table, which may be
+  // recomputed while it is working
+  const LookupTableType *lut = this->GetLookupTable();
+  if(!m_LUTSnapshot || m_LUTSnapshotTime != m_LUTTime)
+    {
+    m_LUTSnapshot = LookupTableType::New();
+    m_LUTSnapshot->Graft(lut);
+    m_LUTSnapshotTime = m_LUTTime;
+    }
+
+  // The image is held by the requests until they are done
+  typename InputImageType::ConstPointer input = this->GetInput();
+  AccessorFunctorType accessor_functor;
+  accessor_functor.SetPixelAccessor(input->GetPixelAccessor());
+  accessor_functor.SetBegin(input->GetBufferPointer());
+
+  // The nearest slices first
+  std::vector<DisplaySliceCache::PrefetchRequest> requests;
+  for(unsigned int i = 1; i <= m_SliceCache->GetPrefetchDepth(); i++)
+    {
+    itk::IndexValueType k = m_SliceIndex + direction * (itk::IndexValueType) i;
+    if(k < 0 || k >= m_NumberOfSlices)
+      break;
+
+    DisplaySliceCache::PrefetchRequest r;
+    r.key = m_CacheKey;
+    r.key.start = m_StartOffset + (k - m_SliceIndex) * m_SliceStride;
+
+    SmartPtr<LookupTableType> lut_copy = m_LUTSnapshot;
+    DisplaySliceCache::SliceKey key = r.key;
+    r.function = [input, lut_copy, accessor_functor, key](OutputPixelType *out)
+      {
+      MapLines(accessor_functor, input->GetBufferPointer() + key.start,
+               key.pixel_stride, key.line_stride, key.width, key.height,
+               lut_copy, out, key.width);
+      };
+    requests.push_back(r);
+    }
+
+  m_SliceCache->Prefetch(requests);
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+bool
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::IsSlicedDirectly() const
+{
+  return m_Slicer->GetUseOrthogonalSlicing() && !m_Slicer->GetPreviewImage();
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+unsigned int
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::GetShrinkFactorForAxis(unsigned int axis) const
+{
+  // Axes of size one are not shrunk, as in BinAverageImageFilter
+  if(m_ShrinkFactor <= 1 || m_Slicer->GetInput()->GetLargestPossibleRegion().GetSize(axis) <= 1)
+    return 1;
+  return m_ShrinkFactor;
+}
+
+template <class TSlicer, class TOutputImage, class TInputImage>
+typename SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>::OutputPixelType
+SliceIntensityMappingFilter<TSlicer, TOutputImage, TInputImage>
+::MapPixel(const SlicePixelType &xin)
+{
+  // Make sure all the inputs are up to date
+  LookupTableType *lut = const_cast<LookupTableType *>(this->GetLookupTable());
+  lut->Update();
+
+  OutputPixelType xout;
+  if(xin == 0 && !lut->CheckRange(0))
+    xout.Fill(0);
+  else
+    xout = lut->MapIntensityToDisplay(xin);
+
+  return xout;
+}
+
+#endif // SLICEINTENSITYMAPPINGFILTER_TXX
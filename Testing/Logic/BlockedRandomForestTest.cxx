@@ -0,0 +1,195 @@
+// Checks that BlockedRandomForestClassifyImageFilter, which classifies the
+// voxels a tile at a time, computes the same speed image as
+// RandomForestClassifyImageFilter, which classifies them one at a time, up
+// to one unit of the output type from the rounding of the summed class
+// probabilities.
+//
+// A forest is trained on a scalar and a two-component image with patch and
+// coordinate features, and both filters are run with several biases. The
+// tile size is chosen so that the tiles do not line up with the rows.
+//
+// Usage: BlockedRandomForestTest [size [tileSize]]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkVectorImage.h>
+#include <itkImageRegionIterator.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include "SNAPCommon.h"
+#include "RandomForestClassifier.h"
+#include "RandomForestClassifyImageFilter.h"
+#include "BlockedRandomForestClassifyImageFilter.h"
+#include "ImageCollectionConstIteratorWithIndex.h"
+#include "Library/classification.h"
+#include "Library/data.h"
+
+typedef itk::Image<float, 3> ImageType;
+typedef itk::VectorImage<float, 3> VectorImageType;
+typedef itk::Image<short, 3> SpeedImageType;
+typedef RandomForestClassifier<float, LabelType, 3> ClassifierType;
+typedef RandomForestClassifyImageFilter<ImageType, VectorImageType, SpeedImageType, LabelType> ReferenceFilterType;
+typedef BlockedRandomForestClassifyImageFilter<ImageType, VectorImageType, SpeedImageType, LabelType> BlockedFilterType;
+
+// Two tissues with different intensities and textures, and a bright blob
+// that is only distinguished by its position
+void makeImages(int n, ImageType::Pointer &scalar, VectorImageType::Pointer &vector,
+                std::vector<LabelType> &truth)
+{
+  ImageType::SizeType size = {{ (itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n / 2 }};
+  scalar = ImageType::New();
+  scalar->SetRegions(ImageType::RegionType(size));
+  scalar->Allocate();
+  vector = VectorImageType::New();
+  vector->SetRegions(ImageType::RegionType(size));
+  vector->SetNumberOfComponentsPerPixel(2);
+  vector->Allocate();
+
+  std::mt19937 rng(11);
+  std::normal_distribution<float> noise(0.0f, 0.3f);
+  itk::VariableLengthVector<float> v(2);
+  truth.clear();
+
+  itk::ImageRegionIterator<VectorImageType> vit(vector, vector->GetBufferedRegion());
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(scalar, scalar->GetBufferedRegion());
+      !it.IsAtEnd(); ++it, ++vit)
+    {
+    ImageType::IndexType idx = it.GetIndex();
+    double dx = idx[0] - n / 2.0, dy = idx[1] - n / 2.0, dz = 2.0 * idx[2] - n / 2.0;
+    bool inside = dx * dx + dy * dy + dz * dz < n * n / 9.0;
+    bool blob = idx[0] < n / 4 && idx[1] < n / 4;
+    LabelType label = inside ? 1 : (blob ? 3 : 2);
+
+    it.Set((inside ? 2.0f : 1.0f) + noise(rng));
+    v[0] = (inside ? 0.5f : 1.0f) + noise(rng);
+    v[1] = (blob ? 0.5f : 0.0f) + ((idx[0] + idx[1]) % 2) * (inside ? 0.3f : 0.0f) + noise(rng);
+    vit.Set(v);
+    truth.push_back(label);
+    }
+}
+
+SmartPtr<ClassifierType> trainClassifier(ImageType *scalar, VectorImageType *vector,
+                                         const std::vector<LabelType> &truth,
+                                         const itk::Size<3> &radius)
+{
+  typedef ImageCollectionConstIteratorWithIndex<ImageType, VectorImageType> CollectionIter;
+  ImageType::RegionType region = scalar->GetBufferedRegion();
+  region.ShrinkByRadius(radius);
+
+  // Train on every fifth voxel in the region
+  CollectionIter cit(radius, region);
+  cit.AddImage(scalar);
+  cit.AddImage(vector);
+  int nPatch = cit.GetTotalComponents() * cit.GetNeighborhoodSize();
+  int nColumns = nPatch + 3;
+  unsigned long nSamples = (region.GetNumberOfPixels() + 4) / 5;
+
+  MLData<float, LabelType> sample(nSamples, nColumns);
+  vnl_vector<double> x(nPatch);
+  itk::ImageRegionConstIteratorWithIndex<ImageType> it(scalar, region);
+  unsigned long iVoxel = 0, iSample = 0;
+  for(; !it.IsAtEnd(); ++it, ++cit, ++iVoxel)
+    {
+    if(iVoxel % 5)
+      continue;
+
+    cit.GetNeighborhoodValues(x);
+    auto &column = sample.data[iSample];
+    for(int k = 0; k < nPatch; k++)
+      column[k] = x[k];
+    for(int d = 0; d < 3; d++)
+      column[nPatch + d] = it.GetIndex()[d];
+    sample.label[iSample++] = truth[scalar->ComputeOffset(it.GetIndex())];
+    }
+
+  TrainingParameters params;
+  params.treeDepth = 12;
+  params.treeNum = 20;
+  params.candidateNodeClassifierNum = 10;
+  params.candidateClassifierThresholdNum = 10;
+  params.subSamplePercent = 0;
+  params.splitIG = 0.1;
+  params.leafEntropy = 0.05;
+  params.verbose = false;
+
+  typedef Classification<float, LabelType, ClassifierType::RFAxisClassifierType> ClassificationType;
+  ClassificationType classification;
+  SmartPtr<ClassifierType> classifier = ClassifierType::New();
+  classification.Learning(params, sample, *classifier->GetForest(),
+                          classifier->GetValidLabel(), classifier->GetClassToLabelMapping());
+
+  // Label 1 is the foreground
+  int nClasses = classifier->GetClassToLabelMapping().size();
+  classifier->GetClassWeights().resize(nClasses, -1.0);
+  for(auto it : classifier->GetClassToLabelMapping())
+    classifier->GetClassWeights()[it.first] = it.second == 1 ? 1.0 : -1.0;
+
+  classifier->SetPatchRadius(radius);
+  classifier->SetUseCoordinateFeatures(true);
+  return classifier;
+}
+
+template <class TFilter>
+SpeedImageType::Pointer classify(TFilter *filter, ImageType *scalar, VectorImageType *vector,
+                                 ClassifierType *classifier)
+{
+  filter->AddScalarImage(scalar);
+  filter->AddVectorImage(vector);
+  filter->SetClassifier(classifier);
+  filter->Update();
+  return filter->GetOutput();
+}
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 32;
+  unsigned int tileSize = argc > 2 ? atoi(argv[2]) : 37;
+
+  ImageType::Pointer scalar;
+  VectorImageType::Pointer vector;
+  std::vector<LabelType> truth;
+  makeImages(n, scalar, vector, truth);
+
+  itk::Size<3> radius;
+  radius.Fill(1);
+  SmartPtr<ClassifierType> classifier = trainClassifier(scalar, vector, truth, radius);
+  if(!classifier->IsValidClassifier())
+    {
+    printf("The classifier could not be trained\n");
+    return EXIT_FAILURE;
+    }
+
+  int failures = 0;
+  const double biases[] = { 0.5, 0.3, 0.8 };
+  for(double bias : biases)
+    {
+    classifier->SetBiasParameter(bias);
+
+    ReferenceFilterType::Pointer reference = ReferenceFilterType::New();
+    SpeedImageType::Pointer expected = classify(reference.GetPointer(), scalar, vector, classifier);
+
+    BlockedFilterType::Pointer blocked = BlockedFilterType::New();
+    blocked->SetTileSize(tileSize);
+    SpeedImageType::Pointer result = classify(blocked.GetPointer(), scalar, vector, classifier);
+
+    // Only the rounding of the output values may differ, by at most one
+    unsigned long nDiffer = 0;
+    itk::ImageRegionConstIterator<SpeedImageType> eit(expected, expected->GetBufferedRegion());
+    for(itk::ImageRegionConstIterator<SpeedImageType> rit(result, result->GetBufferedRegion());
+        !rit.IsAtEnd(); ++rit, ++eit)
+      {
+      if(std::abs(rit.Get() - eit.Get()) > 1)
+        nDiffer++;
+      }
+
+    printf("Bias %4.2f: %lu of %lu voxels differ\n", bias, nDiffer,
+           (unsigned long) expected->GetBufferedRegion().GetNumberOfPixels());
+    if(nDiffer)
+      failures++;
+    }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+// Checks that the discrete meshes that MultiLabelMeshPipeline updates after
+// an edit are the same as those of a pipeline that meshes the edited image
+// from scratch.
+//
+// The image is a grid of small boxes of different labels, so each label has
+// neighbors across faces, edges and corners, and neighbors of neighbors
+// within the reach of the relaxation. A block of voxels is painted with one
+// label, another block with a new label, and one label is erased, and after
+// each edit the meshes of every label are compared point by point.
+//
+// Usage: DiscreteMeshUpdateTest [iterations]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include <itkCommand.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include "SNAPCommon.h"
+#include "MeshOptions.h"
+#include "MultiLabelMeshPipeline.h"
+#include "RLEImageRegionIterator.h"
+
+typedef MultiLabelMeshPipeline::InputImageType ImageType;
+typedef std::map<LabelType, vtkSmartPointer<vtkPolyData> > MeshMap;
+
+// A 4x4x4 grid of 6-voxel boxes with labels 1 to 8, checkered so that
+// boxes that only meet at an edge or a corner may share a label
+ImageType::Pointer makeImage()
+{
+  ImageType::Pointer img = ImageType::New();
+  ImageType::SizeType size = {{ 28, 28, 28 }};
+  img->SetRegions(ImageType::RegionType(size));
+  img->Allocate();
+  img->FillBuffer(0);
+
+  for(int z = 2; z < 26; z++)
+    for(int y = 2; y < 26; y++)
+      for(int x = 2; x < 26; x++)
+        {
+        int i = (x - 2) / 6, j = (y - 2) / 6, k = (z - 2) / 6;
+        itk::Index<3> idx = {{ x, y, z }};
+        img->SetPixel(idx, (LabelType) (1 + (i + 2 * j + 3 * k) % 8));
+        }
+  return img;
+}
+
+void paint(ImageType *img, LabelType label, int x0, int x1, int y0, int y1, int z0, int z1)
+{
+  for(int z = z0; z < z1; z++)
+    for(int y = y0; y < y1; y++)
+      for(int x = x0; x < x1; x++)
+        {
+        itk::Index<3> idx = {{ x, y, z }};
+        img->SetPixel(idx, label);
+        }
+  img->Modified();
+}
+
+void erase(ImageType *img, LabelType label)
+{
+  itk::ImageRegionIterator<ImageType> it(img, img->GetBufferedRegion());
+  for(; !it.IsAtEnd(); ++it)
+    if(it.Get() == label)
+      it.Set(0);
+  img->Modified();
+}
+
+MeshMap update(MultiLabelMeshPipeline *pipeline, ImageType *img)
+{
+  itk::CStyleCommand::Pointer progress = itk::CStyleCommand::New();
+  pipeline->SetImage(img);
+  pipeline->UpdateMeshes(progress);
+  return pipeline->GetMeshCollection();
+}
+
+// The points of a mesh, sorted, since the order of the vertices depends on
+// the region that was swept
+std::vector<std::vector<double> > sortedPoints(vtkPolyData *mesh)
+{
+  std::vector<std::vector<double> > points(mesh->GetNumberOfPoints(), std::vector<double>(3));
+  for(vtkIdType i = 0; i < mesh->GetNumberOfPoints(); i++)
+    mesh->GetPoint(i, points[i].data());
+  std::sort(points.begin(), points.end());
+  return points;
+}
+
+int compare(const char *step, const MeshMap &updated, const MeshMap &full)
+{
+  int failures = 0;
+  if(updated.size() != full.size())
+    {
+    printf("%s: %zu meshes, expected %zu\n", step, updated.size(), full.size());
+    return 1;
+    }
+
+  for(MeshMap::const_iterator it = full.begin(); it != full.end(); ++it)
+    {
+    MeshMap::const_iterator uit = updated.find(it->first);
+    if(uit == updated.end())
+      {
+      printf("%s: label %d has no mesh\n", step, (int) it->first);
+      failures++;
+      continue;
+      }
+
+    vtkPolyData *a = uit->second, *b = it->second;
+    bool same = a->GetNumberOfPolys() == b->GetNumberOfPolys() &&
+                a->GetNumberOfPoints() == b->GetNumberOfPoints();
+    if(same)
+      {
+      std::vector<std::vector<double> > pa = sortedPoints(a), pb = sortedPoints(b);
+      for(size_t i = 0; same && i < pa.size(); i++)
+        for(int d = 0; d < 3; d++)
+          if(std::fabs(pa[i][d] - pb[i][d]) > 1e-6)
+            same = false;
+      }
+
+    if(!same)
+      {
+      printf("%s: mesh of label %d differs from that of a full sweep\n", step, (int) it->first);
+      failures++;
+      }
+    }
+  return failures;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int iterations = argc > 1 ? atoi(argv[1]) : 10;
+
+  SmartPtr<MeshOptions> options = MeshOptions::New();
+  options->SetUseDiscreteMeshing(true);
+  options->SetDiscreteRelaxationIterations(iterations);
+
+  ImageType::Pointer img = makeImage();
+  SmartPtr<MultiLabelMeshPipeline> pipeline = MultiLabelMeshPipeline::New();
+  pipeline->SetMeshOptions(options);
+  update(pipeline, img);
+
+  int failures = 0;
+
+  // Grow one box into its face neighbor, an edit whose effect reaches
+  // labels that only meet the changed voxels at an edge or a corner
+  paint(img, 3, 12, 16, 8, 14, 8, 14);
+  MeshMap updated = update(pipeline, img);
+  SmartPtr<MultiLabelMeshPipeline> fresh = MultiLabelMeshPipeline::New();
+  fresh->SetMeshOptions(options);
+  failures += compare("Growing a label", updated, update(fresh, img));
+
+  // Paint a new label across a corner of the grid
+  paint(img, 9, 6, 10, 6, 10, 6, 10);
+  updated = update(pipeline, img);
+  fresh = MultiLabelMeshPipeline::New();
+  fresh->SetMeshOptions(options);
+  failures += compare("Adding a label", updated, update(fresh, img));
+
+  // Remove a label altogether
+  erase(img, 5);
+  updated = update(pipeline, img);
+  fresh = MultiLabelMeshPipeline::New();
+  fresh->SetMeshOptions(options);
+  failures += compare("Removing a label", updated, update(fresh, img));
+
+  printf("%d failures\n", failures);
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+// Checks that EMGaussianMixtures recovers a known mixture of three
+// two-dimensional Gaussians, with all samples at once and with mini-batches,
+// and that the fitted model is the same for any number of threads.
+//
+// Usage: EMGaussianMixturesTest [nSamples [nThreads]]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <itkMultiThreaderBase.h>
+#include "EMGaussianMixtures.h"
+#include "GaussianMixtureModel.h"
+
+typedef EMGaussianMixtures::VectorType VectorType;
+typedef EMGaussianMixtures::MatrixType MatrixType;
+
+const int K = 3, D = 2;
+const double TrueWeight[K] = { 0.5, 0.3, 0.2 };
+const double TrueMean[K][D] = { { 0.0, 0.0 }, { 5.0, 1.0 }, { 1.0, 6.0 } };
+const double TrueSigma[K][D] = { { 1.0, 0.5 }, { 0.7, 1.2 }, { 1.5, 0.8 } };
+
+// Samples of the mixture, one per row
+std::vector<double> makeSamples(int n)
+{
+  std::mt19937 rng(5);
+  std::discrete_distribution<int> component(TrueWeight, TrueWeight + K);
+  std::normal_distribution<double> normal(0.0, 1.0);
+
+  std::vector<double> x(n * D);
+  for(int i = 0; i < n; i++)
+    {
+    int j = component(rng);
+    for(int a = 0; a < D; a++)
+      x[i * D + a] = TrueMean[j][a] + TrueSigma[j][a] * normal(rng);
+    }
+  return x;
+}
+
+// Fit the mixture from a model that is off by about a standard deviation,
+// and return its weights, means and covariances
+std::vector<double> fit(const std::vector<double> &x, int nThreads, int batchSize)
+{
+  itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(nThreads);
+
+  int n = x.size() / D;
+  EMGaussianMixtures em(x.data(), n, D, K);
+  for(int j = 0; j < K; j++)
+    {
+    VectorType mean(D);
+    MatrixType cov(D, D, 0.0);
+    mean[0] = TrueMean[j][0] + 0.8;
+    mean[1] = TrueMean[j][1] - 0.6;
+    cov(0, 0) = cov(1, 1) = 4.0;
+    em.SetParameters(j, mean, cov, 1.0 / K);
+    }
+
+  em.SetBatchSize(batchSize);
+  em.SetMaxIteration(batchSize ? 50 : 200);
+  em.Update();
+
+  std::vector<double> params;
+  GaussianMixtureModel *gmm = em.GetGaussianMixtureModel();
+  for(int j = 0; j < K; j++)
+    {
+    params.push_back(gmm->GetWeight(j));
+    for(int a = 0; a < D; a++)
+      params.push_back(gmm->GetMean(j)[a]);
+    for(int a = 0; a < D; a++)
+      for(int b = 0; b < D; b++)
+        params.push_back(gmm->GetCovariance(j)(a, b));
+    }
+  return params;
+}
+
+int check(const char *mode, const std::vector<double> &params, double tol)
+{
+  int failures = 0;
+  const int stride = 1 + D + D * D;
+  for(int j = 0; j < K; j++)
+    {
+    const double *p = &params[j * stride];
+    printf("%s: Gaussian %d weight %6.4f mean (%7.4f, %7.4f) sd (%6.4f, %6.4f)\n",
+           mode, j, p[0], p[1], p[2], sqrt(p[3]), sqrt(p[6]));
+
+    bool ok = fabs(p[0] - TrueWeight[j]) < tol;
+    for(int a = 0; a < D; a++)
+      {
+      ok = ok && fabs(p[1 + a] - TrueMean[j][a]) < 5 * tol;
+      ok = ok && fabs(sqrt(p[1 + D + a * (D + 1)]) - TrueSigma[j][a]) < 5 * tol;
+      }
+    if(!ok)
+      {
+      printf("%s: Gaussian %d does not match the mixture\n", mode, j);
+      failures++;
+      }
+    }
+  return failures;
+}
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 200000;
+  int nThreads = argc > 2 ? atoi(argv[2]) : 4;
+  std::vector<double> x = makeSamples(n);
+
+  int failures = 0;
+  const char *modes[] = { "Batch EM", "Stepwise EM" };
+  const int batchSizes[] = { 0, 10000 };
+  for(int m = 0; m < 2; m++)
+    {
+    std::vector<double> serial = fit(x, 1, batchSizes[m]);
+    std::vector<double> threaded = fit(x, nThreads, batchSizes[m]);
+    failures += check(modes[m], serial, batchSizes[m] ? 0.02 : 0.01);
+
+    // The chunks and the order of their sums do not depend on the threads
+    if(serial != threaded)
+      {
+      printf("%s: the fit with %d threads differs from the fit with one\n", modes[m], nThreads);
+      failures++;
+      }
+    }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
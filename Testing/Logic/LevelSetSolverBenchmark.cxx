@@ -0,0 +1,205 @@
+// Compares the level set solvers of SNAPLevelSetDriver on a fixed set of
+// small bubbles growing in a test volume, the way a snake starts out. For
+// each solver and number of threads, reports the iterations per second and
+// the speedup over one thread. Checks that the sparse field solver gives the
+// same level set for any number of threads, and that the two solvers give
+// nearly the same segmentation.
+//
+// Usage: LevelSetSolverBenchmark [n [nIterations [maxThreads]]]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "itkImage.h"
+#include "itkMultiThreaderBase.h"
+#include "SNAPLevelSetDriver.h"
+
+using namespace std;
+
+typedef SNAPLevelSetDriver3d DriverType;
+typedef DriverType::FloatImageType FloatImageType;
+typedef DriverType::ShortImageType ShortImageType;
+
+// Bubbles of radius 3, placed in a few slices of the volume so that a
+// partition of the image into slabs leaves most slabs empty
+vector<itk::Point<double, 3> > makeBubbles(int n)
+{
+  vector<itk::Point<double, 3> > bubbles;
+  double c[][3] = {{ 0.3, 0.3, 0.50 }, { 0.7, 0.3, 0.52 },
+                   { 0.3, 0.7, 0.48 }, { 0.7, 0.7, 0.50 }};
+  for(auto &b : c)
+    {
+    itk::Point<double, 3> p;
+    for(int d = 0; d < 3; d++)
+      p[d] = b[d] * n;
+    bubbles.push_back(p);
+    }
+  return bubbles;
+}
+
+// Region competition speed, positive inside a large blob and negative
+// outside, so that the bubbles grow and merge
+ShortImageType::Pointer makeSpeed(int n)
+{
+  ShortImageType::Pointer image = ShortImageType::New();
+  ShortImageType::SizeType size = {{ (itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n }};
+  image->SetRegions(ShortImageType::RegionType(size));
+  image->Allocate();
+
+  short *p = image->GetBufferPointer();
+  for(int z = 0; z < n; z++)
+    for(int y = 0; y < n; y++)
+      for(int x = 0; x < n; x++)
+        {
+        double dx = x - 0.5 * n, dy = y - 0.5 * n, dz = z - 0.5 * n;
+        double r = sqrt(dx * dx + dy * dy + 2.0 * dz * dz) / (0.4 * n);
+        double wobble = 0.1 * sin(0.3 * x) * cos(0.2 * y);
+        *p++ = (short) (0x7fff * max(-1.0, min(1.0, 2.0 * (1.0 - r) + wobble)));
+        }
+  return image;
+}
+
+// Signed distance to the bubbles, negative inside
+FloatImageType::Pointer makeLevelSet(int n)
+{
+  FloatImageType::Pointer image = FloatImageType::New();
+  FloatImageType::SizeType size = {{ (itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n }};
+  image->SetRegions(FloatImageType::RegionType(size));
+  image->Allocate();
+
+  vector<itk::Point<double, 3> > bubbles = makeBubbles(n);
+  float *p = image->GetBufferPointer();
+  for(int z = 0; z < n; z++)
+    for(int y = 0; y < n; y++)
+      for(int x = 0; x < n; x++)
+        {
+        double dmin = n;
+        for(auto &b : bubbles)
+          {
+          double dx = x - b[0], dy = y - b[1], dz = z - b[2];
+          dmin = min(dmin, sqrt(dx * dx + dy * dy + dz * dz));
+          }
+        *p++ = (float) max(-4.0, min(4.0, dmin - 3.0));
+        }
+  return image;
+}
+
+// Evolve for nIterations, ten at a time as when playing the snake, and
+// return the iterations per second
+double timeSolver(SnakeParameters::SolverType solver, unsigned int nThreads,
+                  ShortImageType *speed, FloatImageType *phi, int nIterations,
+                  vector<float> &result)
+{
+  itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(nThreads);
+
+  SnakeParameters param = SnakeParameters::GetDefaultInOutParameters();
+  param.SetSolver(solver);
+  DriverType driver(phi, speed, param);
+
+  auto t0 = chrono::steady_clock::now();
+  for(int i = 0; i < nIterations; i += 10)
+    driver.Run(min(10, nIterations - i));
+  auto t1 = chrono::steady_clock::now();
+
+  FloatImageType *out = driver.GetOutput();
+  result.assign(out->GetBufferPointer(),
+                out->GetBufferPointer() + out->GetPixelContainer()->Size());
+  return nIterations / chrono::duration<double>(t1 - t0).count();
+}
+
+// Dice overlap of the insides of two level sets
+double dice(const vector<float> &a, const vector<float> &b)
+{
+  size_t na = 0, nb = 0, nab = 0;
+  for(size_t i = 0; i < a.size(); i++)
+    {
+    na += a[i] < 0;
+    nb += b[i] < 0;
+    nab += a[i] < 0 && b[i] < 0;
+    }
+  return na + nb ? 2.0 * nab / (na + nb) : 1.0;
+}
+
+// Voxels with a different sign, and the largest difference in the band
+void compare(const vector<float> &a, const vector<float> &b, size_t &nSign, double &maxDiff)
+{
+  nSign = 0; maxDiff = 0.0;
+  for(size_t i = 0; i < a.size(); i++)
+    {
+    if((a[i] < 0) != (b[i] < 0))
+      nSign++;
+    if(fabs(a[i]) < 3 || fabs(b[i]) < 3)
+      maxDiff = max(maxDiff, (double) fabs(a[i] - b[i]));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  int n = 192, nIterations = 200;
+  unsigned int maxThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  if(argc > 1) n = atoi(argv[1]);
+  if(argc > 2) nIterations = atoi(argv[2]);
+  if(argc > 3) maxThreads = atoi(argv[3]);
+
+  cout << "Volume " << n << "^3, " << nIterations << " iterations, 4 bubbles" << endl;
+
+  ShortImageType::Pointer speed = makeSpeed(n);
+  FloatImageType::Pointer phi = makeLevelSet(n);
+
+  struct { SnakeParameters::SolverType solver; const char *name; } solvers[] = {
+    { SnakeParameters::PARALLEL_SPARSE_FIELD_SOLVER, "parallel sparse field" },
+    { SnakeParameters::SPARSE_FIELD_SOLVER, "sparse field" }
+  };
+
+  // Powers of two up to the maximum number of threads, and the maximum
+  vector<unsigned int> threads;
+  for(unsigned int t = 1; t < maxThreads; t *= 2)
+    threads.push_back(t);
+  threads.push_back(maxThreads);
+
+  bool ok = true;
+  vector<float> solverResult[2];
+  for(int k = 0; k < 2; k++)
+    {
+    auto &s = solvers[k];
+    vector<float> ref, result;
+    double base = 0.0;
+    for(unsigned int t : threads)
+      {
+      double ips = timeSolver(s.solver, t, speed, phi, nIterations, t == 1 ? ref : result);
+      if(t == 1)
+        base = ips;
+
+      cout << setw(22) << s.name << setw(4) << t << " threads"
+           << fixed << setprecision(1)
+           << "  " << setw(8) << ips << " it/s"
+           << "  speedup " << setprecision(2) << setw(5) << ips / base;
+
+      if(t > 1)
+        {
+        size_t nSign; double maxDiff;
+        compare(ref, result, nSign, maxDiff);
+        cout << "  vs 1 thread: sign changes " << nSign << ", max diff " << maxDiff;
+
+        // Only the sparse field solver is expected to be deterministic
+        if(s.solver == SnakeParameters::SPARSE_FIELD_SOLVER)
+          ok = ok && nSign == 0 && maxDiff == 0.0;
+        }
+      cout << endl;
+      }
+
+    solverResult[k] = threads.size() > 1 ? result : ref;
+    }
+
+  // The solvers update the front in a different order, so they are only
+  // expected to agree closely, not exactly
+  double overlap = dice(solverResult[0], solverResult[1]);
+  cout << "Dice overlap of the two solvers: " << setprecision(4) << overlap << endl;
+  ok = ok && overlap > 0.99;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,162 @@
+// Loads uncompressed NIfTI and MetaImage files through GuidedNativeImageIO
+// twice, once with their voxel data mapped into memory and once read into
+// a buffer, and checks that both give the same image. Also checks that
+// data is not mapped when it would be cast, and that a file that is too
+// short for the requested range is never mapped.
+//
+// Usage: MappedImageIOTest [tempdir]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include "itksys/SystemTools.hxx"
+#include "SNAPCommon.h"
+#include "GuidedNativeImageIO.h"
+#include "MemoryMappedFile.h"
+#include "Registry.h"
+
+template <class TPixel>
+typename itk::Image<TPixel, 3>::Pointer makeImage(int nx, int ny, int nz)
+{
+  typedef itk::Image<TPixel, 3> ImageType;
+  typename ImageType::Pointer img = ImageType::New();
+  typename ImageType::SizeType size = {{ (itk::SizeValueType) nx, (itk::SizeValueType) ny, (itk::SizeValueType) nz }};
+  img->SetRegions(typename ImageType::RegionType(size));
+  img->Allocate();
+
+  double spacing[3] = { 0.8, 0.9, 1.2 }, origin[3] = { -10.0, 4.5, 30.25 };
+  img->SetSpacing(spacing);
+  img->SetOrigin(origin);
+
+  for(itk::ImageRegionIteratorWithIndex<ImageType> it(img, img->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    typename ImageType::IndexType idx = it.GetIndex();
+    it.Set((TPixel) ((idx[0] * 7 + idx[1] * 13 + idx[2] * 29) % 1000 - 200));
+    }
+  return img;
+}
+
+template <class TPixel>
+bool loadAndCompare(const std::string &fn, itk::IOComponentEnum type)
+{
+  typedef itk::VectorImage<TPixel, 4> NativeImageType;
+
+  SmartPtr<GuidedNativeImageIO> io_mapped = GuidedNativeImageIO::New();
+  std::set<itk::IOComponentEnum> types;
+  types.insert(type);
+  io_mapped->SetMappableComponentTypes(types);
+  Registry reg_mapped;
+  io_mapped->ReadNativeImage(fn.c_str(), reg_mapped);
+
+  SmartPtr<GuidedNativeImageIO> io_read = GuidedNativeImageIO::New();
+  Registry reg_read;
+  io_read->ReadNativeImage(fn.c_str(), reg_read);
+
+  NativeImageType *mapped = dynamic_cast<NativeImageType *>(io_mapped->GetNativeImage());
+  NativeImageType *read = dynamic_cast<NativeImageType *>(io_read->GetNativeImage());
+  if(!mapped || !read)
+    {
+    std::cerr << fn << ": unexpected native type" << std::endl;
+    return false;
+    }
+
+  bool ok = true;
+  if(!MemoryMappedFile::IsMapped(mapped->GetBufferPointer()))
+    {
+    std::cerr << fn << ": data was not mapped" << std::endl;
+    ok = false;
+    }
+  if(MemoryMappedFile::IsMapped(read->GetBufferPointer()))
+    {
+    std::cerr << fn << ": data was mapped without a mappable type" << std::endl;
+    ok = false;
+    }
+
+  size_t n = read->GetPixelContainer()->Size();
+  if(mapped->GetBufferedRegion() != read->GetBufferedRegion()
+     || mapped->GetNumberOfComponentsPerPixel() != read->GetNumberOfComponentsPerPixel()
+     || mapped->GetPixelContainer()->Size() != n)
+    {
+    std::cerr << fn << ": regions differ" << std::endl;
+    ok = false;
+    }
+  else if(memcmp(mapped->GetBufferPointer(), read->GetBufferPointer(), n * sizeof(TPixel)))
+    {
+    std::cerr << fn << ": voxels differ" << std::endl;
+    ok = false;
+    }
+
+  if(mapped->GetSpacing() != read->GetSpacing() || mapped->GetOrigin() != read->GetOrigin()
+     || mapped->GetDirection() != read->GetDirection())
+    {
+    std::cerr << fn << ": geometry differs" << std::endl;
+    ok = false;
+    }
+
+  std::cout << fn << ": " << n * sizeof(TPixel) / (1024 * 1024) << " MB "
+            << (ok ? "OK" : "FAILED") << std::endl;
+  return ok;
+}
+
+template <class TPixel>
+bool writeAndTest(const std::string &dir, const char *ext, itk::IOComponentEnum type,
+                  int nx, int ny, int nz)
+{
+  typedef itk::Image<TPixel, 3> ImageType;
+  std::string fn = dir + "/mapped_io_test" + ext;
+  typename itk::ImageFileWriter<ImageType>::Pointer writer = itk::ImageFileWriter<ImageType>::New();
+  writer->SetInput(makeImage<TPixel>(nx, ny, nz));
+  writer->SetFileName(fn);
+  writer->SetUseCompression(false);
+  writer->Update();
+
+  bool ok = loadAndCompare<TPixel>(fn, type);
+  itksys::SystemTools::RemoveFile(fn);
+  if(std::string(ext) == ".mhd")
+    itksys::SystemTools::RemoveFile(dir + "/mapped_io_test.raw");
+  return ok;
+}
+
+// A file shorter than the requested range must not be mapped
+bool testShortFile(const std::string &dir)
+{
+  std::string fn = dir + "/mapped_io_short.bin";
+  {
+  std::ofstream ofs(fn.c_str(), std::ios::binary);
+  std::string data(4096, 'x');
+  ofs.write(data.data(), data.size());
+  }
+
+  MemoryMappedFile mmf;
+  bool ok = mmf.Map(fn, 0, 8192, fn) == nullptr && mmf.Map(fn, 1024, 4096, fn) == nullptr
+      && mmf.Map(fn, 1024, 3072, fn) != nullptr;
+  mmf.Unmap();
+  itksys::SystemTools::RemoveFile(fn);
+
+  std::cout << "short file: " << (ok ? "OK" : "FAILED") << std::endl;
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  std::string dir = argc > 1 ? argv[1] : itksys::SystemTools::GetCurrentWorkingDirectory();
+
+  // The images are larger than GuidedNativeImageIO::MIN_MAPPED_DATA_SIZE
+  int failures = 0;
+  failures += !writeAndTest<float>(dir, ".nii", itk::IOComponentEnum::FLOAT, 160, 160, 170);
+  failures += !writeAndTest<float>(dir, ".mha", itk::IOComponentEnum::FLOAT, 160, 160, 170);
+  failures += !writeAndTest<float>(dir, ".mhd", itk::IOComponentEnum::FLOAT, 160, 160, 170);
+  failures += !writeAndTest<short>(dir, ".nii", itk::IOComponentEnum::SHORT, 256, 256, 130);
+  failures += !writeAndTest<short>(dir, ".mha", itk::IOComponentEnum::SHORT, 256, 256, 130);
+  failures += !testShortFile(dir);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
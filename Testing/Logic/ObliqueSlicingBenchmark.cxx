@@ -0,0 +1,171 @@
+// Compares the line kernel of NonOrthogonalSlicer (FastLinearLineSampler)
+// with the per-voxel kernel it replaces, on short and float volumes sliced
+// at an oblique angle into a 4K-sized slice. For each pixel type and each
+// interpolation mode, reports the time per slice of both kernels and checks
+// that their slices are identical.
+//
+// Usage: ObliqueSlicingBenchmark [n [width height [nRepeats]]]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "itkImage.h"
+#include "itkEuler3DTransform.h"
+#include "NonOrthogonalSlicer.h"
+
+using namespace std;
+
+// The kernel before FastLinearLineSampler: one bounds-checked call per voxel
+template <typename TInputImage, typename TOutputImage>
+class PerVoxelWorkerTraits
+    : public DefaultNonOrthogonalSlicerWorkerTraits<TInputImage, TOutputImage>
+{
+public:
+  typedef DefaultNonOrthogonalSlicerWorkerTraits<TInputImage, TOutputImage> Superclass;
+  typedef typename Superclass::OutputComponentType OutputComponentType;
+
+  PerVoxelWorkerTraits(TInputImage *image) : Superclass(image) {}
+
+  void ProcessLine(double *cix, const double *step, int n, bool use_nn,
+                   OutputComponentType **out_ptr)
+  {
+    for(int i = 0; i < n; i++)
+      {
+      this->ProcessVoxel(cix, use_nn, out_ptr);
+      for(int d = 0; d < 3; d++)
+        cix[d] += step[d];
+      }
+  }
+};
+
+typedef itk::ImageBase<3> ReferenceType;
+typedef itk::Euler3DTransform<double> TransformType;
+
+// A smooth volume with some noise, so that interpolation is not trivial
+template <typename TPixel>
+typename itk::Image<TPixel, 3>::Pointer makeVolume(int n)
+{
+  typedef itk::Image<TPixel, 3> ImageType;
+  typename ImageType::Pointer image = ImageType::New();
+  typename ImageType::SizeType size = {{ (itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n }};
+  image->SetRegions(typename ImageType::RegionType(size));
+  image->Allocate();
+
+  mt19937 rng(42);
+  uniform_real_distribution<double> noise(-50.0, 50.0);
+  TPixel *p = image->GetBufferPointer();
+  for(int z = 0; z < n; z++)
+    for(int y = 0; y < n; y++)
+      for(int x = 0; x < n; x++)
+        *p++ = static_cast<TPixel>(
+                 1000.0 * sin(0.05 * x) * cos(0.07 * y) + 10.0 * z + noise(rng));
+  return image;
+}
+
+// A slice through the middle of the volume, large enough to extend past it
+ReferenceType::Pointer makeReference(int n, int width, int height)
+{
+  typedef itk::Image<char, 3> RefImageType;
+  RefImageType::Pointer ref = RefImageType::New();
+  RefImageType::SizeType size = {{ (itk::SizeValueType) width, (itk::SizeValueType) height, 1 }};
+  ref->SetRegions(RefImageType::RegionType(size));
+
+  RefImageType::SpacingType spacing;
+  spacing.Fill(1.4 * n / width);
+  ref->SetSpacing(spacing);
+
+  RefImageType::PointType origin;
+  origin[0] = 0.5 * n - 0.5 * width * spacing[0];
+  origin[1] = 0.5 * n - 0.5 * height * spacing[1];
+  origin[2] = 0.5 * n;
+  ref->SetOrigin(origin);
+  return ref.GetPointer();
+}
+
+template <typename TPixel, typename TWorkerTraits>
+double timeSlicer(itk::Image<TPixel, 3> *volume, ReferenceType *ref, TransformType *tran,
+                  bool use_nn, int nRepeats, typename itk::Image<TPixel, 2>::Pointer &slice)
+{
+  typedef itk::Image<TPixel, 3> ImageType;
+  typedef itk::Image<TPixel, 2> SliceType;
+  typedef NonOrthogonalSlicer<ImageType, SliceType, TWorkerTraits> SlicerType;
+
+  typename SlicerType::Pointer slicer = SlicerType::New();
+  slicer->SetInput(volume);
+  slicer->SetReferenceImage(ref);
+  slicer->SetTransform(tran);
+  slicer->SetUseNearestNeighbor(use_nn);
+
+  auto t0 = chrono::steady_clock::now();
+  for(int i = 0; i < nRepeats; i++)
+    {
+    slicer->Modified();
+    slicer->Update();
+    }
+  auto t1 = chrono::steady_clock::now();
+
+  slice = slicer->GetOutput();
+  slice->DisconnectPipeline();
+  return chrono::duration<double, milli>(t1 - t0).count() / nRepeats;
+}
+
+template <typename TPixel>
+bool runBenchmark(const char *name, int n, int width, int height, int nRepeats)
+{
+  typedef itk::Image<TPixel, 3> ImageType;
+  typedef itk::Image<TPixel, 2> SliceType;
+
+  typename ImageType::Pointer volume = makeVolume<TPixel>(n);
+  ReferenceType::Pointer ref = makeReference(n, width, height);
+
+  // Rotate about the center of the volume, as in registration mode
+  TransformType::Pointer tran = TransformType::New();
+  TransformType::InputPointType center;
+  center.Fill(0.5 * n);
+  tran->SetCenter(center);
+  tran->SetRotation(0.3, -0.2, 0.5);
+
+  bool ok = true;
+  for(int use_nn = 0; use_nn < 2; use_nn++)
+    {
+    typename SliceType::Pointer s1, s2;
+    double t1 = timeSlicer<TPixel, PerVoxelWorkerTraits<ImageType, SliceType> >(
+                  volume, ref, tran, use_nn, nRepeats, s1);
+    double t2 = timeSlicer<TPixel, DefaultNonOrthogonalSlicerWorkerTraits<ImageType, SliceType> >(
+                  volume, ref, tran, use_nn, nRepeats, s2);
+
+    size_t nPix = s1->GetBufferedRegion().GetNumberOfPixels(), nDiff = 0;
+    for(size_t i = 0; i < nPix; i++)
+      if(s1->GetBufferPointer()[i] != s2->GetBufferPointer()[i])
+        nDiff++;
+
+    cout << setw(6) << name << setw(9) << (use_nn ? "nearest" : "linear")
+         << fixed << setprecision(2)
+         << "  per voxel " << setw(8) << t1 << " ms"
+         << "  line " << setw(8) << t2 << " ms"
+         << "  speedup " << setw(5) << t1 / t2
+         << "  differing pixels " << nDiff << endl;
+
+    ok = ok && nDiff == 0;
+    }
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  int n = 256, width = 3840, height = 2160, nRepeats = 5;
+  if(argc > 1) n = atoi(argv[1]);
+  if(argc > 3) { width = atoi(argv[2]); height = atoi(argv[3]); }
+  if(argc > 4) nRepeats = atoi(argv[4]);
+
+  cout << "Volume " << n << "^3, slice " << width << " x " << height
+       << ", " << nRepeats << " repeats" << endl;
+
+  bool ok = runBenchmark<short>("short", n, width, height, nRepeats);
+  ok = runBenchmark<float>("float", n, width, height, nRepeats) && ok;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,198 @@
+// Checks the retraining of the random forest classifier by RFClassificationEngine.
+// An image is loaded into an IRISApplication, voxels of two labels are
+// painted in the SNAP segmentation, and the classifier is trained with
+// incremental training and a cap on the number of training voxels. Checks
+// that retraining without changes computes no features and grows no trees,
+// that the same training voxels are selected each time, and that after a
+// small stroke only the features of the new voxels are computed and only
+// some of the trees are replaced.
+//
+// Usage: RFClassificationEngineTest [tempdir]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkImageFileWriter.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include "itksys/SystemTools.hxx"
+#include "IRISApplication.h"
+#include "IRISImageData.h"
+#include "ImageIODelegates.h"
+#include "SNAPImageData.h"
+#include "SNAPSegmentationROISettings.h"
+#include "RFClassificationEngine.h"
+#include "RandomForestClassifier.h"
+#include "UIReporterDelegates.h"
+
+class DummySystemInfoDelegate : public SystemInfoDelegate
+{
+public:
+
+  DummySystemInfoDelegate(const char *argv0)
+    {
+    m_ExecutableName = argv0;
+    }
+
+  virtual std::string GetApplicationDirectory()
+    {
+    return itksys::SystemTools::GetFilenamePath(m_ExecutableName);
+    }
+
+  virtual std::string GetApplicationFile()
+    {
+    return m_ExecutableName;
+    }
+
+  virtual std::string GetApplicationPermanentDataLocation()
+    {
+    return std::string(".itksnap.test");
+    }
+
+  virtual std::string GetUserDocumentsLocation()
+    {
+    return std::string(".itksnap.test");
+    }
+
+  virtual std::string EncodeServerURL(const std::string &url)
+    {
+    return url;
+    }
+
+  typedef SystemInfoDelegate::GrayscaleImage GrayscaleImage;
+  typedef SystemInfoDelegate::RGBAPixelType RGBAPixelType;
+  typedef SystemInfoDelegate::RGBAImageType RGBAImageType;
+
+  virtual void LoadResourceAsImage2D(std::string tag, GrayscaleImage *image) {}
+  virtual void LoadResourceAsRegistry(std::string tag, Registry &reg) {}
+  virtual void WriteRGBAImage2D(std::string file, RGBAImageType *image) {}
+
+protected:
+  std::string m_ExecutableName;
+};
+
+typedef itk::Image<short, 3> GreyImageType;
+typedef IRISApplication::RFEngine RFEngine;
+
+// A bright sphere on a dark background
+std::string writeImage(const std::string &dir, int n)
+{
+  GreyImageType::Pointer img = GreyImageType::New();
+  GreyImageType::SizeType size = {{ (itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n }};
+  img->SetRegions(GreyImageType::RegionType(size));
+  img->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<GreyImageType> it(img, img->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    GreyImageType::IndexType idx = it.GetIndex();
+    double dx = idx[0] - n / 2.0, dy = idx[1] - n / 2.0, dz = idx[2] - n / 2.0;
+    bool inside = dx * dx + dy * dy + dz * dz < n * n / 9.0;
+    it.Set((short) ((inside ? 800 : 200) + (idx[0] * 7 + idx[1] * 13 + idx[2] * 29) % 50));
+    }
+
+  std::string fn = dir + "/RFClassificationEngineTest.nii";
+  typedef itk::ImageFileWriter<GreyImageType> WriterType;
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(img);
+  writer->SetFileName(fn.c_str());
+  writer->Update();
+  return fn;
+}
+
+// Paint a box of voxels with a label
+void paint(LabelImageWrapper *seg, LabelType label,
+           int x0, int x1, int y0, int y1, int z0, int z1)
+{
+  LabelImageWrapper::ImageType *img = seg->GetModifiableImage();
+  for(int z = z0; z < z1; z++)
+    for(int y = y0; y < y1; y++)
+      for(int x = x0; x < x1; x++)
+        {
+        itk::Index<3> idx = {{ x, y, z }};
+        img->SetPixel(idx, label);
+        }
+  img->Modified();
+}
+
+int main(int argc, char *argv[])
+{
+  std::string dir = argc > 1 ? argv[1] : ".";
+  const int n = 40;
+
+  DummySystemInfoDelegate sidel(argv[0]);
+  SystemInterface::SetSystemInfoDelegate(&sidel);
+
+  IRISApplication::Pointer app = IRISApplication::New();
+  IRISWarningList wl;
+  app->OpenImage(writeImage(dir, n).c_str(), MAIN_ROLE, wl);
+
+  SNAPSegmentationROISettings roi;
+  roi.SetROI(app->GetCurrentImageData()->GetImageRegion());
+  app->InitializeSNAPImageData(roi);
+  SNAPImageData *sid = app->GetSNAPImageData();
+  LabelImageWrapper *seg = sid->GetFirstSegmentationLayer();
+
+  // Label the inside and the outside of the sphere
+  paint(seg, 1, 15, 25, 15, 25, 15, 25);
+  paint(seg, 2, 2, 12, 2, 38, 2, 38);
+
+  SmartPtr<RFEngine> engine = RFEngine::New();
+  engine->SetDataSource(sid);
+  engine->SetForestSize(20);
+  engine->SetTreeDepth(10);
+  engine->SetMaximumNumberOfSamples(2000);
+  engine->SetIncrementalTraining(true);
+
+  int failures = 0;
+
+  // The first training computes the features of all the training voxels
+  engine->TrainClassifier();
+  std::vector<long> first = engine->GetTrainingVoxelOffsets();
+  printf("First training: %lu voxels, %lu features computed, %d trees grown\n",
+         (unsigned long) first.size(), engine->GetNumberOfFeaturesComputed(),
+         engine->GetNumberOfTreesGrown());
+  if(first.size() < 1000 || first.size() > 3000 ||
+     engine->GetNumberOfFeaturesComputed() != first.size() ||
+     engine->GetNumberOfTreesGrown() != 20)
+    failures++;
+
+  // Retraining without changes selects the same voxels and reuses them
+  engine->TrainClassifier();
+  printf("Retraining: %lu features computed, %d trees grown\n",
+         engine->GetNumberOfFeaturesComputed(), engine->GetNumberOfTreesGrown());
+  if(engine->GetTrainingVoxelOffsets() != first ||
+     engine->GetNumberOfFeaturesComputed() != 0 ||
+     engine->GetNumberOfTreesGrown() != 0)
+    failures++;
+
+  // A small stroke of the first label only adds voxels to the training set,
+  // computes their features only, and replaces some of the trees
+  paint(seg, 1, 25, 27, 15, 25, 15, 25);
+  engine->TrainClassifier();
+  const std::vector<long> &second = engine->GetTrainingVoxelOffsets();
+  std::vector<long> kept;
+  std::set_intersection(first.begin(), first.end(), second.begin(), second.end(),
+                        std::back_inserter(kept));
+  printf("After a stroke: %lu voxels, %lu kept, %lu features computed, %d trees grown\n",
+         (unsigned long) second.size(), (unsigned long) kept.size(),
+         engine->GetNumberOfFeaturesComputed(), engine->GetNumberOfTreesGrown());
+  if(kept.size() < first.size() * 95 / 100 ||
+     engine->GetNumberOfFeaturesComputed() != second.size() - kept.size() ||
+     engine->GetNumberOfTreesGrown() <= 0 || engine->GetNumberOfTreesGrown() >= 20 ||
+     engine->GetClassifier()->GetForest()->GetForestSize() != 20)
+    failures++;
+
+  // A new label needs the whole forest to be grown again
+  paint(seg, 3, 30, 34, 2, 38, 2, 38);
+  engine->TrainClassifier();
+  printf("After a new label: %d trees grown\n", engine->GetNumberOfTreesGrown());
+  if(engine->GetNumberOfTreesGrown() != 20)
+    failures++;
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+// Measures RLEImage with the storage layout it was compiled with: building
+// the image from a synthetic parcellation, whole-volume scans with the
+// region iterator, and random paint strokes through SetPixel().
+//
+// The benchmark is built twice, as RLEStorageBenchmarkVector (one
+// std::vector per line) and RLEStorageBenchmarkFlat (runs in a shared
+// RLELineArena), so that the two runs can be compared side by side.
+//
+// Usage: RLEStorageBenchmark[Vector|Flat] [nx ny nz [nLabels [nEdits]]]
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <itkImage.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkTimeProbe.h>
+#include "RLEImageRegionIterator.h"
+#include "RLERegionOfInterestImageFilter.h"
+
+typedef itk::Image<short, 3> SegImageType;
+typedef RLEImage<short> RLESegImageType;
+
+struct Blob
+{
+  double cx, cy, cz, r2;
+  short label;
+};
+
+// Synthetic parcellation: overlapping spheres of random size
+SegImageType::Pointer makeParcellation(int nx, int ny, int nz, int nLabels)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> ux(0, nx), uy(0, ny), uz(0, nz);
+  std::uniform_real_distribution<double> ur(0.02, 0.15);
+  std::vector<Blob> blobs;
+  for (int i = 0; i < nLabels; i++)
+    {
+    double r = ur(rng) * nx;
+    Blob b = { ux(rng), uy(rng), uz(rng), r * r, short(1 + i) };
+    blobs.push_back(b);
+    }
+
+  SegImageType::Pointer img = SegImageType::New();
+  SegImageType::SizeType size = {{ (itk::SizeValueType) nx, (itk::SizeValueType) ny, (itk::SizeValueType) nz }};
+  img->SetRegions(SegImageType::RegionType(size));
+  img->Allocate();
+
+  for (itk::ImageRegionIteratorWithIndex<SegImageType> it(img, img->GetBufferedRegion());
+       !it.IsAtEnd(); ++it)
+    {
+    SegImageType::IndexType idx = it.GetIndex();
+    short v = 0;
+    for (size_t i = 0; i < blobs.size(); i++)
+      {
+      double dx = idx[0] - blobs[i].cx, dy = idx[1] - blobs[i].cy, dz = idx[2] - blobs[i].cz;
+      if (dx * dx + dy * dy + dz * dz < blobs[i].r2)
+        v = blobs[i].label;
+      }
+    it.Set(v);
+    }
+  return img;
+}
+
+// Whole-volume pass computing voxel counts per label
+unsigned long long scanVolume(RLESegImageType *rle, std::vector<unsigned long long> &counts)
+{
+  std::fill(counts.begin(), counts.end(), 0);
+  for (itk::ImageRegionConstIterator<RLESegImageType> it(rle, rle->GetBufferedRegion());
+       !it.IsAtEnd(); ++it)
+    counts[it.Get()]++;
+
+  unsigned long long check = 0;
+  for (size_t k = 0; k < counts.size(); k++)
+    check += counts[k] * (k + 1);
+  return check;
+}
+
+size_t heapInUse()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+  return mi.uordblks + mi.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+void reportScan(const char *stage, RLESegImageType *rle, size_t heap, int nRep,
+                std::vector<unsigned long long> &counts)
+{
+  unsigned long long check = 0;
+  itk::TimeProbe tp;
+  for (int r = 0; r < nRep; r++)
+    {
+    tp.Start();
+    check = scanVolume(rle, counts);
+    tp.Stop();
+    }
+
+  double ms = tp.GetMean() * 1000.0;
+  double nVoxels = rle->GetBufferedRegion().GetNumberOfPixels();
+  std::cout << std::setw(14) << std::left << stage
+            << std::setw(14) << std::right << rle->GetRunStorageMemorySize() / 1024
+            << std::setw(14) << heap / 1024
+            << std::setw(12) << std::fixed << std::setprecision(2) << ms
+            << std::setw(12) << std::setprecision(0) << nVoxels / (ms * 1000.0)
+            << "   (" << check << ")" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  int nx = argc > 3 ? atoi(argv[1]) : 512;
+  int ny = argc > 3 ? atoi(argv[2]) : 512;
+  int nz = argc > 3 ? atoi(argv[3]) : 400;
+  int nLabels = argc > 4 ? atoi(argv[4]) : 40;
+  int nEdits = argc > 5 ? atoi(argv[5]) : 200000;
+  const int nRep = 5;
+
+#ifdef SNAP_RLE_FLAT_STORAGE
+  const char *mode = "flat (RLELineArena)";
+#else
+  const char *mode = "vector (std::vector per line)";
+#endif
+
+  std::cout << "RLEImage storage: " << mode << std::endl;
+  std::cout << "Volume " << nx << "x" << ny << "x" << nz << ", " << nLabels
+            << " labels, " << nEdits << " edits" << std::endl << std::endl;
+
+  SegImageType::Pointer seg = makeParcellation(nx, ny, nz, nLabels);
+  std::vector<unsigned long long> counts(nLabels + 1);
+
+  // Build the RLE image the way the segmentation wrapper does
+  typedef itk::RegionOfInterestImageFilter<SegImageType, RLESegImageType> ConverterType;
+  size_t h0 = heapInUse();
+  itk::TimeProbe tBuild;
+  tBuild.Start();
+  ConverterType::Pointer conv = ConverterType::New();
+  conv->SetInput(seg);
+  conv->SetRegionOfInterest(seg->GetBufferedRegion());
+  conv->Update();
+  RLESegImageType::Pointer rle = conv->GetOutput();
+  rle->DisconnectPipeline();
+  conv = NULL;
+  tBuild.Stop();
+
+  itk::TimeProbe tCompact;
+  tCompact.Start();
+  rle->Compact();
+  tCompact.Stop();
+  size_t heap = heapInUse() - h0;
+
+  std::cout << "Build " << std::fixed << std::setprecision(1) << tBuild.GetTotal() * 1000.0
+            << " ms, compact " << tCompact.GetTotal() * 1000.0 << " ms" << std::endl << std::endl;
+
+  std::cout << std::setw(14) << std::left << "Stage" << std::setw(14) << std::right << "Runs KB"
+            << std::setw(14) << "Heap KB" << std::setw(12) << "Scan ms"
+            << std::setw(12) << "Mvox/s" << std::endl;
+  reportScan("built", rle, heap, nRep, counts);
+
+  // Random paint strokes along x, made one voxel at a time as the paint
+  // tools do
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> ux(0, nx - 1), uy(0, ny - 1), uz(0, nz - 1);
+  std::uniform_int_distribution<int> ulen(1, 16), uv(0, nLabels);
+
+  h0 = heapInUse();
+  itk::TimeProbe tEdit;
+  tEdit.Start();
+  for (int e = 0; e < nEdits; e++)
+    {
+    RLESegImageType::IndexType idx = {{ ux(rng), uy(rng), uz(rng) }};
+    int len = std::min(ulen(rng), nx - (int) idx[0]);
+    short value = (short) uv(rng);
+    for (int i = 0; i < len; i++, idx[0]++)
+      rle->SetPixel(idx, value);
+    }
+  tEdit.Stop();
+  heap += heapInUse() - h0;
+
+  reportScan("edited", rle, heap, nRep, counts);
+
+  h0 = heapInUse();
+  rle->Compact();
+  heap += heapInUse() - h0;
+  reportScan("recompacted", rle, heap, nRep, counts);
+
+  std::cout << std::endl << "SetPixel strokes: " << std::setprecision(1)
+            << tEdit.GetTotal() * 1000.0 << " ms" << std::endl;
+
+  return EXIT_SUCCESS;
+}
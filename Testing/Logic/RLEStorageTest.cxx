@@ -0,0 +1,305 @@
+// Checks RLEImage with the storage layout it was compiled with against a
+// plain itk::Image that receives the same edits. The RLE image is built
+// from a synthetic parcellation. It is then edited with SetPixel strokes,
+// region iterators and Compact(). After each step it is compared voxel for
+// voxel through the region, index and scanline iterators, IRISSlicer slices
+// along all axes and region of interest extraction.
+//
+// The test is built twice, as RLEStorageTestVector (one std::vector per
+// line) and RLEStorageTestFlat (runs in a shared RLELineArena). Since both
+// are compared with the same reference, the two layouts agree voxel for
+// voxel.
+//
+// Usage: RLEStorageTest[Vector|Flat] [nx ny nz [nEdits]]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkImageRegionIteratorWithIndex.h>
+#include <itkImageScanlineConstIterator.h>
+#include "RLEImageRegionIterator.h"
+#include "RLEImageScanlineConstIterator.h"
+#include "RLERegionOfInterestImageFilter.h"
+#include "IRISSlicer.h"
+
+typedef itk::Image<short, 3> SegImageType;
+typedef itk::Image<short, 2> SliceImageType;
+typedef RLEImage<short> RLESegImageType;
+
+// Overlapping spheres of random size
+SegImageType::Pointer makeParcellation(int nx, int ny, int nz, int nLabels)
+{
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> ux(0, nx), uy(0, ny), uz(0, nz), ur(0.05, 0.3);
+  std::vector<std::vector<double> > blobs;
+  for(int i = 0; i < nLabels; i++)
+    {
+    double r = ur(rng) * nx;
+    blobs.push_back({ ux(rng), uy(rng), uz(rng), r * r });
+    }
+
+  SegImageType::Pointer img = SegImageType::New();
+  SegImageType::SizeType size = {{ (itk::SizeValueType) nx, (itk::SizeValueType) ny, (itk::SizeValueType) nz }};
+  img->SetRegions(SegImageType::RegionType(size));
+  img->Allocate();
+
+  for(itk::ImageRegionIteratorWithIndex<SegImageType> it(img, img->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    {
+    SegImageType::IndexType idx = it.GetIndex();
+    short v = 0;
+    for(size_t i = 0; i < blobs.size(); i++)
+      {
+      double dx = idx[0] - blobs[i][0], dy = idx[1] - blobs[i][1], dz = idx[2] - blobs[i][2];
+      if(dx * dx + dy * dy + dz * dz < blobs[i][3])
+        v = (short) (1 + i);
+      }
+    it.Set(v);
+    }
+  return img;
+}
+
+// Compare the two images with the region, index and scanline iterators
+int compareVoxels(const char *step, RLESegImageType *rle, SegImageType *ref)
+{
+  unsigned long nDiffer = 0;
+  SegImageType::RegionType region = ref->GetBufferedRegion();
+
+  itk::ImageRegionConstIterator<SegImageType> rit(ref, region);
+  for(itk::ImageRegionConstIterator<RLESegImageType> it(rle, region); !it.IsAtEnd(); ++it, ++rit)
+    nDiffer += (it.Get() != rit.Get());
+
+  for(itk::ImageRegionConstIteratorWithIndex<RLESegImageType> it(rle, region); !it.IsAtEnd(); ++it)
+    nDiffer += (it.Get() != ref->GetPixel(it.GetIndex()));
+
+  itk::ImageScanlineConstIterator<SegImageType> rsit(ref, region);
+  itk::ImageScanlineConstIterator<RLESegImageType> sit(rle, region);
+  for(; !sit.IsAtEnd(); sit.NextLine(), rsit.NextLine())
+    for(; !sit.IsAtEndOfLine(); ++sit, ++rsit)
+      nDiffer += (sit.Get() != rsit.Get());
+
+  if(nDiffer)
+    printf("%s: %lu voxel differences\n", step, nDiffer);
+  return nDiffer ? 1 : 0;
+}
+
+// Compare the slices extracted by IRISSlicer along each axis, in both
+// directions of traversal
+int compareSlices(const char *step, RLESegImageType *rle, SegImageType *ref)
+{
+  typedef IRISSlicer<RLESegImageType, SliceImageType, RLESegImageType> RLESlicerType;
+  typedef IRISSlicer<SegImageType, SliceImageType, SegImageType> SlicerType;
+  const unsigned int axes[3][3] = { { 2, 1, 0 }, { 1, 0, 2 }, { 0, 2, 1 } };
+
+  int failures = 0;
+  for(int a = 0; a < 3; a++)
+    {
+    for(int dir = 0; dir < 4; dir++)
+      {
+      unsigned int s = axes[a][0];
+      unsigned int index = ref->GetBufferedRegion().GetSize(s) / 3;
+
+      RLESlicerType::Pointer rs = RLESlicerType::New();
+      SlicerType::Pointer ss = SlicerType::New();
+      rs->SetInput(rle);
+      ss->SetInput(ref);
+      rs->SetSliceIndex(index);
+      ss->SetSliceIndex(index);
+      rs->SetSliceDirectionImageAxis(s);
+      ss->SetSliceDirectionImageAxis(s);
+      rs->SetLineDirectionImageAxis(axes[a][1]);
+      ss->SetLineDirectionImageAxis(axes[a][1]);
+      rs->SetPixelDirectionImageAxis(axes[a][2]);
+      ss->SetPixelDirectionImageAxis(axes[a][2]);
+      rs->SetLineTraverseForward(dir & 1);
+      ss->SetLineTraverseForward(dir & 1);
+      rs->SetPixelTraverseForward(dir & 2);
+      ss->SetPixelTraverseForward(dir & 2);
+      rs->Update();
+      ss->Update();
+
+      unsigned long nDiffer = 0;
+      SliceImageType *rslice = rs->GetOutput(), *slice = ss->GetOutput();
+      itk::ImageRegionConstIterator<SliceImageType> it(slice, slice->GetBufferedRegion());
+      for(itk::ImageRegionConstIterator<SliceImageType> rit(rslice, rslice->GetBufferedRegion());
+          !rit.IsAtEnd(); ++rit, ++it)
+        nDiffer += (rit.Get() != it.Get());
+
+      if(nDiffer || rslice->GetBufferedRegion() != slice->GetBufferedRegion())
+        {
+        printf("%s: slice along axis %d (traversal %d) has %lu differences\n", step, s, dir, nDiffer);
+        failures++;
+        }
+      }
+    }
+  return failures;
+}
+
+// Count the voxels of a region of interest that differ from the reference
+template <class TImage>
+unsigned long countROIDifferences(TImage *sub, const SegImageType::RegionType &roi, SegImageType *ref)
+{
+  unsigned long nDiffer = 0;
+  typename TImage::RegionType region = sub->GetBufferedRegion();
+  if(region.GetSize() != roi.GetSize())
+    return region.GetNumberOfPixels() + 1;
+
+  for(itk::ImageRegionConstIteratorWithIndex<TImage> it(sub, region); !it.IsAtEnd(); ++it)
+    {
+    SegImageType::IndexType idx = it.GetIndex();
+    for(int d = 0; d < 3; d++)
+      idx[d] += roi.GetIndex(d) - region.GetIndex(d);
+    nDiffer += (it.Get() != ref->GetPixel(idx));
+    }
+  return nDiffer;
+}
+
+// Compare the regions of interest extracted as RLE and as plain images, for
+// a box inside the image and for a slab of whole lines, which the RLE filter
+// copies line by line
+int compareROI(const char *step, RLESegImageType *rle, SegImageType *ref)
+{
+  SegImageType::RegionType roi = ref->GetBufferedRegion();
+  for(int d = 0; d < 3; d++)
+    {
+    roi.SetIndex(d, roi.GetSize(d) / 4);
+    roi.SetSize(d, roi.GetSize(d) / 2);
+    }
+
+  SegImageType::RegionType slab = roi;
+  slab.SetIndex(0, 0);
+  slab.SetSize(0, ref->GetBufferedRegion().GetSize(0));
+
+  unsigned long nDiffer = 0;
+  typedef itk::RegionOfInterestImageFilter<RLESegImageType, RLESegImageType> RLEROIType;
+  typedef itk::RegionOfInterestImageFilter<RLESegImageType, SegImageType> DecoderType;
+  const SegImageType::RegionType regions[] = { roi, slab };
+  for(int i = 0; i < 2; i++)
+    {
+    RLEROIType::Pointer rroi = RLEROIType::New();
+    rroi->SetInput(rle);
+    rroi->SetRegionOfInterest(regions[i]);
+    rroi->Update();
+    nDiffer += countROIDifferences<RLESegImageType>(rroi->GetOutput(), regions[i], ref);
+
+    DecoderType::Pointer dec = DecoderType::New();
+    dec->SetInput(rle);
+    dec->SetRegionOfInterest(regions[i]);
+    dec->Update();
+    nDiffer += countROIDifferences<SegImageType>(dec->GetOutput(), regions[i], ref);
+    }
+
+  if(nDiffer)
+    printf("%s: %lu differences in the regions of interest\n", step, nDiffer);
+  return nDiffer ? 1 : 0;
+}
+
+int compare(const char *step, RLESegImageType *rle, SegImageType *ref)
+{
+  int failures = compareVoxels(step, rle, ref)
+      + compareSlices(step, rle, ref)
+      + compareROI(step, rle, ref);
+  printf("%-20s %s\n", step, failures ? "FAILED" : "ok");
+  return failures;
+}
+
+int main(int argc, char *argv[])
+{
+  int nx = argc > 3 ? atoi(argv[1]) : 64;
+  int ny = argc > 3 ? atoi(argv[2]) : 48;
+  int nz = argc > 3 ? atoi(argv[3]) : 40;
+  int nEdits = argc > 4 ? atoi(argv[4]) : 20000;
+
+#ifdef SNAP_RLE_FLAT_STORAGE
+  printf("RLEImage storage: flat (RLELineArena)\n");
+#else
+  printf("RLEImage storage: vector (std::vector per line)\n");
+#endif
+
+  SegImageType::Pointer ref = makeParcellation(nx, ny, nz, 12);
+
+  // Build the RLE image the way the segmentation wrapper does
+  typedef itk::RegionOfInterestImageFilter<SegImageType, RLESegImageType> ConverterType;
+  ConverterType::Pointer conv = ConverterType::New();
+  conv->SetInput(ref);
+  conv->SetRegionOfInterest(ref->GetBufferedRegion());
+  conv->Update();
+  RLESegImageType::Pointer rle = conv->GetOutput();
+  rle->DisconnectPipeline();
+
+  int failures = compare("Built", rle, ref);
+
+  // Paint strokes along each axis, one voxel at a time as the paint tools
+  // do, including strokes that split, join and extend runs
+  std::mt19937 rng(9);
+  std::uniform_int_distribution<int> ux(0, nx - 1), uy(0, ny - 1), uz(0, nz - 1);
+  std::uniform_int_distribution<int> ulen(1, 12), uv(0, 14), uaxis(0, 2);
+  for(int e = 0; e < nEdits; e++)
+    {
+    SegImageType::IndexType idx = {{ ux(rng), uy(rng), uz(rng) }};
+    int axis = uaxis(rng), len = ulen(rng);
+    short value = (short) uv(rng);
+    int n[3] = { nx, ny, nz };
+    for(int i = 0; i < len && idx[axis] < n[axis]; i++, idx[axis]++)
+      {
+      rle->SetPixel(idx, value);
+      ref->SetPixel(idx, value);
+      }
+    }
+  failures += compare("SetPixel strokes", rle, ref);
+
+  // Fill a box with a label, and a checkerboard of two labels that breaks
+  // every line of another box into single voxel runs
+  SegImageType::RegionType box = ref->GetBufferedRegion();
+  for(int d = 0; d < 3; d++)
+    {
+    box.SetIndex(d, box.GetSize(d) / 8);
+    box.SetSize(d, box.GetSize(d) - 2 * box.GetIndex(d));
+    }
+  itk::ImageRegionIterator<SegImageType> rit(ref, box);
+  for(itk::ImageRegionIterator<RLESegImageType> it(rle, box); !it.IsAtEnd(); ++it, ++rit)
+    {
+    it.Set(5);
+    rit.Set(5);
+    }
+
+  SegImageType::RegionType checker = ref->GetBufferedRegion();
+  for(int d = 0; d < 3; d++)
+    checker.SetSize(d, checker.GetSize(d) / 3);
+  itk::ImageRegionIteratorWithIndex<SegImageType> rcit(ref, checker);
+  for(itk::ImageRegionIteratorWithIndex<RLESegImageType> it(rle, checker); !it.IsAtEnd(); ++it, ++rcit)
+    {
+    SegImageType::IndexType idx = it.GetIndex();
+    short value = (idx[0] + idx[1] + idx[2]) % 2 ? 7 : 8;
+    it.Set(value);
+    rcit.Set(value);
+    }
+  failures += compare("Iterator edits", rle, ref);
+
+  // Compacting must not change the voxels, and the image must stay
+  // editable afterwards
+  rle->Compact();
+  failures += compare("Compacted", rle, ref);
+
+  for(int e = 0; e < nEdits / 10; e++)
+    {
+    SegImageType::IndexType idx = {{ ux(rng), uy(rng), uz(rng) }};
+    short value = (short) uv(rng);
+    rle->SetPixel(idx, value);
+    ref->SetPixel(idx, value);
+    }
+  failures += compare("Edited after compact", rle, ref);
+
+  // A copy through the RLE region of interest filter must match as well
+  typedef itk::RegionOfInterestImageFilter<RLESegImageType, RLESegImageType> CopyType;
+  CopyType::Pointer copy = CopyType::New();
+  copy->SetInput(rle);
+  copy->SetRegionOfInterest(rle->GetBufferedRegion());
+  copy->Update();
+  failures += compare("Copied", copy->GetOutput(), ref);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -27,6 +27,18 @@ typedef itk::LabelMap<itk::LabelObject<short, 2 > > Label2DType;
 typedef itk::ImageFileReader<Seg3DImageType> SegReaderType;
 typedef itk::ImageFileWriter<Seg2DImageType> SegWriterType;
 
+inline char axisToLetter(unsigned axis)
+{
+    if (axis == 0)
+        return 'X';
+    else if (axis == 1)
+        return 'Y';
+    else if (axis == 2)
+        return 'Z';
+    else
+        return '?';
+}
+
 Seg3DImageType::Pointer loadImage(const string filename)
 {
     SegReaderType::Pointer sr = SegReaderType::New();
@@ -160,10 +172,11 @@ Seg2DImageType::Pointer cropIRIS(Seg3DImageType::Pointer image)
     return roi->GetOutput();
 }
 
-Seg2DImageType::Pointer cropRLEiris(RLEImage3D::Pointer image)
+typedef IRISSlicer<RLEImage3D, Seg2DImageType, RLEImage3D> RLEirisSlicerType;
+
+RLEirisSlicerType::Pointer makeRLEirisSlicer(RLEImage3D::Pointer image)
 {
-    typedef IRISSlicer<RLEImage3D, Seg2DImageType, RLEImage3D> roiType;
-    roiType::Pointer roi = roiType::New();
+    RLEirisSlicerType::Pointer roi = RLEirisSlicerType::New();
     roi->SetInput(image);
     roi->SetSliceIndex(sliceIndex);
     roi->SetSliceDirectionImageAxis(axis);
@@ -182,10 +195,45 @@ Seg2DImageType::Pointer cropRLEiris(RLEImage3D::Pointer image)
         roi->SetLineDirectionImageAxis(1);
         roi->SetPixelDirectionImageAxis(0);
     }
+    return roi;
+}
+
+Seg2DImageType::Pointer cropRLEiris(RLEImage3D::Pointer image)
+{
+    RLEirisSlicerType::Pointer roi = makeRLEirisSlicer(image);
     roi->Update();
     return roi->GetOutput();
 }
 
+//times the RLE slicer when scrubbing through nSlices consecutive slices,
+//either single-threaded with a linear walk along lines (the old behavior)
+//or multi-threaded with the run end index
+double timeRLEirisScrubbing(RLEImage3D::Pointer image, bool fast, int nSlices,
+                            Seg2DImageType::Pointer &result)
+{
+    RLEirisSlicerType::Pointer roi = makeRLEirisSlicer(image);
+    if (!fast)
+    {
+        roi->SetNumberOfWorkUnits(1);
+        roi->SetUseRunEndIndex(false);
+    }
+
+    int nAxis = image->GetLargestPossibleRegion().GetSize(axis);
+    itk::TimeProbe tp;
+    for (int i = 0; i < nSlices; i++)
+    {
+        roi->SetSliceIndex((sliceIndex + i + 1) % nAxis);
+        tp.Start();
+        roi->Update();
+        tp.Stop();
+    }
+
+    roi->SetSliceIndex(sliceIndex);
+    roi->Update();
+    result = roi->GetOutput();
+    return tp.GetMean() * 1000;
+}
+
 Seg3DImageType::Pointer cropRLE(Label3DType::Pointer image)
 {
     typedef itk::ChangeRegionLabelMapFilter<Label3DType> roiLMType;
@@ -307,6 +355,30 @@ int main(int argc, char *argv[])
 
     cout << " slicing took: " << tp.GetMean() * 1000 << " ms " << endl;
 
+    if (irisRLE)
+    {
+        // Record the per-slice time for scrubbing along this axis with the
+        // old (serial, linear walk) and new (threaded, indexed) slicer
+        const int nScrub = 20;
+        Seg2DImageType::Pointer slow2D, fast2D;
+        double tSlow = timeRLEirisScrubbing(rleImage, false, nScrub, slow2D);
+        double tFast = timeRLEirisScrubbing(rleImage, true, nScrub, fast2D);
+        cout << "irisRLE scrubbing along " << axisToLetter(axis) << ": serial "
+             << tSlow << " ms, threaded " << tFast << " ms per slice" << endl;
+
+        // Both code paths must produce identical slices
+        typedef itk::Testing::ComparisonImageFilter<Seg2DImageType, Seg2DImageType> CompareType;
+        CompareType::Pointer cmp = CompareType::New();
+        cmp->SetValidInput(slow2D);
+        cmp->SetTestInput(fast2D);
+        cmp->Update();
+        if (cmp->GetNumberOfPixelsWithDifferences() > 0)
+        {
+            cout << "Serial and threaded RLE slices differ!" << endl;
+            return 1;
+        }
+    }
+
 
     if (!iris && !rli && !irisRLE)
     {
@@ -0,0 +1,137 @@
+// Checks that the quantiles computed by TDigestImageFilter come from the
+// values themselves, and not from the fine histogram that it fills in the
+// same pass. The test image has PET-like values between 0 and 20 and a few
+// extreme outliers, so the histogram bins are much wider than the spread of
+// the bulk of the data, while the t-digest stays accurate.
+//
+// Also checks that when only some time points of a 4D image are added to the
+// digest, the min and max still cover an outlier in a time point that is not
+// added, since the display lookup tables are indexed by them.
+//
+// Usage: TDigestQuantileTest [size]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <itkImage.h>
+#include <itkImageRegionIterator.h>
+#include "TDigestImageFilter.h"
+
+typedef itk::Image<float, 3> ImageType;
+typedef itk::Image<short, 4> TimeSeriesImageType;
+
+int testSkippedTimePoints()
+{
+  // Twenty time points, of which the filter adds 0, 6, 13 and 19
+  TimeSeriesImageType::Pointer img = TimeSeriesImageType::New();
+  TimeSeriesImageType::SizeType size = {{ 16, 16, 8, 20 }};
+  img->SetRegions(TimeSeriesImageType::RegionType(size));
+  img->Allocate();
+
+  size_t i = 0;
+  for(itk::ImageRegionIterator<TimeSeriesImageType> it(img, img->GetBufferedRegion());
+      !it.IsAtEnd(); ++it, ++i)
+    it.Set((short) (100 + i % 50));
+
+  // Outliers in time points 1 and 2
+  TimeSeriesImageType::IndexType high = {{ 3, 4, 5, 1 }}, low = {{ 7, 2, 1, 2 }};
+  img->SetPixel(high, 30000);
+  img->SetPixel(low, -20000);
+
+  typedef TDigestImageFilter<TimeSeriesImageType> FilterType;
+  FilterType::Pointer filter = FilterType::New();
+  filter->SetInput(img);
+  filter->SetMaximumNumberOfTimePoints(4);
+  filter->Update();
+  TDigestDataObject *digest = filter->GetTDigest();
+
+  int failures = 0;
+  if(filter->GetImageMin()->Get() != -20000 || filter->GetImageMax()->Get() != 30000 ||
+     digest->GetImageMinimum() != -20000.0f || digest->GetImageMaximum() != 30000.0f)
+    {
+    printf("Range with skipped time points: %d to %d, expected -20000 to 30000\n",
+           filter->GetImageMin()->Get(), filter->GetImageMax()->Get());
+    failures++;
+    }
+
+  // Only the four time points are in the digest
+  unsigned long long expected = 4ull * 16 * 16 * 8;
+  if(digest->GetTotalWeight() != expected)
+    {
+    printf("Digest weight with skipped time points %llu, expected %llu\n",
+           digest->GetTotalWeight(), expected);
+    failures++;
+    }
+
+  return failures;
+}
+
+int main(int argc, char *argv[])
+{
+  int n = argc > 1 ? atoi(argv[1]) : 96;
+
+  ImageType::Pointer img = ImageType::New();
+  ImageType::SizeType size = {{ (itk::SizeValueType) n, (itk::SizeValueType) n, (itk::SizeValueType) n }};
+  img->SetRegions(ImageType::RegionType(size));
+  img->Allocate();
+
+  std::mt19937 rng(17);
+  std::lognormal_distribution<float> uptake(0.5f, 0.6f);
+  std::vector<float> values;
+  values.reserve(img->GetBufferedRegion().GetNumberOfPixels());
+  size_t i = 0;
+  for(itk::ImageRegionIterator<ImageType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it, ++i)
+    {
+    float v = std::min(uptake(rng), 20.0f);
+    if(i % 100000 == 7)
+      v = 1.0e6f;
+    it.Set(v);
+    values.push_back(v);
+    }
+
+  typedef TDigestImageFilter<ImageType> FilterType;
+  FilterType::Pointer filter = FilterType::New();
+  filter->SetInput(img);
+  filter->Update();
+  TDigestDataObject *digest = filter->GetTDigest();
+
+  std::sort(values.begin(), values.end());
+  int failures = 0;
+  if(digest->GetImageMinimum() != values.front() || digest->GetImageMaximum() != values.back())
+    {
+    printf("Range: %f to %f, expected %f to %f\n",
+           digest->GetImageMinimum(), digest->GetImageMaximum(), values.front(), values.back());
+    failures++;
+    }
+
+  // The histogram cannot resolve the bulk of the data
+  double bin_width = digest->GetHistogram().GetBinWidth();
+  double spread = values[(size_t) (0.99 * (values.size() - 1))]
+      - values[(size_t) (0.01 * (values.size() - 1))];
+  printf("Histogram bin width %g, 1-99%% spread %g\n", bin_width, spread);
+
+  const double qs[] = { 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99 };
+  for(double q : qs)
+    {
+    double exact = values[(size_t) (q * (values.size() - 1))];
+    double approx = digest->GetImageQuantile(q);
+    bool ok = std::fabs(approx - exact) < 0.02 * spread;
+    printf("Quantile %4.2f: %10.5f, exact %10.5f %s\n", q, approx, exact, ok ? "" : "FAILED");
+    failures += !ok;
+    }
+
+  if(digest->GetTotalWeight() != values.size())
+    {
+    printf("Digest weight %llu, expected %zu\n",
+           digest->GetTotalWeight(), values.size());
+    failures++;
+    }
+
+  failures += testSkippedTimePoints();
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
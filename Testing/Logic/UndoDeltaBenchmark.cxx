@@ -0,0 +1,303 @@
+// Compares dense and sparse undo deltas on a fixed set of paint strokes
+// applied to a LabelImageWrapper. Sparse strokes are painted with
+// SegmentationUpdateIterator and undone with LabelImageWrapper::Undo, as
+// the paint tools do. Dense strokes encode every voxel of the bounding box,
+// as the iterator used to. For each stroke set, reports the time to encode
+// and commit the strokes, the bytes held by the deltas and the time to undo
+// all of them, and checks that undo restores the original labels.
+//
+// Also checks that a small stroke in a large update region is encoded with
+// one call per run of changed voxels.
+//
+// Usage: UndoDeltaBenchmark [nx ny nz [nStrokes]]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "SNAPCommon.h"
+#include "LabelImageWrapper.h"
+#include "RLEImageRegionIterator.h"
+#include "SegmentationUpdateIterator.h"
+#include "UndoDataManager.h"
+
+using namespace std;
+
+typedef UndoDataManager<LabelType>::Delta Delta;
+typedef itk::ImageRegion<3> RegionType;
+typedef LabelImageWrapper::ImageType LabelImageType;
+
+// The label image and its size
+struct Volume
+{
+  int nx, ny, nz;
+  SmartPtr<LabelImageWrapper> seg;
+};
+
+// A stroke paints the voxels within 'width' of the segment p0-p1, clipped
+// to its bounding box, the way the paintbrush and polygon tools do
+struct Stroke
+{
+  double p0[3], p1[3], width;
+  LabelType label;
+};
+
+vector<Stroke> makeStrokes(const Volume &vol, int n, bool polygon)
+{
+  vector<Stroke> strokes;
+  unsigned int seed = polygon ? 11 : 7;
+  auto rnd = [&seed]() { seed = seed * 1103515245 + 12345; return (seed >> 8) / double(1 << 24); };
+  for(int i = 0; i < n; i++)
+    {
+    Stroke s;
+    double z = 8 + rnd() * (vol.nz - 16);
+    s.p0[0] = 8 + rnd() * (vol.nx - 16);
+    s.p0[1] = 8 + rnd() * (vol.ny - 16);
+    s.p0[2] = z;
+    if(polygon)
+      {
+      // Long thin edge within a single slice
+      s.p1[0] = 8 + rnd() * (vol.nx - 16);
+      s.p1[1] = 8 + rnd() * (vol.ny - 16);
+      s.p1[2] = z;
+      s.width = 1.0;
+      }
+    else
+      {
+      // Short drag of a round brush
+      s.p1[0] = min(vol.nx - 9.0, s.p0[0] + rnd() * 24);
+      s.p1[1] = min(vol.ny - 9.0, s.p0[1] + rnd() * 24);
+      s.p1[2] = min(vol.nz - 9.0, z + rnd() * 2);
+      s.width = 6.0;
+      }
+    s.label = LabelType(1 + i % 6);
+    strokes.push_back(s);
+    }
+  return strokes;
+}
+
+RegionType strokeRegion(const Stroke &s)
+{
+  RegionType region;
+  for(int d = 0; d < 3; d++)
+    {
+    long a = (long) floor(min(s.p0[d], s.p1[d]) - s.width);
+    long b = (long) ceil(max(s.p0[d], s.p1[d]) + s.width);
+    region.SetIndex(d, a);
+    region.SetSize(d, b - a + 1);
+    }
+  return region;
+}
+
+bool inStroke(const Stroke &s, double x, double y, double z)
+{
+  double u[3] = { s.p1[0] - s.p0[0], s.p1[1] - s.p0[1], s.p1[2] - s.p0[2] };
+  double v[3] = { x - s.p0[0], y - s.p0[1], z - s.p0[2] };
+  double uu = u[0] * u[0] + u[1] * u[1] + u[2] * u[2];
+  double t = uu > 0 ? (u[0] * v[0] + u[1] * v[1] + u[2] * v[2]) / uu : 0;
+  t = max(0.0, min(1.0, t));
+  double d2 = 0;
+  for(int d = 0; d < 3; d++)
+    d2 += (v[d] - t * u[d]) * (v[d] - t * u[d]);
+  return d2 <= s.width * s.width;
+}
+
+// The labels of the whole volume, for checking that undo restores them
+vector<LabelType> labels(Volume &vol)
+{
+  LabelImageType *img = vol.seg->GetModifiableImage();
+  vector<LabelType> data;
+  data.reserve(img->GetBufferedRegion().GetNumberOfPixels());
+  for(itk::ImageRegionConstIterator<LabelImageType> it(img, img->GetBufferedRegion());
+      !it.IsAtEnd(); ++it)
+    data.push_back(it.Get());
+  return data;
+}
+
+// Paint a stroke with SegmentationUpdateIterator, which encodes the runs of
+// changed voxels into a sparse delta
+Delta *paintSparse(Volume &vol, const Stroke &s, const RegionType &region)
+{
+  SegmentationUpdateIterator it(vol.seg, region, s.label, DrawOverFilter());
+  for(; !it.IsAtEnd(); ++it)
+    {
+    const itk::Index<3> &idx = it.GetIndex();
+    if(inStroke(s, idx[0], idx[1], idx[2]))
+      it.PaintAsForeground();
+    }
+
+  if(!it.Finalize())
+    return NULL;
+  return it.RelinquishDelta();
+}
+
+// Paint a stroke encoding the difference at every voxel of the region into
+// a dense delta, for comparison
+Delta *paintDense(Volume &vol, const Stroke &s, const RegionType &region)
+{
+  Delta *delta = new Delta();
+  delta->SetRegion(region);
+
+  itk::ImageRegionIteratorWithIndex<LabelImageType> it(vol.seg->GetModifiableImage(), region);
+  for(; !it.IsAtEnd(); ++it)
+    {
+    const itk::Index<3> &idx = it.GetIndex();
+    LabelType v = it.Get(), d = 0;
+    if(inStroke(s, idx[0], idx[1], idx[2]) && v != s.label)
+      {
+      d = s.label - v;
+      it.Set(s.label);
+      }
+    delta->Encode(d);
+    }
+  delta->FinishEncoding();
+  vol.seg->GetModifiableImage()->Modified();
+  return delta;
+}
+
+double msSince(chrono::steady_clock::time_point t0)
+{
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+bool run(const char *name, Volume &vol, const vector<Stroke> &strokes, bool sparse)
+{
+  vector<LabelType> original = labels(vol);
+  vol.seg->ClearUndoPoints();
+
+  size_t bytes = 0, rles = 0;
+  auto t0 = chrono::steady_clock::now();
+  for(size_t i = 0; i < strokes.size(); i++)
+    {
+    RegionType region = strokeRegion(strokes[i]);
+    Delta *delta = sparse
+        ? paintSparse(vol, strokes[i], region)
+        : paintDense(vol, strokes[i], region);
+    if(!delta)
+      continue;
+
+    bytes += delta->GetMemorySize();
+    rles += delta->GetNumberOfRLEs();
+    vol.seg->StoreUndoPoint("stroke", delta);
+    }
+  double tCommit = msSince(t0);
+
+  t0 = chrono::steady_clock::now();
+  while(vol.seg->IsUndoPossible())
+    vol.seg->Undo();
+  double tUndo = msSince(t0);
+
+  bool ok = (labels(vol) == original);
+  cout << setw(10) << left << name << setw(8) << (sparse ? "sparse" : "dense")
+       << setw(12) << right << fixed << setprecision(2) << tCommit
+       << setw(14) << tCommit * 1000.0 / strokes.size()
+       << setw(12) << rles
+       << setw(14) << bytes / 1024
+       << setw(12) << tUndo
+       << (ok ? "" : "   UNDO MISMATCH") << endl;
+  return ok;
+}
+
+// A single brush dab in a large bounding box, as when the region of an update
+// is the whole slice or volume. The sparse delta must be encoded once per run
+// of changed voxels, not once per voxel of the box.
+bool checkSmallStrokeInLargeBox(Volume &vol)
+{
+  vector<LabelType> original = labels(vol);
+  vol.seg->ClearUndoPoints();
+
+  Stroke s;
+  s.p0[0] = s.p1[0] = vol.nx / 2;
+  s.p0[1] = s.p1[1] = vol.ny / 2;
+  s.p0[2] = s.p1[2] = vol.nz / 2;
+  s.width = 2.0;
+  s.label = 7;
+
+  // Count the lines of the dab that change, which bound the number of runs
+  LabelImageType *img = vol.seg->GetModifiableImage();
+  size_t changedLines = 0, changedVoxels = 0;
+  RegionType dab = strokeRegion(s);
+  for(long z = dab.GetIndex(2); z < dab.GetIndex(2) + (long) dab.GetSize(2); z++)
+    for(long y = dab.GetIndex(1); y < dab.GetIndex(1) + (long) dab.GetSize(1); y++)
+      {
+      size_t n = 0;
+      for(long x = dab.GetIndex(0); x < dab.GetIndex(0) + (long) dab.GetSize(0); x++)
+        {
+        itk::Index<3> idx = {{ x, y, z }};
+        if(inStroke(s, x, y, z) && img->GetPixel(idx) != s.label)
+          n++;
+        }
+      changedVoxels += n;
+      changedLines += (n > 0);
+      }
+
+  // Paint the dab with the whole volume as the region of the update
+  auto t0 = chrono::steady_clock::now();
+  Delta *delta = paintSparse(vol, s, img->GetBufferedRegion());
+  double tCommit = msSince(t0);
+  if(!delta)
+    {
+    cout << "Dab changed no voxels   FAILED" << endl;
+    return false;
+    }
+
+  size_t calls = delta->GetNumberOfEncodeCalls();
+  bool ok = changedVoxels > 0 && calls >= changedLines && calls <= changedVoxels;
+
+  cout << "Dab in " << img->GetBufferedRegion().GetNumberOfPixels() << " voxel box: "
+       << changedVoxels << " voxels changed on " << changedLines << " lines, " << calls
+       << " encode calls, " << delta->GetNumberOfRLEs() << " RLEs, "
+       << fixed << setprecision(2) << tCommit << " ms";
+
+  // Undo must restore the volume
+  vol.seg->StoreUndoPoint("dab", delta);
+  vol.seg->Undo();
+  ok &= (labels(vol) == original);
+
+  cout << (ok ? "" : "   FAILED") << endl << endl;
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  Volume vol;
+  vol.nx = argc > 3 ? atoi(argv[1]) : 512;
+  vol.ny = argc > 3 ? atoi(argv[2]) : 512;
+  vol.nz = argc > 3 ? atoi(argv[3]) : 200;
+  int nStrokes = argc > 4 ? atoi(argv[4]) : 200;
+
+  // Background with a few existing labels, so deltas are not all one value
+  typedef LabelImageWrapper::Image4DType Image4DType;
+  Image4DType::Pointer img = Image4DType::New();
+  Image4DType::SizeType size = {{ (itk::SizeValueType) vol.nx, (itk::SizeValueType) vol.ny,
+                                  (itk::SizeValueType) vol.nz, 1 }};
+  img->SetRegions(Image4DType::RegionType(size));
+  img->Allocate();
+  size_t i = 0;
+  for(itk::ImageRegionIterator<Image4DType> it(img, img->GetBufferedRegion()); !it.IsAtEnd(); ++it, ++i)
+    it.Set(LabelType((i / 4096) % 3));
+
+  vol.seg = LabelImageWrapper::New();
+  vol.seg->SetImage4D(img);
+
+  cout << "Volume " << vol.nx << "x" << vol.ny << "x" << vol.nz << ", "
+       << nStrokes << " strokes per set" << endl << endl;
+
+  bool ok = checkSmallStrokeInLargeBox(vol);
+
+  cout << setw(10) << left << "Strokes" << setw(8) << "Delta"
+       << setw(12) << right << "Commit ms" << setw(14) << "us/stroke"
+       << setw(12) << "RLEs" << setw(14) << "Delta KB" << setw(12) << "Undo ms" << endl;
+
+  vector<Stroke> brush = makeStrokes(vol, nStrokes, false);
+  vector<Stroke> polygon = makeStrokes(vol, nStrokes, true);
+  ok &= run("brush", vol, brush, false);
+  ok &= run("brush", vol, brush, true);
+  ok &= run("polygon", vol, polygon, false);
+  ok &= run("polygon", vol, polygon, true);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}